@@ -0,0 +1,992 @@
+#include "bcn.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+/*
+* BC7 partition tables, straight out of the D3D11 functional spec.  The
+* two-subset table is a bitmask (bit i set means texel i is in subset 1);
+* the three-subset table packs two bits per texel.
+*/
+static const uint16_t bc7_partition2[64] = {
+    0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+    0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+    0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+    0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+    0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+    0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+    0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+    0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+};
+
+static const uint32_t bc7_partition3[64] = {
+    0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050,
+    0x5555a0a0, 0x5a5a5050, 0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090,
+    0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250, 0xa5945040, 0x0a425054,
+    0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+    0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414,
+    0x50a4a450, 0x6a5a0200, 0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424,
+    0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50, 0x500aa550, 0xaaaa4444,
+    0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+    0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580,
+    0xaa141414, 0x96960000, 0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000,
+    0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+};
+
+/* The texel whose index drops its top bit, for subsets other than 0. */
+static const uint8_t bc7_anchor2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+    15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+    6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+};
+
+static const uint8_t bc7_anchor3a[64] = {
+    3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+    3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+    8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+    3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3
+};
+
+static const uint8_t bc7_anchor3b[64] = {
+    15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+    15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+    15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+    15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8
+};
+
+static const uint8_t bc7_weights2[4] = { 0, 21, 43, 64 };
+static const uint8_t bc7_weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const uint8_t bc7_weights4[16] = {
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+};
+
+struct BC7Mode {
+    uint8_t subsets;
+    uint8_t partition_bits;
+    uint8_t rotation_bits;
+    uint8_t selector_bits;
+    uint8_t color_bits;
+    uint8_t alpha_bits;
+    uint8_t endpoint_pbits;
+    uint8_t shared_pbits;
+    uint8_t index_bits;
+    uint8_t index2_bits;
+};
+
+static const BC7Mode bc7_modes[8] = {
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+};
+
+/* Reads a BC7 block LSB first. */
+class BlockBits {
+public:
+    BlockBits(const unsigned char* block) : m_pos(0)
+    {
+        m_lo = 0;
+        m_hi = 0;
+        for (int i = 7; i >= 0; i--) {
+            m_lo = (m_lo << 8) | block[i];
+            m_hi = (m_hi << 8) | block[i + 8];
+        }
+    }
+
+    uint32_t Read(uint32_t count)
+    {
+        if (count == 0) {
+            return 0;
+        }
+
+        uint64_t v;
+        if (m_pos < 64) {
+            v = m_lo >> m_pos;
+            if (m_pos + count > 64) {
+                v |= m_hi << (64 - m_pos);
+            }
+        } else {
+            v = m_hi >> (m_pos - 64);
+        }
+
+        m_pos += count;
+        return static_cast<uint32_t>(v) & ((1u << count) - 1);
+    }
+
+private:
+    uint64_t m_lo, m_hi;
+    uint32_t m_pos;
+};
+
+static const uint8_t* bc7_weights(uint32_t bits)
+{
+    switch (bits) {
+    case 2:
+        return bc7_weights2;
+    case 3:
+        return bc7_weights3;
+    default:
+        return bc7_weights4;
+    }
+}
+
+/*
+* Fills 'count' (always even) RGBA8 palette entries with the BC7 blend
+* ((64 - w) * e0 + w * e1 + 32) >> 6.  The SSE2 path does two entries at a
+* time with all four channels in 16-bit lanes.
+*/
+static void bc7_palette(const uint8_t* e0, const uint8_t* e1,
+  const uint8_t* weights, uint32_t count, unsigned char* out)
+{
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(32);
+    const __m128i sixtyfour = _mm_set1_epi16(64);
+
+    uint32_t p0, p1;
+    std::memcpy(&p0, e0, 4);
+    std::memcpy(&p1, e1, 4);
+    __m128i a = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(p0)), zero);
+    __m128i b = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(p1)), zero);
+
+    for (uint32_t i = 0; i < count; i += 2) {
+        __m128i w = _mm_setr_epi16(weights[i], weights[i], weights[i],
+          weights[i], weights[i + 1], weights[i + 1], weights[i + 1],
+          weights[i + 1]);
+        __m128i iw = _mm_sub_epi16(sixtyfour, w);
+        __m128i v = _mm_add_epi16(_mm_mullo_epi16(a, iw),
+          _mm_mullo_epi16(b, w));
+        v = _mm_srli_epi16(_mm_add_epi16(v, round), 6);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i * 4),
+          _mm_packus_epi16(v, v));
+    }
+#else
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t w = weights[i];
+        for (uint32_t c = 0; c < 4; c++) {
+            out[i * 4 + c] = static_cast<unsigned char>(
+              ((64 - w) * e0[c] + w * e1[c] + 32) >> 6);
+        }
+    }
+#endif
+}
+
+/*
+* The four-colour BC1 palette: the two endpoints plus the 1/3 and 2/3
+* blends.  In SSE2 both blends come out of one multiply; the divide by
+* three is a multiply-high by 0x5556, which is exact for these ranges.
+*/
+static void bc1_blend(const uint8_t* e0, const uint8_t* e1,
+  unsigned char* out)
+{
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+
+    uint32_t p0, p1;
+    std::memcpy(&p0, e0, 4);
+    std::memcpy(&p1, e1, 4);
+    __m128i a = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(p0)), zero);
+    __m128i b = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(p1)), zero);
+
+    __m128i v = _mm_add_epi16(
+      _mm_mullo_epi16(a, _mm_setr_epi16(2, 2, 2, 2, 1, 1, 1, 1)),
+      _mm_mullo_epi16(b, _mm_setr_epi16(1, 1, 1, 1, 2, 2, 2, 2)));
+    v = _mm_mulhi_epu16(v, _mm_set1_epi16(0x5556));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out),
+      _mm_packus_epi16(v, v));
+#else
+    for (uint32_t c = 0; c < 4; c++) {
+        out[c] = static_cast<unsigned char>((2 * e0[c] + e1[c]) / 3);
+        out[4 + c] = static_cast<unsigned char>((e0[c] + 2 * e1[c]) / 3);
+    }
+#endif
+}
+
+static void expand565(uint16_t c, uint8_t* out)
+{
+    uint32_t r = (c >> 11) & 0x1f;
+    uint32_t g = (c >> 5) & 0x3f;
+    uint32_t b = c & 0x1f;
+
+    out[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+    out[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+    out[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+    out[3] = 0xff;
+}
+
+static void write_block(const unsigned char* texels, unsigned char* out,
+  size_t pitch)
+{
+    for (uint32_t y = 0; y < 4; y++) {
+        std::memcpy(out + y * pitch, texels + y * 16, 16);
+    }
+}
+
+/*
+* Decodes the colour half of a BC1/BC3 block into 'texels'.  BC3 always
+* uses the four-colour palette, no matter how the endpoints are ordered.
+*/
+static void decode_bc1_color(const unsigned char* block, bool three_color,
+  unsigned char* texels)
+{
+    uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+    uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+
+    unsigned char palette[16];
+    expand565(c0, palette);
+    expand565(c1, palette + 4);
+
+    if (c0 > c1 || !three_color) {
+        bc1_blend(palette, palette + 4, palette + 8);
+    } else {
+        for (uint32_t c = 0; c < 4; c++) {
+            palette[8 + c] = static_cast<unsigned char>(
+              (palette[c] + palette[4 + c]) / 2);
+            palette[12 + c] = 0;
+        }
+    }
+
+    uint32_t indices = static_cast<uint32_t>(block[4]) |
+      (static_cast<uint32_t>(block[5]) << 8) |
+      (static_cast<uint32_t>(block[6]) << 16) |
+      (static_cast<uint32_t>(block[7]) << 24);
+
+    for (uint32_t i = 0; i < 16; i++) {
+        std::memcpy(texels + i * 4, palette + ((indices >> (i * 2)) & 3) * 4,
+          4);
+    }
+}
+
+void DecodeBC1Block(const unsigned char* block, unsigned char* out,
+  size_t pitch)
+{
+    unsigned char texels[64];
+    decode_bc1_color(block, true, texels);
+    write_block(texels, out, pitch);
+}
+
+void DecodeBC3Block(const unsigned char* block, unsigned char* out,
+  size_t pitch)
+{
+    unsigned char texels[64];
+    decode_bc1_color(block + 8, false, texels);
+
+    uint32_t a0 = block[0];
+    uint32_t a1 = block[1];
+    unsigned char alpha[8];
+    alpha[0] = static_cast<unsigned char>(a0);
+    alpha[1] = static_cast<unsigned char>(a1);
+    if (a0 > a1) {
+        for (uint32_t i = 1; i < 7; i++) {
+            alpha[i + 1] = static_cast<unsigned char>(
+              ((7 - i) * a0 + i * a1) / 7);
+        }
+    } else {
+        for (uint32_t i = 1; i < 5; i++) {
+            alpha[i + 1] = static_cast<unsigned char>(
+              ((5 - i) * a0 + i * a1) / 5);
+        }
+        alpha[6] = 0;
+        alpha[7] = 0xff;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 7; i >= 2; i--) {
+        indices = (indices << 8) | block[i];
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+        texels[i * 4 + 3] = alpha[(indices >> (i * 3)) & 7];
+    }
+
+    write_block(texels, out, pitch);
+}
+
+void DecodeBC7Block(const unsigned char* block, unsigned char* out,
+  size_t pitch)
+{
+    unsigned char texels[64];
+
+    uint32_t mode = 0;
+    while (mode < 8 && !(block[0] & (1 << mode))) {
+        mode++;
+    }
+
+    /* Reserved mode: the spec says to decode to transparent black. */
+    if (mode == 8) {
+        std::memset(texels, 0, sizeof(texels));
+        write_block(texels, out, pitch);
+        return;
+    }
+
+    const BC7Mode& m = bc7_modes[mode];
+    BlockBits bits(block);
+    bits.Read(mode + 1);
+
+    uint32_t partition = bits.Read(m.partition_bits);
+    uint32_t rotation = bits.Read(m.rotation_bits);
+    uint32_t selector = bits.Read(m.selector_bits);
+
+    uint32_t endpoints = m.subsets * 2u;
+    uint8_t ep[6][4];
+    for (uint32_t c = 0; c < 3; c++) {
+        for (uint32_t e = 0; e < endpoints; e++) {
+            ep[e][c] = static_cast<uint8_t>(bits.Read(m.color_bits));
+        }
+    }
+    for (uint32_t e = 0; e < endpoints; e++) {
+        ep[e][3] = static_cast<uint8_t>(bits.Read(m.alpha_bits));
+    }
+
+    uint32_t pbits[6] = { 0, 0, 0, 0, 0, 0 };
+    bool has_pbits = m.endpoint_pbits || m.shared_pbits;
+    if (m.endpoint_pbits) {
+        for (uint32_t e = 0; e < endpoints; e++) {
+            pbits[e] = bits.Read(1);
+        }
+    } else if (m.shared_pbits) {
+        for (uint32_t s = 0; s < m.subsets; s++) {
+            pbits[s * 2] = pbits[s * 2 + 1] = bits.Read(1);
+        }
+    }
+
+    /* Unquantize: fold in the p-bit, then replicate the top bits down. */
+    for (uint32_t e = 0; e < endpoints; e++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            uint32_t width = c < 3 ? m.color_bits : m.alpha_bits;
+            if (width == 0) {
+                ep[e][c] = 0xff;
+                continue;
+            }
+
+            uint32_t v = ep[e][c];
+            if (has_pbits) {
+                v = (v << 1) | pbits[e];
+                width++;
+            }
+
+            v <<= 8 - width;
+            ep[e][c] = static_cast<uint8_t>(v | (v >> width));
+        }
+    }
+
+    uint8_t subset[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        if (m.subsets == 2) {
+            subset[i] = (bc7_partition2[partition] >> i) & 1;
+        } else if (m.subsets == 3) {
+            subset[i] = (bc7_partition3[partition] >> (i * 2)) & 3;
+        } else {
+            subset[i] = 0;
+        }
+    }
+
+    uint8_t index[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        bool anchor = i == 0;
+        if (m.subsets == 2) {
+            anchor = anchor || i == bc7_anchor2[partition];
+        } else if (m.subsets == 3) {
+            anchor = anchor || i == bc7_anchor3a[partition] ||
+              i == bc7_anchor3b[partition];
+        }
+        index[i] = static_cast<uint8_t>(
+          bits.Read(anchor ? m.index_bits - 1u : m.index_bits));
+    }
+
+    uint8_t index2[16];
+    if (m.index2_bits) {
+        for (uint32_t i = 0; i < 16; i++) {
+            index2[i] = static_cast<uint8_t>(
+              bits.Read(i == 0 ? m.index2_bits - 1u : m.index2_bits));
+        }
+    }
+
+    unsigned char palette[3][64];
+    for (uint32_t s = 0; s < m.subsets; s++) {
+        bc7_palette(ep[s * 2], ep[s * 2 + 1], bc7_weights(m.index_bits),
+          1u << m.index_bits, palette[s]);
+    }
+
+    if (m.index2_bits == 0) {
+        for (uint32_t i = 0; i < 16; i++) {
+            std::memcpy(texels + i * 4, palette[subset[i]] + index[i] * 4, 4);
+        }
+    } else {
+        /*
+        * Modes 4 and 5 carry colour and alpha indices separately.  Mode 4's
+        * selector bit swaps which of the two sets drives colour.
+        */
+        unsigned char palette2[64];
+        bc7_palette(ep[0], ep[1], bc7_weights(m.index2_bits),
+          1u << m.index2_bits, palette2);
+
+        for (uint32_t i = 0; i < 16; i++) {
+            const unsigned char* color = palette[0] + index[i] * 4;
+            const unsigned char* alpha = palette2 + index2[i] * 4;
+            if (selector) {
+                std::swap(color, alpha);
+            }
+
+            std::memcpy(texels + i * 4, color, 3);
+            texels[i * 4 + 3] = alpha[3];
+        }
+    }
+
+    if (rotation) {
+        for (uint32_t i = 0; i < 16; i++) {
+            std::swap(texels[i * 4 + 3], texels[i * 4 + rotation - 1]);
+        }
+    }
+
+    write_block(texels, out, pitch);
+}
+
+bool DecompressImage(const MipImage* in, MipImage* out)
+{
+    void (*decode)(const unsigned char*, unsigned char*, size_t) = nullptr;
+    switch (in->format) {
+    case MipImage::BC1:
+        decode = DecodeBC1Block;
+        break;
+    case MipImage::BC3:
+        decode = DecodeBC3Block;
+        break;
+    case MipImage::BC7:
+        decode = DecodeBC7Block;
+        break;
+    default:
+        return false;
+    }
+
+    out->format = MipImage::RGBA8;
+    out->srgb = in->srgb;
+    MipImageLayout(out, in->width, in->height,
+      static_cast<uint32_t>(in->levels.size()));
+
+    size_t block_bytes = MipImageBlockBytes(in->format);
+    for (size_t l = 0; l < in->levels.size(); l++) {
+        const MipImage::Level& src = in->levels[l];
+        const MipImage::Level& dst = out->levels[l];
+        const unsigned char* block = MipImageBytes(in) + src.offset;
+        size_t pitch = static_cast<size_t>(dst.width) * 4;
+
+        for (uint32_t y = 0; y < src.height; y += 4) {
+            for (uint32_t x = 0; x < src.width; x += 4) {
+                unsigned char* texel = out->data.data() + dst.offset +
+                  y * pitch + x * 4;
+
+                if (x + 4 <= dst.width && y + 4 <= dst.height) {
+                    decode(block, texel, pitch);
+                } else {
+                    /* Ragged edge: decode aside and keep what fits. */
+                    unsigned char scratch[64];
+                    decode(block, scratch, 16);
+
+                    uint32_t cols = std::min(4u, dst.width - x);
+                    uint32_t rows = std::min(4u, dst.height - y);
+                    for (uint32_t r = 0; r < rows; r++) {
+                        std::memcpy(texel + r * pitch, scratch + r * 16,
+                          cols * 4);
+                    }
+                }
+
+                block += block_bytes;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+* Encoder side.  Blocks are worked on as floats, one array per channel, so
+* that four texels fit in an SSE register.
+*/
+struct BlockTexels {
+    float c[4][16];
+};
+
+static void load_block(const unsigned char* rgba, size_t pitch,
+  BlockTexels* out)
+{
+    for (uint32_t y = 0; y < 4; y++) {
+        const unsigned char* row = rgba + y * pitch;
+        for (uint32_t x = 0; x < 4; x++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                out->c[c][y * 4 + x] = row[x * 4 + c];
+            }
+        }
+    }
+}
+
+/*
+* Picks the closest palette entry for every texel and returns the total
+* squared error.  Only the first 'channels' channels count towards the
+* distance.  'palette' holds 'count' RGBA8 entries.
+*/
+static float select_indices(const BlockTexels* px, const unsigned char* palette,
+  uint32_t count, uint32_t channels, uint8_t* indices)
+{
+    float total = 0.0f;
+
+#if defined(__SSE2__)
+    for (uint32_t g = 0; g < 16; g += 4) {
+        __m128 best = _mm_set1_ps(1e30f);
+        __m128i best_index = _mm_setzero_si128();
+
+        for (uint32_t i = 0; i < count; i++) {
+            __m128 dist = _mm_setzero_ps();
+            for (uint32_t c = 0; c < channels; c++) {
+                __m128 d = _mm_sub_ps(_mm_loadu_ps(&px->c[c][g]),
+                  _mm_set1_ps(palette[i * 4 + c]));
+                dist = _mm_add_ps(dist, _mm_mul_ps(d, d));
+            }
+
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(dist, best));
+            best = _mm_min_ps(dist, best);
+            best_index = _mm_or_si128(
+              _mm_and_si128(closer, _mm_set1_epi32(static_cast<int>(i))),
+              _mm_andnot_si128(closer, best_index));
+        }
+
+        float errors[4];
+        int32_t chosen[4];
+        _mm_storeu_ps(errors, best);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(chosen), best_index);
+        for (uint32_t k = 0; k < 4; k++) {
+            indices[g + k] = static_cast<uint8_t>(chosen[k]);
+            total += errors[k];
+        }
+    }
+#else
+    for (uint32_t t = 0; t < 16; t++) {
+        float best = 1e30f;
+        for (uint32_t i = 0; i < count; i++) {
+            float dist = 0.0f;
+            for (uint32_t c = 0; c < channels; c++) {
+                float d = px->c[c][t] - palette[i * 4 + c];
+                dist += d * d;
+            }
+            if (dist < best) {
+                best = dist;
+                indices[t] = static_cast<uint8_t>(i);
+            }
+        }
+        total += best;
+    }
+#endif
+
+    return total;
+}
+
+/*
+* Endpoints at the extremes of the block's principal axis.  The axis comes
+* from a few rounds of power iteration on the covariance matrix, starting
+* from the bounding box diagonal.
+*/
+static void fit_axis(const BlockTexels* px, uint32_t channels, float* e0,
+  float* e1)
+{
+    float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float lo[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+    float hi[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (uint32_t c = 0; c < channels; c++) {
+        for (uint32_t t = 0; t < 16; t++) {
+            mean[c] += px->c[c][t];
+            lo[c] = std::min(lo[c], px->c[c][t]);
+            hi[c] = std::max(hi[c], px->c[c][t]);
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float cov[4][4] = {};
+    for (uint32_t t = 0; t < 16; t++) {
+        for (uint32_t i = 0; i < channels; i++) {
+            for (uint32_t j = i; j < channels; j++) {
+                cov[i][j] += (px->c[i][t] - mean[i]) * (px->c[j][t] - mean[j]);
+            }
+        }
+    }
+    for (uint32_t i = 0; i < channels; i++) {
+        for (uint32_t j = 0; j < i; j++) {
+            cov[i][j] = cov[j][i];
+        }
+    }
+
+    float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (uint32_t c = 0; c < channels; c++) {
+        axis[c] = hi[c] - lo[c];
+    }
+
+    for (uint32_t round = 0; round < 8; round++) {
+        float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float len = 0.0f;
+        for (uint32_t i = 0; i < channels; i++) {
+            for (uint32_t j = 0; j < channels; j++) {
+                next[i] += cov[i][j] * axis[j];
+            }
+            len = std::max(len, std::fabs(next[i]));
+        }
+        if (len < 1e-6f) {
+            break;
+        }
+        for (uint32_t c = 0; c < channels; c++) {
+            axis[c] = next[c] / len;
+        }
+    }
+
+    float tmin = 1e30f;
+    float tmax = -1e30f;
+    float len2 = 0.0f;
+    for (uint32_t c = 0; c < channels; c++) {
+        len2 += axis[c] * axis[c];
+    }
+
+    if (len2 < 1e-12f) {
+        /* Solid block, or near enough. */
+        for (uint32_t c = 0; c < 4; c++) {
+            e0[c] = e1[c] = c < channels ? mean[c] : 255.0f;
+        }
+        return;
+    }
+
+    for (uint32_t t = 0; t < 16; t++) {
+        float d = 0.0f;
+        for (uint32_t c = 0; c < channels; c++) {
+            d += (px->c[c][t] - mean[c]) * axis[c];
+        }
+        tmin = std::min(tmin, d);
+        tmax = std::max(tmax, d);
+    }
+
+    for (uint32_t c = 0; c < 4; c++) {
+        if (c < channels) {
+            e0[c] = mean[c] + axis[c] * tmin / len2;
+            e1[c] = mean[c] + axis[c] * tmax / len2;
+        } else {
+            e0[c] = e1[c] = 255.0f;
+        }
+    }
+}
+
+/*
+* Least squares endpoints for a fixed set of indices, where index i sits at
+* weights[i] of the way from e0 to e1.  Returns false when every texel
+* picked the same weight and the system is singular.
+*/
+static bool refine_endpoints(const BlockTexels* px, const uint8_t* indices,
+  const float* weights, uint32_t channels, float* e0, float* e1)
+{
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float x[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float y[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    for (uint32_t t = 0; t < 16; t++) {
+        float w = weights[indices[t]];
+        float iw = 1.0f - w;
+        a += iw * iw;
+        b += iw * w;
+        c += w * w;
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            x[ch] += iw * px->c[ch][t];
+            y[ch] += w * px->c[ch][t];
+        }
+    }
+
+    float det = a * c - b * b;
+    if (std::fabs(det) < 1e-6f) {
+        return false;
+    }
+
+    for (uint32_t ch = 0; ch < channels; ch++) {
+        float lo = (c * x[ch] - b * y[ch]) / det;
+        float hi = (a * y[ch] - b * x[ch]) / det;
+        e0[ch] = std::min(255.0f, std::max(0.0f, lo));
+        e1[ch] = std::min(255.0f, std::max(0.0f, hi));
+    }
+
+    return true;
+}
+
+static uint16_t quantize565(const float* e)
+{
+    uint32_t r = static_cast<uint32_t>(e[0] * 31.0f / 255.0f + 0.5f);
+    uint32_t g = static_cast<uint32_t>(e[1] * 63.0f / 255.0f + 0.5f);
+    uint32_t b = static_cast<uint32_t>(e[2] * 31.0f / 255.0f + 0.5f);
+
+    return static_cast<uint16_t>((std::min(r, 31u) << 11) |
+      (std::min(g, 63u) << 5) | std::min(b, 31u));
+}
+
+/* Same palette the decoder builds, so the error we measure is the real one. */
+static void bc1_palette(uint16_t c0, uint16_t c1, unsigned char* palette)
+{
+    expand565(c0, palette);
+    expand565(c1, palette + 4);
+    bc1_blend(palette, palette + 4, palette + 8);
+}
+
+void EncodeBC1Block(const unsigned char* rgba, size_t pitch,
+  unsigned char* block)
+{
+    static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    BlockTexels px;
+    load_block(rgba, pitch, &px);
+
+    float e0[4], e1[4];
+    fit_axis(&px, 3, e0, e1);
+
+    uint16_t c0 = quantize565(e0);
+    uint16_t c1 = quantize565(e1);
+    unsigned char palette[16];
+    uint8_t indices[16];
+    bc1_palette(c0, c1, palette);
+    float error = select_indices(&px, palette, 4, 3, indices);
+
+    for (uint32_t pass = 0; pass < 2 && error > 0.0f; pass++) {
+        if (!refine_endpoints(&px, indices, weights, 3, e0, e1)) {
+            break;
+        }
+
+        uint16_t r0 = quantize565(e0);
+        uint16_t r1 = quantize565(e1);
+        uint8_t trial[16];
+        bc1_palette(r0, r1, palette);
+        float e = select_indices(&px, palette, 4, 3, trial);
+        if (e >= error) {
+            break;
+        }
+
+        c0 = r0;
+        c1 = r1;
+        error = e;
+        std::memcpy(indices, trial, sizeof(indices));
+    }
+
+    /* Four-colour mode needs c0 > c1.  Swapping flips 0<->1 and 2<->3. */
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        for (uint32_t t = 0; t < 16; t++) {
+            indices[t] ^= 1;
+        }
+    } else if (c0 == c1) {
+        std::memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t packed = 0;
+    for (uint32_t t = 0; t < 16; t++) {
+        packed |= static_cast<uint32_t>(indices[t]) << (t * 2);
+    }
+
+    block[0] = static_cast<unsigned char>(c0 & 0xff);
+    block[1] = static_cast<unsigned char>(c0 >> 8);
+    block[2] = static_cast<unsigned char>(c1 & 0xff);
+    block[3] = static_cast<unsigned char>(c1 >> 8);
+    block[4] = static_cast<unsigned char>(packed & 0xff);
+    block[5] = static_cast<unsigned char>((packed >> 8) & 0xff);
+    block[6] = static_cast<unsigned char>((packed >> 16) & 0xff);
+    block[7] = static_cast<unsigned char>(packed >> 24);
+}
+
+/*
+* Mode 6 endpoints are 7 bits per channel plus a p-bit shared by the whole
+* endpoint, which makes an exact 8-bit value (q << 1 | p).  Both p-bits are
+* tried and the closer one wins.
+*/
+static void quantize_mode6(const float* e, uint8_t* q, uint32_t* pbit,
+  uint8_t* actual)
+{
+    float best = 1e30f;
+    for (uint32_t p = 0; p < 2; p++) {
+        uint8_t trial[4];
+        float err = 0.0f;
+        for (uint32_t c = 0; c < 4; c++) {
+            int v = static_cast<int>((e[c] - p) / 2.0f + 0.5f);
+            v = std::min(127, std::max(0, v));
+            trial[c] = static_cast<uint8_t>(v);
+            float d = static_cast<float>(v * 2 + static_cast<int>(p)) - e[c];
+            err += d * d;
+        }
+        if (err < best) {
+            best = err;
+            pbit[0] = p;
+            std::memcpy(q, trial, 4);
+        }
+    }
+
+    for (uint32_t c = 0; c < 4; c++) {
+        actual[c] = static_cast<uint8_t>((q[c] << 1) | pbit[0]);
+    }
+}
+
+class BlockWriter {
+public:
+    BlockWriter() : m_lo(0), m_hi(0), m_pos(0) {}
+
+    void Write(uint64_t value, uint32_t count)
+    {
+        if (m_pos < 64) {
+            m_lo |= value << m_pos;
+            if (m_pos + count > 64) {
+                m_hi |= value >> (64 - m_pos);
+            }
+        } else {
+            m_hi |= value << (m_pos - 64);
+        }
+        m_pos += count;
+    }
+
+    void Store(unsigned char* block)
+    {
+        for (uint32_t i = 0; i < 8; i++) {
+            block[i] = static_cast<unsigned char>(m_lo >> (i * 8));
+            block[i + 8] = static_cast<unsigned char>(m_hi >> (i * 8));
+        }
+    }
+
+private:
+    uint64_t m_lo, m_hi;
+    uint32_t m_pos;
+};
+
+void EncodeBC7Block(const unsigned char* rgba, size_t pitch,
+  unsigned char* block)
+{
+    float weights[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        weights[i] = bc7_weights4[i] / 64.0f;
+    }
+
+    BlockTexels px;
+    load_block(rgba, pitch, &px);
+
+    float e0[4], e1[4];
+    fit_axis(&px, 4, e0, e1);
+
+    uint8_t q[2][4], actual[2][4];
+    uint32_t pbits[2];
+    quantize_mode6(e0, q[0], &pbits[0], actual[0]);
+    quantize_mode6(e1, q[1], &pbits[1], actual[1]);
+
+    unsigned char palette[64];
+    uint8_t indices[16];
+    bc7_palette(actual[0], actual[1], bc7_weights4, 16, palette);
+    float error = select_indices(&px, palette, 16, 4, indices);
+
+    for (uint32_t pass = 0; pass < 2 && error > 0.0f; pass++) {
+        if (!refine_endpoints(&px, indices, weights, 4, e0, e1)) {
+            break;
+        }
+
+        uint8_t tq[2][4], ta[2][4];
+        uint32_t tp[2];
+        uint8_t trial[16];
+        quantize_mode6(e0, tq[0], &tp[0], ta[0]);
+        quantize_mode6(e1, tq[1], &tp[1], ta[1]);
+        bc7_palette(ta[0], ta[1], bc7_weights4, 16, palette);
+        float e = select_indices(&px, palette, 16, 4, trial);
+        if (e >= error) {
+            break;
+        }
+
+        error = e;
+        std::memcpy(q, tq, sizeof(q));
+        std::memcpy(pbits, tp, sizeof(pbits));
+        std::memcpy(indices, trial, sizeof(indices));
+    }
+
+    /* Texel 0's index only gets three bits, so its top bit has to be 0. */
+    if (indices[0] & 8) {
+        std::swap(q[0], q[1]);
+        std::swap(pbits[0], pbits[1]);
+        for (uint32_t t = 0; t < 16; t++) {
+            indices[t] = static_cast<uint8_t>(15 - indices[t]);
+        }
+    }
+
+    BlockWriter bits;
+    bits.Write(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+        bits.Write(q[0][c], 7);
+        bits.Write(q[1][c], 7);
+    }
+    bits.Write(pbits[0], 1);
+    bits.Write(pbits[1], 1);
+    bits.Write(indices[0], 3);
+    for (uint32_t t = 1; t < 16; t++) {
+        bits.Write(indices[t], 4);
+    }
+    bits.Store(block);
+}
+
+bool CompressImage(const MipImage* in, MipImage::Format format,
+  MipImage* out)
+{
+    void (*encode)(const unsigned char*, size_t, unsigned char*) = nullptr;
+    switch (format) {
+    case MipImage::BC1:
+        encode = EncodeBC1Block;
+        break;
+    case MipImage::BC7:
+        encode = EncodeBC7Block;
+        break;
+    default:
+        return false;
+    }
+
+    if (in->format != MipImage::RGBA8) {
+        return false;
+    }
+
+    out->format = format;
+    out->srgb = in->srgb;
+    MipImageLayout(out, in->width, in->height,
+      static_cast<uint32_t>(in->levels.size()));
+
+    size_t block_bytes = MipImageBlockBytes(format);
+    for (size_t l = 0; l < in->levels.size(); l++) {
+        const MipImage::Level& src = in->levels[l];
+        const MipImage::Level& dst = out->levels[l];
+        unsigned char* block = out->data.data() + dst.offset;
+        size_t pitch = static_cast<size_t>(src.width) * 4;
+
+        for (uint32_t y = 0; y < src.height; y += 4) {
+            for (uint32_t x = 0; x < src.width; x += 4) {
+                const unsigned char* texel = MipImageBytes(in) + src.offset +
+                  y * pitch + x * 4;
+
+                if (x + 4 <= src.width && y + 4 <= src.height) {
+                    encode(texel, pitch, block);
+                } else {
+                    /* Pad ragged edges by repeating the last row/column. */
+                    unsigned char scratch[64];
+                    for (uint32_t r = 0; r < 4; r++) {
+                        uint32_t sy = std::min(r, src.height - y - 1);
+                        for (uint32_t c = 0; c < 4; c++) {
+                            uint32_t sx = std::min(c, src.width - x - 1);
+                            std::memcpy(scratch + r * 16 + c * 4,
+                              texel + sy * pitch + sx * 4, 4);
+                        }
+                    }
+                    encode(scratch, 16, block);
+                }
+
+                block += block_bytes;
+            }
+        }
+    }
+
+    return true;
+}
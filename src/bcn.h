@@ -0,0 +1,50 @@
+#ifndef VKTEST_BCN_H
+#define VKTEST_BCN_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "dds.h"
+
+/*
+* Software decoders for the block-compressed formats, for devices that
+* don't expose textureCompressionBC.  Each call unpacks one 4x4 block into
+* RGBA8 texels, 'pitch' bytes apart row to row.
+*
+* The palette math uses SSE2 when the compiler has it (always true on
+* x86-64) and plain C++ otherwise.
+*/
+void DecodeBC1Block(const unsigned char* block, unsigned char* out,
+  size_t pitch);
+void DecodeBC3Block(const unsigned char* block, unsigned char* out,
+  size_t pitch);
+void DecodeBC7Block(const unsigned char* block, unsigned char* out,
+  size_t pitch);
+
+/*
+* Unpacks every level of a block-compressed image into an RGBA8 MipImage
+* with the same dimensions.  Returns false for anything that isn't BCn.
+*/
+bool DecompressImage(const MipImage* in, MipImage* out);
+
+/*
+* Encoders, used by vktest-cook.  BC1 is always written in four-colour
+* mode, so any alpha is lost; BC7 only uses mode 6 (one subset, RGBA with
+* 4-bit indices), which handles alpha and still decodes well for most
+* content.  Both fit endpoints to the block's principal axis, then refine
+* them with a least squares pass.  Index selection is SSE2 where it's
+* available.
+*/
+void EncodeBC1Block(const unsigned char* rgba, size_t pitch,
+  unsigned char* block);
+void EncodeBC7Block(const unsigned char* rgba, size_t pitch,
+  unsigned char* block);
+
+/*
+* The other direction of DecompressImage: every level of an RGBA8 image
+* gets packed into 'format' (BC1 or BC7).
+*/
+bool CompressImage(const MipImage* in, MipImage::Format format,
+  MipImage* out);
+
+#endif // VKTEST_BCN_H
@@ -0,0 +1,260 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#if defined(__linux__)
+  #include <sched.h>
+#elif defined(_WIN32)
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#endif
+
+#include "global.h"
+#include "timer.h"
+
+struct BenchOptions {
+    std::string filter;
+    uint32_t samples;
+    double warmup_ms;
+    double sample_ms;
+    int cpu;                    // -1 to leave the scheduler alone
+    bool csv;
+    bool list;
+};
+
+struct BenchSummary {
+    uint64_t iterations;        // per sample
+    double min_ns;
+    double median_ns;
+    double mean_ns;
+    double stddev_ns;
+    double max_ns;
+};
+
+static void print_help(void)
+{
+    std::stringstream out;
+    out << "Usage: vktest-bench [OPTIONS]" << std::endl << std::endl;
+    out << "Times the renderer's CPU hot paths; no GPU needed." << std::endl;
+    out << std::endl << "Options:" << std::endl;
+    out << "\t--filter=TEXT\tOnly run cases with TEXT in their name.";
+    out << std::endl;
+    out << "\t--samples=N\tSamples per case (" << BENCH_DEFAULT_SAMPLES;
+    out << ")." << std::endl;
+    out << "\t--warmup=MS\tRun each case this long before timing it (";
+    out << BENCH_DEFAULT_WARMUP_MS << ")." << std::endl;
+    out << "\t--min-time=MS\tShortest a sample may be (";
+    out << BENCH_DEFAULT_SAMPLE_MS << ")." << std::endl;
+    out << "\t--cpu=N\t\tPin to CPU N; -1 doesn't pin (default: the last ";
+    out << "CPU)." << std::endl;
+    out << "\t--csv\t\tPrint results as CSV." << std::endl;
+    out << "\t--list\t\tList the cases and exit." << std::endl;
+    out << "\t--help\t\tPrint this help message." << std::endl;
+
+    std::cout << out.str();
+}
+
+static bool parse_cli(BenchOptions* opts, int argc, char* argv[])
+{
+    uint32_t cpus = std::thread::hardware_concurrency();
+
+    opts->samples = BENCH_DEFAULT_SAMPLES;
+    opts->warmup_ms = BENCH_DEFAULT_WARMUP_MS;
+    opts->sample_ms = BENCH_DEFAULT_SAMPLE_MS;
+    opts->cpu = cpus > 0 ? static_cast<int>(cpus) - 1 : -1;
+    opts->csv = false;
+    opts->list = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--filter=", 9) == 0) {
+            opts->filter = arg + 9;
+        } else if (std::strncmp(arg, "--samples=", 10) == 0) {
+            opts->samples = std::max(1, std::atoi(arg + 10));
+        } else if (std::strncmp(arg, "--warmup=", 9) == 0) {
+            opts->warmup_ms = std::max(0.0, std::atof(arg + 9));
+        } else if (std::strncmp(arg, "--min-time=", 11) == 0) {
+            opts->sample_ms = std::max(1.0, std::atof(arg + 11));
+        } else if (std::strncmp(arg, "--cpu=", 6) == 0) {
+            opts->cpu = std::atoi(arg + 6);
+        } else if (std::strcmp(arg, "--csv") == 0) {
+            opts->csv = true;
+        } else if (std::strcmp(arg, "--list") == 0) {
+            opts->list = true;
+        } else if (std::strcmp(arg, "--help") == 0) {
+            print_help();
+            std::exit(EXIT_SUCCESS);
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+* Keeps the measurements off the scheduler's hands: migrating between
+* cores mid-sample throws away the caches and, on some machines, lands on
+* a core running at a different clock.
+*/
+static bool pin_cpu(int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+    return SetThreadAffinityMask(GetCurrentThread(),
+      static_cast<DWORD_PTR>(1) << cpu) != 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+static double time_ms(const BenchCase& c, uint64_t iterations)
+{
+    uint64_t start = Timer::Ticks();
+    c.run(iterations);
+    uint64_t end = Timer::Ticks();
+
+    return static_cast<double>(end - start) * 1000.0 /
+      static_cast<double>(Timer::Frequency());
+}
+
+static void run_case(const BenchCase& c, const BenchOptions& opts,
+  BenchSummary* out)
+{
+    /* Warm up with ever longer runs until the time is used up. */
+    uint64_t iterations = 1;
+    double elapsed = 0.0;
+    double last = time_ms(c, iterations);
+    elapsed += last;
+    while (elapsed < opts.warmup_ms && last < opts.sample_ms) {
+        iterations *= 2;
+        last = time_ms(c, iterations);
+        elapsed += last;
+    }
+
+    /* Then size a sample so that the clock's resolution doesn't matter. */
+    while (last < opts.sample_ms) {
+        double scale = last > 0.0 ? opts.sample_ms / last * 1.1 : 10.0;
+        scale = std::min(10.0, std::max(1.5, scale));
+        iterations = static_cast<uint64_t>(iterations * scale) + 1;
+        last = time_ms(c, iterations);
+    }
+
+    std::vector<double> ns;
+    for (uint32_t i = 0; i < opts.samples; i++) {
+        ns.push_back(time_ms(c, iterations) * 1e6 / iterations);
+    }
+    std::sort(ns.begin(), ns.end());
+
+    double sum = 0.0;
+    for (size_t i = 0; i < ns.size(); i++) {
+        sum += ns[i];
+    }
+    double mean = sum / ns.size();
+
+    double var = 0.0;
+    for (size_t i = 0; i < ns.size(); i++) {
+        var += (ns[i] - mean) * (ns[i] - mean);
+    }
+    var /= ns.size() > 1 ? ns.size() - 1 : 1;
+
+    size_t mid = ns.size() / 2;
+    out->iterations = iterations;
+    out->min_ns = ns.front();
+    out->median_ns = ns.size() % 2 ? ns[mid] : (ns[mid - 1] + ns[mid]) / 2.0;
+    out->mean_ns = mean;
+    out->stddev_ns = std::sqrt(var);
+    out->max_ns = ns.back();
+}
+
+static void print_row(const BenchCase& c, const BenchSummary& s, bool csv)
+{
+    std::stringstream out;
+    out << std::fixed << std::setprecision(2);
+
+    if (csv) {
+        out << c.name << "," << s.iterations << "," << s.min_ns << ",";
+        out << s.median_ns << "," << s.mean_ns << "," << s.stddev_ns << ",";
+        out << s.max_ns;
+    } else {
+        double cv = s.mean_ns > 0.0 ? 100.0 * s.stddev_ns / s.mean_ns : 0.0;
+        out << std::left << std::setw(28) << c.name << std::right;
+        out << std::setw(12) << s.iterations;
+        out << std::setw(14) << s.min_ns << std::setw(14) << s.median_ns;
+        out << std::setw(14) << s.mean_ns << std::setw(8) << cv << "%";
+        out << std::setw(14) << s.max_ns;
+    }
+
+    std::cout << out.str() << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions opts;
+    if (!parse_cli(&opts, argc, argv)) {
+        return EXIT_FAILURE;
+    }
+
+    const std::vector<BenchCase>& cases = GetBenchCases();
+    if (opts.list) {
+        for (size_t i = 0; i < cases.size(); i++) {
+            std::cout << cases[i].name << std::endl;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    SDL_Init(SDL_INIT_TIMER);
+
+    if (opts.cpu >= 0 && !pin_cpu(opts.cpu)) {
+        std::cerr << "Could not pin to CPU " << opts.cpu << ", timings ";
+        std::cerr << "may be noisier." << std::endl;
+    }
+
+    if (opts.csv) {
+        std::cout << "case,iterations,min_ns,median_ns,mean_ns,stddev_ns,";
+        std::cout << "max_ns" << std::endl;
+    } else {
+        std::cout << std::left << std::setw(28) << "case" << std::right;
+        std::cout << std::setw(12) << "iterations";
+        std::cout << std::setw(14) << "min ns" << std::setw(14) << "median";
+        std::cout << std::setw(14) << "mean" << std::setw(9) << "+/-";
+        std::cout << std::setw(14) << "max" << std::endl;
+    }
+
+    for (size_t i = 0; i < cases.size(); i++) {
+        const BenchCase& c = cases[i];
+        if (std::strstr(c.name, opts.filter.c_str()) == nullptr) {
+            continue;
+        }
+
+        std::string why;
+        if (c.setup != nullptr && !c.setup(&why)) {
+            std::cerr << c.name << ": skipped, " << why << std::endl;
+            continue;
+        }
+
+        BenchSummary summary;
+        run_case(c, opts, &summary);
+        print_row(c, summary, opts.csv);
+
+        if (c.teardown != nullptr) {
+            c.teardown();
+        }
+    }
+
+    SDL_Quit();
+    return EXIT_SUCCESS;
+}
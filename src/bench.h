@@ -0,0 +1,46 @@
+#ifndef VKTEST_BENCH_H
+#define VKTEST_BENCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+* vktest-bench times the CPU-side hot paths of the renderer in isolation,
+* so that an optimization can be shown to be one.  Nothing in here needs a
+* GPU, a window or a Vulkan driver.
+*
+* Each case runs its kernel 'iterations' times per call.  The harness
+* first runs it for the warm-up time, then works out how many iterations
+* fill the minimum sample time, then takes the requested number of
+* samples and reports nanoseconds per iteration across them.
+*/
+#define BENCH_DEFAULT_SAMPLES       (15)
+#define BENCH_DEFAULT_WARMUP_MS     (200)
+#define BENCH_DEFAULT_SAMPLE_MS     (50)
+
+struct BenchCase {
+    const char* name;
+    /* Optional; false skips the case (a missing input file, say). */
+    bool (*setup)(std::string* why);
+    void (*run)(uint64_t iterations);
+    /* Optional. */
+    void (*teardown)(void);
+};
+
+/* Every case in the suite, defined in bench_cases.cpp. */
+const std::vector<BenchCase>& GetBenchCases(void);
+
+/* Keeps the compiler from optimizing a result away. */
+template <typename T>
+inline void BenchKeep(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+#endif // VKTEST_BENCH_H
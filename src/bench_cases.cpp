@@ -0,0 +1,286 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "bench.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "cook.h"
+#include "flightrec.h"
+#include "global.h"
+
+/*
+* The cases, roughly in the order a frame meets them.  Inputs are built in
+* setup() so that only the kernel itself gets timed, and every result goes
+* through BenchKeep().
+*
+* There's no culling in the renderer yet, so there's no case for it; the
+* same goes for the vkCmd* half of recording, which needs a device.
+*/
+
+#define BENCH_OBJECTS           (1024)  // the "large" benchmark preset
+#define BENCH_FILE_SIZE         (1 << 20)
+#define BENCH_FILE_PATH         ("./vktest-bench.tmp")
+#define BENCH_FLIGHT_PATH       ("./vktest-bench.vfr")
+#define BENCH_IMAGE_PATH        ("./textures/bitcoin.png")
+#define BENCH_VERTICES          (1 << 16)
+
+static std::vector<glm::mat4> placements;
+static std::vector<ObjectData> constants;
+static std::vector<char> image_bytes;
+static std::vector<ObjVertex> vertices;
+static std::vector<PackedVertex> packed;
+
+/* Renderer::update_camera(), less the upload. */
+static void camera_view_proj(uint64_t iterations)
+{
+    glm::vec3 target(0.0f, 0.0f, 0.0f);
+    glm::vec3 up(0.0f, 0.0f, 1.0f);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        glm::vec3 eye(2.0f, 2.0f, 2.0f + (i & 0xff) * 0.001f);
+        glm::mat4 view = glm::lookAt(eye, target, up);
+        glm::mat4 proj = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f,
+          0.1f, 10.0f);
+        proj[1][1] *= -1;
+
+        CameraData camera = {};
+        camera.view_proj = proj * view;
+        BenchKeep(camera);
+    }
+}
+
+/* The model matrix Renderer::Update() builds every frame. */
+static void object_model(uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; i++) {
+        float elapsed = (i & 0xffff) * (1.0f / 60.0f);
+
+        ObjectData object = {};
+        object.model = glm::rotate(glm::mat4(),
+          elapsed * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        BenchKeep(object);
+    }
+}
+
+/* Same grid as Renderer::Init() lays the boxes out on. */
+static bool constants_setup(std::string* why)
+{
+    (void)why;
+
+    uint32_t side = 1;
+    while (side * side < BENCH_OBJECTS) {
+        side++;
+    }
+
+    float scale = 1.0f / side;
+    float spacing = 1.5f / side;
+    placements.clear();
+    for (uint32_t i = 0; i < BENCH_OBJECTS; i++) {
+        glm::vec3 at((i % side - (side - 1) * 0.5f) * spacing,
+          (i / side - (side - 1) * 0.5f) * spacing, 0.0f);
+        placements.push_back(glm::scale(glm::translate(glm::mat4(), at),
+          glm::vec3(scale)));
+    }
+    constants.resize(BENCH_OBJECTS);
+
+    return true;
+}
+
+/* Per-object push constants, as record_cmdbuffer() works them out. */
+static void object_constants(uint64_t iterations)
+{
+    glm::mat4 model = glm::rotate(glm::mat4(), 0.5f,
+      glm::vec3(0.0f, 0.0f, 1.0f));
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        for (size_t j = 0; j < placements.size(); j++) {
+            constants[j].model = placements[j] * model;
+        }
+        BenchKeep(constants[0]);
+    }
+}
+
+static void constants_teardown(void)
+{
+    std::vector<glm::mat4>().swap(placements);
+    std::vector<ObjectData>().swap(constants);
+}
+
+/* Note that this replaces log.txt in the working directory. */
+static bool log_setup(std::string* why)
+{
+    if (!Log::Init(Log::ROUTINE)) {
+        *why = "could not open log.txt";
+        return false;
+    }
+
+    return true;
+}
+
+/*
+* The caller's side only.  Nothing keeps up with a loop that does nothing
+* but log, so once the queue fills most of these are counted as dropped
+* rather than queued; both are a handful of atomics.
+*/
+static void log_write(uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; i++) {
+        Log::Write(Log::ROUTINE, "Renderer::stream_textures -> texture {} "
+          "failed to decode, keeping the placeholder.", i & 0xff);
+    }
+}
+
+static void log_teardown(void)
+{
+    Log::Close();
+}
+
+static bool flight_setup(std::string* why)
+{
+    if (!FlightRecorder::Init(BENCH_FLIGHT_PATH, FLIGHT_DEFAULT_EVENTS)) {
+        *why = std::string("could not map ") + BENCH_FLIGHT_PATH;
+        return false;
+    }
+
+    return true;
+}
+
+/* One frame's worth: begin, acquire, submit, present, end. */
+static void flight_record(uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; i++) {
+        FlightRecorder::Record(FLIGHT_FRAME_BEGIN, i);
+        FlightRecorder::Record(FLIGHT_ACQUIRE, i % 3, 0);
+        FlightRecorder::Record(FLIGHT_SUBMIT, i % 3);
+        FlightRecorder::Record(FLIGHT_PRESENT, i % 3, 0);
+        FlightRecorder::Record(FLIGHT_FRAME_END, i);
+    }
+}
+
+static void flight_teardown(void)
+{
+    FlightRecorder::Release();
+
+    std::string old = std::string(BENCH_FLIGHT_PATH) + ".old";
+    std::remove(BENCH_FLIGHT_PATH);
+    std::remove(old.c_str());
+}
+
+static bool file_setup(std::string* why)
+{
+    std::ofstream f(BENCH_FILE_PATH, std::ofstream::out |
+      std::ofstream::binary | std::ofstream::trunc);
+    std::vector<char> data(BENCH_FILE_SIZE, 'x');
+    f.write(data.data(), data.size());
+    if (!f) {
+        *why = std::string("could not write ") + BENCH_FILE_PATH;
+        return false;
+    }
+
+    return true;
+}
+
+static void file_read(uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; i++) {
+        std::vector<char> data = ReadFile(BENCH_FILE_PATH);
+        BenchKeep(data[0]);
+    }
+}
+
+static void file_teardown(void)
+{
+    std::remove(BENCH_FILE_PATH);
+}
+
+/* ReadFile() gives up on the whole process if the file isn't there. */
+static bool image_setup(std::string* why)
+{
+    if (!std::ifstream(BENCH_IMAGE_PATH).good()) {
+        *why = std::string(BENCH_IMAGE_PATH) + " not found";
+        return false;
+    }
+
+    image_bytes = ReadFile(BENCH_IMAGE_PATH);
+    return true;
+}
+
+static void image_decode(uint64_t iterations)
+{
+    const unsigned char* bytes =
+      reinterpret_cast<const unsigned char*>(image_bytes.data());
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        STBImage img = {};
+        if (ReadImage(&img, bytes, image_bytes.size())) {
+            BenchKeep(img.data[0]);
+            ReleaseImage(&img);
+        }
+    }
+}
+
+static void image_teardown(void)
+{
+    std::vector<char>().swap(image_bytes);
+}
+
+/* A bumpy grid, so that no component is constant. */
+static bool mesh_setup(std::string* why)
+{
+    (void)why;
+
+    vertices.resize(BENCH_VERTICES);
+    for (uint32_t i = 0; i < BENCH_VERTICES; i++) {
+        float x = (i & 0xff) / 255.0f;
+        float y = (i >> 8) / 255.0f;
+        ObjVertex& v = vertices[i];
+        v.pos[0] = x * 4.0f - 2.0f;
+        v.pos[1] = y * 4.0f - 2.0f;
+        v.pos[2] = x * y;
+        v.color[0] = x;
+        v.color[1] = y;
+        v.color[2] = 1.0f - x;
+        v.texcoord[0] = x;
+        v.texcoord[1] = y;
+    }
+
+    return true;
+}
+
+static void mesh_pack(uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; i++) {
+        MeshHeader header = {};
+        PackVertices(vertices, &header, &packed);
+        BenchKeep(packed[0]);
+    }
+}
+
+static void mesh_teardown(void)
+{
+    std::vector<ObjVertex>().swap(vertices);
+    std::vector<PackedVertex>().swap(packed);
+}
+
+const std::vector<BenchCase>& GetBenchCases(void)
+{
+    static const BenchCase cases[] = {
+        { "camera/view_proj", nullptr, camera_view_proj, nullptr },
+        { "object/model", nullptr, object_model, nullptr },
+        { "object/constants_1024", constants_setup, object_constants,
+          constants_teardown },
+        { "log/write", log_setup, log_write, log_teardown },
+        { "flight/frame_events", flight_setup, flight_record,
+          flight_teardown },
+        { "file/read_1mib", file_setup, file_read, file_teardown },
+        { "image/decode_png", image_setup, image_decode, image_teardown },
+        { "mesh/pack_64k", mesh_setup, mesh_pack, mesh_teardown }
+    };
+    static const std::vector<BenchCase> list(cases,
+      cases + sizeof(cases) / sizeof(cases[0]));
+
+    return list;
+}
@@ -0,0 +1,339 @@
+#include "benchmark.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "timer.h"
+
+static const BenchmarkPreset presets[] = {
+    { "small",  1,    1,    800,  600  },
+    { "medium", 64,   16,   1280, 720  },
+    { "large",  1024, 256,  1920, 1080 }
+};
+
+/*
+* The report is built as a flat list of section/key/value rows first, so
+* that the CSV and JSON writers only differ in punctuation.
+*/
+struct Row {
+    std::string section;
+    std::string key;
+    std::string value;
+    bool text;                  // quoted in JSON
+};
+
+template <typename T>
+static void add_row(std::vector<Row>* rows, const char* section,
+  const char* key, T value)
+{
+    std::stringstream out;
+    out << std::fixed << std::setprecision(3) << value;
+
+    Row row = { section, key, out.str(), false };
+    rows->push_back(row);
+}
+
+static void add_text(std::vector<Row>* rows, const char* section,
+  const char* key, std::string value)
+{
+    Row row = { section, key, value, true };
+    rows->push_back(row);
+}
+
+static std::string json_string(const std::string& str)
+{
+    std::string ret = "\"";
+    for (size_t i = 0; i < str.size(); i++) {
+        if (str[i] == '"' || str[i] == '\\') {
+            ret += '\\';
+        }
+        ret += str[i];
+    }
+
+    return ret + "\"";
+}
+
+static std::string csv_field(const std::string& str)
+{
+    if (str.find_first_of(",\"\n") == std::string::npos) {
+        return str;
+    }
+
+    std::string ret = "\"";
+    for (size_t i = 0; i < str.size(); i++) {
+        if (str[i] == '"') {
+            ret += '"';
+        }
+        ret += str[i];
+    }
+
+    return ret + "\"";
+}
+
+static bool write_csv(std::string path, const std::vector<Row>& rows)
+{
+    std::ofstream out(path.c_str(), std::ofstream::out |
+      std::ofstream::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    out << "section,key,value" << std::endl;
+    for (size_t i = 0; i < rows.size(); i++) {
+        out << csv_field(rows[i].section) << "," << csv_field(rows[i].key);
+        out << "," << csv_field(rows[i].value) << std::endl;
+    }
+
+    return static_cast<bool>(out);
+}
+
+/* Rows of a section are always next to each other. */
+static bool write_json(std::string path, const std::vector<Row>& rows)
+{
+    std::ofstream out(path.c_str(), std::ofstream::out |
+      std::ofstream::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    out << "{";
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row& row = rows[i];
+        bool first = i == 0 || rows[i - 1].section != row.section;
+        bool last = i + 1 == rows.size() ||
+          rows[i + 1].section != row.section;
+
+        if (first) {
+            out << (i == 0 ? "" : ",") << std::endl;
+            out << "  " << json_string(row.section) << ": {" << std::endl;
+        }
+
+        out << "    " << json_string(row.key) << ": ";
+        out << (row.text ? json_string(row.value) : row.value);
+        out << (last ? "" : ",") << std::endl;
+
+        if (last) {
+            out << "  }";
+        }
+    }
+    out << std::endl << "}" << std::endl;
+
+    return static_cast<bool>(out);
+}
+
+static std::string version_string(uint32_t version)
+{
+    std::stringstream out;
+    out << VK_VERSION_MAJOR(version) << "." << VK_VERSION_MINOR(version);
+    out << "." << VK_VERSION_PATCH(version);
+
+    return out.str();
+}
+
+static const char* device_type(VkPhysicalDeviceType type)
+{
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+/*
+* Resident and peak resident set size of the process, in KiB.  Only Linux
+* says; everywhere else both come back zero.
+*/
+static void host_memory(uint64_t* rss, uint64_t* peak)
+{
+    *rss = 0;
+    *peak = 0;
+
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            *rss = std::strtoull(line.c_str() + 6, nullptr, 10);
+        } else if (line.compare(0, 6, "VmHWM:") == 0) {
+            *peak = std::strtoull(line.c_str() + 6, nullptr, 10);
+        }
+    }
+#endif
+}
+
+static void add_frame_stats(std::vector<Row>* rows, const FrameStats* stats)
+{
+    for (int i = 0; i < FrameStats::METRIC_COUNT; i++) {
+        FrameStats::Metric metric = static_cast<FrameStats::Metric>(i);
+        const char* name = FrameStats::GetName(metric);
+
+        FrameStats::Summary s;
+        stats->GetSummary(metric, &s);
+        add_row(rows, name, "count", s.count);
+        add_row(rows, name, "over_budget", s.over_budget);
+        add_row(rows, name, "mean_ms", s.mean_ms);
+        add_row(rows, name, "p50_ms", s.p50_ms);
+        add_row(rows, name, "p90_ms", s.p90_ms);
+        add_row(rows, name, "p99_ms", s.p99_ms);
+        add_row(rows, name, "p99.9_ms", s.p999_ms);
+        add_row(rows, name, "max_ms", s.max_ms);
+    }
+}
+
+/* False if the window was closed. */
+static bool pump_events(Renderer* rend)
+{
+    SDL_Event ev;
+    while (SDL_PollEvent(&ev)) {
+        if (ev.type == SDL_QUIT) {
+            return false;
+        }
+        if (ev.type == SDL_WINDOWEVENT) {
+            rend->PushEvent(ev.window);
+        }
+    }
+
+    return true;
+}
+
+const BenchmarkPreset* FindBenchmarkPreset(const char* name)
+{
+    for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+        if (std::strcmp(presets[i].name, name) == 0) {
+            return &presets[i];
+        }
+    }
+
+    return nullptr;
+}
+
+void PrintBenchmarkPresets(std::ostream& out)
+{
+    out << "preset\tobjects\ttextures\tresolution" << std::endl;
+    for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+        out << presets[i].name << "\t" << presets[i].objects << "\t";
+        out << presets[i].textures << "\t\t" << presets[i].width << "x";
+        out << presets[i].height << std::endl;
+    }
+}
+
+int RunBenchmark(Renderer::CreateInfo* info, const BenchmarkPreset* preset,
+  uint32_t frames, const char* path)
+{
+    info->width = preset->width;
+    info->height = preset->height;
+    info->objects = preset->objects;
+    info->textures = preset->textures;
+
+    Timer startup;
+    Renderer* rend = Renderer::Init(info);
+    if (rend == nullptr) {
+        Log::Write(Log::SEVERE, "RunBenchmark -> renderer failed to start.");
+        return EXIT_FAILURE;
+    }
+    double startup_ms = startup.Elapsed() * 1000.0;
+
+    /*
+    * Nothing is measured until the textures are all in, so that every run
+    * draws the same thing.  Time still moves on a fixed step here.
+    */
+    Timer warmup;
+    uint32_t warmup_frames = 0;
+    while (warmup_frames < BENCHMARK_WARMUP_FRAMES ||
+      (!rend->StreamingIdle() &&
+      warmup.Elapsed() < BENCHMARK_WARMUP_SECONDS)) {
+        if (!pump_events(rend)) {
+            Renderer::Release(rend);
+            return EXIT_FAILURE;
+        }
+        rend->Update(warmup_frames * BENCHMARK_TIMESTEP);
+        rend->Render();
+        warmup_frames++;
+    }
+
+    if (!rend->StreamingIdle()) {
+        Log::Write(Log::WARNING, "RunBenchmark -> textures still streaming "
+          "after the warm-up, the results will include uploads.");
+    }
+
+    rend->ResetFrameStats();
+
+    Timer run;
+    for (uint32_t i = 0; i < frames; i++) {
+        if (!pump_events(rend)) {
+            Renderer::Release(rend);
+            return EXIT_FAILURE;
+        }
+        PROFILE_ZONE("frame");
+        rend->Update(i * BENCHMARK_TIMESTEP);
+        rend->Render();
+    }
+    double seconds = run.Elapsed();
+
+    Renderer::Info ri;
+    rend->GetInfo(&ri);
+
+    std::vector<Row> rows;
+    add_text(&rows, "run", "preset", preset->name);
+    add_row(&rows, "run", "objects", ri.objects);
+    add_row(&rows, "run", "textures", ri.textures);
+    add_row(&rows, "run", "width", preset->width);
+    add_row(&rows, "run", "height", preset->height);
+    add_row(&rows, "run", "frames", frames);
+    add_row(&rows, "run", "warmup_frames", warmup_frames);
+    add_row(&rows, "run", "timestep_ms", BENCHMARK_TIMESTEP * 1000.0);
+    add_row(&rows, "run", "seconds", seconds);
+    add_row(&rows, "run", "fps", frames / seconds);
+    add_row(&rows, "run", "budget_ms", rend->GetFrameStats()->GetBudget());
+    add_text(&rows, "run", "bindless", ri.bindless ? "true" : "false");
+
+    add_text(&rows, "device", "name", ri.properties.deviceName);
+    add_text(&rows, "device", "type", device_type(ri.properties.deviceType));
+    add_row(&rows, "device", "vendor_id", ri.properties.vendorID);
+    add_row(&rows, "device", "device_id", ri.properties.deviceID);
+    add_text(&rows, "device", "api_version",
+      version_string(ri.properties.apiVersion));
+    add_row(&rows, "device", "driver_version", ri.properties.driverVersion);
+
+    for (size_t i = 0; i < ri.startup.size(); i++) {
+        add_row(&rows, "startup_ms", ri.startup[i].name, ri.startup[i].ms);
+    }
+    add_row(&rows, "startup_ms", "total", startup_ms);
+
+    uint64_t rss = 0;
+    uint64_t peak = 0;
+    host_memory(&rss, &peak);
+    add_row(&rows, "memory", "texture_kib",
+      ri.streaming.bytes_resident / 1024);
+    add_row(&rows, "memory", "textures_resident", ri.streaming.resident);
+    add_row(&rows, "memory", "textures_failed", ri.streaming.failed);
+    add_row(&rows, "memory", "gpu_buffers", ri.resources.buffers);
+    add_row(&rows, "memory", "gpu_images", ri.resources.images);
+    add_row(&rows, "memory", "stale_handles", ri.resources.stale);
+    add_row(&rows, "memory", "host_rss_kib", rss);
+    add_row(&rows, "memory", "host_peak_rss_kib", peak);
+
+    add_frame_stats(&rows, rend->GetFrameStats());
+
+    Renderer::Release(rend);
+
+    std::string out = path;
+    bool csv = out.size() >= 4 && out.compare(out.size() - 4, 4, ".csv") == 0;
+    if (!(csv ? write_csv(out, rows) : write_json(out, rows))) {
+        Log::Write(Log::SEVERE, "RunBenchmark -> could not write {}", out);
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Benchmark results written to " << out << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,41 @@
+#ifndef VKTEST_BENCHMARK_H
+#define VKTEST_BENCHMARK_H
+
+#include <ostream>
+
+#include "renderer.h"
+
+#define BENCHMARK_DEFAULT_FRAMES    (1000)
+#define BENCHMARK_DEFAULT_OUT       ("./benchmark.json")
+
+/* Animation advances by exactly this much per frame, whatever the clock. */
+#define BENCHMARK_TIMESTEP          (1.0 / 60.0)
+
+/*
+* Frames drawn before measuring starts, and then for as long as it takes
+* the textures to stream in, up to the time limit.
+*/
+#define BENCHMARK_WARMUP_FRAMES     (16)
+#define BENCHMARK_WARMUP_SECONDS    (30.0)
+
+/* A scene and the window it's drawn into. */
+struct BenchmarkPreset {
+    const char* name;
+    uint32_t objects;
+    uint32_t textures;
+    uint16_t width, height;
+};
+
+const BenchmarkPreset* FindBenchmarkPreset(const char* name);
+void PrintBenchmarkPresets(std::ostream& out);
+
+/*
+* Draws 'frames' frames of the preset's scene on a fixed timestep and
+* writes what it saw to 'path': CSV if the name ends in .csv, JSON
+* otherwise.  Everything in 'info' except the window size and the scene is
+* passed through to the renderer.  Returns the process exit code.
+*/
+int RunBenchmark(Renderer::CreateInfo* info, const BenchmarkPreset* preset,
+  uint32_t frames, const char* path);
+
+#endif  /* VKTEST_BENCHMARK_H */
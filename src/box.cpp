@@ -1,6 +1,7 @@
 #include "box.h"
 
-Box* Box::Init(VkDevice device, VkCommandPool pool, VkQueue queue)
+Box* Box::Init(VkDevice device, VkCommandPool pool,
+  Scheduler* scheduler)
 {
     Box* box = new Box();
 
@@ -60,7 +61,7 @@ Box* Box::Init(VkDevice device, VkCommandPool pool, VkQueue queue)
     }
 
     result = Utility::CopyBuffer(device, stagingbuffer, m_vbuffer,
-      buffersize, pool, queue);
+      buffersize, pool, scheduler);
     if (result) {
         return nullptr;
     }
@@ -10,7 +10,8 @@
 class Box : public GameObject {
 public:
     virtual ~Box(void) { };
-    static Box* Init(VkDevice device, VkCommandPool pool, VkQueue queue);
+    static Box* Init(VkDevice device, VkCommandPool pool,
+      Scheduler* scheduler);
     static void Release(Box* box);
 
     void Draw(void);
@@ -0,0 +1,420 @@
+#include "cook.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <sys/stat.h>
+#if defined(_WIN32)
+  #include <direct.h>
+#endif
+
+struct CookJob {
+    enum Kind {
+        TEXTURE,
+        MESH,
+        COPY        // packed as-is, nothing to cook
+    };
+
+    std::string input;
+    std::string output;
+    Kind kind;
+
+    uint64_t hash;
+    bool skipped;
+    bool ok;
+    std::string report;
+};
+
+static bool read_bytes(const std::string& path,
+  std::vector<unsigned char>* out)
+{
+    std::ifstream f(path.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!f.is_open()) {
+        return false;
+    }
+
+    f.seekg(0L, f.end);
+    std::streamoff len = f.tellg();
+    f.seekg(0L, f.beg);
+    if (len < 0) {
+        return false;
+    }
+
+    out->resize(static_cast<size_t>(len));
+    f.read(reinterpret_cast<char*>(out->data()), len);
+
+    return static_cast<bool>(f);
+}
+
+static bool file_exists(const std::string& path)
+{
+    std::ifstream f(path.c_str());
+    return f.good();
+}
+
+/*
+* Like mkdir -p: every missing directory along 'path' is made.  Says
+* whether 'path' is a directory once it's done.
+*/
+static bool make_dirs(const std::string& path)
+{
+    for (size_t i = 1; i <= path.size(); i++) {
+        if (i < path.size() && path[i] != '/' && path[i] != '\\') {
+            continue;
+        }
+
+        /* Anything already there is fine; the stat below has the say. */
+        std::string part = path.substr(0, i);
+#if defined(_WIN32)
+        if (part.back() != ':') {
+            _mkdir(part.c_str());
+        }
+#else
+        mkdir(part.c_str(), 0777);
+#endif
+    }
+
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static std::string base_name(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path :
+      path.substr(slash + 1);
+
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+static std::string extension(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) {
+        return "";
+    }
+
+    std::string ext = path.substr(dot + 1);
+    for (size_t i = 0; i < ext.size(); i++) {
+        ext[i] = static_cast<char>(std::tolower(ext[i]));
+    }
+
+    return ext;
+}
+
+/*
+* The cache is one "<hash> <output name>" pair per line, kept next to the
+* cooked files.  A job is skipped when its output still exists and the hash
+* of (tool version, options, source bytes) hasn't changed.
+*/
+static void load_cache(const std::string& path,
+  std::map<std::string, uint64_t>* cache)
+{
+    std::ifstream f(path.c_str());
+    std::string hex, name;
+    while (f >> hex >> name) {
+        cache[0][name] = std::strtoull(hex.c_str(), nullptr, 16);
+    }
+}
+
+static bool save_cache(const std::string& path,
+  const std::map<std::string, uint64_t>& cache)
+{
+    std::ofstream f(path.c_str(), std::ofstream::out | std::ofstream::trunc);
+    if (!f.is_open()) {
+        return false;
+    }
+
+    for (std::map<std::string, uint64_t>::const_iterator it = cache.begin();
+      it != cache.end(); ++it) {
+        f << std::hex << std::setw(16) << std::setfill('0') << it->second;
+        f << " " << it->first << std::endl;
+    }
+
+    return static_cast<bool>(f);
+}
+
+static void run_job(CookJob* job, const CookOptions& opts,
+  const std::map<std::string, uint64_t>& cache)
+{
+    if (job->kind == CookJob::COPY) {
+        job->ok = file_exists(job->input);
+        job->skipped = true;
+        job->report = job->ok ? "packed as-is" : "could not read " +
+          job->input;
+        return;
+    }
+
+    std::vector<unsigned char> src;
+    if (!read_bytes(job->input, &src)) {
+        job->ok = false;
+        job->report = "could not read " + job->input;
+        return;
+    }
+
+    /* Anything that changes the output has to be part of the hash. */
+    std::stringstream settings;
+    settings << COOK_VERSION << ":" << static_cast<int>(opts.format) << ":";
+    settings << opts.mips << ":" << job->kind;
+    std::string s = settings.str();
+    job->hash = HashBytes(s.data(), s.size());
+    job->hash = HashBytes(src.data(), src.size(), job->hash);
+
+    std::string name = job->output.substr(opts.outdir.size() + 1);
+    std::map<std::string, uint64_t>::const_iterator it = cache.find(name);
+    if (!opts.force && it != cache.end() && it->second == job->hash &&
+      file_exists(job->output)) {
+        job->ok = true;
+        job->skipped = true;
+        job->report = "up to date";
+        return;
+    }
+
+    if (job->kind == CookJob::MESH) {
+        job->ok = CookMesh(src, job->output, opts, &job->report);
+    } else {
+        job->ok = CookTexture(src, job->output, opts, &job->report);
+    }
+}
+
+/*
+* Pack names are relative to the pack's own directory, so that the paths
+* the runtime opens loose files by ("./shaders/x.spv") also find them in
+* the pack.
+*/
+static std::string pack_name(const std::string& path, const std::string& root)
+{
+    if (!root.empty() && path.compare(0, root.size(), root) == 0 &&
+      path.size() > root.size() &&
+      (path[root.size()] == '/' || path[root.size()] == '\\')) {
+        return path.substr(root.size() + 1);
+    }
+
+    return path;
+}
+
+static bool write_pack(const std::string& path,
+  const std::vector<CookJob>& jobs)
+{
+    size_t slash = path.find_last_of("/\\");
+    std::string root = slash == std::string::npos ? "." :
+      path.substr(0, slash);
+
+    std::vector<AssetPack::Source> sources;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        AssetPack::Source src;
+        src.path = jobs[i].output;
+        src.name = pack_name(jobs[i].output, root);
+        sources.push_back(src);
+    }
+
+    std::string error;
+    if (!AssetPack::Write(path, sources, &error)) {
+        std::cerr << "FAILED " << path << ": " << error << std::endl;
+        return false;
+    }
+
+    std::cout << "Packed " << sources.size() << " files into " << path;
+    std::cout << std::endl;
+
+    return true;
+}
+
+static void print_help(void)
+{
+    std::stringstream out;
+    out << "Usage:" << std::endl;
+    out << "\tvktest-cook [OPTIONS] FILE..." << std::endl << std::endl;
+    out << "Images (png, tga, jpg, bmp) are cooked into mipmapped DDS files.";
+    out << std::endl;
+    out << "Wavefront OBJ meshes are cooked into .vkm files." << std::endl;
+    out << "SPIR-V (.spv) files are only packed." << std::endl;
+    out << std::endl;
+    out << "Options:" << std::endl;
+    out << "\t--out=DIR\tWhere cooked files go (default: .)" << std::endl;
+    out << "\t--format=F\tbc7 (default) or bc1 for opaque textures.";
+    out << std::endl;
+    out << "\t--no-mips\tOnly cook the top level." << std::endl;
+    out << "\t--pack=FILE\tAlso bundle the results into an asset pack.";
+    out << std::endl;
+    out << "\t--threads=N\tWorker count (default: every core)." << std::endl;
+    out << "\t--force\t\tIgnore the cache and cook everything." << std::endl;
+    out << "\t--help\t\tPrint this help message." << std::endl;
+
+    std::cout << out.str();
+}
+
+int main(int argc, char* argv[])
+{
+    CookOptions opts;
+    opts.outdir = ".";
+    opts.format = MipImage::BC7;
+    opts.mips = true;
+    opts.force = false;
+    opts.threads = std::thread::hardware_concurrency();
+
+    std::vector<CookJob> jobs;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (std::strcmp(arg, "--help") == 0) {
+            print_help();
+            return EXIT_SUCCESS;
+        } else if (std::strncmp(arg, "--out=", 6) == 0) {
+            opts.outdir = arg + 6;
+            while (opts.outdir.size() > 1 &&
+              (opts.outdir.back() == '/' || opts.outdir.back() == '\\')) {
+                opts.outdir.erase(opts.outdir.size() - 1);
+            }
+        } else if (std::strcmp(arg, "--format=bc1") == 0) {
+            opts.format = MipImage::BC1;
+        } else if (std::strcmp(arg, "--format=bc7") == 0) {
+            opts.format = MipImage::BC7;
+        } else if (std::strncmp(arg, "--pack=", 7) == 0) {
+            opts.pack = arg + 7;
+        } else if (std::strcmp(arg, "--no-mips") == 0) {
+            opts.mips = false;
+        } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+            opts.threads = static_cast<uint32_t>(std::atoi(arg + 10));
+        } else if (std::strcmp(arg, "--force") == 0) {
+            opts.force = true;
+        } else if (std::strncmp(arg, "--", 2) == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return EXIT_FAILURE;
+        } else {
+            CookJob job = {};
+            job.input = arg;
+            std::string ext = extension(arg);
+            job.kind = ext == "obj" ? CookJob::MESH :
+              ext == "spv" ? CookJob::COPY : CookJob::TEXTURE;
+            jobs.push_back(job);
+        }
+    }
+
+    if (jobs.empty()) {
+        print_help();
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].kind == CookJob::COPY) {
+            jobs[i].output = jobs[i].input;
+        } else {
+            jobs[i].output = opts.outdir + "/" + base_name(jobs[i].input) +
+              (jobs[i].kind == CookJob::MESH ? ".vkm" : ".dds");
+        }
+    }
+
+    /*
+    * Outputs are named after the input alone, so a/stone.png and
+    * b/stone.png would both be cooked into the same file, at the same time
+    * on two threads.
+    */
+    std::map<std::string, std::string> outputs;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        std::map<std::string, std::string>::iterator it =
+          outputs.find(jobs[i].output);
+        if (it != outputs.end()) {
+            std::cerr << it->second << " and " << jobs[i].input
+              << " would both be cooked into " << jobs[i].output << "."
+              << std::endl;
+            return EXIT_FAILURE;
+        }
+        outputs[jobs[i].output] = jobs[i].input;
+    }
+
+    if (!make_dirs(opts.outdir)) {
+        std::cerr << "Could not create the output directory " << opts.outdir
+          << "." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string cache_path = opts.outdir + "/" + COOK_CACHE_FILE;
+    std::map<std::string, uint64_t> cache;
+    load_cache(cache_path, &cache);
+
+    if (opts.threads == 0) {
+        opts.threads = 1;
+    }
+    opts.threads = std::min<uint32_t>(opts.threads,
+      static_cast<uint32_t>(jobs.size()));
+
+    /*
+    * Jobs are handed out one at a time from a shared counter, so one big
+    * texture doesn't hold up a thread's worth of small ones behind it.
+    */
+    std::atomic<size_t> next(0);
+    std::mutex print_lock;
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < opts.threads; t++) {
+        workers.push_back(std::thread([&]() {
+            size_t i;
+            while ((i = next.fetch_add(1)) < jobs.size()) {
+                run_job(&jobs[i], opts, cache);
+
+                std::lock_guard<std::mutex> guard(print_lock);
+                std::ostream& out = jobs[i].ok ? std::cout : std::cerr;
+                out << (jobs[i].ok ? "" : "FAILED ") << jobs[i].input;
+                out << ": " << jobs[i].report << std::endl;
+            }
+        }));
+    }
+
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+
+    int failed = 0;
+    int cooked = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].kind == CookJob::COPY) {
+            failed += jobs[i].ok ? 0 : 1;
+            continue;
+        }
+
+        std::string name = jobs[i].output.substr(opts.outdir.size() + 1);
+        if (jobs[i].ok) {
+            cache[name] = jobs[i].hash;
+            cooked += jobs[i].skipped ? 0 : 1;
+        } else {
+            cache.erase(name);
+            failed++;
+        }
+    }
+
+    if (!save_cache(cache_path, cache)) {
+        std::cerr << "Could not write " << cache_path << std::endl;
+    }
+
+    int copied = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        copied += jobs[i].kind == CookJob::COPY && jobs[i].ok ? 1 : 0;
+    }
+
+    std::cout << cooked << " cooked, " << jobs.size() - cooked - failed -
+      copied << " up to date, " << failed << " failed." << std::endl;
+
+    if (!opts.pack.empty()) {
+        if (failed) {
+            std::cerr << "Not writing " << opts.pack << "." << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (!write_pack(opts.pack, jobs)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
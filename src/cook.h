@@ -0,0 +1,58 @@
+#ifndef VKTEST_COOK_H
+#define VKTEST_COOK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dds.h"
+#include "mesh.h"
+#include "pack.h"
+
+/*
+* vktest-cook turns source assets into the files the runtime would rather
+* load: PNG/TGA/JPG textures become mipmapped, block-compressed DDS files,
+* and Wavefront OBJ meshes become quantized, cache-ordered .vkm files (see
+* mesh.h).  None of this links against Vulkan or SDL.
+*
+* With --pack, everything it cooked, plus any other files it was handed
+* (SPIR-V, say), also goes into an asset pack (see pack.h).  Pack names are
+* paths relative to the directory the pack is written to.
+*/
+#define COOK_VERSION        (1)
+#define COOK_CACHE_FILE     (".cook-cache")
+
+struct CookOptions {
+    std::string outdir;
+    std::string pack;           // empty if no pack is wanted
+    MipImage::Format format;    // BC1 or BC7
+    bool mips;
+    bool force;
+    uint32_t threads;
+};
+
+/*
+* Each cooker takes the raw bytes of its source file and writes the
+* cooked result to 'out'.  On failure, 'error' says why.  'report' gets a
+* one-line summary for the tool's output either way.
+*/
+bool CookTexture(const std::vector<unsigned char>& src, const std::string& out,
+  const CookOptions& opts, std::string* report);
+bool CookMesh(const std::vector<unsigned char>& src, const std::string& out,
+  const CookOptions& opts, std::string* report);
+
+/* A mesh vertex as parsed, before it's packed. */
+struct ObjVertex {
+    float pos[3];
+    float color[3];
+    float texcoord[2];
+};
+
+/*
+* Quantizes vertices into PackedVertex records and fills in the header's
+* position bounds to match.  Part of CookMesh(), split out for vktest-bench.
+*/
+void PackVertices(const std::vector<ObjVertex>& vertices, MeshHeader* header,
+  std::vector<PackedVertex>* out);
+
+#endif // VKTEST_COOK_H
@@ -0,0 +1,424 @@
+#include "cook.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "mesh.h"
+
+/* Size of the LRU cache the vertex cache optimizer models. */
+#define COOK_VCACHE_SIZE        (32)
+
+/* FIFO size used when reporting ACMR, roughly what real hardware has. */
+#define COOK_ACMR_FIFO_SIZE     (16)
+
+/*
+* Just enough Wavefront OBJ for our purposes: positions (with the common
+* "v x y z r g b" colour extension), texture coordinates and faces, which
+* are fanned into triangles.  Normals are skipped since nothing samples
+* them yet.
+*/
+static bool parse_obj(const std::vector<unsigned char>& src,
+  std::vector<ObjVertex>* vertices, std::vector<uint32_t>* indices,
+  std::string* error)
+{
+    std::vector<float> pos, color, uv;
+    std::map<uint64_t, uint32_t> unique;
+
+    std::string text(src.begin(), src.end());
+    std::istringstream in(text);
+    std::string line;
+    uint32_t lineno = 0;
+
+    while (std::getline(in, line)) {
+        lineno++;
+        std::istringstream ls(line);
+        std::string tag;
+        ls >> tag;
+
+        if (tag == "v") {
+            float v[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+            int n = 0;
+            while (n < 6 && (ls >> v[n])) {
+                n++;
+            }
+            if (n < 3) {
+                std::stringstream msg;
+                msg << "line " << lineno << ": bad vertex";
+                error[0] = msg.str();
+                return false;
+            }
+            pos.insert(pos.end(), v, v + 3);
+            color.insert(color.end(), v + 3, v + 6);
+        } else if (tag == "vt") {
+            float t[2] = { 0.0f, 0.0f };
+            ls >> t[0] >> t[1];
+            uv.insert(uv.end(), t, t + 2);
+        } else if (tag == "f") {
+            std::vector<uint32_t> face;
+            std::string corner;
+            while (ls >> corner) {
+                long vi = std::strtol(corner.c_str(), nullptr, 10);
+                long ti = 0;
+                size_t slash = corner.find('/');
+                if (slash != std::string::npos && slash + 1 < corner.size() &&
+                  corner[slash + 1] != '/') {
+                    ti = std::strtol(corner.c_str() + slash + 1, nullptr, 10);
+                }
+
+                /* Negative indices count back from the end. */
+                long vcount = static_cast<long>(pos.size() / 3);
+                long tcount = static_cast<long>(uv.size() / 2);
+                vi = vi < 0 ? vcount + vi : vi - 1;
+                ti = ti < 0 ? tcount + ti : ti - 1;
+                if (vi < 0 || vi >= vcount || ti >= tcount) {
+                    std::stringstream msg;
+                    msg << "line " << lineno << ": index out of range";
+                    error[0] = msg.str();
+                    return false;
+                }
+
+                uint64_t key = (static_cast<uint64_t>(vi) << 32) |
+                  static_cast<uint32_t>(ti);
+                std::map<uint64_t, uint32_t>::iterator it = unique.find(key);
+                if (it == unique.end()) {
+                    ObjVertex v = {};
+                    std::memcpy(v.pos, &pos[vi * 3], sizeof(v.pos));
+                    std::memcpy(v.color, &color[vi * 3], sizeof(v.color));
+                    if (ti >= 0) {
+                        std::memcpy(v.texcoord, &uv[ti * 2],
+                          sizeof(v.texcoord));
+                    }
+
+                    uint32_t index = static_cast<uint32_t>(vertices->size());
+                    vertices->push_back(v);
+                    it = unique.insert(std::make_pair(key, index)).first;
+                }
+                face.push_back(it->second);
+            }
+
+            for (size_t i = 2; i < face.size(); i++) {
+                indices->push_back(face[0]);
+                indices->push_back(face[i - 1]);
+                indices->push_back(face[i]);
+            }
+        }
+    }
+
+    if (indices->empty()) {
+        error[0] = "no faces";
+        return false;
+    }
+
+    return true;
+}
+
+/* Average cache miss ratio: transformed vertices per triangle. */
+static float acmr(const std::vector<uint32_t>& indices, uint32_t vcount)
+{
+    std::vector<uint32_t> stamp(vcount, 0);
+    uint32_t misses = 0;
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        uint32_t v = indices[i];
+        if (stamp[v] == 0 || misses - stamp[v] >= COOK_ACMR_FIFO_SIZE) {
+            misses++;
+            stamp[v] = misses;
+        }
+    }
+
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+/*
+* Tom Forsyth's linear-speed vertex cache optimisation.  Every vertex gets
+* a score from its position in a modelled LRU cache and from how many
+* triangles still need it; the next triangle out is always the best scoring
+* one touching the cache, falling back to the best remaining overall.
+*/
+static float vertex_score(int cache_pos, uint32_t live)
+{
+    if (live == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cache_pos >= 0) {
+        if (cache_pos < 3) {
+            score = 0.75f;
+        } else {
+            float scale = 1.0f / (COOK_VCACHE_SIZE - 3);
+            score = std::pow(1.0f - (cache_pos - 3) * scale, 1.5f);
+        }
+    }
+
+    return score + 2.0f / std::sqrt(static_cast<float>(live));
+}
+
+static void optimize_vertex_cache(std::vector<uint32_t>* indices,
+  uint32_t vcount)
+{
+    size_t tcount = indices->size() / 3;
+    const std::vector<uint32_t>& in = indices[0];
+
+    /* Triangles using each vertex, packed into one array. */
+    std::vector<uint32_t> live(vcount, 0);
+    for (size_t i = 0; i < in.size(); i++) {
+        live[in[i]]++;
+    }
+
+    std::vector<uint32_t> first(vcount + 1, 0);
+    for (uint32_t v = 0; v < vcount; v++) {
+        first[v + 1] = first[v] + live[v];
+    }
+
+    std::vector<uint32_t> adjacency(in.size());
+    std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+    for (size_t t = 0; t < tcount; t++) {
+        for (uint32_t k = 0; k < 3; k++) {
+            adjacency[fill[in[t * 3 + k]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<int> cache_pos(vcount, -1);
+    std::vector<float> vscore(vcount);
+    for (uint32_t v = 0; v < vcount; v++) {
+        vscore[v] = vertex_score(-1, live[v]);
+    }
+
+    std::vector<float> tscore(tcount);
+    std::vector<bool> emitted(tcount, false);
+    for (size_t t = 0; t < tcount; t++) {
+        tscore[t] = vscore[in[t * 3]] + vscore[in[t * 3 + 1]] +
+          vscore[in[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> out;
+    out.reserve(in.size());
+    std::vector<uint32_t> cache;
+    size_t cursor = 0;
+    long best = -1;
+
+    for (size_t n = 0; n < tcount; n++) {
+        if (best < 0) {
+            /* Nothing useful in the cache: take the best triangle left. */
+            float top = -1e30f;
+            for (size_t t = cursor; t < tcount; t++) {
+                if (!emitted[t] && tscore[t] > top) {
+                    top = tscore[t];
+                    best = static_cast<long>(t);
+                }
+            }
+            while (cursor < tcount && emitted[cursor]) {
+                cursor++;
+            }
+        }
+
+        uint32_t tri = static_cast<uint32_t>(best);
+        emitted[tri] = true;
+
+        std::vector<uint32_t> next;
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t v = in[tri * 3 + k];
+            out.push_back(v);
+            next.push_back(v);
+
+            /* Drop the finished triangle from this vertex's list. */
+            uint32_t* begin = &adjacency[first[v]];
+            uint32_t* end = begin + live[v];
+            uint32_t* hit = std::find(begin, end, tri);
+            if (hit != end) {
+                std::swap(*hit, *(end - 1));
+                live[v]--;
+            }
+        }
+
+        for (size_t i = 0; i < cache.size(); i++) {
+            if (std::find(next.begin(), next.end(), cache[i]) == next.end()) {
+                next.push_back(cache[i]);
+            }
+        }
+
+        /* Re-score everything that moved, including what fell out. */
+        for (size_t i = 0; i < next.size(); i++) {
+            uint32_t v = next[i];
+            cache_pos[v] = i < COOK_VCACHE_SIZE ? static_cast<int>(i) : -1;
+            vscore[v] = vertex_score(cache_pos[v], live[v]);
+        }
+
+        if (next.size() > COOK_VCACHE_SIZE) {
+            next.resize(COOK_VCACHE_SIZE);
+        }
+        cache.swap(next);
+
+        best = -1;
+        float top = -1e30f;
+        for (size_t i = 0; i < cache.size(); i++) {
+            uint32_t v = cache[i];
+            for (uint32_t j = 0; j < live[v]; j++) {
+                uint32_t t = adjacency[first[v] + j];
+                tscore[t] = vscore[in[t * 3]] + vscore[in[t * 3 + 1]] +
+                  vscore[in[t * 3 + 2]];
+                if (tscore[t] > top) {
+                    top = tscore[t];
+                    best = static_cast<long>(t);
+                }
+            }
+        }
+    }
+
+    indices->swap(out);
+}
+
+/*
+* Renumbers vertices in the order the index buffer first touches them so
+* vertex fetches walk memory forwards.
+*/
+static void optimize_vertex_fetch(std::vector<ObjVertex>* vertices,
+  std::vector<uint32_t>* indices)
+{
+    std::vector<uint32_t> remap(vertices->size(), UINT32_MAX);
+    std::vector<ObjVertex> ordered;
+    ordered.reserve(vertices->size());
+
+    for (size_t i = 0; i < indices->size(); i++) {
+        uint32_t& v = indices[0][i];
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[0][v]);
+        }
+        v = remap[v];
+    }
+
+    vertices->swap(ordered);
+}
+
+static uint16_t float_to_half(float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x007fffff;
+
+    if (exponent <= 0) {
+        /* Too small for a normal half; flush to signed zero. */
+        return static_cast<uint16_t>(sign);
+    } else if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+
+    /* Round to nearest, carrying into the exponent if need be. */
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) |
+      (mantissa >> 13);
+    if (mantissa & 0x1000) {
+        half++;
+    }
+
+    return static_cast<uint16_t>(half);
+}
+
+static unsigned char unorm8(float v)
+{
+    v = std::min(1.0f, std::max(0.0f, v));
+    return static_cast<unsigned char>(v * 255.0f + 0.5f);
+}
+
+void PackVertices(const std::vector<ObjVertex>& vertices, MeshHeader* header,
+  std::vector<PackedVertex>* out)
+{
+    float lo[3] = { 1e30f, 1e30f, 1e30f };
+    float hi[3] = { -1e30f, -1e30f, -1e30f };
+    for (size_t i = 0; i < vertices.size(); i++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], vertices[i].pos[c]);
+            hi[c] = std::max(hi[c], vertices[i].pos[c]);
+        }
+    }
+    for (uint32_t c = 0; c < 3; c++) {
+        header->pos_min[c] = lo[c];
+        header->pos_scale[c] = (hi[c] - lo[c]) / 65535.0f;
+    }
+
+    out->resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const ObjVertex& v = vertices[i];
+        PackedVertex& p = out[0][i];
+        for (uint32_t c = 0; c < 3; c++) {
+            float range = hi[c] - lo[c];
+            float t = range > 0.0f ? (v.pos[c] - lo[c]) / range : 0.0f;
+            p.pos[c] = static_cast<uint16_t>(t * 65535.0f + 0.5f);
+            p.color[c] = unorm8(v.color[c]);
+        }
+        p.pad = 0;
+        p.color[3] = 0xff;
+        p.texcoord[0] = float_to_half(v.texcoord[0]);
+        p.texcoord[1] = float_to_half(v.texcoord[1]);
+    }
+}
+
+bool CookMesh(const std::vector<unsigned char>& src, const std::string& out,
+  const CookOptions& opts, std::string* report)
+{
+    (void)opts;
+
+    std::vector<ObjVertex> vertices;
+    std::vector<uint32_t> indices;
+    if (!parse_obj(src, &vertices, &indices, report)) {
+        return false;
+    }
+
+    uint32_t vcount = static_cast<uint32_t>(vertices.size());
+    float before = acmr(indices, vcount);
+    optimize_vertex_cache(&indices, vcount);
+    float after = acmr(indices, vcount);
+    optimize_vertex_fetch(&vertices, &indices);
+
+    MeshHeader header = {};
+    header.magic = MESH_MAGIC;
+    header.version = MESH_VERSION;
+    header.vertex_count = static_cast<uint32_t>(vertices.size());
+    header.index_count = static_cast<uint32_t>(indices.size());
+    header.index_size = vertices.size() <= 0xffff ? 2 : 4;
+
+    std::vector<PackedVertex> packed;
+    PackVertices(vertices, &header, &packed);
+
+    std::ofstream f(out.c_str(), std::ofstream::out | std::ofstream::binary |
+      std::ofstream::trunc);
+    if (!f.is_open()) {
+        report[0] = "could not write " + out;
+        return false;
+    }
+
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(reinterpret_cast<const char*>(packed.data()),
+      packed.size() * sizeof(PackedVertex));
+    if (header.index_size == 2) {
+        std::vector<uint16_t> narrow(indices.begin(), indices.end());
+        f.write(reinterpret_cast<const char*>(narrow.data()),
+          narrow.size() * sizeof(uint16_t));
+    } else {
+        f.write(reinterpret_cast<const char*>(indices.data()),
+          indices.size() * sizeof(uint32_t));
+    }
+
+    if (!f) {
+        report[0] = "could not write " + out;
+        return false;
+    }
+
+    std::stringstream msg;
+    msg << header.vertex_count << " vertices, " << indices.size() / 3;
+    msg << " triangles, " << sizeof(ObjVertex) * vertices.size() / 1024;
+    msg << " KiB -> " << sizeof(PackedVertex) * vertices.size() / 1024;
+    msg << " KiB of vertices, ACMR " << before << " -> " << after;
+    report[0] = msg.str();
+
+    return true;
+}
@@ -0,0 +1,141 @@
+#include "cook.h"
+
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+#include "bcn.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+/*
+* Source art is authored in sRGB, so mips are averaged in linear light and
+* converted back.  Averaging the stored values directly darkens every
+* level a little more than the last.
+*/
+struct SRGBTable {
+    float linear[256];
+
+    SRGBTable()
+    {
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            linear[i] = c <= 0.04045f ? c / 12.92f :
+              std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+    }
+};
+
+static float srgb_to_linear(unsigned char v)
+{
+    /* Function-local statics are initialized exactly once, even with
+     * several cook jobs racing to get here first. */
+    static const SRGBTable table;
+    return table.linear[v];
+}
+
+static unsigned char linear_to_srgb(float v)
+{
+    float c = v <= 0.0031308f ? v * 12.92f :
+      1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+    c = std::min(1.0f, std::max(0.0f, c));
+
+    return static_cast<unsigned char>(c * 255.0f + 0.5f);
+}
+
+/* 2x2 box filter from level 'l - 1' into level 'l'.  Odd edges clamp. */
+static void downsample(MipImage* img, size_t l)
+{
+    const MipImage::Level& src = img->levels[l - 1];
+    const MipImage::Level& dst = img->levels[l];
+    const unsigned char* in = img->data.data() + src.offset;
+    unsigned char* out = img->data.data() + dst.offset;
+
+    for (uint32_t y = 0; y < dst.height; y++) {
+        uint32_t y0 = std::min(y * 2, src.height - 1);
+        uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+
+        for (uint32_t x = 0; x < dst.width; x++) {
+            uint32_t x0 = std::min(x * 2, src.width - 1);
+            uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+
+            const unsigned char* p[4] = {
+                in + (y0 * src.width + x0) * 4,
+                in + (y0 * src.width + x1) * 4,
+                in + (y1 * src.width + x0) * 4,
+                in + (y1 * src.width + x1) * 4
+            };
+
+            unsigned char* texel = out + (y * dst.width + x) * 4;
+            for (uint32_t c = 0; c < 3; c++) {
+                float sum = srgb_to_linear(p[0][c]) + srgb_to_linear(p[1][c]) +
+                  srgb_to_linear(p[2][c]) + srgb_to_linear(p[3][c]);
+                texel[c] = linear_to_srgb(sum * 0.25f);
+            }
+            texel[3] = static_cast<unsigned char>(
+              (p[0][3] + p[1][3] + p[2][3] + p[3][3] + 2) / 4);
+        }
+    }
+}
+
+bool CookTexture(const std::vector<unsigned char>& src, const std::string& out,
+  const CookOptions& opts, std::string* report)
+{
+    int width, height, comp;
+    unsigned char* pixels = stbi_load_from_memory(src.data(),
+      static_cast<int>(src.size()), &width, &height, &comp, STBI_rgb_alpha);
+    if (pixels == nullptr) {
+        report[0] = std::string("could not decode image: ") +
+          stbi_failure_reason();
+        return false;
+    }
+
+    /*
+    * The runtime has always sampled textures as UNORM, so they're cooked
+    * that way too; only the mip filtering treats them as sRGB.
+    */
+    MipImage rgba;
+    rgba.format = MipImage::RGBA8;
+    rgba.srgb = false;
+    MipImageLayout(&rgba, static_cast<uint32_t>(width),
+      static_cast<uint32_t>(height), opts.mips ? 0 : 1);
+    std::memcpy(rgba.data.data(), pixels, rgba.levels[0].size);
+    stbi_image_free(pixels);
+
+    for (size_t l = 1; l < rgba.levels.size(); l++) {
+        downsample(&rgba, l);
+    }
+
+    /* BC1 has nowhere to put alpha; don't silently throw it away. */
+    MipImage::Format format = opts.format;
+    bool opaque = true;
+    for (size_t i = 3; i < rgba.levels[0].size && opaque; i += 4) {
+        opaque = rgba.data[i] == 0xff;
+    }
+
+    std::stringstream msg;
+    if (format == MipImage::BC1 && !opaque) {
+        format = MipImage::BC7;
+        msg << "has alpha, using BC7; ";
+    }
+
+    MipImage cooked;
+    if (!CompressImage(&rgba, format, &cooked)) {
+        report[0] = "unsupported output format";
+        return false;
+    }
+
+    if (!WriteDDS(&cooked, out)) {
+        report[0] = "could not write " + out;
+        return false;
+    }
+
+    msg << width << "x" << height << ", " << cooked.levels.size();
+    msg << " levels, " << (format == MipImage::BC1 ? "BC1" : "BC7") << ", ";
+    msg << MipImageRGBASize(&cooked) / 1024 << " KiB -> ";
+    msg << cooked.data.size() / 1024 << " KiB";
+    report[0] = msg.str();
+
+    return true;
+}
@@ -0,0 +1,167 @@
+#include "cpuprofiler.h"
+
+#include <fstream>
+#include <iomanip>
+
+std::mutex CpuProfiler::m_lock;
+std::vector<CpuProfiler::Ring*> CpuProfiler::m_rings;
+std::vector<CpuProfiler::Event> CpuProfiler::m_events;
+uint64_t CpuProfiler::m_origin = 0;
+double CpuProfiler::m_period = 0.0;
+uint64_t CpuProfiler::m_dropped = 0;
+
+thread_local CpuProfiler::Ring* CpuProfiler::m_ring = nullptr;
+
+static void write_string(std::ostream& out, const char* str)
+{
+    out << '"';
+    for (const char* c = str; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+void CpuProfiler::Init(void)
+{
+    m_origin = Timer::Ticks();
+    m_period = 1000000.0 / static_cast<double>(Timer::Frequency());
+    NameThread("main");
+}
+
+void CpuProfiler::Release(void)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    for (size_t i = 0; i < m_rings.size(); i++) {
+        delete(m_rings[i]);
+    }
+    m_rings.clear();
+    m_events.clear();
+    m_dropped = 0;
+    m_ring = nullptr;
+}
+
+void CpuProfiler::NameThread(const char* name)
+{
+    Ring* ring = m_ring;
+    if (ring == nullptr) {
+        ring = add_thread();
+    }
+    ring->name.store(name, std::memory_order_relaxed);
+}
+
+void CpuProfiler::Flush(void)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    for (size_t i = 0; i < m_rings.size(); i++) {
+        Ring* ring = m_rings[i];
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+
+        for (; tail != head; tail++) {
+            const Record& r =
+              ring->records[tail & (CPU_PROFILER_RING_RECORDS - 1)];
+            if (r.name != nullptr) {
+                ring->open.push_back(r);
+                continue;
+            }
+
+            /* Zones are only ever dropped whole, so this can't underflow. */
+            const Record& start = ring->open.back();
+            if (m_events.size() < CPU_PROFILER_TRACE_EVENTS) {
+                Event ev = {};
+                ev.name = start.name;
+                ev.tid = ring->tid;
+                ev.start_us = static_cast<double>(start.tick - m_origin) *
+                  m_period;
+                ev.duration_us = static_cast<double>(r.tick - start.tick) *
+                  m_period;
+                m_events.push_back(ev);
+            } else {
+                m_dropped++;
+            }
+            ring->open.pop_back();
+        }
+
+        /* Hands the slots back to the owning thread. */
+        ring->tail.store(tail, std::memory_order_release);
+    }
+}
+
+uint64_t CpuProfiler::GetDroppedZones(void)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    uint64_t dropped = m_dropped;
+    for (size_t i = 0; i < m_rings.size(); i++) {
+        dropped += m_rings[i]->dropped.load(std::memory_order_relaxed);
+    }
+
+    return dropped;
+}
+
+bool CpuProfiler::WriteTrace(std::string path)
+{
+    Flush();
+
+    std::ofstream out(path.c_str(), std::ofstream::out |
+      std::ofstream::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    /* Thread names first, then every zone as one complete event. */
+    const char* sep = "";
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < m_rings.size(); i++) {
+        const char* name = m_rings[i]->name.load(std::memory_order_relaxed);
+        if (name == nullptr) {
+            continue;
+        }
+        out << sep << std::endl;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,";
+        out << "\"tid\":" << m_rings[i]->tid << ",\"args\":{\"name\":";
+        write_string(out, name);
+        out << "}}";
+        sep = ",";
+    }
+
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < m_events.size(); i++) {
+        out << sep << std::endl;
+        out << "{\"name\":";
+        write_string(out, m_events[i].name);
+        out << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,";
+        out << "\"tid\":" << m_events[i].tid << ",";
+        out << "\"ts\":" << m_events[i].start_us << ",";
+        out << "\"dur\":" << m_events[i].duration_us << "}";
+        sep = ",";
+    }
+    out << std::endl;
+    out << "]}" << std::endl;
+
+    return static_cast<bool>(out);
+}
+
+CpuProfiler::Ring* CpuProfiler::add_thread(void)
+{
+    Ring* ring = new Ring();
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+    ring->depth = 0;
+    ring->dropped.store(0, std::memory_order_relaxed);
+    ring->name.store(nullptr, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    ring->tid = m_rings.size() + 1;
+    m_rings.push_back(ring);
+    m_ring = ring;
+
+    return ring;
+}
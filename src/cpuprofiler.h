@@ -0,0 +1,163 @@
+#ifndef VKTEST_CPUPROFILER_H
+#define VKTEST_CPUPROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "timer.h"
+
+/* Records per thread between Flush() calls; a power of two. */
+#define CPU_PROFILER_RING_RECORDS   (1 << 17)
+
+/* Past this many zones, WriteTrace() only has the oldest ones. */
+#define CPU_PROFILER_TRACE_EVENTS   (1 << 20)
+
+/*
+* Zones only exist in VKTEST_PROFILE builds.  Everywhere else the macros are
+* empty and nothing in here is ever touched.
+*
+*     void Renderer::Render(void)
+*     {
+*         PROFILE_ZONE("Renderer::Render");
+*         ...
+*     }
+*/
+#if defined(VKTEST_PROFILE)
+  #define CPU_PROFILER_ENABLED      (1)
+  #define PROFILE_CONCAT_(a, b)     a##b
+  #define PROFILE_CONCAT(a, b)      PROFILE_CONCAT_(a, b)
+  #define PROFILE_ZONE(name) \
+    CpuProfiler::Zone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+  #define PROFILE_THREAD(name)      CpuProfiler::NameThread(name)
+#else
+  #define CPU_PROFILER_ENABLED      (0)
+  #define PROFILE_ZONE(name)        ((void)0)
+  #define PROFILE_THREAD(name)      ((void)0)
+#endif
+
+/*
+* Times named stretches of CPU work on any thread.  Each thread gets a ring
+* of fixed-size records the first time it opens a zone, and from then on a
+* zone is two counter reads and two stores into memory no other thread
+* writes: no locks, no allocation, no shared cache lines.
+*
+* Flush() drains every ring into the trace, matching each begin with its
+* end.  It has to be called often enough that no ring fills up in between
+* (once a second is plenty); a zone that doesn't fit is dropped whole and
+* counted.  WriteTrace() flushes and writes the lot as Chrome's
+* about://tracing JSON, which Perfetto's UI opens as well.
+*
+* Zone names aren't copied; pass string literals.
+*/
+class CpuProfiler {
+public:
+    class Zone {
+    public:
+        explicit Zone(const char* name) : m_open(begin(name)) { }
+        ~Zone(void) { if (m_open) { end(); } }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+    private:
+        bool m_open;
+    };
+
+    /* Sets time zero and names the calling thread "main". */
+    static void Init(void);
+    /* Only once every thread that opened a zone is gone. */
+    static void Release(void);
+
+    /* What the calling thread shows up as in the trace. */
+    static void NameThread(const char* name);
+
+    static void Flush(void);
+    static uint64_t GetDroppedZones(void);
+    static bool WriteTrace(std::string path);
+
+private:
+    /* A null name closes the innermost open zone. */
+    struct Record {
+        const char* name;
+        uint64_t tick;
+    };
+
+    /*
+    * Single producer, single consumer.  The owning thread only moves
+    * 'head' and Flush() only moves 'tail', so they sit on separate cache
+    * lines.  Every open zone holds back a record for its end, so an end
+    * never finds the ring full and begins and ends always pair up.
+    */
+    struct Ring {
+        std::atomic<uint64_t> head;
+        char pad0[64 - sizeof(std::atomic<uint64_t>)];
+        std::atomic<uint64_t> tail;
+        char pad1[64 - sizeof(std::atomic<uint64_t>)];
+        uint64_t depth;                     // owning thread only
+        std::atomic<uint64_t> dropped;
+        std::atomic<const char*> name;
+        Record records[CPU_PROFILER_RING_RECORDS];
+
+        /* Flush() only, under m_lock. */
+        uint32_t tid;
+        std::vector<Record> open;
+    };
+
+    struct Event {
+        const char* name;
+        uint32_t tid;
+        double start_us;
+        double duration_us;
+    };
+
+    static std::mutex m_lock;
+    static std::vector<Ring*> m_rings;
+    static std::vector<Event> m_events;
+    static uint64_t m_origin;
+    static double m_period;             // microseconds per tick
+    static uint64_t m_dropped;
+
+    static thread_local Ring* m_ring;
+
+    static Ring* add_thread(void);
+
+    static bool begin(const char* name)
+    {
+        uint64_t tick = Timer::Ticks();
+        Ring* ring = m_ring;
+        if (ring == nullptr) {
+            ring = add_thread();
+        }
+
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        uint64_t tail = ring->tail.load(std::memory_order_acquire);
+        if (head - tail + ring->depth + 2 > CPU_PROFILER_RING_RECORDS) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        Record& r = ring->records[head & (CPU_PROFILER_RING_RECORDS - 1)];
+        r.name = name;
+        r.tick = tick;
+        ring->depth++;
+        ring->head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    static void end(void)
+    {
+        uint64_t tick = Timer::Ticks();
+        Ring* ring = m_ring;
+
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        Record& r = ring->records[head & (CPU_PROFILER_RING_RECORDS - 1)];
+        r.name = nullptr;
+        r.tick = tick;
+        ring->depth--;
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+};
+
+#endif  /* VKTEST_CPUPROFILER_H */
@@ -0,0 +1,349 @@
+#include "dds.h"
+
+#include <cstring>
+#include <fstream>
+
+#define DDS_MAGIC                   (0x20534444)    // "DDS "
+#define DDS_HEADER_SIZE             (124)
+#define DDS_DX10_HEADER_SIZE        (20)
+
+#define DDSD_CAPS                   (0x00000001)
+#define DDSD_HEIGHT                 (0x00000002)
+#define DDSD_WIDTH                  (0x00000004)
+#define DDSD_PIXELFORMAT            (0x00001000)
+#define DDSD_MIPMAPCOUNT            (0x00020000)
+#define DDSD_LINEARSIZE             (0x00080000)
+#define DDPF_FOURCC                 (0x00000004)
+#define DDSCAPS_COMPLEX             (0x00000008)
+#define DDSCAPS_TEXTURE             (0x00001000)
+#define DDSCAPS_MIPMAP              (0x00400000)
+#define DDSCAPS2_CUBEMAP            (0x00000200)
+#define DDSCAPS2_VOLUME             (0x00200000)
+
+#define DDS_FOURCC(a, b, c, d)      (static_cast<uint32_t>(a) | \
+  (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | \
+  (static_cast<uint32_t>(d) << 24))
+
+/* The handful of DXGI_FORMAT values we know how to upload. */
+#define DXGI_FORMAT_BC1_UNORM       (71)
+#define DXGI_FORMAT_BC1_UNORM_SRGB  (72)
+#define DXGI_FORMAT_BC3_UNORM       (77)
+#define DXGI_FORMAT_BC3_UNORM_SRGB  (78)
+#define DXGI_FORMAT_BC7_UNORM       (98)
+#define DXGI_FORMAT_BC7_UNORM_SRGB  (99)
+
+#define D3D10_RESOURCE_DIMENSION_TEXTURE2D  (3)
+
+static uint32_t read_u32(const unsigned char* p)
+{
+    return static_cast<uint32_t>(p[0]) |
+      (static_cast<uint32_t>(p[1]) << 8) |
+      (static_cast<uint32_t>(p[2]) << 16) |
+      (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void write_u32(unsigned char* p, uint32_t v)
+{
+    p[0] = static_cast<unsigned char>(v & 0xff);
+    p[1] = static_cast<unsigned char>((v >> 8) & 0xff);
+    p[2] = static_cast<unsigned char>((v >> 16) & 0xff);
+    p[3] = static_cast<unsigned char>(v >> 24);
+}
+
+size_t MipImageBlockBytes(MipImage::Format format)
+{
+    switch (format) {
+    case MipImage::BC1:
+        return 8;
+    case MipImage::BC3:
+    case MipImage::BC7:
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+uint64_t MipImageRGBASize(const MipImage* img)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < img->levels.size(); i++) {
+        total += static_cast<uint64_t>(img->levels[i].width) *
+          img->levels[i].height * 4;
+    }
+
+    return total;
+}
+
+static size_t layout(MipImage* img, uint32_t width, uint32_t height,
+  uint32_t count)
+{
+    img->width = width;
+    img->height = height;
+    img->levels.clear();
+
+    size_t unit = MipImageBlockBytes(img->format);
+    size_t offset = 0;
+    uint32_t w = width;
+    uint32_t h = height;
+
+    while (true) {
+        MipImage::Level level;
+        level.width = w;
+        level.height = h;
+        level.offset = offset;
+        if (img->format == MipImage::RGBA8) {
+            level.size = static_cast<size_t>(w) * h * unit;
+        } else {
+            level.size = static_cast<size_t>((w + 3) / 4) * ((h + 3) / 4) *
+              unit;
+        }
+
+        img->levels.push_back(level);
+        offset += level.size;
+
+        if (img->levels.size() == count || (w == 1 && h == 1)) {
+            break;
+        }
+
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    return offset;
+}
+
+void MipImageLayout(MipImage* img, uint32_t width, uint32_t height,
+  uint32_t count)
+{
+    img->view = nullptr;
+    img->data.resize(layout(img, width, height, count));
+}
+
+const unsigned char* MipImageBytes(const MipImage* img)
+{
+    return img->view != nullptr ? img->view : img->data.data();
+}
+
+size_t MipImageSize(const MipImage* img)
+{
+    if (img->levels.empty()) {
+        return 0;
+    }
+
+    return img->levels.back().offset + img->levels.back().size;
+}
+
+bool ReadDDS(MipImage* out, std::string path)
+{
+    std::ifstream f(path.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!f.is_open()) {
+        return false;
+    }
+
+    f.seekg(0L, f.end);
+    std::streamoff len = f.tellg();
+    f.seekg(0L, f.beg);
+    if (len <= 0) {
+        return false;
+    }
+
+    std::vector<unsigned char> bytes(static_cast<size_t>(len));
+    f.read(reinterpret_cast<char*>(bytes.data()), len);
+    if (!f) {
+        return false;
+    }
+
+    return ParseDDS(out, bytes.data(), bytes.size());
+}
+
+/*
+* Reads the headers, fills in the format and level table, and returns the
+* offset of the first level, or zero if the file is no good.
+*/
+static size_t parse_header(MipImage* out, const unsigned char* bytes,
+  size_t len)
+{
+    if (bytes == nullptr || len < 4 + DDS_HEADER_SIZE ||
+      read_u32(bytes) != DDS_MAGIC) {
+        return 0;
+    }
+
+    const unsigned char* hdr = bytes + 4;
+    if (read_u32(hdr) != DDS_HEADER_SIZE) {
+        return 0;
+    }
+
+    uint32_t flags = read_u32(hdr + 4);
+    uint32_t height = read_u32(hdr + 8);
+    uint32_t width = read_u32(hdr + 12);
+    uint32_t mips = read_u32(hdr + 24);
+    uint32_t pf_flags = read_u32(hdr + 76);
+    uint32_t fourcc = read_u32(hdr + 80);
+    uint32_t caps2 = read_u32(hdr + 108);
+
+    if (width == 0 || height == 0 || !(pf_flags & DDPF_FOURCC) ||
+      (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))) {
+        return 0;
+    }
+
+    size_t offset = 4 + DDS_HEADER_SIZE;
+    out->srgb = false;
+
+    if (fourcc == DDS_FOURCC('D', 'X', 'T', '1')) {
+        out->format = MipImage::BC1;
+    } else if (fourcc == DDS_FOURCC('D', 'X', 'T', '5')) {
+        out->format = MipImage::BC3;
+    } else if (fourcc == DDS_FOURCC('D', 'X', '1', '0')) {
+        if (len < offset + DDS_DX10_HEADER_SIZE) {
+            return 0;
+        }
+
+        const unsigned char* dx10 = bytes + offset;
+        uint32_t dxgi = read_u32(dx10);
+        uint32_t dimension = read_u32(dx10 + 4);
+        uint32_t array_size = read_u32(dx10 + 12);
+        offset += DDS_DX10_HEADER_SIZE;
+
+        if (dimension != D3D10_RESOURCE_DIMENSION_TEXTURE2D ||
+          array_size > 1) {
+            return 0;
+        }
+
+        switch (dxgi) {
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            out->srgb = true;
+            /* fall through */
+        case DXGI_FORMAT_BC1_UNORM:
+            out->format = MipImage::BC1;
+            break;
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            out->srgb = true;
+            /* fall through */
+        case DXGI_FORMAT_BC3_UNORM:
+            out->format = MipImage::BC3;
+            break;
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            out->srgb = true;
+            /* fall through */
+        case DXGI_FORMAT_BC7_UNORM:
+            out->format = MipImage::BC7;
+            break;
+        default:
+            return 0;
+        }
+    } else {
+        return 0;
+    }
+
+    if (!(flags & DDSD_MIPMAPCOUNT) || mips == 0) {
+        mips = 1;
+    }
+
+    size_t size = layout(out, width, height, mips);
+    if (len - offset < size) {
+        out->levels.clear();
+        return 0;
+    }
+
+    return offset;
+}
+
+bool ParseDDS(MipImage* out, const unsigned char* bytes, size_t len)
+{
+    if (out == nullptr) {
+        return false;
+    }
+
+    size_t offset = parse_header(out, bytes, len);
+    out->view = nullptr;
+    if (offset == 0) {
+        out->data.clear();
+        return false;
+    }
+
+    out->data.assign(bytes + offset, bytes + offset + MipImageSize(out));
+    return true;
+}
+
+bool ParseDDSView(MipImage* out, const unsigned char* bytes, size_t len)
+{
+    if (out == nullptr) {
+        return false;
+    }
+
+    size_t offset = parse_header(out, bytes, len);
+    out->data.clear();
+    out->view = offset == 0 ? nullptr : bytes + offset;
+
+    return offset != 0;
+}
+
+bool WriteDDS(const MipImage* img, std::string path)
+{
+    if (img == nullptr || img->levels.empty()) {
+        return false;
+    }
+
+    uint32_t fourcc = 0;
+    uint32_t dxgi = 0;
+    switch (img->format) {
+    case MipImage::BC1:
+        fourcc = DDS_FOURCC('D', 'X', 'T', '1');
+        dxgi = img->srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+        break;
+    case MipImage::BC3:
+        fourcc = DDS_FOURCC('D', 'X', 'T', '5');
+        dxgi = img->srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+        break;
+    case MipImage::BC7:
+        dxgi = img->srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+        break;
+    default:
+        return false;
+    }
+
+    bool dx10 = fourcc == 0 || img->srgb;
+    if (dx10) {
+        fourcc = DDS_FOURCC('D', 'X', '1', '0');
+    }
+
+    uint32_t levels = static_cast<uint32_t>(img->levels.size());
+    unsigned char header[4 + DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE] = {};
+    unsigned char* hdr = header + 4;
+
+    write_u32(header, DDS_MAGIC);
+    write_u32(hdr, DDS_HEADER_SIZE);
+    write_u32(hdr + 4, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH |
+      DDSD_PIXELFORMAT | DDSD_LINEARSIZE |
+      (levels > 1 ? DDSD_MIPMAPCOUNT : 0));
+    write_u32(hdr + 8, img->height);
+    write_u32(hdr + 12, img->width);
+    write_u32(hdr + 16, static_cast<uint32_t>(img->levels[0].size));
+    write_u32(hdr + 24, levels);
+    write_u32(hdr + 72, 32);
+    write_u32(hdr + 76, DDPF_FOURCC);
+    write_u32(hdr + 80, fourcc);
+    write_u32(hdr + 104, DDSCAPS_TEXTURE |
+      (levels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+
+    size_t header_size = 4 + DDS_HEADER_SIZE;
+    if (dx10) {
+        unsigned char* ext = header + header_size;
+        write_u32(ext, dxgi);
+        write_u32(ext + 4, D3D10_RESOURCE_DIMENSION_TEXTURE2D);
+        write_u32(ext + 12, 1);
+        header_size += DDS_DX10_HEADER_SIZE;
+    }
+
+    std::ofstream f(path.c_str(), std::ofstream::out |
+      std::ofstream::binary | std::ofstream::trunc);
+    if (!f.is_open()) {
+        return false;
+    }
+
+    f.write(reinterpret_cast<const char*>(header), header_size);
+    f.write(reinterpret_cast<const char*>(MipImageBytes(img)),
+      MipImageSize(img));
+
+    return static_cast<bool>(f);
+}
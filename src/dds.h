@@ -0,0 +1,80 @@
+#ifndef VKTEST_DDS_H
+#define VKTEST_DDS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+* A 2D texture and its whole mip chain, packed back to back in a single
+* allocation so that it can go to the GPU with one staging buffer and one
+* copy region per level.  Block-compressed levels are stored exactly as
+* they appear in the file.
+*
+* The levels usually live in 'data', but an image parsed out of an asset
+* pack can point 'view' at the mapped file instead and leave 'data' empty.
+* Use MipImageBytes() and MipImageSize() to get at the levels either way.
+*
+* Nothing in here touches Vulkan or SDL on purpose: the asset tools link
+* against it too.
+*/
+struct MipImage {
+    enum Format {
+        RGBA8,
+        BC1,
+        BC3,
+        BC7
+    };
+
+    struct Level {
+        uint32_t width, height;
+        size_t offset, size;
+    };
+
+    Format format;
+    bool srgb;
+    uint32_t width, height;
+    std::vector<Level> levels;
+    std::vector<unsigned char> data;
+    const unsigned char* view = nullptr;
+};
+
+/* Bytes per 4x4 block, or per texel for RGBA8. */
+size_t MipImageBlockBytes(MipImage::Format format);
+
+/* Where the packed levels start, and how many bytes they take up. */
+const unsigned char* MipImageBytes(const MipImage* img);
+size_t MipImageSize(const MipImage* img);
+
+/* How much the same mip chain would take up as plain RGBA8. */
+uint64_t MipImageRGBASize(const MipImage* img);
+
+/*
+* Fills in the level table for a width x height image with 'count' levels
+* and sizes img->data to match.  A count of zero means the full chain.
+*/
+void MipImageLayout(MipImage* img, uint32_t width, uint32_t height,
+  uint32_t count);
+
+/*
+* DDS reader.  Handles the legacy DXT1/DXT5 FourCC headers as well as the
+* DX10 extended header (needed for BC7).  Cube maps, volumes and arrays
+* are rejected.
+*/
+bool ReadDDS(MipImage* out, std::string path);
+bool ParseDDS(MipImage* out, const unsigned char* bytes, size_t len);
+
+/*
+* Same as ParseDDS, except the levels are left where they are: out->view
+* points into 'bytes', which has to outlive the image.
+*/
+bool ParseDDSView(MipImage* out, const unsigned char* bytes, size_t len);
+
+/*
+* Writes BC1/BC3 with the legacy header so that older tools can open them,
+* and BC7 (or any sRGB format) with the DX10 header.
+*/
+bool WriteDDS(const MipImage* img, std::string path);
+
+#endif // VKTEST_DDS_H
@@ -10,6 +10,7 @@ static PFN_vkDestroyDebugReportCallbackEXT
   pfnDestroyDebugReportCallback = nullptr;
 static PFN_vkDebugReportMessageEXT
   pfnDebugReportMessage = nullptr;
+static std::mutex log_lock;
 
 VKAPI_ATTR VkBool32 VKAPI_CALL VkTestDebugReportCallback(
   VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT objectType,
@@ -106,6 +107,9 @@ VKAPI_ATTR VkBool32 VKAPI_CALL VkTestDebugReportCallback(
     Renderer* state = (Renderer*)pUserData;
     std::stringstream out;
 
+    FlightRecorder::RecordText(FLIGHT_VALIDATION, pMessage, flags,
+      static_cast<uint32_t>(messageCode), object);
+
     switch (flags) {
     case VK_DEBUG_REPORT_ERROR_BIT_EXT:
         out << "ERROR: ";
@@ -137,7 +141,11 @@ VKAPI_ATTR VkBool32 VKAPI_CALL VkTestDebugReportCallback(
         out << std::endl;
     }
 
-    /* Output everything to the m_log file. */
+    /*
+    * Output everything to the m_log file.  Messages come in on whichever
+    * thread made the call, and Init() makes calls from several.
+    */
+    std::lock_guard<std::mutex> guard(log_lock);
     std::fstream* file = state->_get_log_file();
     if (file->is_open()) {
         *file << out.str().c_str();
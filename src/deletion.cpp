@@ -0,0 +1,102 @@
+#include "deletion.h"
+
+#include "flightrec.h"
+
+DeletionQueue* DeletionQueue::Init(VkDevice device, Scheduler* scheduler)
+{
+    DeletionQueue* queue = new DeletionQueue();
+    queue->m_device = device;
+    queue->m_scheduler = scheduler;
+
+    return queue;
+}
+
+void DeletionQueue::Release(DeletionQueue* queue)
+{
+    for (size_t i = 0; i < queue->m_entries.size(); i++) {
+        queue->m_entries[i].destroy();
+    }
+
+    delete(queue);
+}
+
+void DeletionQueue::Defer(std::function<void()> destroy)
+{
+    Defer(m_scheduler->GetSubmitted(), destroy);
+}
+
+void DeletionQueue::Defer(uint64_t value, std::function<void()> destroy)
+{
+    /* Nearly always the newest, so look from the back. */
+    std::deque<Entry>::iterator it = m_entries.end();
+    while (it != m_entries.begin() && (it - 1)->value > value) {
+        --it;
+    }
+
+    Entry entry = { value, destroy };
+    m_entries.insert(it, entry);
+}
+
+void DeletionQueue::DestroyBuffer(VkBuffer buffer)
+{
+    VkDevice device = m_device;
+    Defer([device, buffer]() {
+        vkDestroyBuffer(device, buffer, nullptr);
+    });
+}
+
+void DeletionQueue::DestroyFramebuffer(VkFramebuffer framebuffer)
+{
+    VkDevice device = m_device;
+    Defer([device, framebuffer]() {
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+    });
+}
+
+void DeletionQueue::DestroyImage(VkImage image)
+{
+    VkDevice device = m_device;
+    Defer([device, image]() {
+        vkDestroyImage(device, image, nullptr);
+    });
+}
+
+void DeletionQueue::DestroyImageView(VkImageView view)
+{
+    VkDevice device = m_device;
+    Defer([device, view]() {
+        vkDestroyImageView(device, view, nullptr);
+    });
+}
+
+void DeletionQueue::DestroyRenderPass(VkRenderPass renderpass)
+{
+    VkDevice device = m_device;
+    Defer([device, renderpass]() {
+        vkDestroyRenderPass(device, renderpass, nullptr);
+    });
+}
+
+void DeletionQueue::FreeMemory(VkDeviceMemory memory)
+{
+    VkDevice device = m_device;
+    Defer([device, memory]() {
+        FlightRecorder::Record(FLIGHT_FREE, (uint64_t)memory);
+        vkFreeMemory(device, memory, nullptr);
+    });
+}
+
+size_t DeletionQueue::Flush(void)
+{
+    if (m_entries.empty() || !m_scheduler->Finished(m_entries[0].value)) {
+        return m_entries.size();
+    }
+
+    uint64_t done = m_scheduler->GetCompleted();
+    while (!m_entries.empty() && m_entries.front().value <= done) {
+        m_entries.front().destroy();
+        m_entries.pop_front();
+    }
+
+    return m_entries.size();
+}
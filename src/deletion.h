@@ -0,0 +1,55 @@
+#ifndef VKTEST_DELETION_H
+#define VKTEST_DELETION_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vulkan/vulkan.h>
+
+#include "scheduler.h"
+
+/*
+* Holds on to whatever the GPU may still be using until it's done with it,
+* so that throwing something away at runtime never means idling the device.
+* Each request is tagged with a Scheduler value: by default the last one
+* submitted, since nothing after it can be using a handle that's already
+* been let go.  Flush() once a frame runs everything whose value the GPU
+* has got past, oldest first, and leaves the rest.
+*
+*     m_deletions->DestroyImageView(view);
+*     m_deletions->Defer(texture.last_use, [=]() { ... });
+*
+* Release() runs everything left regardless, so the device has to be idle
+* by then.  Like the Scheduler, it belongs to the render thread.
+*/
+class DeletionQueue {
+public:
+    static DeletionQueue* Init(VkDevice device, Scheduler* scheduler);
+    static void Release(DeletionQueue* queue);
+
+    void Defer(std::function<void()> destroy);
+    void Defer(uint64_t value, std::function<void()> destroy);
+
+    /* The usual suspects, after everything submitted so far. */
+    void DestroyBuffer(VkBuffer buffer);
+    void DestroyFramebuffer(VkFramebuffer framebuffer);
+    void DestroyImage(VkImage image);
+    void DestroyImageView(VkImageView view);
+    void DestroyRenderPass(VkRenderPass renderpass);
+    void FreeMemory(VkDeviceMemory memory);
+
+    /* Runs whatever has retired, and says how much is still waiting. */
+    size_t Flush(void);
+
+private:
+    struct Entry {
+        uint64_t value;
+        std::function<void()> destroy;
+    };
+
+    VkDevice m_device;
+    Scheduler* m_scheduler;
+    std::deque<Entry> m_entries;    // by value, then by when they came in
+};
+
+#endif  /* VKTEST_DELETION_H */
@@ -0,0 +1,443 @@
+#include "descriptors.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "pack.h"
+
+/*
+* Non-dispatchable handles are pointers on 64-bit builds and uint64_t on
+* 32-bit ones, so they get copied into a key rather than cast.
+*/
+template <typename T>
+static uint64_t handle_bits(T handle)
+{
+    uint64_t bits = 0;
+    std::memcpy(&bits, &handle, sizeof(handle));
+    return bits;
+}
+
+static uint64_t hash_key(const std::vector<uint64_t>& key)
+{
+    return HashBytes(key.data(), key.size() * sizeof(uint64_t));
+}
+
+/* Which of the three info arrays a write actually uses. */
+static bool uses_images(VkDescriptorType type)
+{
+    return type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+      type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+      type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+      type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+      type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+static bool uses_texel_views(VkDescriptorType type)
+{
+    return type == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER ||
+      type == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+}
+
+/*
+* What a set's key records for 'count' infos of one type, 'stride' bytes
+* apart from 'infos' on.  The handles among them go in 'refs' as well.
+*/
+static void key_infos(std::vector<uint64_t>* key, std::vector<uint64_t>* refs,
+  VkDescriptorType type, uint32_t count, const void* infos, size_t stride)
+{
+    const char* at = static_cast<const char*>(infos);
+    for (uint32_t i = 0; i < count; i++, at += stride) {
+        if (uses_images(type)) {
+            const VkDescriptorImageInfo* ii =
+              reinterpret_cast<const VkDescriptorImageInfo*>(at);
+            key->push_back(handle_bits(ii->sampler));
+            key->push_back(handle_bits(ii->imageView));
+            key->push_back(ii->imageLayout);
+            refs->push_back(handle_bits(ii->sampler));
+            refs->push_back(handle_bits(ii->imageView));
+        } else if (uses_texel_views(type)) {
+            key->push_back(handle_bits(
+              *reinterpret_cast<const VkBufferView*>(at)));
+            refs->push_back(key->back());
+        } else {
+            const VkDescriptorBufferInfo* bi =
+              reinterpret_cast<const VkDescriptorBufferInfo*>(at);
+            key->push_back(handle_bits(bi->buffer));
+            key->push_back(bi->offset);
+            key->push_back(bi->range);
+            refs->push_back(handle_bits(bi->buffer));
+        }
+    }
+}
+
+static bool binding_less(const VkDescriptorSetLayoutBinding* a,
+  const VkDescriptorSetLayoutBinding* b)
+{
+    return a->binding < b->binding;
+}
+
+DescriptorAllocator* DescriptorAllocator::Init(VkDevice device,
+  const CreateInfo* info)
+{
+    if (info->sets_per_pool == 0 || info->sizes.empty()) {
+        return nullptr;
+    }
+
+    DescriptorAllocator* ret = new DescriptorAllocator();
+    ret->m_device = device;
+    ret->m_sets_per_pool = info->sets_per_pool;
+    ret->m_flags = info->flags;
+    ret->m_persistent.current = VK_NULL_HANDLE;
+    ret->m_pool_count = 0;
+    ret->m_allocations = 0;
+    ret->m_layout_count = 0;
+    ret->m_pipeline_layout_count = 0;
+    ret->m_set_count = 0;
+
+    for (size_t i = 0; i < info->sizes.size(); i++) {
+        VkDescriptorPoolSize size = {};
+        size.type = info->sizes[i].type;
+        size.descriptorCount = info->sizes[i].count * info->sets_per_pool;
+        ret->m_sizes.push_back(size);
+    }
+
+    return ret;
+}
+
+void DescriptorAllocator::Release(DescriptorAllocator* allocator)
+{
+    VkDevice device = allocator->m_device;
+
+    /* Sets go away with their pools. */
+    const std::vector<VkDescriptorPool>& used = allocator->m_persistent.used;
+    for (size_t i = 0; i < used.size(); i++) {
+        vkDestroyDescriptorPool(device, used[i], nullptr);
+    }
+
+    /* Pipeline layouts first, since they were made from the others. */
+    PipelineLayoutCache::iterator pit;
+    for (pit = allocator->m_pipeline_layouts.begin();
+      pit != allocator->m_pipeline_layouts.end(); ++pit) {
+        for (size_t i = 0; i < pit->second.size(); i++) {
+            vkDestroyPipelineLayout(device, pit->second[i].value, nullptr);
+        }
+    }
+
+    LayoutCache::iterator it;
+    for (it = allocator->m_layouts.begin(); it != allocator->m_layouts.end();
+      ++it) {
+        for (size_t i = 0; i < it->second.size(); i++) {
+            vkDestroyDescriptorSetLayout(device, it->second[i].value,
+              nullptr);
+        }
+    }
+
+    delete(allocator);
+}
+
+VkResult DescriptorAllocator::GetLayout(
+  const VkDescriptorSetLayoutCreateInfo* info, VkDescriptorSetLayout* out)
+{
+    /*
+    * Per binding flags ride along in the pNext chain.  Older headers don't
+    * have VkBaseInStructure, so the chain is walked by hand.
+    */
+    const VkFlags* binding_flags = nullptr;
+#if defined(VK_EXT_descriptor_indexing)
+    struct Chain {
+        VkStructureType sType;
+        const void* pNext;
+    };
+
+    const VkStructureType flags_type =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    const Chain* next = static_cast<const Chain*>(info->pNext);
+    for (; next != nullptr; next = static_cast<const Chain*>(next->pNext)) {
+        if (next->sType == flags_type) {
+            const VkDescriptorSetLayoutBindingFlagsCreateInfoEXT* bfci =
+              reinterpret_cast<
+              const VkDescriptorSetLayoutBindingFlagsCreateInfoEXT*>(next);
+            binding_flags = bfci->pBindingFlags;
+        }
+    }
+#endif
+
+    /* The order bindings are listed in doesn't change the layout. */
+    std::vector<const VkDescriptorSetLayoutBinding*> bindings;
+    for (uint32_t i = 0; i < info->bindingCount; i++) {
+        bindings.push_back(&info->pBindings[i]);
+    }
+    std::sort(bindings.begin(), bindings.end(), binding_less);
+
+    std::vector<uint64_t> key;
+    key.push_back(info->flags);
+    key.push_back(info->bindingCount);
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const VkDescriptorSetLayoutBinding* b = bindings[i];
+        size_t index = b - info->pBindings;
+
+        key.push_back(b->binding);
+        key.push_back(b->descriptorType);
+        key.push_back(b->descriptorCount);
+        key.push_back(b->stageFlags);
+        key.push_back(binding_flags ? binding_flags[index] : 0);
+        for (uint32_t j = 0; b->pImmutableSamplers != nullptr &&
+          j < b->descriptorCount; j++) {
+            key.push_back(handle_bits(b->pImmutableSamplers[j]));
+        }
+    }
+
+    std::vector<Cached<VkDescriptorSetLayout> >& bucket =
+      m_layouts[hash_key(key)];
+    for (size_t i = 0; i < bucket.size(); i++) {
+        if (bucket[i].key == key) {
+            *out = bucket[i].value;
+            return VK_SUCCESS;
+        }
+    }
+
+    Cached<VkDescriptorSetLayout> entry;
+    VkResult result = vkCreateDescriptorSetLayout(m_device, info, nullptr,
+      &entry.value);
+    if (result) {
+        return result;
+    }
+
+    entry.key.swap(key);
+    bucket.push_back(entry);
+    m_layout_count++;
+    *out = entry.value;
+
+    return result;
+}
+
+VkResult DescriptorAllocator::GetPipelineLayout(
+  const VkPipelineLayoutCreateInfo* info, VkPipelineLayout* out)
+{
+    /* Set layouts are cached above, so their handles are the identity. */
+    std::vector<uint64_t> key;
+    key.push_back(info->flags);
+    key.push_back(info->setLayoutCount);
+    for (uint32_t i = 0; i < info->setLayoutCount; i++) {
+        key.push_back(handle_bits(info->pSetLayouts[i]));
+    }
+    key.push_back(info->pushConstantRangeCount);
+    for (uint32_t i = 0; i < info->pushConstantRangeCount; i++) {
+        key.push_back(info->pPushConstantRanges[i].stageFlags);
+        key.push_back(info->pPushConstantRanges[i].offset);
+        key.push_back(info->pPushConstantRanges[i].size);
+    }
+
+    std::vector<Cached<VkPipelineLayout> >& bucket =
+      m_pipeline_layouts[hash_key(key)];
+    for (size_t i = 0; i < bucket.size(); i++) {
+        if (bucket[i].key == key) {
+            *out = bucket[i].value;
+            return VK_SUCCESS;
+        }
+    }
+
+    Cached<VkPipelineLayout> entry;
+    VkResult result = vkCreatePipelineLayout(m_device, info, nullptr,
+      &entry.value);
+    if (result) {
+        return result;
+    }
+
+    entry.key.swap(key);
+    bucket.push_back(entry);
+    m_pipeline_layout_count++;
+    *out = entry.value;
+
+    return result;
+}
+
+VkResult DescriptorAllocator::GetSet(VkDescriptorSetLayout layout,
+  const VkWriteDescriptorSet* writes, uint32_t count, VkDescriptorSet* out)
+{
+    std::vector<uint64_t> key;
+    std::vector<uint64_t> refs;
+    key.push_back(handle_bits(layout));
+    for (uint32_t i = 0; i < count; i++) {
+        const VkWriteDescriptorSet& w = writes[i];
+        key.push_back(w.dstBinding);
+        key.push_back(w.dstArrayElement);
+        key.push_back(w.descriptorType);
+        key.push_back(w.descriptorCount);
+
+        if (uses_images(w.descriptorType)) {
+            key_infos(&key, &refs, w.descriptorType, w.descriptorCount,
+              w.pImageInfo, sizeof(VkDescriptorImageInfo));
+        } else if (uses_texel_views(w.descriptorType)) {
+            key_infos(&key, &refs, w.descriptorType, w.descriptorCount,
+              w.pTexelBufferView, sizeof(VkBufferView));
+        } else {
+            key_infos(&key, &refs, w.descriptorType, w.descriptorCount,
+              w.pBufferInfo, sizeof(VkDescriptorBufferInfo));
+        }
+    }
+
+    std::vector<CachedSet>& bucket = m_sets[hash_key(key)];
+    for (size_t i = 0; i < bucket.size(); i++) {
+        if (bucket[i].key == key) {
+            *out = bucket[i].value;
+            return VK_SUCCESS;
+        }
+    }
+
+    CachedSet entry;
+    VkResult result = allocate(&m_persistent, layout, &entry.value);
+    if (result) {
+        return result;
+    }
+
+    std::vector<VkWriteDescriptorSet> dw(writes, writes + count);
+    for (size_t i = 0; i < dw.size(); i++) {
+        dw[i].dstSet = entry.value;
+    }
+    vkUpdateDescriptorSets(m_device, dw.size(), dw.data(), 0, nullptr);
+
+    entry.key.swap(key);
+    entry.refs.swap(refs);
+    bucket.push_back(entry);
+    m_set_count++;
+    *out = entry.value;
+
+    return result;
+}
+
+VkResult DescriptorAllocator::GetSet(VkDescriptorSetLayout layout,
+  const DescriptorWriter* writer, const void* data, VkDescriptorSet* out)
+{
+    const std::vector<DescriptorWriter::Entry>& entries =
+      writer->GetEntries();
+
+    /* The same key the writes above would make for these descriptors. */
+    std::vector<uint64_t> key;
+    std::vector<uint64_t> refs;
+    key.push_back(handle_bits(layout));
+    for (size_t i = 0; i < entries.size(); i++) {
+        const DescriptorWriter::Entry& e = entries[i];
+        key.push_back(e.binding);
+        key.push_back(0);
+        key.push_back(e.type);
+        key.push_back(e.count);
+        key_infos(&key, &refs, e.type, e.count,
+          static_cast<const char*>(data) + e.offset, e.stride);
+    }
+
+    std::vector<CachedSet>& bucket = m_sets[hash_key(key)];
+    for (size_t i = 0; i < bucket.size(); i++) {
+        if (bucket[i].key == key) {
+            *out = bucket[i].value;
+            return VK_SUCCESS;
+        }
+    }
+
+    CachedSet entry;
+    VkResult result = allocate(&m_persistent, layout, &entry.value);
+    if (result) {
+        return result;
+    }
+    writer->Write(entry.value, data);
+
+    entry.key.swap(key);
+    entry.refs.swap(refs);
+    bucket.push_back(entry);
+    m_set_count++;
+    *out = entry.value;
+
+    return result;
+}
+
+void DescriptorAllocator::forget(uint64_t bits)
+{
+    if (bits == 0) {
+        return;
+    }
+
+    for (SetCache::iterator it = m_sets.begin(); it != m_sets.end(); ++it) {
+        std::vector<CachedSet>& bucket = it->second;
+        for (size_t i = 0; i < bucket.size();) {
+            const std::vector<uint64_t>& refs = bucket[i].refs;
+            if (std::find(refs.begin(), refs.end(), bits) == refs.end()) {
+                i++;
+                continue;
+            }
+
+            bucket[i] = bucket.back();
+            bucket.pop_back();
+            m_set_count--;
+        }
+    }
+}
+
+VkResult DescriptorAllocator::Allocate(VkDescriptorSetLayout layout,
+  VkDescriptorSet* out)
+{
+    return allocate(&m_persistent, layout, out);
+}
+
+void DescriptorAllocator::GetStats(Stats* out)
+{
+    out->pools = m_pool_count;
+    out->layouts = m_layout_count;
+    out->pipeline_layouts = m_pipeline_layout_count;
+    out->cached_sets = m_set_count;
+    out->allocations = m_allocations;
+}
+
+VkResult DescriptorAllocator::allocate(PoolGroup* group,
+  VkDescriptorSetLayout layout, VkDescriptorSet* out)
+{
+    VkDescriptorSetAllocateInfo ai = {};
+    ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    ai.descriptorSetCount = 1;
+    ai.pSetLayouts = &layout;
+
+    VkResult result = VK_SUCCESS;
+    if (group->current != VK_NULL_HANDLE) {
+        ai.descriptorPool = group->current;
+        result = vkAllocateDescriptorSets(m_device, &ai, out);
+        if (result == VK_SUCCESS) {
+            m_allocations++;
+            return result;
+        }
+    }
+
+    /*
+    * Which error a full pool reports depends on the driver and on whether
+    * VK_KHR_maintenance1 is around, so any failure gets one more try out
+    * of a fresh pool.  Failing that, the set doesn't fit in a pool at all.
+    */
+    result = grab_pool(&group->current);
+    if (result) {
+        return result;
+    }
+    group->used.push_back(group->current);
+
+    ai.descriptorPool = group->current;
+    result = vkAllocateDescriptorSets(m_device, &ai, out);
+    if (result == VK_SUCCESS) {
+        m_allocations++;
+    }
+
+    return result;
+}
+
+VkResult DescriptorAllocator::grab_pool(VkDescriptorPool* out)
+{
+    VkDescriptorPoolCreateInfo pi = {};
+    pi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pi.flags = m_flags;
+    pi.maxSets = m_sets_per_pool;
+    pi.poolSizeCount = m_sizes.size();
+    pi.pPoolSizes = m_sizes.data();
+
+    VkResult result = vkCreateDescriptorPool(m_device, &pi, nullptr, out);
+    if (result == VK_SUCCESS) {
+        m_pool_count++;
+    }
+
+    return result;
+}
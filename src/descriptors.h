@@ -0,0 +1,132 @@
+#ifndef VKTEST_DESCRIPTORS_H
+#define VKTEST_DESCRIPTORS_H
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "descwriter.h"
+
+/*
+* The DescriptorAllocator hands out descriptor sets from pools that it
+* creates as it goes.  Every pool has the same shape (CreateInfo::sizes
+* times sets_per_pool), so when one runs dry the next one is chained on and
+* the allocation is simply retried.  Every set lives until the allocator
+* is released; nothing is freed or reset one set at a time.
+*
+* Set layouts are cached by a hash of their bindings, so asking for the
+* same layout twice hands back the same handle.  Pipeline layouts likewise,
+* by their set layouts and push constant ranges.  GetSet() does the same for
+* sets whose contents never change once written, keyed on the layout and
+* the writes (or a DescriptorWriter and the struct it writes from): a hit
+* costs no driver calls at all.  Whatever a cached set points at has to
+* outlive the allocator, or be Forget()ten before it's destroyed.
+*
+* The allocator owns every layout, set and pool it hands out.
+*/
+class DescriptorAllocator {
+public:
+    /* How many descriptors of a type one set needs. */
+    struct PoolSize {
+        VkDescriptorType type;
+        uint32_t count;
+    };
+
+    struct CreateInfo {
+        uint32_t sets_per_pool;
+        VkDescriptorPoolCreateFlags flags;
+        std::vector<PoolSize> sizes;
+    };
+
+    struct Stats {
+        uint32_t pools;
+        uint32_t layouts;
+        uint32_t pipeline_layouts;
+        uint32_t cached_sets;
+        uint64_t allocations;
+    };
+
+    static DescriptorAllocator* Init(VkDevice device, const CreateInfo* info);
+    static void Release(DescriptorAllocator* allocator);
+
+    VkResult GetLayout(const VkDescriptorSetLayoutCreateInfo* info,
+      VkDescriptorSetLayout* out);
+    VkResult GetPipelineLayout(const VkPipelineLayoutCreateInfo* info,
+      VkPipelineLayout* out);
+    VkResult GetSet(VkDescriptorSetLayout layout,
+      const VkWriteDescriptorSet* writes, uint32_t count,
+      VkDescriptorSet* out);
+    VkResult GetSet(VkDescriptorSetLayout layout,
+      const DescriptorWriter* writer, const void* data,
+      VkDescriptorSet* out);
+
+    /*
+    * Drops every cached set that points at 'handle' (an image view,
+    * sampler, buffer or buffer view), so that whatever is created later
+    * with the same handle value isn't given a set meant for this one.  The
+    * sets themselves stay allocated until Release(), since in-flight
+    * frames may still have them bound.
+    */
+    template <typename T>
+    void Forget(T handle)
+    {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &handle, sizeof(handle));
+        forget(bits);
+    }
+
+    VkResult Allocate(VkDescriptorSetLayout layout, VkDescriptorSet* out);
+
+    void GetStats(Stats* out);
+
+private:
+    struct PoolGroup {
+        VkDescriptorPool current;
+        std::vector<VkDescriptorPool> used;
+    };
+
+    /* Hash buckets keep the whole key so that collisions can't alias. */
+    template <typename T>
+    struct Cached {
+        std::vector<uint64_t> key;
+        T value;
+    };
+
+    typedef std::unordered_map<uint64_t,
+      std::vector<Cached<VkDescriptorSetLayout> > > LayoutCache;
+    typedef std::unordered_map<uint64_t,
+      std::vector<Cached<VkPipelineLayout> > > PipelineLayoutCache;
+    /* Sets also remember which handles they point at, for Forget(). */
+    struct CachedSet {
+        std::vector<uint64_t> key;
+        std::vector<uint64_t> refs;
+        VkDescriptorSet value;
+    };
+
+    typedef std::unordered_map<uint64_t, std::vector<CachedSet> > SetCache;
+
+    VkDevice m_device;
+    std::vector<VkDescriptorPoolSize> m_sizes;
+    uint32_t m_sets_per_pool;
+    VkDescriptorPoolCreateFlags m_flags;
+
+    PoolGroup m_persistent;
+    uint32_t m_pool_count;
+    uint64_t m_allocations;
+
+    LayoutCache m_layouts;
+    PipelineLayoutCache m_pipeline_layouts;
+    SetCache m_sets;
+    uint32_t m_layout_count;
+    uint32_t m_pipeline_layout_count;
+    uint32_t m_set_count;
+
+    VkResult allocate(PoolGroup* group, VkDescriptorSetLayout layout,
+      VkDescriptorSet* out);
+    VkResult grab_pool(VkDescriptorPool* out);
+    void forget(uint64_t bits);
+};
+
+#endif  /* VKTEST_DESCRIPTORS_H */
@@ -0,0 +1,172 @@
+#include "descwriter.h"
+
+#include "global.h"
+
+/* Which of the three info arrays a write of this type reads. */
+enum InfoKind {
+    INFO_IMAGE,
+    INFO_TEXEL_VIEW,
+    INFO_BUFFER
+};
+
+static InfoKind info_kind(VkDescriptorType type)
+{
+    switch (type) {
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+        return INFO_IMAGE;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+        return INFO_TEXEL_VIEW;
+    default:
+        return INFO_BUFFER;
+    }
+}
+
+/* How far apart the infos are when they're packed into an array. */
+static size_t info_size(InfoKind kind)
+{
+    switch (kind) {
+    case INFO_IMAGE:
+        return sizeof(VkDescriptorImageInfo);
+    case INFO_TEXEL_VIEW:
+        return sizeof(VkBufferView);
+    default:
+        return sizeof(VkDescriptorBufferInfo);
+    }
+}
+
+DescriptorWriter* DescriptorWriter::Init(VkDevice device,
+  VkDescriptorSetLayout layout, const std::vector<Entry>& entries,
+  bool templates)
+{
+    DescriptorWriter* writer = new DescriptorWriter();
+    writer->m_device = device;
+    writer->m_entries = entries;
+
+#if defined(VK_KHR_descriptor_update_template)
+    writer->m_template = VK_NULL_HANDLE;
+    writer->m_destroy = nullptr;
+    writer->m_update = nullptr;
+
+    PFN_vkCreateDescriptorUpdateTemplateKHR create = nullptr;
+    if (templates && !entries.empty()) {
+        create = (PFN_vkCreateDescriptorUpdateTemplateKHR)
+          vkGetDeviceProcAddr(device, "vkCreateDescriptorUpdateTemplateKHR");
+        writer->m_destroy = (PFN_vkDestroyDescriptorUpdateTemplateKHR)
+          vkGetDeviceProcAddr(device, "vkDestroyDescriptorUpdateTemplateKHR");
+        writer->m_update = (PFN_vkUpdateDescriptorSetWithTemplateKHR)
+          vkGetDeviceProcAddr(device,
+          "vkUpdateDescriptorSetWithTemplateKHR");
+    }
+
+    if (create != nullptr && writer->m_destroy != nullptr &&
+      writer->m_update != nullptr) {
+        std::vector<VkDescriptorUpdateTemplateEntryKHR> te;
+        for (size_t i = 0; i < entries.size(); i++) {
+            VkDescriptorUpdateTemplateEntryKHR e = {};
+            e.dstBinding = entries[i].binding;
+            e.dstArrayElement = 0;
+            e.descriptorCount = entries[i].count;
+            e.descriptorType = entries[i].type;
+            e.offset = entries[i].offset;
+            e.stride = entries[i].stride;
+            te.push_back(e);
+        }
+
+        VkDescriptorUpdateTemplateCreateInfoKHR ci = {};
+        ci.sType =
+          VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+        ci.descriptorUpdateEntryCount = te.size();
+        ci.pDescriptorUpdateEntries = te.data();
+        ci.templateType =
+          VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+        ci.descriptorSetLayout = layout;
+
+        VkResult result = create(device, &ci, nullptr, &writer->m_template);
+        if (result) {
+            Log::Write(Log::WARNING, "DescriptorWriter::Init -> making the "
+              "update template failed with {}; using plain writes.", result);
+            writer->m_template = VK_NULL_HANDLE;
+        }
+    }
+#else
+    (void)layout;
+    (void)templates;
+#endif
+
+    return writer;
+}
+
+void DescriptorWriter::Release(DescriptorWriter* writer)
+{
+#if defined(VK_KHR_descriptor_update_template)
+    if (writer->m_template != VK_NULL_HANDLE) {
+        writer->m_destroy(writer->m_device, writer->m_template, nullptr);
+    }
+#endif
+
+    delete(writer);
+}
+
+void DescriptorWriter::Write(VkDescriptorSet set, const void* data) const
+{
+#if defined(VK_KHR_descriptor_update_template)
+    if (m_template != VK_NULL_HANDLE) {
+        m_update(m_device, set, m_template, data);
+        return;
+    }
+#endif
+
+    const char* base = static_cast<const char*>(data);
+    std::vector<VkWriteDescriptorSet> dw;
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        const Entry& e = m_entries[i];
+
+        /* A write's infos are an array, so a wider stride needs one each. */
+        InfoKind kind = info_kind(e.type);
+        bool packed = e.stride == info_size(kind);
+        uint32_t writes = packed ? 1 : e.count;
+        for (uint32_t j = 0; j < writes; j++) {
+            const void* info = base + e.offset + j * e.stride;
+
+            VkWriteDescriptorSet w = {};
+            w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            w.dstSet = set;
+            w.dstBinding = e.binding;
+            w.dstArrayElement = j;
+            w.descriptorCount = packed ? e.count : 1;
+            w.descriptorType = e.type;
+            if (kind == INFO_IMAGE) {
+                w.pImageInfo =
+                  static_cast<const VkDescriptorImageInfo*>(info);
+            } else if (kind == INFO_TEXEL_VIEW) {
+                w.pTexelBufferView = static_cast<const VkBufferView*>(info);
+            } else {
+                w.pBufferInfo =
+                  static_cast<const VkDescriptorBufferInfo*>(info);
+            }
+            dw.push_back(w);
+        }
+    }
+
+    vkUpdateDescriptorSets(m_device, dw.size(), dw.data(), 0, nullptr);
+}
+
+const std::vector<DescriptorWriter::Entry>&
+  DescriptorWriter::GetEntries(void) const
+{
+    return m_entries;
+}
+
+bool DescriptorWriter::UsesTemplate(void) const
+{
+#if defined(VK_KHR_descriptor_update_template)
+    return m_template != VK_NULL_HANDLE;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,58 @@
+#ifndef VKTEST_DESCWRITER_H
+#define VKTEST_DESCWRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/*
+* Fills in every descriptor of one set layout from a single struct of
+* handles.  Each Entry says where in that struct a binding's infos sit
+* (VkDescriptorBufferInfo, VkDescriptorImageInfo or VkBufferView, as the
+* type calls for), so a whole set goes in with one call:
+*
+*     struct Data { VkDescriptorBufferInfo camera; ... };
+*     writer->Write(set, &data);
+*
+* With VK_KHR_descriptor_update_template that's one template made up front
+* and one vkUpdateDescriptorSetWithTemplateKHR per set, which spares the
+* driver from walking VkWriteDescriptorSets.  Without it, the same entries
+* are turned into writes that point straight into the struct.
+*/
+class DescriptorWriter {
+public:
+    struct Entry {
+        uint32_t binding;
+        uint32_t count;
+        VkDescriptorType type;
+        size_t offset;          // of the first info in the struct
+        size_t stride;          // between infos of the same binding
+    };
+
+    /*
+    * 'templates' says the device has the extension enabled.  If making the
+    * template fails anyway, the writer quietly falls back to writes.
+    */
+    static DescriptorWriter* Init(VkDevice device,
+      VkDescriptorSetLayout layout, const std::vector<Entry>& entries,
+      bool templates);
+    static void Release(DescriptorWriter* writer);
+
+    void Write(VkDescriptorSet set, const void* data) const;
+
+    const std::vector<Entry>& GetEntries(void) const;
+    bool UsesTemplate(void) const;
+
+private:
+    VkDevice m_device;
+    std::vector<Entry> m_entries;
+
+#if defined(VK_KHR_descriptor_update_template)
+    VkDescriptorUpdateTemplateKHR m_template;
+    PFN_vkDestroyDescriptorUpdateTemplateKHR m_destroy;
+    PFN_vkUpdateDescriptorSetWithTemplateKHR m_update;
+#endif
+};
+
+#endif  /* VKTEST_DESCWRITER_H */
@@ -0,0 +1,91 @@
+#include "dirwatch.h"
+
+#include <algorithm>
+
+#if defined(__linux__)
+  #include <poll.h>
+  #include <sys/inotify.h>
+  #include <unistd.h>
+#endif
+
+DirWatcher* DirWatcher::Init(std::string dir)
+{
+#if defined(__linux__)
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    int watch = inotify_add_watch(fd, dir.c_str(),
+      IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch < 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    DirWatcher* watcher = new DirWatcher();
+    watcher->m_dir = dir;
+    watcher->m_fd = fd;
+    watcher->m_watch = watch;
+
+    return watcher;
+#else
+    (void)dir;
+    return nullptr;
+#endif
+}
+
+void DirWatcher::Release(DirWatcher* watcher)
+{
+#if defined(__linux__)
+    inotify_rm_watch(watcher->m_fd, watcher->m_watch);
+    close(watcher->m_fd);
+#endif
+    delete(watcher);
+}
+
+bool DirWatcher::Wait(uint32_t timeout_ms, std::vector<std::string>* changed)
+{
+#if defined(__linux__)
+    struct pollfd pfd = {};
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, static_cast<int>(timeout_ms)) <= 0) {
+        return false;
+    }
+
+    /* Aligned for the events the kernel packs into it. */
+    alignas(struct inotify_event) char buffer[4096];
+    size_t before = changed->size();
+
+    for (;;) {
+        ssize_t len = read(m_fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            break;
+        }
+
+        ssize_t offset = 0;
+        while (offset < len) {
+            const struct inotify_event* ev =
+              reinterpret_cast<const struct inotify_event*>(buffer + offset);
+            offset += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->len == 0 || (ev->mask & IN_ISDIR)) {
+                continue;
+            }
+
+            std::string path = m_dir + "/" + ev->name;
+            if (std::find(changed->begin(), changed->end(), path) ==
+              changed->end()) {
+                changed->push_back(path);
+            }
+        }
+    }
+
+    return changed->size() > before;
+#else
+    (void)timeout_ms;
+    (void)changed;
+    return false;
+#endif
+}
@@ -0,0 +1,36 @@
+#ifndef VKTEST_DIRWATCH_H
+#define VKTEST_DIRWATCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+* Tells whoever asks which files in one directory have been written since
+* they last asked.  Only files that were closed after writing, or renamed
+* into the directory, count, so a compiler that's half way through its
+* output doesn't show up yet.
+*
+* Built on inotify, so Init() gives back nullptr anywhere but Linux, and
+* callers are expected to carry on without it.
+*/
+class DirWatcher {
+public:
+    static DirWatcher* Init(std::string dir);
+    static void Release(DirWatcher* watcher);
+
+    /*
+    * Waits up to 'timeout_ms' for something to change, then adds the path
+    * of every file that did to 'changed', each once.  The paths are the
+    * directory given to Init() plus a slash and the file name.  False if
+    * nothing changed in time.
+    */
+    bool Wait(uint32_t timeout_ms, std::vector<std::string>* changed);
+
+private:
+    std::string m_dir;
+    int m_fd;
+    int m_watch;
+};
+
+#endif // VKTEST_DIRWATCH_H
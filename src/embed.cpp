@@ -0,0 +1,177 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+* vktest-embed: bakes compiled SPIR-V into a header for shaderlib.cpp, so
+* vktest doesn't have to find its shaders on disk at startup.  Each file
+* becomes an aligned constexpr uint32_t array, and a manifest at the end
+* lists them under their file names with the .spv taken off.
+*
+*     vktest-embed --out=shaders_embedded.h shaders/test.vert.spv ...
+*
+* The header is written every time, even when it comes out the same:
+* make and CMake only see that it's up to date by its timestamp.
+*/
+
+#define SPIRV_MAGIC     (0x07230203)
+
+static void print_help(void)
+{
+    std::stringstream out;
+    out << "Usage: vktest-embed --out=FILE [SPIRV...]" << std::endl;
+    out << std::endl;
+    out << "Writes the SPIR-V files as C++ arrays, with a manifest, for ";
+    out << "vktest to" << std::endl << "compile in." << std::endl;
+
+    std::cout << out.str();
+}
+
+/* Words in the host's order, whichever order the file was written in. */
+static bool read_spirv(const std::string& path, std::vector<uint32_t>* out)
+{
+    std::ifstream f(path.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!f.is_open()) {
+        return false;
+    }
+
+    f.seekg(0L, f.end);
+    std::streamoff len = f.tellg();
+    f.seekg(0L, f.beg);
+    if (len < 20 || len % 4 != 0) {
+        return false;
+    }
+
+    out->resize(static_cast<size_t>(len) / 4);
+    f.read(reinterpret_cast<char*>(out->data()), len);
+    if (!f) {
+        return false;
+    }
+
+    if ((*out)[0] == SPIRV_MAGIC) {
+        return true;
+    }
+
+    for (size_t i = 0; i < out->size(); i++) {
+        uint32_t w = (*out)[i];
+        (*out)[i] = (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) |
+          (w << 24);
+    }
+
+    return (*out)[0] == SPIRV_MAGIC;
+}
+
+/* "shaders/test.vert.spv" is "test.vert". */
+static std::string shader_name(const std::string& path)
+{
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    size_t ext = name.rfind(".spv");
+    if (ext != std::string::npos && ext + 4 == name.size()) {
+        name.erase(ext);
+    }
+
+    return name;
+}
+
+/* ...and its array is spirv_test_vert. */
+static std::string symbol_name(const std::string& name)
+{
+    std::string symbol = "spirv_";
+    for (size_t i = 0; i < name.size(); i++) {
+        char c = name[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+          (c >= '0' && c <= '9');
+        symbol += ok ? c : '_';
+    }
+
+    return symbol;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string out_path;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (std::strcmp(arg, "--help") == 0) {
+            print_help();
+            return EXIT_SUCCESS;
+        } else if (std::strncmp(arg, "--out=", 6) == 0) {
+            out_path = arg + 6;
+        } else if (std::strncmp(arg, "--", 2) == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return EXIT_FAILURE;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (out_path.empty()) {
+        print_help();
+        return EXIT_FAILURE;
+    }
+
+    std::stringstream out;
+    out << "/* Generated by vktest-embed.  Don't edit. */" << std::endl;
+    out << "#ifndef VKTEST_SHADERS_EMBEDDED_H" << std::endl;
+    out << "#define VKTEST_SHADERS_EMBEDDED_H" << std::endl << std::endl;
+
+    std::vector<std::string> names;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        std::vector<uint32_t> words;
+        if (!read_spirv(inputs[i], &words)) {
+            std::cerr << inputs[i] << " isn't SPIR-V." << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::string name = shader_name(inputs[i]);
+        for (size_t j = 0; j < names.size(); j++) {
+            if (names[j] == name) {
+                std::cerr << "Two shaders called " << name << "."
+                  << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        names.push_back(name);
+
+        out << "alignas(16) static constexpr uint32_t " << symbol_name(name)
+          << "[] = {";
+        for (size_t j = 0; j < words.size(); j++) {
+            out << (j % 6 == 0 ? "\n    " : " ") << "0x" << std::hex
+              << std::setw(8) << std::setfill('0') << words[j] << std::dec
+              << (j + 1 < words.size() ? "," : "");
+        }
+        out << std::endl << "};" << std::endl << std::endl;
+    }
+
+    /* Never empty, so there's something to declare without shaders. */
+    out << "static const EmbeddedShader embedded_shaders[] = {" << std::endl;
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string symbol = symbol_name(names[i]);
+        out << "    { \"" << names[i] << "\", " << symbol << ", sizeof("
+          << symbol << ") }," << std::endl;
+    }
+    out << "    { nullptr, nullptr, 0 }" << std::endl << "};" << std::endl;
+    out << std::endl << "#endif // VKTEST_SHADERS_EMBEDDED_H" << std::endl;
+
+    std::ofstream f(out_path.c_str(), std::ofstream::out |
+      std::ofstream::binary | std::ofstream::trunc);
+    f << out.str();
+    if (!f) {
+        std::cerr << "Could not write " << out_path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Embedded " << names.size() << " shaders in " << out_path
+      << std::endl;
+
+    return EXIT_SUCCESS;
+}
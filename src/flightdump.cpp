@@ -0,0 +1,373 @@
+/* flightrec.h pulls in SDL for its clock; keep SDL's hands off main(). */
+#define SDL_MAIN_HANDLED
+#include "flightrec.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+/*
+* vktest-flight: turns a flight recorder file back into something to read.
+* Plain text on stdout by default, or a Chrome trace (about://tracing, or
+* Perfetto's UI) with --chrome.
+*/
+
+/* One slot that survived, with its message if it carried one. */
+struct Decoded {
+    uint64_t tick;
+    uint16_t type;
+    uint16_t thread;
+    uint64_t a, b, c;
+    std::string text;
+};
+
+static const char* type_names[FLIGHT_TYPE_COUNT] = {
+    "none",
+    "frame_begin",
+    "frame_end",
+    "acquire",
+    "submit",
+    "present",
+    "swapchain",
+    "alloc",
+    "free",
+    "validation",
+    "text"
+};
+
+static void print_help(void)
+{
+    std::stringstream out;
+    out << "Usage: vktest-flight [OPTIONS] FILE" << std::endl << std::endl;
+    out << "Decodes a flight recorder file (" << FLIGHT_DEFAULT_PATH;
+    out << " by default) written by vktest." << std::endl;
+    out << std::endl << "Options:" << std::endl;
+    out << "\t--chrome=FILE\tWrite a Chrome trace instead of text.";
+    out << std::endl;
+    out << "\t--help\t\tPrint this help message." << std::endl;
+
+    std::cout << out.str();
+}
+
+static bool read_file(const std::string& path, std::vector<char>* out)
+{
+    std::ifstream f(path.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!f.is_open()) {
+        return false;
+    }
+
+    f.seekg(0L, f.end);
+    std::streamoff len = f.tellg();
+    f.seekg(0L, f.beg);
+    if (len < 0) {
+        return false;
+    }
+
+    out->resize(static_cast<size_t>(len));
+    f.read(out->data(), len);
+
+    return static_cast<bool>(f);
+}
+
+/*
+* Walks the ring oldest first.  A slot only counts if its sequence number
+* says it was finished on the lap the head expects; anything else was cut
+* off mid-write or already overwritten by a later lap.
+*/
+static bool decode(const std::vector<char>& file, const FlightHeader** hdr,
+  std::vector<Decoded>* out, uint64_t* torn)
+{
+    if (file.size() < FLIGHT_HEADER_SIZE) {
+        return false;
+    }
+
+    const FlightHeader* h = reinterpret_cast<const FlightHeader*>(
+      file.data());
+    bool ok = h->magic == FLIGHT_MAGIC && h->version == FLIGHT_VERSION &&
+      h->event_size == sizeof(FlightEvent) && h->capacity != 0 &&
+      (h->capacity & (h->capacity - 1)) == 0 &&
+      (file.size() - FLIGHT_HEADER_SIZE) / sizeof(FlightEvent) >=
+      h->capacity;
+    if (!ok) {
+        return false;
+    }
+    *hdr = h;
+
+    const FlightEvent* events = reinterpret_cast<const FlightEvent*>(
+      file.data() + FLIGHT_HEADER_SIZE);
+    uint64_t mask = h->capacity - 1;
+    uint64_t head = h->head.load(std::memory_order_relaxed);
+    uint64_t pos = head > h->capacity ? head - h->capacity : 0;
+
+    *torn = 0;
+    for (; pos < head; pos++) {
+        const FlightEvent& ev = events[pos & mask];
+        if (ev.sequence.load(std::memory_order_relaxed) != pos + 1 ||
+          ev.type >= FLIGHT_TYPE_COUNT) {
+            (*torn)++;
+            continue;
+        }
+        if (ev.type == FLIGHT_TEXT) {
+            continue;   // picked up with the slot it belongs to
+        }
+
+        Decoded d = {};
+        d.tick = ev.tick;
+        d.type = ev.type;
+        d.thread = ev.thread;
+        d.a = ev.args.a;
+        d.b = ev.args.b;
+        d.c = ev.args.c;
+
+        for (uint16_t i = 1; i <= ev.extra && pos + i < head; i++) {
+            const FlightEvent& t = events[(pos + i) & mask];
+            if (t.sequence.load(std::memory_order_relaxed) != pos + i + 1 ||
+              t.type != FLIGHT_TEXT) {
+                break;
+            }
+            d.text.append(t.text, strnlen(t.text, FLIGHT_TEXT_BYTES));
+        }
+
+        out->push_back(d);
+    }
+
+    return true;
+}
+
+static double to_ms(const FlightHeader* h, uint64_t tick)
+{
+    int64_t since = static_cast<int64_t>(tick - h->origin);
+    return static_cast<double>(since) * 1000.0 /
+      static_cast<double>(h->frequency);
+}
+
+static std::string hex(uint64_t value)
+{
+    std::stringstream out;
+    out << "0x" << std::hex << value;
+    return out.str();
+}
+
+/* What each event says, apart from when and where. */
+static std::string describe(const Decoded& d)
+{
+    std::stringstream out;
+    int32_t result = static_cast<int32_t>(d.b);
+
+    switch (d.type) {
+    case FLIGHT_FRAME_BEGIN:
+    case FLIGHT_FRAME_END:
+        out << "frame " << d.a;
+        break;
+    case FLIGHT_ACQUIRE:
+    case FLIGHT_PRESENT:
+        out << "image " << d.a << ", VkResult " << result;
+        break;
+    case FLIGHT_SUBMIT:
+        if (d.a == UINT32_MAX) {
+            out << "one-off";
+        } else {
+            out << "image " << d.a;
+        }
+        break;
+    case FLIGHT_SWAPCHAIN:
+        out << d.a << "x" << d.b;
+        break;
+    case FLIGHT_ALLOC:
+        out << hex(d.a) << ", " << d.b << " bytes, type " << d.c;
+        break;
+    case FLIGHT_FREE:
+        out << hex(d.a);
+        break;
+    case FLIGHT_VALIDATION:
+        out << "flags " << hex(d.a) << ", code " << static_cast<int32_t>(d.b);
+        out << ", object " << hex(d.c);
+        break;
+    }
+
+    if (!d.text.empty()) {
+        out << ": " << d.text;
+    }
+
+    return out.str();
+}
+
+static void write_text(std::ostream& out, const FlightHeader* h,
+  const std::vector<Decoded>& events, uint64_t torn)
+{
+    time_t wall = static_cast<time_t>(h->wall_time);
+    out << "Recording started " << std::ctime(&wall);
+    out << events.size() << " events kept of the last " << h->capacity;
+    out << ", " << torn << " unreadable." << std::endl;
+
+    /* A frame_end also says how long it was since its frame_begin. */
+    std::map<uint64_t, uint64_t> begun;
+
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < events.size(); i++) {
+        const Decoded& d = events[i];
+        out << std::setw(12) << to_ms(h, d.tick) << " ms  t" << d.thread;
+        out << "  " << std::left << std::setw(12) << type_names[d.type];
+        out << std::right << describe(d);
+
+        if (d.type == FLIGHT_FRAME_BEGIN) {
+            begun[d.a] = d.tick;
+        } else if (d.type == FLIGHT_FRAME_END && begun.count(d.a) != 0) {
+            out << " (" << to_ms(h, d.tick) - to_ms(h, begun[d.a]);
+            out << " ms)";
+            begun.erase(d.a);
+        }
+        out << std::endl;
+    }
+}
+
+static std::string json_string(const std::string& str)
+{
+    std::string ret = "\"";
+    for (size_t i = 0; i < str.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        if (c == '"' || c == '\\') {
+            ret += '\\';
+            ret += str[i];
+        } else if (c < 0x20) {
+            ret += ' ';
+        } else {
+            ret += str[i];
+        }
+    }
+
+    return ret + "\"";
+}
+
+/*
+* Frames become complete events on their thread, device memory a counter,
+* and everything else an instant event carrying its description.
+*/
+static bool write_chrome(std::string path, const FlightHeader* h,
+  const std::vector<Decoded>& events)
+{
+    std::ofstream out(path.c_str(), std::ofstream::out |
+      std::ofstream::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    std::map<uint64_t, const Decoded*> begun;
+    std::map<uint64_t, uint64_t> sizes;
+    uint64_t resident = 0;
+
+    const char* sep = "";
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); i++) {
+        const Decoded& d = events[i];
+        double us = to_ms(h, d.tick) * 1000.0;
+
+        if (d.type == FLIGHT_FRAME_BEGIN) {
+            begun[d.a] = &d;
+            continue;
+        }
+
+        if (d.type == FLIGHT_FRAME_END) {
+            if (begun.count(d.a) == 0) {
+                continue;
+            }
+            const Decoded* b = begun[d.a];
+            double start = to_ms(h, b->tick) * 1000.0;
+            out << sep << std::endl;
+            out << "{\"name\":\"frame " << d.a << "\",\"cat\":\"frame\",";
+            out << "\"ph\":\"X\",\"pid\":1,\"tid\":" << b->thread << ",";
+            out << "\"ts\":" << start << ",\"dur\":" << us - start << "}";
+            begun.erase(d.a);
+            sep = ",";
+            continue;
+        }
+
+        if (d.type == FLIGHT_ALLOC || d.type == FLIGHT_FREE) {
+            if (d.type == FLIGHT_ALLOC) {
+                sizes[d.a] = d.b;
+                resident += d.b;
+            } else if (sizes.count(d.a) != 0) {
+                resident -= sizes[d.a];
+                sizes.erase(d.a);
+            }
+            out << sep << std::endl;
+            out << "{\"name\":\"device memory\",\"ph\":\"C\",\"pid\":1,";
+            out << "\"ts\":" << us << ",\"args\":{\"bytes\":" << resident;
+            out << "}}";
+            sep = ",";
+        }
+
+        out << sep << std::endl;
+        out << "{\"name\":\"" << type_names[d.type] << "\",";
+        out << "\"cat\":\"flight\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,";
+        out << "\"tid\":" << d.thread << ",\"ts\":" << us << ",";
+        out << "\"args\":{\"what\":" << json_string(describe(d)) << "}}";
+        sep = ",";
+    }
+    out << std::endl;
+    out << "]}" << std::endl;
+
+    return static_cast<bool>(out);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string input;
+    std::string chrome;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (std::strcmp(arg, "--help") == 0) {
+            print_help();
+            return EXIT_SUCCESS;
+        } else if (std::strncmp(arg, "--chrome=", 9) == 0) {
+            chrome = arg + 9;
+        } else if (std::strncmp(arg, "--", 2) == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return EXIT_FAILURE;
+        } else {
+            input = arg;
+        }
+    }
+
+    if (input.empty()) {
+        print_help();
+        return EXIT_FAILURE;
+    }
+
+    std::vector<char> file;
+    if (!read_file(input, &file)) {
+        std::cerr << "Could not read " << input << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const FlightHeader* hdr = nullptr;
+    std::vector<Decoded> events;
+    uint64_t torn = 0;
+    if (!decode(file, &hdr, &events, &torn)) {
+        std::cerr << input << " isn't a flight recorder file." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (chrome.empty()) {
+        write_text(std::cout, hdr, events, torn);
+        return EXIT_SUCCESS;
+    }
+
+    if (!write_chrome(chrome, hdr, events)) {
+        std::cerr << "Could not write " << chrome << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << events.size() << " events written to " << chrome;
+    std::cout << std::endl;
+    return EXIT_SUCCESS;
+}
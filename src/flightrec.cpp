@@ -0,0 +1,172 @@
+#include "flightrec.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+FlightHeader* FlightRecorder::m_header = nullptr;
+FlightEvent* FlightRecorder::m_events = nullptr;
+uint64_t FlightRecorder::m_mask = 0;
+size_t FlightRecorder::m_size = 0;
+std::atomic<uint16_t> FlightRecorder::m_threads(0);
+thread_local uint16_t FlightRecorder::m_thread = 0;
+
+#if defined(_WIN32)
+void* FlightRecorder::m_file = nullptr;
+void* FlightRecorder::m_mapping = nullptr;
+#else
+int FlightRecorder::m_fd = -1;
+#endif
+
+bool FlightRecorder::Init(std::string path, uint32_t capacity)
+{
+    if (m_header != nullptr) {
+        return false;
+    }
+
+    uint32_t count = 1;
+    while (count < capacity) {
+        count <<= 1;
+    }
+    size_t size = FLIGHT_HEADER_SIZE + count * sizeof(FlightEvent);
+
+    /* The last run's recording is the one somebody may still want. */
+    std::string old = path + ".old";
+    std::remove(old.c_str());
+    std::rename(path.c_str(), old.c_str());
+
+    void* base = nullptr;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+      FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+      nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+      static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+      static_cast<DWORD>(size), nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    base = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+    if (base == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+#else
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    /* A fresh file reads back as zeroes, so no slot looks written yet. */
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        return false;
+    }
+
+    base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    m_fd = fd;
+#endif
+
+    FlightHeader* hdr = static_cast<FlightHeader*>(base);
+    hdr->magic = FLIGHT_MAGIC;
+    hdr->version = FLIGHT_VERSION;
+    hdr->event_size = sizeof(FlightEvent);
+    hdr->capacity = count;
+    hdr->frequency = Timer::Frequency();
+    hdr->origin = Timer::Ticks();
+    hdr->wall_time = static_cast<uint64_t>(std::time(nullptr));
+    hdr->head.store(0, std::memory_order_relaxed);
+
+    m_events = reinterpret_cast<FlightEvent*>(
+      static_cast<unsigned char*>(base) + FLIGHT_HEADER_SIZE);
+    m_mask = count - 1;
+    m_size = size;
+    m_header = hdr;
+
+    return true;
+}
+
+void FlightRecorder::Release(void)
+{
+    if (m_header == nullptr) {
+        return;
+    }
+
+    void* base = m_header;
+    m_header = nullptr;
+    m_events = nullptr;
+
+#if defined(_WIN32)
+    FlushViewOfFile(base, 0);
+    UnmapViewOfFile(base);
+    CloseHandle(static_cast<HANDLE>(m_mapping));
+    CloseHandle(static_cast<HANDLE>(m_file));
+#else
+    munmap(base, m_size);
+    close(m_fd);
+    m_fd = -1;
+#endif
+}
+
+void FlightRecorder::RecordText(FlightEventType type, const char* text,
+  uint64_t a, uint64_t b, uint64_t c)
+{
+    if (m_header == nullptr) {
+        return;
+    }
+
+    size_t len = text != nullptr ? std::strlen(text) : 0;
+    size_t slots = std::min<size_t>(FLIGHT_TEXT_SLOTS,
+      (len + FLIGHT_TEXT_BYTES - 1) / FLIGHT_TEXT_BYTES);
+
+    uint64_t pos = m_header->head.fetch_add(1 + slots,
+      std::memory_order_relaxed);
+    uint64_t tick = Timer::Ticks();
+    uint16_t thread = thread_id();
+
+    for (size_t i = 0; i < slots; i++) {
+        FlightEvent* ev = &m_events[(pos + 1 + i) & m_mask];
+        size_t offset = i * FLIGHT_TEXT_BYTES;
+        size_t n = std::min<size_t>(FLIGHT_TEXT_BYTES, len - offset);
+
+        ev->tick = tick;
+        ev->type = FLIGHT_TEXT;
+        ev->thread = thread;
+        ev->extra = 0;
+        std::memset(ev->text, 0, FLIGHT_TEXT_BYTES);
+        std::memcpy(ev->text, text + offset, n);
+        ev->sequence.store(pos + 2 + i, std::memory_order_release);
+    }
+
+    /* The first slot goes last, so a reader never sees half a message. */
+    FlightEvent* ev = &m_events[pos & m_mask];
+    ev->tick = tick;
+    ev->type = static_cast<uint16_t>(type);
+    ev->thread = thread;
+    ev->extra = static_cast<uint16_t>(slots);
+    ev->args.a = a;
+    ev->args.b = b;
+    ev->args.c = c;
+    ev->sequence.store(pos + 1, std::memory_order_release);
+}
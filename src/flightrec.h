@@ -0,0 +1,154 @@
+#ifndef VKTEST_FLIGHTREC_H
+#define VKTEST_FLIGHTREC_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "timer.h"
+
+/*
+* The flight recorder keeps the last few seconds of what the renderer did
+* in a ring of fixed-size binary events inside a memory-mapped file.  The
+* mapping is shared with the kernel, so whatever was written is in the
+* page cache the moment the store lands and ends up on disk even when the
+* process doesn't get to exit: after a hitch or a crash, the file is there
+* to be decoded by vktest-flight.  Init() moves the last run's file out of
+* the way (to the same name plus ".old") rather than overwriting it.
+*
+* Layout, native endian, since the file is read back on the same machine:
+*
+*     FlightHeader                  one page
+*     FlightEvent[capacity]         the ring
+*
+* Recording an event is one fetch_add on the header's head to claim a
+* slot, a handful of plain stores, and a release store of the slot's
+* sequence number last.  The decoder trusts a slot only when its sequence
+* matches its position, which skips a slot whose writer died half way.
+*/
+#define FLIGHT_MAGIC            (0x52465456)    // "VTFR"
+#define FLIGHT_VERSION          (1)
+#define FLIGHT_HEADER_SIZE      (4096)
+
+/* 65536 events of 64 bytes: a 4 MiB file. */
+#define FLIGHT_DEFAULT_EVENTS   (1 << 16)
+#define FLIGHT_DEFAULT_PATH     ("./flight.vfr")
+
+/* Text bytes in a FLIGHT_TEXT slot, and the most slots one message gets. */
+#define FLIGHT_TEXT_BYTES       (40)
+#define FLIGHT_TEXT_SLOTS       (8)
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+  #error "The flight recorder needs lock-free 64-bit atomics."
+#endif
+
+enum FlightEventType {
+    FLIGHT_NONE,
+    FLIGHT_FRAME_BEGIN,         // a: frame
+    FLIGHT_FRAME_END,           // a: frame
+    FLIGHT_ACQUIRE,             // a: image, b: VkResult
+    FLIGHT_SUBMIT,              // a: image, or UINT32_MAX for one-off work
+    FLIGHT_PRESENT,             // a: image, b: VkResult
+    FLIGHT_SWAPCHAIN,           // a: width, b: height
+    FLIGHT_ALLOC,               // a: VkDeviceMemory, b: bytes, c: type index
+    FLIGHT_FREE,                // a: VkDeviceMemory
+    FLIGHT_VALIDATION,          // a: flags, b: message code, c: object
+    FLIGHT_TEXT,                // continues the slot before it
+    FLIGHT_TYPE_COUNT
+};
+
+struct FlightEvent {
+    std::atomic<uint64_t> sequence;     // position + 1 once written
+    uint64_t tick;
+    uint16_t type;
+    uint16_t thread;
+    uint16_t extra;             // FLIGHT_TEXT slots that follow
+    uint16_t pad;
+    union {
+        struct {
+            uint64_t a, b, c;
+        } args;
+        char text[FLIGHT_TEXT_BYTES];
+    };
+};
+
+struct FlightHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t event_size;
+    uint32_t capacity;          // a power of two
+    uint64_t frequency;         // ticks per second
+    uint64_t origin;            // tick at Init()
+    uint64_t wall_time;         // seconds since the epoch at Init()
+    alignas(64) std::atomic<uint64_t> head;
+};
+
+static_assert(sizeof(FlightEvent) == 64, "FlightEvent should be 64 bytes");
+static_assert(sizeof(FlightHeader) <= FLIGHT_HEADER_SIZE,
+  "FlightHeader doesn't fit its page");
+
+/*
+* Does nothing at all until Init() succeeds, so it's safe to record from
+* anywhere, including before startup and after shutdown.
+*/
+class FlightRecorder {
+public:
+    /* 'capacity' is rounded up to a power of two. */
+    static bool Init(std::string path, uint32_t capacity);
+    /* Only once nothing else is recording. */
+    static void Release(void);
+
+    static void Record(FlightEventType type, uint64_t a = 0, uint64_t b = 0,
+      uint64_t c = 0)
+    {
+        if (m_header == nullptr) {
+            return;
+        }
+
+        uint64_t pos = m_header->head.fetch_add(1, std::memory_order_relaxed);
+        FlightEvent* ev = &m_events[pos & m_mask];
+        ev->tick = Timer::Ticks();
+        ev->type = static_cast<uint16_t>(type);
+        ev->thread = thread_id();
+        ev->extra = 0;
+        ev->args.a = a;
+        ev->args.b = b;
+        ev->args.c = c;
+        ev->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    /*
+    * Like Record(), with a message carried in the FLIGHT_TEXT slots right
+    * behind it.  All of them are claimed with the one fetch_add, so they
+    * stay together however many threads are recording.
+    */
+    static void RecordText(FlightEventType type, const char* text,
+      uint64_t a = 0, uint64_t b = 0, uint64_t c = 0);
+
+private:
+    static uint16_t thread_id(void)
+    {
+        if (m_thread == 0) {
+            m_thread = m_threads.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+        return m_thread;
+    }
+
+    static FlightHeader* m_header;
+    static FlightEvent* m_events;
+    static uint64_t m_mask;
+    static size_t m_size;
+    static std::atomic<uint16_t> m_threads;
+    static thread_local uint16_t m_thread;
+
+#if defined(_WIN32)
+    static void* m_file;
+    static void* m_mapping;
+#else
+    static int m_fd;
+#endif
+};
+
+#endif // VKTEST_FLIGHTREC_H
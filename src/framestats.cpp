@@ -0,0 +1,211 @@
+#include "framestats.h"
+
+#include <cmath>
+#include <iomanip>
+
+Histogram::Histogram(void)
+{
+    Reset();
+}
+
+void Histogram::Record(uint64_t ns)
+{
+    m_buckets[bucket(ns)]++;
+    m_count++;
+    m_sum += ns;
+    if (ns > m_max) {
+        m_max = ns;
+    }
+}
+
+void Histogram::Reset(void)
+{
+    m_buckets.fill(0);
+    m_count = 0;
+    m_max = 0;
+    m_sum = 0;
+}
+
+uint64_t Histogram::GetCount(void) const
+{
+    return m_count;
+}
+
+uint64_t Histogram::GetMax(void) const
+{
+    return m_max;
+}
+
+double Histogram::GetMean(void) const
+{
+    if (m_count == 0) {
+        return 0.0;
+    }
+
+    return static_cast<double>(m_sum) / static_cast<double>(m_count);
+}
+
+uint64_t Histogram::GetPercentile(double fraction) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(fraction *
+      static_cast<double>(m_count)));
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKETS; i++) {
+        seen += m_buckets[i];
+        if (seen >= rank) {
+            /* The middle of the bucket, but never past what was seen. */
+            uint64_t value = bucket_low(i) + bucket_width(i) / 2;
+            return value < m_max ? value : m_max;
+        }
+    }
+
+    return m_max;
+}
+
+/*
+* Below SUB every value has a bucket of its own.  Above that the bucket is
+* picked by the position of the top bit, then by the HISTOGRAM_SUB_BITS
+* bits under it.
+*/
+uint32_t Histogram::bucket(uint64_t ns)
+{
+    if (ns < SUB) {
+        return static_cast<uint32_t>(ns);
+    }
+
+    uint32_t top = 0;
+    for (uint64_t v = ns; v > 1; v >>= 1) {
+        top++;
+    }
+    if (top > HISTOGRAM_MAX_EXP) {
+        return BUCKETS - 1;
+    }
+
+    uint32_t shift = top - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * SUB + static_cast<uint32_t>(ns >> shift) - SUB;
+}
+
+uint64_t Histogram::bucket_low(uint32_t index)
+{
+    if (index < SUB) {
+        return index;
+    }
+
+    uint32_t shift = index / SUB - 1;
+    return static_cast<uint64_t>(SUB + index % SUB) << shift;
+}
+
+uint64_t Histogram::bucket_width(uint32_t index)
+{
+    if (index < SUB) {
+        return 1;
+    }
+
+    return static_cast<uint64_t>(1) << (index / SUB - 1);
+}
+
+FrameStats* FrameStats::Init(double budget_ms)
+{
+    if (budget_ms <= 0.0) {
+        return nullptr;
+    }
+
+    FrameStats* ret = new FrameStats();
+    ret->m_budget_ns = static_cast<uint64_t>(budget_ms * 1e6);
+    ret->Reset();
+
+    return ret;
+}
+
+void FrameStats::Release(FrameStats* stats)
+{
+    delete(stats);
+}
+
+void FrameStats::Record(Metric metric, double ms)
+{
+    uint64_t ns = ms > 0.0 ? static_cast<uint64_t>(ms * 1e6) : 0;
+
+    m_histograms[metric].Record(ns);
+    if (ns > m_budget_ns) {
+        m_over_budget[metric]++;
+    }
+}
+
+void FrameStats::Reset(void)
+{
+    for (size_t i = 0; i < m_histograms.size(); i++) {
+        m_histograms[i].Reset();
+    }
+    m_over_budget.fill(0);
+}
+
+void FrameStats::GetSummary(Metric metric, Summary* out) const
+{
+    const Histogram& h = m_histograms[metric];
+
+    out->count = h.GetCount();
+    out->over_budget = m_over_budget[metric];
+    out->mean_ms = h.GetMean() / 1e6;
+    out->p50_ms = h.GetPercentile(0.50) / 1e6;
+    out->p90_ms = h.GetPercentile(0.90) / 1e6;
+    out->p99_ms = h.GetPercentile(0.99) / 1e6;
+    out->p999_ms = h.GetPercentile(0.999) / 1e6;
+    out->max_ms = h.GetMax() / 1e6;
+}
+
+double FrameStats::GetBudget(void) const
+{
+    return m_budget_ns / 1e6;
+}
+
+const char* FrameStats::GetName(Metric metric)
+{
+    switch (metric) {
+    case FRAME:
+        return "frame";
+    case CPU:
+        return "cpu";
+    case GPU:
+        return "gpu";
+    case ACQUIRE:
+        return "acquire";
+    case PRESENT:
+        return "present";
+    case WAIT:
+        return "wait";
+    default:
+        return "unknown";
+    }
+}
+
+void FrameStats::Print(std::ostream& out) const
+{
+    out << std::fixed << std::setprecision(3);
+    out << "Frame times in ms, budget " << GetBudget() << ":" << std::endl;
+    out << std::setw(8) << "" << std::setw(9) << "count";
+    out << std::setw(9) << "mean" << std::setw(9) << "p50";
+    out << std::setw(9) << "p90" << std::setw(9) << "p99";
+    out << std::setw(9) << "p99.9" << std::setw(9) << "max";
+    out << std::setw(9) << "over" << std::endl;
+
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        Summary s;
+        GetSummary(static_cast<Metric>(i), &s);
+
+        out << std::setw(8) << GetName(static_cast<Metric>(i));
+        out << std::setw(9) << s.count;
+        out << std::setw(9) << s.mean_ms << std::setw(9) << s.p50_ms;
+        out << std::setw(9) << s.p90_ms << std::setw(9) << s.p99_ms;
+        out << std::setw(9) << s.p999_ms << std::setw(9) << s.max_ms;
+        out << std::setw(9) << s.over_budget << std::endl;
+    }
+}
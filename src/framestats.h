@@ -0,0 +1,102 @@
+#ifndef VKTEST_FRAMESTATS_H
+#define VKTEST_FRAMESTATS_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+/*
+* A log-linear histogram of durations.  Every power of two is split into
+* 2^HISTOGRAM_SUB_BITS equal buckets, so anything it reports is within
+* about 3% of the real value, from a nanosecond up to HISTOGRAM_MAX_EXP.
+* The buckets are a fixed array: recording is a few shifts and an
+* increment, and nothing is ever allocated.
+*/
+#define HISTOGRAM_SUB_BITS      (5)
+#define HISTOGRAM_MAX_EXP       (40)    // 2^40 ns, about 18 minutes
+
+class Histogram {
+public:
+    Histogram(void);
+
+    void Record(uint64_t ns);
+    void Reset(void);
+
+    uint64_t GetCount(void) const;
+    uint64_t GetMax(void) const;
+    double GetMean(void) const;
+    /* 'fraction' is in [0, 1]; 0.99 is the 99th percentile. */
+    uint64_t GetPercentile(double fraction) const;
+
+private:
+    static const uint32_t SUB = 1 << HISTOGRAM_SUB_BITS;
+    static const uint32_t BUCKETS = (HISTOGRAM_MAX_EXP -
+      HISTOGRAM_SUB_BITS + 2) * SUB;
+
+    std::array<uint64_t, BUCKETS> m_buckets;
+    uint64_t m_count;
+    uint64_t m_max;
+    uint64_t m_sum;
+
+    static uint32_t bucket(uint64_t ns);
+    static uint64_t bucket_low(uint32_t index);
+    static uint64_t bucket_width(uint32_t index);
+};
+
+/*
+* Per-frame timings, kept for the whole run so that the odd long frame
+* shows up in the tail instead of being averaged away:
+*
+*     FRAME     from one Render() to the next, what the user sees
+*     CPU       Update() plus Render(), less the three waits below
+*     GPU       the frame's outermost GpuProfiler scopes, added up
+*     ACQUIRE   blocked in vkAcquireNextImageKHR
+*     PRESENT   blocked in vkQueuePresentKHR
+*     WAIT      blocked in Scheduler::Wait until the frame's submit is done,
+*               which is mostly the GPU still working on it
+*
+* Any sample longer than the budget counts against it.
+*/
+class FrameStats {
+public:
+    enum Metric {
+        FRAME,
+        CPU,
+        GPU,
+        ACQUIRE,
+        PRESENT,
+        WAIT,
+        METRIC_COUNT
+    };
+
+    struct Summary {
+        uint64_t count;
+        uint64_t over_budget;
+        double mean_ms;
+        double p50_ms;
+        double p90_ms;
+        double p99_ms;
+        double p999_ms;
+        double max_ms;
+    };
+
+    static FrameStats* Init(double budget_ms);
+    static void Release(FrameStats* stats);
+
+    void Record(Metric metric, double ms);
+    void Reset(void);
+
+    void GetSummary(Metric metric, Summary* out) const;
+    double GetBudget(void) const;
+    static const char* GetName(Metric metric);
+
+    /* One line per metric, for the log on the way out. */
+    void Print(std::ostream& out) const;
+
+private:
+    uint64_t m_budget_ns;
+    std::array<Histogram, METRIC_COUNT> m_histograms;
+    std::array<uint64_t, METRIC_COUNT> m_over_budget;
+};
+
+#endif  /* VKTEST_FRAMESTATS_H */
@@ -18,10 +18,20 @@
 #include <glm/glm.hpp>
 #include <SDL2/SDL.h>
 
-struct UniformBufferObject {
+#include "log.h"
+
+/*
+* The vertex shaders' inputs are split by how often they change.  Camera
+* data sits in a uniform buffer that is only written when the camera or the
+* window size changes; per-object data goes in as push constants with each
+* draw.
+*/
+struct CameraData {
+    glm::mat4 view_proj;
+};
+
+struct ObjectData {
     glm::mat4 model;
-    glm::mat4 view;
-    glm::mat4 proj;
 };
 
 struct Vertex {
@@ -64,25 +74,39 @@ struct Vertex {
     }
 };
 
-struct STBImage {
-    int width, height, comp;
-    unsigned char* data;
-};
+/*
+* Per-instance data for the bindless pipeline.  Each instance carries the
+* index of its texture in the renderer's sampler array, so objects with
+* different textures can still go out in one instanced draw.
+*/
+struct InstanceData {
+    uint32_t texture;
+
+    static VkVertexInputBindingDescription getBindDesc(void)
+    {
+        VkVertexInputBindingDescription desc = {};
+        desc.binding = 1;
+        desc.stride = sizeof(InstanceData);
+        desc.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
-class Log {
-public:
-    enum Level {
-        SEVERE,
-        WARNING,
-        ROUTINE
-    };
+        return desc;
+    }
 
-    static Level m_verbosity;
-    static std::fstream m_file;
+    static VkVertexInputAttributeDescription getAttrDesc(void)
+    {
+        VkVertexInputAttributeDescription desc = {};
+        desc.binding = 1;
+        desc.location = 3;
+        desc.format = VK_FORMAT_R32_UINT;
+        desc.offset = offsetof(InstanceData, texture);
+
+        return desc;
+    }
+};
 
-    static void Close(void);
-    static bool Init(Log::Level verbosity);
-    static void Write(Log::Level level, std::string message);
+struct STBImage {
+    int width, height, comp;
+    unsigned char* data;
 };
 
 void Assert(VkResult test, std::string message, SDL_Window* win = nullptr);
@@ -92,6 +116,7 @@ std::vector<char> ReadFile(std::string path);
 
 /* stb_image wrappers */
 bool ReadImage(struct STBImage* out, std::string path);
+bool ReadImage(struct STBImage* out, const unsigned char* bytes, size_t len);
 void ReleaseImage(struct STBImage* img);
 
 #endif // VKTEST_GLOBAL_H
@@ -0,0 +1,226 @@
+#include "gpuprofiler.h"
+
+#include <fstream>
+#include <iomanip>
+
+GpuProfiler* GpuProfiler::Init(VkDevice device,
+  const VkPhysicalDeviceProperties* properties, uint32_t valid_bits,
+  uint32_t frames, uint32_t max_scopes)
+{
+    if (frames == 0 || max_scopes == 0) {
+        return nullptr;
+    }
+
+    GpuProfiler* ret = new GpuProfiler();
+    ret->m_device = device;
+    ret->m_enabled = valid_bits > 0;
+    ret->m_period = properties->limits.timestampPeriod;
+    ret->m_mask = valid_bits >= 64 ? UINT64_MAX :
+      (UINT64_C(1) << valid_bits) - 1;
+    ret->m_max_scopes = max_scopes;
+    ret->m_frame = 0;
+    ret->m_depth = 0;
+    ret->m_have_origin = false;
+    ret->m_last_first = 0;
+    ret->m_timeline_us = 0.0;
+    ret->m_dropped = 0;
+    ret->m_ticks.resize(max_scopes * 2);
+
+    ret->m_frames.resize(frames);
+    for (uint32_t i = 0; i < frames; i++) {
+        Frame& f = ret->m_frames[i];
+        f.pool = VK_NULL_HANDLE;
+        f.count = 0;
+        f.reset_pending = true;
+        if (!ret->m_enabled) {
+            continue;
+        }
+
+        /* Two timestamps per scope. */
+        VkQueryPoolCreateInfo qpci = {};
+        qpci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        qpci.queryCount = max_scopes * 2;
+
+        VkResult result = vkCreateQueryPool(device, &qpci, nullptr,
+          &f.pool);
+        if (result) {
+            Release(ret);
+            return nullptr;
+        }
+    }
+
+    return ret;
+}
+
+void GpuProfiler::Release(GpuProfiler* profiler)
+{
+    for (size_t i = 0; i < profiler->m_frames.size(); i++) {
+        vkDestroyQueryPool(profiler->m_device, profiler->m_frames[i].pool,
+          nullptr);
+    }
+
+    delete(profiler);
+}
+
+bool GpuProfiler::BeginFrame(void)
+{
+    if (!m_enabled) {
+        return false;
+    }
+
+    m_frame = (m_frame + 1) % m_frames.size();
+    Frame& f = m_frames[m_frame];
+
+    bool resolved = false;
+    if (f.count > 0) {
+        resolved = resolve(&f);
+    }
+
+    f.count = 0;
+    f.reset_pending = true;
+    f.names.clear();
+    f.depths.clear();
+    m_depth = 0;
+
+    return resolved;
+}
+
+uint32_t GpuProfiler::Begin(VkCommandBuffer cmd, const char* name)
+{
+    Frame& f = m_frames[m_frame];
+    if (!m_enabled || f.count == m_max_scopes) {
+        return INVALID_SCOPE;
+    }
+
+    if (f.reset_pending) {
+        vkCmdResetQueryPool(cmd, f.pool, 0, m_max_scopes * 2);
+        f.reset_pending = false;
+    }
+
+    uint32_t scope = f.count++;
+    f.names.push_back(name);
+    f.depths.push_back(m_depth++);
+
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, f.pool,
+      scope * 2);
+
+    return scope;
+}
+
+void GpuProfiler::End(VkCommandBuffer cmd, uint32_t scope)
+{
+    if (scope == INVALID_SCOPE) {
+        return;
+    }
+
+    Frame& f = m_frames[m_frame];
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, f.pool,
+      scope * 2 + 1);
+
+    if (m_depth > 0) {
+        m_depth--;
+    }
+}
+
+const std::vector<GpuProfiler::Timing>& GpuProfiler::GetTimings(void) const
+{
+    return m_timings;
+}
+
+uint64_t GpuProfiler::GetDroppedFrames(void) const
+{
+    return m_dropped;
+}
+
+bool GpuProfiler::IsEnabled(void) const
+{
+    return m_enabled;
+}
+
+bool GpuProfiler::resolve(Frame* f)
+{
+    /*
+    * No WAIT_BIT: if the GPU hasn't got this far yet (or a scope was never
+    * submitted), VK_NOT_READY comes back and the frame is skipped.
+    */
+    VkResult result = vkGetQueryPoolResults(m_device, f->pool, 0,
+      f->count * 2, f->count * 2 * sizeof(uint64_t), m_ticks.data(),
+      sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        m_dropped++;
+        return false;
+    }
+
+    uint64_t first = m_ticks[0] & m_mask;
+    for (uint32_t i = 1; i < f->count; i++) {
+        uint64_t t = m_ticks[i * 2] & m_mask;
+        if (((t - first) & m_mask) > (m_mask >> 1)) {
+            first = t;
+        }
+    }
+
+    /*
+    * Ticks wrap at timestampValidBits, so every difference is masked, and
+    * the trace timeline is built up a frame at a time so that it keeps
+    * going past a wrap.
+    */
+    if (m_have_origin) {
+        m_timeline_us += ((first - m_last_first) & m_mask) * m_period /
+          1000.0;
+    }
+    m_have_origin = true;
+    m_last_first = first;
+    double frame_us = m_timeline_us;
+
+    m_timings.clear();
+    for (uint32_t i = 0; i < f->count; i++) {
+        uint64_t begin = m_ticks[i * 2] & m_mask;
+        uint64_t end = m_ticks[i * 2 + 1] & m_mask;
+
+        Timing t = {};
+        t.name = f->names[i];
+        t.depth = f->depths[i];
+        t.start_ms = ((begin - first) & m_mask) * m_period / 1e6;
+        t.duration_ms = ((end - begin) & m_mask) * m_period / 1e6;
+        m_timings.push_back(t);
+
+        if (m_events.size() < GPU_PROFILER_TRACE_EVENTS) {
+            Event e = {};
+            e.name = t.name;
+            e.start_us = frame_us + t.start_ms * 1000.0;
+            e.duration_us = t.duration_ms * 1000.0;
+            m_events.push_back(e);
+        }
+    }
+
+    return true;
+}
+
+bool GpuProfiler::WriteTrace(std::string path) const
+{
+    std::ofstream out(path.c_str(), std::ofstream::out |
+      std::ofstream::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < m_events.size(); i++) {
+        out << "{\"name\":\"";
+        for (const char* c = m_events[i].name; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\') {
+                out << '\\';
+            }
+            out << *c;
+        }
+        out << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,";
+        out << "\"ts\":" << m_events[i].start_us << ",";
+        out << "\"dur\":" << m_events[i].duration_us << "}";
+        out << (i + 1 < m_events.size() ? "," : "") << std::endl;
+    }
+    out << "]}" << std::endl;
+
+    return static_cast<bool>(out);
+}
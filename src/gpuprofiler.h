@@ -0,0 +1,100 @@
+#ifndef VKTEST_GPUPROFILER_H
+#define VKTEST_GPUPROFILER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/* Past this many scopes, WriteTrace() only has the oldest ones. */
+#define GPU_PROFILER_TRACE_EVENTS   (1 << 20)
+
+/*
+* Measures how long the GPU spends on named stretches of a command buffer
+* by writing a timestamp at either end of each scope:
+*
+*     uint32_t scope = profiler->Begin(cmd, "main pass");
+*     ...
+*     profiler->End(cmd, scope);
+*
+* Each frame in flight has its own query pool.  Results are only read back
+* when that pool comes round again, 'frames' frames later, and without
+* waiting: a frame whose timestamps still aren't available is dropped
+* rather than stalling the CPU.
+*
+* The first Begin() of a frame also records the reset for that frame's
+* pool, so it has to happen outside of a render pass.  Scope names aren't
+* copied; pass string literals.
+*
+* If the queue can't do timestamps (timestampValidBits of zero) the
+* profiler still works, it just never has any timings.
+*/
+class GpuProfiler {
+public:
+    static const uint32_t INVALID_SCOPE = UINT32_MAX;
+
+    struct Timing {
+        const char* name;
+        uint32_t depth;         // how many scopes it's nested inside
+        double start_ms;        // relative to the frame's first timestamp
+        double duration_ms;
+    };
+
+    static GpuProfiler* Init(VkDevice device,
+      const VkPhysicalDeviceProperties* properties, uint32_t valid_bits,
+      uint32_t frames, uint32_t max_scopes);
+    static void Release(GpuProfiler* profiler);
+
+    /*
+    * Call once per frame, before any scopes for that frame are opened.
+    * True if an older frame's timings were read back along the way.
+    */
+    bool BeginFrame(void);
+    uint32_t Begin(VkCommandBuffer cmd, const char* name);
+    void End(VkCommandBuffer cmd, uint32_t scope);
+
+    /* The most recent frame that has been read back. */
+    const std::vector<Timing>& GetTimings(void) const;
+    uint64_t GetDroppedFrames(void) const;
+    bool IsEnabled(void) const;
+
+    /* Everything read back so far, as Chrome's about://tracing JSON. */
+    bool WriteTrace(std::string path) const;
+
+private:
+    struct Frame {
+        VkQueryPool pool;
+        uint32_t count;
+        bool reset_pending;
+        std::vector<const char*> names;
+        std::vector<uint32_t> depths;
+    };
+
+    struct Event {
+        const char* name;
+        double start_us;
+        double duration_us;
+    };
+
+    VkDevice m_device;
+    bool m_enabled;
+    double m_period;            // nanoseconds per tick
+    uint64_t m_mask;
+    uint32_t m_max_scopes;
+
+    std::vector<Frame> m_frames;
+    uint32_t m_frame;
+    uint32_t m_depth;
+
+    std::vector<Timing> m_timings;
+    std::vector<Event> m_events;
+    std::vector<uint64_t> m_ticks;
+    bool m_have_origin;
+    uint64_t m_last_first;      // first tick of the last frame read back
+    double m_timeline_us;       // where that frame sits in the trace
+    uint64_t m_dropped;
+
+    bool resolve(Frame* frame);
+};
+
+#endif  /* VKTEST_GPUPROFILER_H */
@@ -0,0 +1,339 @@
+#include "jobs.h"
+
+#include "cpuprofiler.h"
+
+/* Which pool, if any, the current thread belongs to, and where in it. */
+static thread_local const JobSystem* t_jobs = nullptr;
+static thread_local uint32_t t_index = 0;
+
+/* Spins through find() this many times before a worker goes to sleep. */
+#define JOBS_SPINS              (64)
+
+JobSystem::Deque::Deque(void) : m_top(0), m_bottom(0)
+{
+    for (uint32_t i = 0; i < JOBS_DEQUE_SIZE; i++) {
+        m_jobs[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+bool JobSystem::Deque::Push(Job* job)
+{
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    int64_t t = m_top.load(std::memory_order_acquire);
+    if (b - t >= JOBS_DEQUE_SIZE) {
+        return false;
+    }
+
+    m_jobs[b & (JOBS_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+JobSystem::Job* JobSystem::Deque::Pop(void)
+{
+    int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = m_jobs[b & (JOBS_DEQUE_SIZE - 1)].load(
+      std::memory_order_relaxed);
+    if (t == b) {
+        /* The last one; a thief may be after it too. */
+        if (!m_top.compare_exchange_strong(t, t + 1,
+          std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+/* Comes back empty-handed if another thread got there first, too. */
+JobSystem::Job* JobSystem::Deque::Steal(void)
+{
+    int64_t t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return nullptr;
+    }
+
+    Job* job = m_jobs[t & (JOBS_DEQUE_SIZE - 1)].load(
+      std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+      std::memory_order_relaxed)) {
+        return nullptr;
+    }
+
+    return job;
+}
+
+JobSystem* JobSystem::Init(uint32_t threads)
+{
+    JobSystem* ret = new JobSystem();
+    ret->m_threads = threads > 0 ? threads : 1;
+    ret->m_queued = 0;
+    ret->m_sleeping = 0;
+    ret->m_quit = false;
+
+    for (uint32_t i = 0; i < ret->m_threads; i++) {
+        ret->m_deques.push_back(new Deque());
+    }
+
+    t_jobs = ret;
+    t_index = 0;
+
+    for (uint32_t i = 1; i < ret->m_threads; i++) {
+        ret->m_workers.push_back(std::thread(&JobSystem::worker, ret, i));
+    }
+
+    return ret;
+}
+
+/* Whatever is still queued runs before the workers go. */
+void JobSystem::Release(JobSystem* jobs)
+{
+    uint32_t seed = 0;
+    Job* job = nullptr;
+    while ((job = jobs->find(0, &seed)) != nullptr) {
+        jobs->execute(job);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobs->m_lock);
+        jobs->m_quit = true;
+    }
+    jobs->m_wake.notify_all();
+
+    for (size_t i = 0; i < jobs->m_workers.size(); i++) {
+        jobs->m_workers[i].join();
+    }
+
+    for (size_t i = 0; i < jobs->m_deques.size(); i++) {
+        delete(jobs->m_deques[i]);
+    }
+
+    if (t_jobs == jobs) {
+        t_jobs = nullptr;
+    }
+
+    delete(jobs);
+}
+
+void JobSystem::Run(std::function<void(void)> work, Counter* counter,
+  Counter* after)
+{
+    Job* job = new Job();
+    job->work = work;
+    job->counter = counter;
+
+    if (counter != nullptr) {
+        counter->m_value.fetch_add(1);
+    }
+
+    /* finish() takes the same lock before it lets the held jobs go. */
+    if (after != nullptr && !after->Done()) {
+        std::lock_guard<std::mutex> lock(after->m_lock);
+        if (!after->Done()) {
+            after->m_after.push_back(job);
+            return;
+        }
+    }
+
+    push(job);
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t grain,
+  std::function<void(uint32_t begin, uint32_t end)> work)
+{
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    if (count <= grain || m_threads == 1) {
+        if (count > 0) {
+            work(0, count);
+        }
+        return;
+    }
+
+    /*
+    * The last slice is kept back for this thread, which would only be
+    * stealing one of the others otherwise.
+    */
+    Counter done;
+    uint32_t begin = 0;
+    for (; count - begin > grain; begin += grain) {
+        uint32_t end = begin + grain;
+        Run([&work, begin, end]() {
+            work(begin, end);
+        }, &done);
+    }
+
+    work(begin, count);
+    Wait(&done);
+}
+
+void JobSystem::Wait(Counter* counter)
+{
+    uint32_t thread = t_jobs == this ? t_index : UINT32_MAX;
+    uint32_t seed = thread;
+
+    while (!counter->Done()) {
+        Job* job = find(thread, &seed);
+        if (job != nullptr) {
+            execute(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    /* Whoever took it to zero may not have let go of it yet. */
+    std::lock_guard<std::mutex> lock(counter->m_lock);
+}
+
+uint32_t JobSystem::GetThreads(void) const
+{
+    return m_threads;
+}
+
+void JobSystem::push(Job* job)
+{
+    /*
+    * Counted before it can be taken, so m_queued never dips below zero.
+    * Either a worker going to sleep sees the job in m_queued, or we see
+    * it in m_sleeping and wake it; see worker().
+    */
+    m_queued.fetch_add(1);
+
+    if (t_jobs == this) {
+        if (!m_deques[t_index]->Push(job)) {
+            m_queued.fetch_sub(1);
+            execute(job);
+            return;
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_injected.push_back(job);
+    }
+
+    if (m_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_wake.notify_one();
+    }
+}
+
+/*
+* Its own deque first, newest first, while it's still warm in the cache.
+* Then the oldest job of each other thread in turn, starting somewhere
+* different every time so that thieves spread out, and last of all the
+* jobs from outside the pool.  'thread' is UINT32_MAX outside it.
+*/
+JobSystem::Job* JobSystem::find(uint32_t thread, uint32_t* seed)
+{
+    Job* job = nullptr;
+    if (thread < m_threads) {
+        job = m_deques[thread]->Pop();
+    }
+
+    if (job == nullptr && m_queued.load() > 0) {
+        *seed = *seed * 1664525 + 1013904223;
+        uint32_t start = *seed % m_threads;
+        for (uint32_t i = 0; i < m_threads && job == nullptr; i++) {
+            uint32_t victim = (start + i) % m_threads;
+            if (victim != thread) {
+                job = m_deques[victim]->Steal();
+            }
+        }
+
+        if (job == nullptr) {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (!m_injected.empty()) {
+                job = m_injected.front();
+                m_injected.pop_front();
+            }
+        }
+    }
+
+    if (job != nullptr) {
+        m_queued.fetch_sub(1);
+    }
+
+    return job;
+}
+
+void JobSystem::execute(Job* job)
+{
+    job->work();
+
+    Counter* counter = job->counter;
+    delete(job);
+
+    if (counter != nullptr) {
+        finish(counter);
+    }
+}
+
+/*
+* The count goes down with the lock held, so that once Wait() has had the
+* lock after the count reached zero, nothing touches the counter again.
+*/
+void JobSystem::finish(Counter* counter)
+{
+    std::vector<Job*> after;
+    {
+        std::lock_guard<std::mutex> lock(counter->m_lock);
+        if (counter->m_value.fetch_sub(1) == 1) {
+            after.swap(counter->m_after);
+        }
+    }
+
+    for (size_t i = 0; i < after.size(); i++) {
+        push(after[i]);
+    }
+}
+
+void JobSystem::worker(uint32_t thread)
+{
+    PROFILE_THREAD("jobs");
+
+    t_jobs = this;
+    t_index = thread;
+    uint32_t seed = thread;
+    uint32_t idle = 0;
+
+    for (;;) {
+        Job* job = find(thread, &seed);
+        if (job != nullptr) {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < JOBS_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_lock);
+        if (m_quit) {
+            break;
+        }
+
+        m_sleeping.fetch_add(1);
+        m_wake.wait(lock, [this]() {
+            return m_quit || m_queued.load() > 0;
+        });
+        m_sleeping.fetch_sub(1);
+        idle = 0;
+    }
+}
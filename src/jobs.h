@@ -0,0 +1,133 @@
+#ifndef VKTEST_JOBS_H
+#define VKTEST_JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define JOBS_DEQUE_SIZE         (4096)  // per thread, a power of two
+
+/*
+* A pool of worker threads for the small, frame-sized jobs: a slice of the
+* objects' transforms, a batch of culling tests and the like.  Unlike the
+* TaskGraph it lives as long as the renderer does, and jobs go in and out
+* of it all frame long.
+*
+* Every thread in the pool, the one that called Init() included, has its
+* own deque of jobs.  A thread pushes and pops its own from the bottom, and
+* when that runs dry it steals from the top of somebody else's (Chase and
+* Lev's deque, with the memory orders from Le et al., "Correct and
+* Efficient Work-Stealing for Weak Memory Models").  Threads outside the
+* pool hand their jobs over through one locked queue instead.
+*
+* A job can add itself to a Counter, which goes up when the job is queued
+* and down when it's finished.  Wait() on a counter doesn't block: the
+* waiting thread runs other jobs until the counter reaches zero.  A job can
+* also be held back until a counter reaches zero, which is all there is to
+* dependencies.
+*
+*     JobSystem::Counter done;
+*     jobs->ParallelFor(count, 64, [&](uint32_t begin, uint32_t end) {
+*         ...
+*     });
+*     jobs->Run(cull, &done);
+*     jobs->Run(sort, nullptr, &done);   // after cull
+*
+* A counter has to be Wait()ed on before it goes away, even if Done()
+* already says so, and shouldn't gain new jobs while something is still
+* held back on it.
+*/
+class JobSystem {
+    struct Job;
+
+public:
+    class Counter {
+    public:
+        Counter(void) : m_value(0) {}
+
+        bool Done(void) const { return m_value.load() == 0; }
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<uint32_t> m_value;
+        std::mutex m_lock;
+        std::vector<Job*> m_after;      // held back until m_value is zero
+    };
+
+    /* Counts the calling thread, so 1 means no workers at all. */
+    static JobSystem* Init(uint32_t threads);
+    static void Release(JobSystem* jobs);
+
+    /*
+    * Queues 'work', counting it against 'counter' if there is one, and
+    * holding it back until 'after' reaches zero if that's given.
+    */
+    void Run(std::function<void(void)> work, Counter* counter = nullptr,
+      Counter* after = nullptr);
+
+    /*
+    * Calls 'work' over [0, count) in slices of at most 'grain', spread
+    * over the pool, and comes back once every slice is done.
+    */
+    void ParallelFor(uint32_t count, uint32_t grain,
+      std::function<void(uint32_t begin, uint32_t end)> work);
+
+    /* Runs other jobs on this thread until 'counter' reaches zero. */
+    void Wait(Counter* counter);
+
+    uint32_t GetThreads(void) const;
+
+private:
+    struct Job {
+        std::function<void(void)> work;
+        Counter* counter;
+    };
+
+    /*
+    * The owner pushes and pops at 'bottom', everybody else takes from
+    * 'top'.  Fixed size: a push that doesn't fit fails and the caller runs
+    * the job itself.
+    */
+    class Deque {
+    public:
+        Deque(void);
+
+        bool Push(Job* job);
+        Job* Pop(void);
+        Job* Steal(void);
+
+    private:
+        /* Kept a cache line apart: thieves hammer one, the owner both. */
+        std::atomic<int64_t> m_top;
+        char m_pad[64];
+        std::atomic<int64_t> m_bottom;
+        std::atomic<Job*> m_jobs[JOBS_DEQUE_SIZE];
+    };
+
+    uint32_t m_threads;
+    std::vector<Deque*> m_deques;       // [0] belongs to Init()'s caller
+    std::vector<std::thread> m_workers;
+
+    /* From threads outside the pool, and work for sleepers to check. */
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::deque<Job*> m_injected;
+    std::atomic<uint32_t> m_queued;     // jobs sitting in any queue
+    std::atomic<uint32_t> m_sleeping;
+    bool m_quit;
+
+    int32_t thread_index(void) const;
+    void push(Job* job);
+    Job* find(uint32_t thread, uint32_t* seed);
+    void execute(Job* job);
+    void finish(Counter* counter);
+    void worker(uint32_t thread);
+};
+
+#endif // VKTEST_JOBS_H
@@ -0,0 +1,346 @@
+#include "log.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+Log::Record* Log::m_records = nullptr;
+std::atomic<uint64_t> Log::m_head(0);
+std::atomic<uint64_t> Log::m_tail(0);
+std::atomic<uint64_t> Log::m_dropped(0);
+std::atomic<int> Log::m_verbosity(Log::ROUTINE);
+std::atomic<bool> Log::m_running(false);
+std::thread Log::m_writer;
+std::fstream Log::m_file;
+uint64_t Log::m_origin_tick = 0;
+uint32_t Log::m_origin_ms = 0;
+double Log::m_ms_per_tick = 0.0;
+
+static const int fatal_signals[] = {
+    SIGABRT,
+    SIGFPE,
+    SIGILL,
+    SIGSEGV,
+#if defined(SIGBUS)
+    SIGBUS,
+#endif
+};
+
+void Log::Close(void)
+{
+    stop_writer();
+
+    std::stringstream out;
+    out << "Log closed at " << SDL_GetTicks() << std::endl;
+    if (m_file.is_open()) {
+        m_file << out.str();
+        m_file.flush();
+        m_file.close();
+    } else {
+        std::cout << out.str();
+    }
+}
+
+bool Log::Init(Log::Level verbosity)
+{
+    stop_writer();
+    SetVerbosity(verbosity);
+    m_file.open("log.txt", std::fstream::out | std::fstream::binary);
+    if (!m_file.is_open()) {
+        return false;
+    }
+
+    std::stringstream out;
+    out << "Log opened at " << SDL_GetTicks() << std::endl;
+    m_file << out.str();
+    m_file.flush();
+
+    m_origin_ms = SDL_GetTicks();
+    m_origin_tick = Timer::Ticks();
+    m_ms_per_tick = 1000.0 / static_cast<double>(Timer::Frequency());
+
+    if (m_records == nullptr) {
+        m_records = new Record[LOG_QUEUE_RECORDS];
+
+        /* Only once, however many times the log is opened. */
+        std::atexit(on_exit);
+        for (size_t i = 0; i < sizeof(fatal_signals) / sizeof(int); i++) {
+            std::signal(fatal_signals[i], on_signal);
+        }
+    }
+
+    for (uint64_t i = 0; i < LOG_QUEUE_RECORDS; i++) {
+        m_records[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+
+    m_running.store(true, std::memory_order_release);
+    m_writer = std::thread(writer);
+
+    return true;
+}
+
+void Log::SetVerbosity(Log::Level verbosity)
+{
+    m_verbosity.store(verbosity, std::memory_order_relaxed);
+}
+
+void Log::Flush(void)
+{
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    while (m_running.load(std::memory_order_acquire) &&
+      m_tail.load(std::memory_order_acquire) < head) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+uint64_t Log::GetDropped(void)
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+Log::Record* Log::claim(Record* spare)
+{
+    if (!m_running.load(std::memory_order_acquire)) {
+        return spare;
+    }
+
+    uint64_t pos = m_head.load(std::memory_order_relaxed);
+    for (;;) {
+        Record* r = &m_records[pos & (LOG_QUEUE_RECORDS - 1)];
+        uint64_t seq = r->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq - pos);
+
+        if (diff == 0) {
+            if (m_head.compare_exchange_weak(pos, pos + 1,
+              std::memory_order_relaxed)) {
+                return r;
+            }
+        } else if (diff < 0) {
+            /* The writer hasn't got round to this slot's last lap yet. */
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else {
+            pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Log::publish(Record* r)
+{
+    bool queued = m_records != nullptr && r >= m_records &&
+      r < m_records + LOG_QUEUE_RECORDS;
+    if (queued) {
+        /* A slot that's been claimed sits at its position in the queue. */
+        uint64_t pos = r->sequence.load(std::memory_order_relaxed);
+        r->sequence.store(pos + 1, std::memory_order_release);
+        return;
+    }
+
+    std::string out;
+    format_record(*r, &out);
+    write_out(out);
+}
+
+void Log::pack_text(Record* r, const char* str, size_t len)
+{
+    Arg& a = r->args[r->argc++];
+    if (r->used + len <= LOG_RECORD_TEXT) {
+        a.type = ARG_TEXT;
+        a.text.offset = r->used;
+        a.text.length = static_cast<uint32_t>(len);
+        std::memcpy(r->text + r->used, str, len);
+        r->used += static_cast<uint16_t>(len);
+        return;
+    }
+
+    a.type = ARG_HEAP;
+    a.heap.data = new char[len];
+    a.heap.length = static_cast<uint32_t>(len);
+    std::memcpy(a.heap.data, str, len);
+}
+
+void Log::writer(void)
+{
+    std::string batch;
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    uint64_t reported = 0;
+
+    for (;;) {
+        bool running = m_running.load(std::memory_order_acquire);
+
+        batch.clear();
+        size_t count = drain(&tail, &batch);
+
+        uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != reported) {
+            batch += "WARNING: " + std::to_string(dropped - reported) +
+              " log records dropped, the queue was full.\n";
+            reported = dropped;
+        }
+
+        if (!batch.empty()) {
+            write_out(batch);
+        }
+        m_tail.store(tail, std::memory_order_release);
+
+        /* Whatever was queued before the stop was seen is out now. */
+        if (!running) {
+            break;
+        }
+        if (count == 0) {
+            std::this_thread::sleep_for(
+              std::chrono::milliseconds(LOG_WRITER_SLEEP_MS));
+        }
+    }
+}
+
+/* Formats and frees the slots; m_tail only moves once it's all written. */
+size_t Log::drain(uint64_t* tail, std::string* batch)
+{
+    size_t count = 0;
+    uint64_t pos = *tail;
+
+    for (;;) {
+        Record& r = m_records[pos & (LOG_QUEUE_RECORDS - 1)];
+        if (r.sequence.load(std::memory_order_acquire) != pos + 1) {
+            break;
+        }
+
+        format_record(r, batch);
+        r.sequence.store(pos + LOG_QUEUE_RECORDS, std::memory_order_release);
+        pos++;
+        count++;
+    }
+
+    *tail = pos;
+    return count;
+}
+
+/* Also frees anything that didn't fit in the record. */
+void Log::format_record(const Record& r, std::string* out)
+{
+    switch (r.level) {
+    case SEVERE:
+        *out += "SEVERE:  ";
+        break;
+    case WARNING:
+        *out += "WARNING: ";
+        break;
+    case ROUTINE:
+        *out += "ROUTINE: ";
+        break;
+    }
+
+    /* Same clock as SDL_GetTicks(), only read without the call. */
+    int64_t since = static_cast<int64_t>(r.tick - m_origin_tick);
+    uint32_t ms = m_origin_ms;
+    if (m_ms_per_tick > 0.0) {
+        ms += static_cast<uint32_t>(since * m_ms_per_tick);
+    } else {
+        ms = SDL_GetTicks();
+    }
+
+    char num[32];
+    std::snprintf(num, sizeof(num), "[%u] ", ms);
+    *out += num;
+
+    uint8_t next = 0;
+    for (const char* c = r.format; *c != '\0'; c++) {
+        if (c[0] != '{' || c[1] != '}' || next == r.argc) {
+            *out += *c;
+            continue;
+        }
+
+        const Arg& a = r.args[next++];
+        switch (a.type) {
+        case ARG_INT:
+            std::snprintf(num, sizeof(num), "%lld",
+              static_cast<long long>(a.i));
+            *out += num;
+            break;
+        case ARG_UINT:
+            std::snprintf(num, sizeof(num), "%llu",
+              static_cast<unsigned long long>(a.u));
+            *out += num;
+            break;
+        case ARG_DOUBLE:
+            std::snprintf(num, sizeof(num), "%g", a.d);
+            *out += num;
+            break;
+        case ARG_TEXT:
+            out->append(r.text + a.text.offset, a.text.length);
+            break;
+        case ARG_HEAP:
+            out->append(a.heap.data, a.heap.length);
+            break;
+        }
+        c++;
+    }
+    *out += '\n';
+
+    for (uint8_t i = 0; i < r.argc; i++) {
+        if (r.args[i].type == ARG_HEAP) {
+            delete[] r.args[i].heap.data;
+        }
+    }
+}
+
+void Log::write_out(const std::string& text)
+{
+    if (m_file.is_open()) {
+        m_file << text;
+        m_file.flush();
+    } else {
+        std::cout << text << std::flush;
+    }
+}
+
+void Log::stop_writer(void)
+{
+    m_running.store(false, std::memory_order_release);
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+}
+
+/*
+* Assert() and friends leave through exit(), which would otherwise lose the
+* queue and then trip over a still-joinable std::thread.
+*/
+void Log::on_exit(void)
+{
+    stop_writer();
+    if (m_file.is_open()) {
+        m_file.flush();
+    }
+}
+
+/*
+* Gives the writer a moment to get the last records out, then dies the way
+* the signal meant to.  Not strictly safe inside a signal handler, but the
+* only thing it touches is the queue's tail and the clock.
+*/
+void Log::on_signal(int sig)
+{
+    bool writer_crashed = m_writer.joinable() &&
+      m_writer.get_id() == std::this_thread::get_id();
+
+    if (!writer_crashed && m_running.load(std::memory_order_acquire)) {
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        for (int i = 0; i < LOG_CRASH_WAIT_MS; i++) {
+            if (m_tail.load(std::memory_order_acquire) >= head) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+}
@@ -0,0 +1,235 @@
+#ifndef VKTEST_LOG_H
+#define VKTEST_LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "timer.h"
+
+/*
+* Levels past this one are compiled out: every call site passes its level
+* as a constant, so the check below folds away along with the call.  0 keeps
+* only SEVERE, 1 adds WARNING, 2 (the default) keeps everything.
+*/
+#if !defined(VKTEST_LOG_LEVEL)
+  #define VKTEST_LOG_LEVEL          (2)
+#endif
+
+/* Records in flight between the callers and the writer; a power of two. */
+#define LOG_QUEUE_RECORDS           (4096)
+
+/* Arguments per record, and string bytes kept in the record itself. */
+#define LOG_MAX_ARGS                (6)
+#define LOG_RECORD_TEXT             (128)
+
+/* How long the writer naps when there's nothing to write. */
+#define LOG_WRITER_SLEEP_MS         (2)
+
+/* How long a crash waits for the writer to catch up before dying. */
+#define LOG_CRASH_WAIT_MS           (500)
+
+/*
+* Log::Write() doesn't format or write anything.  It claims a fixed-size
+* record in a bounded queue any thread can push to, copies the format
+* pointer, the raw arguments and a counter read into it, and returns.  A
+* background thread formats whatever has piled up, writes it to log.txt in
+* one go and flushes once per batch.
+*
+*     Log::Write(Log::WARNING, "Renderer -> texture {} failed to decode "
+*       "({} bytes).", handle, size);
+*
+* Each {} takes the next argument: integers, enums, floating point, C
+* strings and std::strings.  The format has to be a string literal (it's
+* kept by pointer, and that's all the template accepts); strings passed as
+* arguments are copied.  Anything else already formatted goes through the
+* std::string overload.
+*
+* When the queue is full the record is dropped and counted rather than
+* making the caller wait; the writer notes how many went missing.  Close(),
+* exit() and the fatal signals all wait for the queue to drain first.
+*/
+class Log {
+public:
+    enum Level {
+        SEVERE,
+        WARNING,
+        ROUTINE
+    };
+
+    static void Close(void);
+    static bool Init(Log::Level verbosity);
+
+    /* Cheap enough to check before building anything expensive to log. */
+    static bool Enabled(Log::Level level)
+    {
+        return level <= VKTEST_LOG_LEVEL &&
+          level <= m_verbosity.load(std::memory_order_relaxed);
+    }
+    static void SetVerbosity(Log::Level verbosity);
+
+    template <size_t N, typename... Args>
+    static void Write(Log::Level level, const char (&format)[N],
+      const Args&... args)
+    {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS,
+          "Log::Write -> too many arguments");
+
+        if (!Enabled(level)) {
+            return;
+        }
+
+        Record spare;
+        Record* r = claim(&spare);
+        if (r == nullptr) {
+            return;
+        }
+
+        r->tick = Timer::Ticks();
+        r->format = format;
+        r->level = static_cast<uint8_t>(level);
+        r->argc = 0;
+        r->used = 0;
+        pack_all(r, args...);
+        publish(r);
+    }
+
+    static void Write(Log::Level level, const std::string& message)
+    {
+        Write(level, "{}", message);
+    }
+
+    /* Blocks until everything written so far is in the file. */
+    static void Flush(void);
+    static uint64_t GetDropped(void);
+
+private:
+    enum ArgType {
+        ARG_INT,
+        ARG_UINT,
+        ARG_DOUBLE,
+        ARG_TEXT,               // in the record's text
+        ARG_HEAP                // too long for it; the writer frees it
+    };
+
+    struct Arg {
+        uint8_t type;
+        union {
+            int64_t i;
+            uint64_t u;
+            double d;
+            struct {
+                uint32_t offset;
+                uint32_t length;
+            } text;
+            struct {
+                char* data;
+                uint32_t length;
+            } heap;
+        };
+    };
+
+    /* 'sequence' hands the slot back and forth, as in Vyukov's queue. */
+    struct Record {
+        std::atomic<uint64_t> sequence;
+        uint64_t tick;
+        const char* format;
+        uint8_t level;
+        uint8_t argc;
+        uint16_t used;
+        Arg args[LOG_MAX_ARGS];
+        char text[LOG_RECORD_TEXT];
+    };
+
+    /*
+    * Null when the queue is full.  Before Init() and after Close() there's
+    * no writer, so 'spare' comes back and publish() writes it out there and
+    * then.
+    */
+    static Record* claim(Record* spare);
+    static void publish(Record* r);
+
+    static void pack_all(Record* r) { (void)r; }
+
+    template <typename T, typename... Rest>
+    static void pack_all(Record* r, const T& first, const Rest&... rest)
+    {
+        pack(r, first);
+        pack_all(r, rest...);
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value &&
+      std::is_signed<T>::value>::type pack(Record* r, T value)
+    {
+        Arg& a = r->args[r->argc++];
+        a.type = ARG_INT;
+        a.i = value;
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value &&
+      std::is_unsigned<T>::value>::type pack(Record* r, T value)
+    {
+        Arg& a = r->args[r->argc++];
+        a.type = ARG_UINT;
+        a.u = value;
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_enum<T>::value>::type
+    pack(Record* r, T value)
+    {
+        Arg& a = r->args[r->argc++];
+        a.type = ARG_INT;
+        a.i = static_cast<int64_t>(value);
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    pack(Record* r, T value)
+    {
+        Arg& a = r->args[r->argc++];
+        a.type = ARG_DOUBLE;
+        a.d = value;
+    }
+
+    static void pack(Record* r, const char* str)
+    {
+        pack_text(r, str != nullptr ? str : "(null)",
+          str != nullptr ? std::strlen(str) : 6);
+    }
+
+    static void pack(Record* r, const std::string& str)
+    {
+        pack_text(r, str.data(), str.size());
+    }
+
+    static void pack_text(Record* r, const char* str, size_t len);
+
+    static void writer(void);
+    static size_t drain(uint64_t* tail, std::string* batch);
+    static void format_record(const Record& r, std::string* out);
+    static void write_out(const std::string& text);
+    static void stop_writer(void);
+    static void on_exit(void);
+    static void on_signal(int sig);
+
+    static Record* m_records;
+    static std::atomic<uint64_t> m_head;    // next slot to claim
+    static std::atomic<uint64_t> m_tail;    // records written to the file
+    static std::atomic<uint64_t> m_dropped;
+    static std::atomic<int> m_verbosity;
+    static std::atomic<bool> m_running;
+    static std::thread m_writer;
+    static std::fstream m_file;
+    static uint64_t m_origin_tick;
+    static uint32_t m_origin_ms;
+    static double m_ms_per_tick;
+};
+
+#endif // VKTEST_LOG_H
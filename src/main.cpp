@@ -2,13 +2,32 @@
 #include <sstream>
 
 #include <SDL2/SDL.h>
+#include "benchmark.h"
+#include "cpuprofiler.h"
+#include "flightrec.h"
 #include "global.h"
+#include "jobs.h"
 #include "renderer.h"
+#include "texstream.h"
 #include "timer.h"
 
 void parse_cli(struct Renderer::CreateInfo* ci, int argc, char* argv[]);
 void print_help(void);
 void print_version(void);
+void run_job_benchmark(int count);
+void run_stream_benchmark(int count);
+void shutdown(void);
+
+/* Set by --cpu-trace, written once everything else has shut down. */
+static const char* cpu_trace = nullptr;
+
+/* Set by --flight, or cleared by --no-flight. */
+static const char* flight_path = FLIGHT_DEFAULT_PATH;
+
+/* Set by --benchmark and friends. */
+static const BenchmarkPreset* bench_preset = nullptr;
+static uint32_t bench_frames = BENCHMARK_DEFAULT_FRAMES;
+static const char* bench_out = BENCHMARK_DEFAULT_OUT;
 
 int main(int argc, char* argv[])
 {
@@ -16,6 +35,7 @@ int main(int argc, char* argv[])
 
     SDL_Init(SDL_INIT_EVERYTHING);
     Log::Init(Log::ROUTINE);
+    CpuProfiler::Init();
 
     struct Renderer::CreateInfo info = {};
     info.width = 1024;
@@ -24,6 +44,18 @@ int main(int argc, char* argv[])
 
     parse_cli(&info, argc, argv);
 
+    if (flight_path != nullptr &&
+      !FlightRecorder::Init(flight_path, FLIGHT_DEFAULT_EVENTS)) {
+        Log::Write(Log::WARNING, "Could not map {}, the flight recorder is "
+          "off.", flight_path);
+    }
+
+    if (bench_preset != nullptr) {
+        int ret = RunBenchmark(&info, bench_preset, bench_frames, bench_out);
+        shutdown();
+        return ret;
+    }
+
     rend = Renderer::Init(&info);
     if (!rend) {
         std::cerr << "Failed to initialize Vulkan library." << std::endl;
@@ -36,6 +68,8 @@ int main(int argc, char* argv[])
 
     bool done = false;
     while (!done) {
+        PROFILE_ZONE("frame");
+
         SDL_Event ev;
         while (SDL_PollEvent(&ev)) {
             if (ev.type == SDL_QUIT) {
@@ -55,9 +89,20 @@ int main(int argc, char* argv[])
     Log::Write(Log::ROUTINE, "Leaving main rendering loop.");
 
     Renderer::Release(rend);
+    shutdown();
+    return 0;
+}
+
+void shutdown(void)
+{
+    if (cpu_trace != nullptr && !CpuProfiler::WriteTrace(cpu_trace)) {
+        Log::Write(Log::WARNING, "Could not write {}", cpu_trace);
+    }
+    CpuProfiler::Release();
+    FlightRecorder::Release();
+
     Log::Close();
     SDL_Quit();
-    return 0;
 }
 
 void parse_cli(struct Renderer::CreateInfo* ci, int argc, char* argv[])
@@ -78,6 +123,79 @@ void parse_cli(struct Renderer::CreateInfo* ci, int argc, char* argv[])
             std::exit(EXIT_SUCCESS);
         }
 
+        ptr = std::strstr(argv[i], "--job-bench=");
+        if (ptr != nullptr) {
+            run_job_benchmark(atoi(ptr + 12));
+            std::exit(EXIT_SUCCESS);
+        }
+
+        ptr = std::strstr(argv[i], "--stream-bench=");
+        if (ptr != nullptr) {
+            run_stream_benchmark(atoi(ptr + 15));
+            std::exit(EXIT_SUCCESS);
+        }
+
+        ptr = std::strstr(argv[i], "--benchmark=");
+        if (ptr != nullptr) {
+            bench_preset = FindBenchmarkPreset(ptr + 12);
+            if (bench_preset == nullptr) {
+                std::cerr << "Unknown benchmark preset " << ptr + 12;
+                std::cerr << ", pick one of:" << std::endl;
+                PrintBenchmarkPresets(std::cerr);
+                std::exit(EXIT_FAILURE);
+            }
+            std::cerr << "CLI: Benchmarking the " << bench_preset->name;
+            std::cerr << " scene." << std::endl;
+        }
+
+        ptr = std::strstr(argv[i], "--benchmark-out=");
+        if (ptr != nullptr) {
+            bench_out = ptr + 16;
+            std::cerr << "CLI: Benchmark results go to " << bench_out;
+            std::cerr << std::endl;
+        }
+
+        ptr = std::strstr(argv[i], "--frames=");
+        if (ptr != nullptr) {
+            int value = atoi(ptr + 9);
+            if (value > 0) {
+                bench_frames = value;
+            }
+            std::cerr << "CLI: Benchmarking " << bench_frames << " frames.";
+            std::cerr << std::endl;
+        }
+
+        ptr = std::strstr(argv[i], "--gpu-trace=");
+        if (ptr != nullptr) {
+            ci->gpu_trace = ptr + std::strlen("--gpu-trace=");
+            std::cerr << "CLI: GPU trace goes to " << ci->gpu_trace;
+            std::cerr << std::endl;
+        }
+
+        ptr = std::strstr(argv[i], "--cpu-trace=");
+        if (ptr != nullptr) {
+            cpu_trace = ptr + std::strlen("--cpu-trace=");
+            std::cerr << "CLI: CPU trace goes to " << cpu_trace;
+            std::cerr << std::endl;
+            if (!CPU_PROFILER_ENABLED) {
+                std::cerr << "CLI: Built without VKTEST_PROFILE, the CPU ";
+                std::cerr << "trace will be empty." << std::endl;
+            }
+        }
+
+        ptr = std::strstr(argv[i], "--flight=");
+        if (ptr != nullptr) {
+            flight_path = ptr + std::strlen("--flight=");
+            std::cerr << "CLI: Flight recorder writes to " << flight_path;
+            std::cerr << std::endl;
+        }
+
+        ptr = std::strstr(argv[i], "--no-flight");
+        if (ptr != nullptr) {
+            flight_path = nullptr;
+            std::cerr << "CLI: Flight recorder off." << std::endl;
+        }
+
         ptr = std::strstr(argv[i], "--fullscreen");
         if (ptr != nullptr) {
             ci->flags = static_cast<Renderer::Flags>(
@@ -108,6 +226,37 @@ void parse_cli(struct Renderer::CreateInfo* ci, int argc, char* argv[])
               static_cast<int>(ci->flags));
             std::cerr << "CLI: FPS Display toggled." << std::endl;
         }
+
+        ptr = std::strstr(argv[i], "--hot-reload");
+        if (ptr != nullptr) {
+            ci->flags = static_cast<Renderer::Flags>(
+              static_cast<int>(Renderer::HOT_RELOAD) |
+              static_cast<int>(ci->flags));
+            std::cerr << "CLI: Shader hot reload on." << std::endl;
+        }
+
+        ptr = std::strstr(argv[i], "--material=");
+        if (ptr != nullptr) {
+            ci->material = ptr + std::strlen("--material=");
+            std::cerr << "CLI: Material set to " << ci->material << "."
+              << std::endl;
+        }
+
+        ptr = std::strstr(argv[i], "--no-bindless");
+        if (ptr != nullptr) {
+            ci->flags = static_cast<Renderer::Flags>(
+              static_cast<int>(Renderer::NO_BINDLESS) |
+              static_cast<int>(ci->flags));
+            std::cerr << "CLI: Bindless textures disabled." << std::endl;
+        }
+
+        ptr = std::strstr(argv[i], "--no-timeline");
+        if (ptr != nullptr) {
+            ci->flags = static_cast<Renderer::Flags>(
+              static_cast<int>(Renderer::NO_TIMELINE) |
+              static_cast<int>(ci->flags));
+            std::cerr << "CLI: Timeline semaphores disabled." << std::endl;
+        }
     }
 }
 
@@ -117,14 +266,45 @@ void print_help(void)
     out << "Usage:" << std::endl;
     out << "\tvktest.exe [OPTIONS]" << std::endl << std::endl;
     out << "Options:" << std::endl;
+    out << "\t--benchmark=PRESET\tDraw a fixed number of frames of a preset ";
+    out << "scene on a fixed timestep, write the results and exit.";
+    out << std::endl;
+    out << "\t--benchmark-out=FILE\tWhere the results go, CSV if it ends in ";
+    out << ".csv and JSON otherwise (" << BENCHMARK_DEFAULT_OUT << ").";
+    out << std::endl;
+    out << "\t--cpu-trace=FILE\tWrite CPU zones as a Chrome trace on exit ";
+    out << "(VKTEST_PROFILE builds)." << std::endl;
     out << "\t--debug=X\tDebug levels from 0-4, least to most verbose.";
     out << std::endl;
+    out << "\t--flight=FILE\tWhere the flight recorder keeps the last ";
+    out << FLIGHT_DEFAULT_EVENTS << " events (" << FLIGHT_DEFAULT_PATH;
+    out << "); read it with vktest-flight." << std::endl;
+    out << "\t--frames=N\tFrames to measure with --benchmark (";
+    out << BENCHMARK_DEFAULT_FRAMES << ")." << std::endl;
     out << "\t--fullscreen\tFull screen rendering." << std::endl;
+    out << "\t--gpu-trace=FILE\tWrite GPU timings as a Chrome trace on ";
+    out << "exit." << std::endl;
     out << "\t--help\t\tPrint this help message." << std::endl;
+    out << "\t--hot-reload\tRebuild the pipeline whenever its SPIR-V in ";
+    out << RENDERER_SHADER_DIR << " is rewritten." << std::endl;
+    out << "\t--job-bench=N\tUpdate N transforms per thread count and ";
+    out << "report how it scales." << std::endl;
+    out << "\t--material=NAME\tHow the boxes look: textured, tinted, ";
+    out << "flat, cutout or glass." << std::endl;
+    out << "\t--no-bindless\tBind one texture at a time even if the GPU ";
+    out << "supports descriptor indexing." << std::endl;
+    out << "\t--no-flight\tDon't run the flight recorder." << std::endl;
+    out << "\t--no-timeline\tTrack submits with fences even if the GPU ";
+    out << "supports timeline semaphores." << std::endl;
+    out << "\t--stream-bench=N\tDecode N textures per thread count and ";
+    out << "report throughput." << std::endl;
     out << "\t--version\tPrint version information and exit." << std::endl;
     out << "\t--vsync\t\tTurn on vsync (locked to 60 FPS max framerate.";
     out << std::endl;
 
+    out << std::endl << "Benchmark presets:" << std::endl;
+    PrintBenchmarkPresets(out);
+
     std::cout << out.str();
 }
 
@@ -132,3 +312,131 @@ void print_version(void)
 {
     std::cout << "VkTest v0.0.1" << std::endl;
 }
+
+/*
+* Measures how Renderer::Update()'s transform pass scales across the
+* JobSystem, from one thread up to one per core.  Each round is a
+* ParallelFor over 'count' objects with the same grain the renderer uses,
+* so the numbers include the cost of handing the slices out.
+*/
+void run_job_benchmark(int count)
+{
+    const uint32_t rounds = 200;
+    if (count <= 0) {
+        count = 65536;
+    }
+
+    uint32_t max_threads = std::thread::hardware_concurrency();
+    if (max_threads == 0) {
+        max_threads = 1;
+    }
+
+    std::vector<uint32_t> thread_counts;
+    for (uint32_t n = 1; n < max_threads; n *= 2) {
+        thread_counts.push_back(n);
+    }
+    thread_counts.push_back(max_threads);
+
+    std::vector<glm::mat4> placements(count);
+    std::vector<ObjectData> objects(count);
+    for (int i = 0; i < count; i++) {
+        placements[i] = glm::translate(glm::mat4(),
+          glm::vec3(i % 256, i / 256, 0.0f));
+    }
+
+    std::cout << "Updating " << count << " transforms, " << rounds;
+    std::cout << " rounds" << std::endl;
+    std::cout << "threads	ms/round	speedup	efficiency" << std::endl;
+
+    double base_ms = 0.0;
+    for (size_t i = 0; i < thread_counts.size(); i++) {
+        JobSystem* jobs = JobSystem::Init(thread_counts[i]);
+        Timer t;
+
+        for (uint32_t r = 0; r < rounds; r++) {
+            glm::mat4 model = glm::rotate(glm::mat4(), r * 0.01f,
+              glm::vec3(0.0f, 0.0f, 1.0f));
+            jobs->ParallelFor(static_cast<uint32_t>(count),
+              RENDERER_TRANSFORM_GRAIN, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t j = begin; j < end; j++) {
+                    objects[j].model = placements[j] * model;
+                }
+            });
+        }
+
+        double ms = t.Elapsed() * 1000.0 / rounds;
+        JobSystem::Release(jobs);
+
+        if (i == 0) {
+            base_ms = ms;
+        }
+        double speedup = base_ms / ms;
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << thread_counts[i] << "\t" << ms << "\t\t" << speedup;
+        std::cout << "\t" << speedup / thread_counts[i] << std::endl;
+    }
+}
+
+/*
+* Measures how fast the TextureStreamer can turn files into pixels.  No GPU
+* is involved; decoded images are popped and thrown away on this thread,
+* the same way the renderer would drain them before uploading.
+*/
+void run_stream_benchmark(int count)
+{
+    const char* path = "./textures/bitcoin.png";
+    if (count <= 0) {
+        count = 256;
+    }
+
+    uint32_t max_threads = std::thread::hardware_concurrency();
+    if (max_threads == 0) {
+        max_threads = 1;
+    }
+
+    std::vector<uint32_t> thread_counts;
+    for (uint32_t n = 1; n < max_threads; n *= 2) {
+        thread_counts.push_back(n);
+    }
+    thread_counts.push_back(max_threads);
+
+    std::cout << "Streaming " << count << " copies of " << path << std::endl;
+    std::cout << "threads\ttextures/s\tMB/s" << std::endl;
+
+    for (size_t i = 0; i < thread_counts.size(); i++) {
+        TextureStreamer* streamer = TextureStreamer::Init(thread_counts[i],
+          false);
+        Timer t;
+
+        for (int j = 0; j < count; j++) {
+            streamer->Request(path, 0);
+        }
+
+        int done = 0;
+        while (done < count) {
+            TextureStreamer::Handle handle;
+            MipImage img;
+            if (!streamer->PopDecoded(&handle, &img)) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            done++;
+        }
+
+        double seconds = t.Elapsed();
+        TextureStreamer::Stats stats;
+        streamer->GetStats(&stats);
+        TextureStreamer::Release(streamer);
+
+        if (stats.failed > 0) {
+            std::cerr << "Failed to decode " << path << std::endl;
+            return;
+        }
+
+        double mbytes = static_cast<double>(stats.bytes_decoded) /
+          (1024.0 * 1024.0);
+        std::cout << thread_counts[i] << "\t" << count / seconds << "\t\t";
+        std::cout << mbytes / seconds << std::endl;
+    }
+}
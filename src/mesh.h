@@ -0,0 +1,37 @@
+#ifndef VKTEST_MESH_H
+#define VKTEST_MESH_H
+
+#include <cstdint>
+
+/*
+* On-disk layout of a cooked mesh (.vkm), as written by vktest-cook.  The
+* file is the header, then vertex_count PackedVertex records, then
+* index_count indices that are 16 bits wide if index_size is 2 and 32 bits
+* wide otherwise.  Everything is little-endian, and the vertex and index
+* arrays are ready to be copied straight into GPU buffers.
+*
+* Positions are unorm16 inside the mesh's bounding box:
+*     pos = pos_min + pos_scale * quantized
+* Texture coordinates are IEEE half floats and colours are unorm8.
+*/
+#define MESH_MAGIC      (0x4d4b5456)    // "VTKM"
+#define MESH_VERSION    (1)
+
+struct MeshHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t index_size;
+    float pos_min[3];
+    float pos_scale[3];
+};
+
+struct PackedVertex {
+    uint16_t pos[3];
+    uint16_t pad;
+    uint8_t color[4];
+    uint16_t texcoord[2];
+};
+
+#endif // VKTEST_MESH_H
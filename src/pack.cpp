@@ -0,0 +1,364 @@
+#include "pack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+static_assert(sizeof(PackHeader) == 32, "PackHeader has padding");
+static_assert(sizeof(PackEntry) == 40, "PackEntry has padding");
+
+uint64_t HashBytes(const void* data, size_t len, uint64_t seed)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static bool entry_less(const PackEntry& a, const PackEntry& b)
+{
+    return a.name_hash < b.name_hash;
+}
+
+AssetPack* AssetPack::Init(std::string path)
+{
+    const unsigned char* base = nullptr;
+    size_t size = 0;
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER len;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &len) && len.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0,
+          nullptr);
+    }
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    base = static_cast<const unsigned char*>(
+      MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    size = static_cast<size_t>(len.QuadPart);
+    if (base == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return nullptr;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    base = static_cast<const unsigned char*>(map);
+
+    /* The table of contents and names are read at once; the blobs are
+     * paged in on demand through Prefetch(). */
+    madvise(map, size, MADV_RANDOM);
+#endif
+
+    AssetPack* pack = new AssetPack();
+    pack->m_base = base;
+    pack->m_size = size;
+    pack->m_header = reinterpret_cast<const PackHeader*>(base);
+#if defined(_WIN32)
+    pack->m_file = file;
+    pack->m_mapping = mapping;
+#else
+    pack->m_fd = fd;
+#endif
+
+    /* Everything past this point is bounds checked once, up front, so
+     * that Find() can trust the table of contents. */
+    const PackHeader* hdr = pack->m_header;
+    bool ok = size >= sizeof(PackHeader) && hdr->magic == PACK_MAGIC &&
+      hdr->version == PACK_VERSION && hdr->toc_offset <= size &&
+      hdr->entry_count <= (size - hdr->toc_offset) / sizeof(PackEntry) &&
+      hdr->toc_offset % alignof(PackEntry) == 0 &&
+      hdr->names_offset <= size && hdr->names_size <= size - hdr->names_offset;
+
+    if (ok) {
+        pack->m_entries = reinterpret_cast<const PackEntry*>(
+          base + hdr->toc_offset);
+        pack->m_names = reinterpret_cast<const char*>(
+          base + hdr->names_offset);
+
+        for (uint32_t i = 0; i < hdr->entry_count && ok; i++) {
+            const PackEntry& e = pack->m_entries[i];
+            ok = e.offset <= size && e.size <= size - e.offset &&
+              e.name_offset <= hdr->names_size &&
+              e.name_length <= hdr->names_size - e.name_offset &&
+              (i == 0 || !entry_less(e, pack->m_entries[i - 1]));
+        }
+    }
+
+    if (!ok) {
+        Release(pack);
+        return nullptr;
+    }
+
+    return pack;
+}
+
+void AssetPack::Release(AssetPack* pack)
+{
+#if defined(_WIN32)
+    UnmapViewOfFile(pack->m_base);
+    CloseHandle(static_cast<HANDLE>(pack->m_mapping));
+    CloseHandle(static_cast<HANDLE>(pack->m_file));
+#else
+    munmap(const_cast<unsigned char*>(pack->m_base), pack->m_size);
+    close(pack->m_fd);
+#endif
+
+    delete(pack);
+}
+
+std::string AssetPack::normalize(std::string name)
+{
+    while (name.compare(0, 2, "./") == 0 || name.compare(0, 2, ".\\") == 0) {
+        name.erase(0, 2);
+    }
+    std::replace(name.begin(), name.end(), '\\', '/');
+
+    return name;
+}
+
+bool AssetPack::Find(std::string name, Span* out) const
+{
+    name = normalize(name);
+
+    PackEntry key = {};
+    key.name_hash = HashBytes(name.data(), name.size());
+
+    const PackEntry* end = m_entries + m_header->entry_count;
+    const PackEntry* it = std::lower_bound(m_entries, end, key, entry_less);
+
+    /* Hash collisions are possible, so the names still get compared. */
+    for (; it != end && it->name_hash == key.name_hash; ++it) {
+        if (name.compare(0, std::string::npos, m_names + it->name_offset,
+          it->name_length) == 0) {
+            out->data = m_base + it->offset;
+            out->size = static_cast<size_t>(it->size);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint32_t AssetPack::GetCount(void) const
+{
+    return m_header->entry_count;
+}
+
+size_t AssetPack::GetSize(void) const
+{
+    return m_size;
+}
+
+void AssetPack::Prefetch(const Span& span) const
+{
+    advise(span, true);
+}
+
+void AssetPack::Done(const Span& span) const
+{
+    advise(span, false);
+}
+
+void AssetPack::advise(const Span& span, bool needed) const
+{
+#if defined(_WIN32)
+    /* Windows 8's PrefetchVirtualMemory would go here; the mingw headers
+     * don't all have it yet, so the page faults are left to do the work. */
+    (void)span;
+    (void)needed;
+#else
+    if (span.size == 0 || span.data < m_base ||
+      span.data >= m_base + m_size) {
+        return;
+    }
+
+    /* madvise wants a page aligned start.  Blobs already are, but spans
+     * can be carved out of the middle of one. */
+    size_t start = static_cast<size_t>(span.data - m_base);
+    size_t aligned = start - start % PACK_ALIGNMENT;
+    madvise(const_cast<unsigned char*>(m_base) + aligned,
+      start - aligned + span.size, needed ? MADV_WILLNEED : MADV_DONTNEED);
+#endif
+}
+
+bool AssetPack::Verify(std::string* bad) const
+{
+    for (uint32_t i = 0; i < m_header->entry_count; i++) {
+        const PackEntry& e = m_entries[i];
+        if (HashBytes(m_base + e.offset, static_cast<size_t>(e.size)) !=
+          e.data_hash) {
+            if (bad != nullptr) {
+                bad->assign(m_names + e.name_offset, e.name_length);
+            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AssetPack::Write(std::string path, const std::vector<Source>& sources,
+  std::string* error)
+{
+    std::vector<PackEntry> entries(sources.size());
+    std::vector<std::string> names(sources.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+        names[i] = normalize(sources[i].name);
+        entries[i] = PackEntry();
+        entries[i].name_hash = HashBytes(names[i].data(), names[i].size());
+        entries[i].name_length = static_cast<uint32_t>(names[i].size());
+    }
+
+    /* Sort a permutation so the names and sources stay lined up. */
+    std::vector<size_t> order(sources.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (entries[a].name_hash != entries[b].name_hash) {
+            return entries[a].name_hash < entries[b].name_hash;
+        }
+        return names[a] < names[b];
+    });
+
+    for (size_t i = 1; i < order.size(); i++) {
+        if (names[order[i]] == names[order[i - 1]]) {
+            error[0] = "two files named " + names[order[i]];
+            return false;
+        }
+    }
+
+    PackHeader header = {};
+    header.magic = PACK_MAGIC;
+    header.version = PACK_VERSION;
+    header.entry_count = static_cast<uint32_t>(sources.size());
+    header.toc_offset = sizeof(PackHeader);
+    header.names_offset = header.toc_offset +
+      sources.size() * sizeof(PackEntry);
+
+    std::string table;
+    for (size_t i = 0; i < order.size(); i++) {
+        entries[order[i]].name_offset = static_cast<uint32_t>(table.size());
+        table += names[order[i]];
+    }
+    header.names_size = static_cast<uint32_t>(table.size());
+
+    /*
+    * Written to a temporary name first so a running copy of vktest never
+    * maps a half-written pack.  The blobs go out first and the header and
+    * table of contents are filled in afterwards, once the hashes are known.
+    */
+    std::string tmp = path + ".tmp";
+    std::ofstream f(tmp.c_str(), std::ofstream::out |
+      std::ofstream::binary | std::ofstream::trunc);
+    if (!f.is_open()) {
+        error[0] = "could not create " + tmp;
+        return false;
+    }
+
+    uint64_t offset = header.names_offset + table.size();
+    const char zeros[PACK_ALIGNMENT] = {};
+
+    /* The table of contents outgrows one page past a hundred or so files. */
+    for (uint64_t left = header.names_offset; left > 0;) {
+        uint64_t n = std::min<uint64_t>(left, PACK_ALIGNMENT);
+        f.write(zeros, static_cast<std::streamsize>(n));
+        left -= n;
+    }
+    f.write(table.data(), static_cast<std::streamsize>(table.size()));
+
+    std::vector<char> bytes;
+    for (size_t i = 0; i < order.size() && f; i++) {
+        const Source& src = sources[order[i]];
+        std::ifstream in(src.path.c_str(), std::ifstream::in |
+          std::ifstream::binary);
+        if (!in.is_open()) {
+            error[0] = "could not read " + src.path;
+            f.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+
+        bytes.assign(std::istreambuf_iterator<char>(in),
+          std::istreambuf_iterator<char>());
+
+        uint64_t pad = (PACK_ALIGNMENT - offset % PACK_ALIGNMENT) %
+          PACK_ALIGNMENT;
+        f.write(zeros, static_cast<std::streamsize>(pad));
+        offset += pad;
+
+        PackEntry& e = entries[order[i]];
+        e.offset = offset;
+        e.size = bytes.size();
+        e.data_hash = HashBytes(bytes.data(), bytes.size());
+
+        f.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        offset += bytes.size();
+    }
+
+    f.seekp(0);
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t i = 0; i < order.size(); i++) {
+        f.write(reinterpret_cast<const char*>(&entries[order[i]]),
+          sizeof(PackEntry));
+    }
+    f.close();
+
+    if (!f) {
+        error[0] = "could not write " + tmp;
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+#if defined(_WIN32)
+    /* rename() only replaces an existing file atomically on POSIX. */
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        error[0] = "could not rename " + tmp + " to " + path;
+        return false;
+    }
+
+    return true;
+}
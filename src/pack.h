@@ -0,0 +1,114 @@
+#ifndef VKTEST_PACK_H
+#define VKTEST_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+* An asset pack (.vpk) bundles every file the runtime needs into one
+* archive that gets mapped into memory once at startup.  Lookups hand back
+* a pointer straight into the mapping, so loaders can parse or memcpy the
+* bytes into a staging buffer without a read() or a heap copy in between.
+*
+* Layout, all little-endian:
+*
+*     PackHeader
+*     PackEntry[entry_count]       sorted by name_hash
+*     name table                   entry names, not NUL terminated
+*     blobs                        each one starts on a PACK_ALIGNMENT line
+*
+* Page aligned blobs mean a blob never shares a page with its neighbour, so
+* the read-ahead hints below only pull in the bytes that were asked for.
+*
+* Like dds.h, nothing here touches Vulkan or SDL: vktest-cook writes packs.
+*/
+#define PACK_MAGIC      (0x4b505456)    // "VTPK"
+#define PACK_VERSION    (1)
+#define PACK_ALIGNMENT  (4096)
+
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t names_size;
+    uint64_t toc_offset;
+    uint64_t names_offset;
+};
+
+struct PackEntry {
+    uint64_t name_hash;
+    uint64_t data_hash;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t name_offset;
+    uint32_t name_length;
+};
+
+/* 64-bit FNV-1a.  Keys the pack's table of contents and the cook cache. */
+uint64_t HashBytes(const void* data, size_t len,
+  uint64_t seed = 0xcbf29ce484222325ULL);
+
+class AssetPack {
+public:
+    struct Span {
+        const unsigned char* data;
+        size_t size;
+    };
+
+    /* One file going into a pack: its name inside the pack, and where the
+     * bytes are on disk right now. */
+    struct Source {
+        std::string name;
+        std::string path;
+    };
+
+    /* Returns nullptr if the file is missing or isn't a valid pack. */
+    static AssetPack* Init(std::string path);
+    static void Release(AssetPack* pack);
+
+    /*
+    * Names are relative paths like "shaders/test.vert.spv".  A leading
+    * "./" is ignored, so the paths the loose-file loaders already use can
+    * be looked up as they are.
+    */
+    bool Find(std::string name, Span* out) const;
+    uint32_t GetCount(void) const;
+    size_t GetSize(void) const;
+
+    /*
+    * Tells the kernel a span is about to be read so the page-in can start
+    * now, on whichever thread asked, rather than in the middle of a memcpy
+    * later.  Done() says it's no longer needed and the pages can go; a
+    * span from outside the pack is ignored, so any image's bytes can be
+    * handed to it.
+    */
+    void Prefetch(const Span& span) const;
+    void Done(const Span& span) const;
+
+    /* Hashes every blob and checks it against the table of contents. */
+    bool Verify(std::string* bad) const;
+
+    static bool Write(std::string path, const std::vector<Source>& sources,
+      std::string* error);
+
+private:
+    const unsigned char* m_base;
+    size_t m_size;
+    const PackHeader* m_header;
+    const PackEntry* m_entries;
+    const char* m_names;
+
+#if defined(_WIN32)
+    void* m_file;
+    void* m_mapping;
+#else
+    int m_fd;
+#endif
+
+    static std::string normalize(std::string name);
+    void advise(const Span& span, bool needed) const;
+};
+
+#endif // VKTEST_PACK_H
@@ -0,0 +1,271 @@
+#include "pipelines.h"
+
+#include "cpuprofiler.h"
+
+PipelineState PipelineState::Default(void)
+{
+    PipelineState state = {};
+    state.blend = BLEND_OPAQUE;
+    state.cull = VK_CULL_MODE_BACK_BIT;
+    state.depth = DEPTH_TEST | DEPTH_WRITE;
+    state.compare = VK_COMPARE_OP_LESS;
+    state.pass = 0;
+    state.features = FEATURE_TEXTURE | FEATURE_FLIP_U;
+    state.alpha_ref = 128;
+
+    return state;
+}
+
+/* FNV-1a, over the bytes as they're packed. */
+uint64_t PipelineState::Hash(void) const
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(this);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < sizeof(PipelineState); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+PipelineVariants* PipelineVariants::Init(VkDevice device, Builder builder)
+{
+    PipelineVariants* variants = new PipelineVariants();
+    variants->m_device = device;
+    variants->m_builder = builder;
+    variants->m_busy = false;
+    variants->m_quit = false;
+    variants->m_stats = {};
+    variants->m_thread = std::thread(&PipelineVariants::worker, variants);
+
+    return variants;
+}
+
+void PipelineVariants::Release(PipelineVariants* variants)
+{
+    {
+        std::lock_guard<std::mutex> guard(variants->m_lock);
+        variants->m_quit = true;
+    }
+    variants->m_wake.notify_all();
+    variants->m_thread.join();
+
+    variants->Clear();
+    delete(variants);
+}
+
+VkResult PipelineVariants::Build(const PipelineState& state)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        Entry& entry = m_entries[state];
+        if (entry.status == READY) {
+            return VK_SUCCESS;
+        }
+
+        /* The builder skips anything that isn't QUEUED when it gets to it. */
+        entry.status = BUILDING;
+        entry.pipeline = VK_NULL_HANDLE;
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = m_builder(state, &pipeline);
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    finish(state, result, pipeline);
+
+    return result;
+}
+
+void PipelineVariants::Insert(const PipelineState& state, VkPipeline pipeline)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    Entry& entry = m_entries[state];
+    if (entry.status == READY) {
+        vkDestroyPipeline(m_device, entry.pipeline, nullptr);
+    } else {
+        m_stats.ready++;
+    }
+
+    /* A build still going for it gets thrown away in finish(). */
+    entry.status = READY;
+    entry.pipeline = pipeline;
+}
+
+void PipelineVariants::Prepare(const std::vector<PipelineState>& states)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        for (size_t i = 0; i < states.size(); i++) {
+            if (m_entries.count(states[i]) != 0) {
+                continue;
+            }
+            Entry entry = { QUEUED, VK_NULL_HANDLE };
+            m_entries[states[i]] = entry;
+            m_queue.push_back(states[i]);
+        }
+    }
+    m_wake.notify_one();
+}
+
+VkResult PipelineVariants::Get(const PipelineState& state, VkPipeline* out)
+{
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        std::unordered_map<PipelineState, Entry, Hasher>::iterator it =
+          m_entries.find(state);
+        if (it != m_entries.end() && it->second.status == READY) {
+            *out = it->second.pipeline;
+            return VK_SUCCESS;
+        }
+
+        if (it == m_entries.end()) {
+            Entry entry = { QUEUED, VK_NULL_HANDLE };
+            m_entries[state] = entry;
+            m_queue.push_back(state);
+            queued = true;
+        }
+
+        *out = fallback(state);
+        m_stats.fallbacks++;
+    }
+
+    if (queued) {
+        m_wake.notify_one();
+    }
+
+    return VK_NOT_READY;
+}
+
+void PipelineVariants::Clear(std::vector<PipelineState>* dropped)
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_queue.clear();
+    while (m_busy) {
+        m_idle.wait(lock);
+    }
+
+    std::unordered_map<PipelineState, Entry, Hasher>::iterator it;
+    for (it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (dropped != nullptr) {
+            dropped->push_back(it->first);
+        }
+        if (it->second.status == READY) {
+            vkDestroyPipeline(m_device, it->second.pipeline, nullptr);
+        }
+    }
+    m_entries.clear();
+    m_stats.ready = 0;
+    m_stats.failed = 0;
+}
+
+void PipelineVariants::GetStats(Stats* out)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    *out = m_stats;
+}
+
+/* Called with m_lock held. */
+void PipelineVariants::finish(const PipelineState& state, VkResult result,
+  VkPipeline pipeline)
+{
+    Entry& entry = m_entries[state];
+    if (entry.status == READY) {
+        if (result == VK_SUCCESS) {
+            vkDestroyPipeline(m_device, pipeline, nullptr);
+        }
+        return;
+    }
+
+    if (result != VK_SUCCESS) {
+        Log::Write(Log::WARNING, "PipelineVariants -> building variant {} "
+          "failed with {}; it'll keep using a stand-in.", state.Hash(),
+          result);
+        entry.status = FAILED;
+        entry.pipeline = VK_NULL_HANDLE;
+        m_stats.failed++;
+        return;
+    }
+
+    entry.status = READY;
+    entry.pipeline = pipeline;
+    m_stats.ready++;
+}
+
+/*
+* Scores every ready variant on the same render pass by what it has in
+* common with 'state'.  Blending counts most, since getting it wrong is
+* what shows; then the shader's features, then depth, then culling.
+* Called with m_lock held.
+*/
+VkPipeline PipelineVariants::fallback(const PipelineState& state)
+{
+    VkPipeline best = VK_NULL_HANDLE;
+    int best_score = -1;
+
+    std::unordered_map<PipelineState, Entry, Hasher>::iterator it;
+    for (it = m_entries.begin(); it != m_entries.end(); ++it) {
+        const PipelineState& other = it->first;
+        if (it->second.status != READY || other.pass != state.pass) {
+            continue;
+        }
+
+        int score = 0;
+        score += other.blend == state.blend ? 16 : 0;
+        score += other.features == state.features ? 8 : 0;
+        score += other.depth == state.depth ? 4 : 0;
+        score += other.compare == state.compare ? 2 : 0;
+        score += other.cull == state.cull ? 1 : 0;
+        if (score > best_score) {
+            best = it->second.pipeline;
+            best_score = score;
+        }
+    }
+
+    return best;
+}
+
+void PipelineVariants::worker(void)
+{
+    PROFILE_THREAD("pipeline builder");
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (;;) {
+        while (!m_quit && m_queue.empty()) {
+            m_wake.wait(lock);
+        }
+        if (m_quit) {
+            break;
+        }
+
+        PipelineState state = m_queue.front();
+        m_queue.pop_front();
+
+        Entry& entry = m_entries[state];
+        if (entry.status != QUEUED) {
+            continue;
+        }
+        entry.status = BUILDING;
+        m_busy = true;
+        lock.unlock();
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkResult result = VK_SUCCESS;
+        {
+            PROFILE_ZONE("PipelineVariants::build");
+            result = m_builder(state, &pipeline);
+        }
+
+        lock.lock();
+        m_busy = false;
+        finish(state, result, pipeline);
+        if (result == VK_SUCCESS) {
+            m_stats.built++;
+        }
+        m_idle.notify_all();
+    }
+}
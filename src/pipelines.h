@@ -0,0 +1,165 @@
+#ifndef VKTEST_PIPELINES_H
+#define VKTEST_PIPELINES_H
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "global.h"
+
+/*
+* The fixed-function state that differs from one material to the next,
+* packed down to a few bytes.  Build one from PipelineState::Default() or
+* zero it first, so the padding hashes and compares the same every time.
+*/
+struct PipelineState {
+    enum Blend {
+        BLEND_OPAQUE,
+        BLEND_ALPHA,        // src alpha, one minus src alpha
+        BLEND_ADDITIVE
+    };
+
+    enum Depth {
+        DEPTH_TEST  = 0x01,
+        DEPTH_WRITE = 0x02
+    };
+
+    /*
+    * What the fragment shader does, handed to it as specialization
+    * constants so the driver compiles out whatever a variant doesn't use.
+    */
+    enum Feature {
+        FEATURE_TEXTURE         = 0x01,
+        FEATURE_VERTEX_COLOR    = 0x02,     // multiplied into the colour
+        FEATURE_ALPHA_TEST      = 0x04,     // discards below alpha_ref
+        FEATURE_FLIP_U          = 0x08
+    };
+
+    /* The constant_id each one has in the fragment shaders. */
+    enum SpecConstant {
+        SPEC_TEXTURE,
+        SPEC_VERTEX_COLOR,
+        SPEC_ALPHA_TEST,
+        SPEC_FLIP_U,
+        SPEC_ALPHA_REF,
+        SPEC_COUNT
+    };
+
+    uint8_t blend;          // Blend
+    uint8_t cull;           // VkCullModeFlags
+    uint8_t depth;          // Depth bits
+    uint8_t compare;        // VkCompareOp
+    uint8_t pass;           // the render pass it has to be compatible with
+    uint8_t features;       // Feature bits
+    uint8_t alpha_ref;      // alpha test threshold, 255 is 1.0
+    uint8_t pad;
+
+    /*
+    * Opaque, back faces culled, depth tested and written, textured with
+    * the U coordinate flipped.  What test.frag always did.
+    */
+    static PipelineState Default(void);
+
+    uint64_t Hash(void) const;
+
+    bool operator==(const PipelineState& other) const
+    {
+        return std::memcmp(this, &other, sizeof(PipelineState)) == 0;
+    }
+};
+
+/*
+* Every VkPipeline the renderer draws with, keyed by its PipelineState.
+* Get() is cheap enough to call per draw from any thread.  A state that
+* hasn't been built yet is queued for the builder thread, and Get() hands
+* back the closest one that is ready meanwhile: the same render pass,
+* matching as much of the rest as it can.  So a new material costs a frame
+* or two of looking slightly wrong instead of a hitch.
+*
+* The builder callback does the actual vkCreateGraphicsPipelines, on the
+* builder thread or on whoever called Build().  Anything it reads must
+* stay put until Clear() has returned.
+*/
+class PipelineVariants {
+public:
+    typedef std::function<VkResult(const PipelineState&, VkPipeline*)>
+      Builder;
+
+    struct Stats {
+        uint32_t ready;
+        uint32_t failed;
+        uint32_t built;         // on the builder thread
+        uint64_t fallbacks;     // Get() calls that got another variant
+    };
+
+    static PipelineVariants* Init(VkDevice device, Builder builder);
+    static void Release(PipelineVariants* variants);
+
+    /* Builds 'state' on the calling thread, unless it's ready already. */
+    VkResult Build(const PipelineState& state);
+    /* Takes over a pipeline somebody else built for 'state'. */
+    void Insert(const PipelineState& state, VkPipeline pipeline);
+    /* Queues whichever of 'states' aren't known yet for the builder. */
+    void Prepare(const std::vector<PipelineState>& states);
+
+    /*
+    * VK_SUCCESS with the pipeline for 'state', or VK_NOT_READY with the
+    * best stand-in.  That's VK_NULL_HANDLE if there's nothing compatible,
+    * in which case whatever wanted it should be skipped this frame.
+    */
+    VkResult Get(const PipelineState& state, VkPipeline* out);
+
+    /*
+    * Waits for the builder to finish what it's doing, then destroys every
+    * pipeline.  Only once the GPU is done with them.  'dropped' gets the
+    * states that were known, to Prepare() again later.
+    */
+    void Clear(std::vector<PipelineState>* dropped = nullptr);
+
+    void GetStats(Stats* out);
+
+private:
+    enum Status {
+        QUEUED,
+        BUILDING,
+        READY,
+        FAILED
+    };
+
+    struct Entry {
+        Status status;
+        VkPipeline pipeline;
+    };
+
+    struct Hasher {
+        size_t operator()(const PipelineState& state) const
+        {
+            return static_cast<size_t>(state.Hash());
+        }
+    };
+
+    VkDevice m_device;
+    Builder m_builder;
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::unordered_map<PipelineState, Entry, Hasher> m_entries;
+    std::deque<PipelineState> m_queue;
+    bool m_busy;
+    bool m_quit;
+    Stats m_stats;
+    std::thread m_thread;
+
+    void finish(const PipelineState& state, VkResult result,
+      VkPipeline pipeline);
+    VkPipeline fallback(const PipelineState& state);
+    void worker(void);
+};
+
+#endif // VKTEST_PIPELINES_H
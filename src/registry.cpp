@@ -0,0 +1,204 @@
+#include "registry.h"
+
+#include "flightrec.h"
+#include "global.h"
+
+ResourceRegistry* ResourceRegistry::Init(VkDevice device,
+  DeletionQueue* deletions)
+{
+    ResourceRegistry* ret = new ResourceRegistry();
+    ret->m_device = device;
+    ret->m_deletions = deletions;
+    ret->m_stale = 0;
+
+    return ret;
+}
+
+void ResourceRegistry::Release(ResourceRegistry* registry)
+{
+    VkDevice device = registry->m_device;
+
+    if (registry->m_stale > 0) {
+        Log::Write(Log::WARNING, "ResourceRegistry::Release -> {} lookups "
+          "went through stale handles.", registry->m_stale);
+    }
+
+    /* Meshes only point at buffers, which go with the rest below. */
+    SlotPool<Buffer>& buffers = registry->m_buffers;
+    for (size_t i = 0; i < buffers.Size(); i++) {
+        vkDestroyBuffer(device, buffers.Data()[i].buffer, nullptr);
+        FlightRecorder::Record(FLIGHT_FREE,
+          (uint64_t)buffers.Data()[i].memory);
+        vkFreeMemory(device, buffers.Data()[i].memory, nullptr);
+    }
+
+    SlotPool<Image>& images = registry->m_images;
+    for (size_t i = 0; i < images.Size(); i++) {
+        vkDestroyImageView(device, images.Data()[i].view, nullptr);
+        vkDestroyImage(device, images.Data()[i].image, nullptr);
+        FlightRecorder::Record(FLIGHT_FREE,
+          (uint64_t)images.Data()[i].memory);
+        vkFreeMemory(device, images.Data()[i].memory, nullptr);
+    }
+
+    SlotPool<Sampler>& samplers = registry->m_samplers;
+    for (size_t i = 0; i < samplers.Size(); i++) {
+        vkDestroySampler(device, samplers.Data()[i].sampler, nullptr);
+    }
+
+    delete(registry);
+}
+
+ResourceRegistry::BufferHandle ResourceRegistry::Add(const Buffer& buffer)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_buffers.Add(buffer);
+}
+
+ResourceRegistry::ImageHandle ResourceRegistry::Add(const Image& image)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_images.Add(image);
+}
+
+ResourceRegistry::SamplerHandle ResourceRegistry::Add(const Sampler& sampler)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_samplers.Add(sampler);
+}
+
+ResourceRegistry::MeshHandle ResourceRegistry::Add(const Mesh& mesh)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_meshes.Add(mesh);
+}
+
+bool ResourceRegistry::Get(BufferHandle handle, Buffer* out)
+{
+    return get(&m_buffers, handle, out);
+}
+
+bool ResourceRegistry::Get(ImageHandle handle, Image* out)
+{
+    return get(&m_images, handle, out);
+}
+
+bool ResourceRegistry::Get(SamplerHandle handle, Sampler* out)
+{
+    return get(&m_samplers, handle, out);
+}
+
+bool ResourceRegistry::Get(MeshHandle handle, Mesh* out)
+{
+    return get(&m_meshes, handle, out);
+}
+
+void ResourceRegistry::Touch(ImageHandle handle, uint64_t value)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    Image* image = m_images.Find(handle);
+    if (image != nullptr && image->last_use < value) {
+        image->last_use = value;
+    }
+}
+
+bool ResourceRegistry::Destroy(BufferHandle handle)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return destroy_buffer(handle);
+}
+
+bool ResourceRegistry::Destroy(ImageHandle handle)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    Image image = {};
+    if (!m_images.Remove(handle, &image)) {
+        return false;
+    }
+
+    VkDevice device = m_device;
+    m_deletions->Defer(image.last_use, [device, image]() {
+        vkDestroyImageView(device, image.view, nullptr);
+        vkDestroyImage(device, image.image, nullptr);
+        FlightRecorder::Record(FLIGHT_FREE, (uint64_t)image.memory);
+        vkFreeMemory(device, image.memory, nullptr);
+    });
+
+    return true;
+}
+
+bool ResourceRegistry::Destroy(SamplerHandle handle)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    Sampler sampler = {};
+    if (!m_samplers.Remove(handle, &sampler)) {
+        return false;
+    }
+
+    VkDevice device = m_device;
+    m_deletions->Defer([device, sampler]() {
+        vkDestroySampler(device, sampler.sampler, nullptr);
+    });
+
+    return true;
+}
+
+bool ResourceRegistry::Destroy(MeshHandle handle)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    Mesh mesh = {};
+    if (!m_meshes.Remove(handle, &mesh)) {
+        return false;
+    }
+
+    destroy_buffer(mesh.vertices);
+    destroy_buffer(mesh.indices);
+
+    return true;
+}
+
+void ResourceRegistry::GetStats(Stats* out)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    out->buffers = static_cast<uint32_t>(m_buffers.Size());
+    out->images = static_cast<uint32_t>(m_images.Size());
+    out->samplers = static_cast<uint32_t>(m_samplers.Size());
+    out->meshes = static_cast<uint32_t>(m_meshes.Size());
+    out->stale = m_stale;
+}
+
+template <typename T>
+bool ResourceRegistry::get(SlotPool<T>* pool, Handle<T> handle, T* out)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    const T* value = pool->Find(handle);
+    if (value == nullptr) {
+        /* A zeroed handle is "none", not a mistake. */
+        if (handle.bits != 0) {
+            m_stale++;
+        }
+        return false;
+    }
+
+    *out = *value;
+    return true;
+}
+
+bool ResourceRegistry::destroy_buffer(BufferHandle handle)
+{
+    Buffer buffer = {};
+    if (!m_buffers.Remove(handle, &buffer)) {
+        return false;
+    }
+
+    m_deletions->DestroyBuffer(buffer.buffer);
+    m_deletions->FreeMemory(buffer.memory);
+
+    return true;
+}
@@ -0,0 +1,227 @@
+#ifndef VKTEST_REGISTRY_H
+#define VKTEST_REGISTRY_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "deletion.h"
+
+/*
+* A reference to something in a SlotPool: the slot's index in the low
+* REGISTRY_INDEX_BITS and its generation in the rest.  Destroying a
+* resource bumps its slot's generation, so a handle that outlives what it
+* pointed at just stops resolving, even once the slot is reused.  Zero is
+* never handed out, so a zeroed handle is a safe "none".
+*
+* Handles are 32 bits and order by their bits, so they fit in per-instance
+* data and in sort keys as they are.  The type parameter only keeps a
+* buffer handle from being passed where an image one is wanted.
+*/
+#define REGISTRY_INDEX_BITS     (20)
+#define REGISTRY_INDEX_MASK     ((1u << REGISTRY_INDEX_BITS) - 1)
+#define REGISTRY_GENERATIONS    (1u << (32 - REGISTRY_INDEX_BITS))
+
+template <typename T>
+struct Handle {
+    uint32_t bits;
+
+    uint32_t Index(void) const { return bits & REGISTRY_INDEX_MASK; }
+    uint32_t Generation(void) const { return bits >> REGISTRY_INDEX_BITS; }
+
+    bool operator==(const Handle& other) const { return bits == other.bits; }
+    bool operator!=(const Handle& other) const { return bits != other.bits; }
+    bool operator<(const Handle& other) const { return bits < other.bits; }
+};
+
+/*
+* Values packed end to end in one array, found through a table of slots
+* that never moves anything.  Adding appends; removing moves the last
+* value into the hole, so both are O(1) and the values stay dense for
+* anything that walks them all.  Slots that come free are reused, newest
+* first, with a new generation.  Not thread safe on its own.
+*/
+template <typename T>
+class SlotPool {
+public:
+    SlotPool(void) : m_free(UINT32_MAX) {}
+
+    Handle<T> Add(const T& value)
+    {
+        uint32_t index = m_free;
+        if (index != UINT32_MAX) {
+            m_free = m_slots[index].dense;
+        } else {
+            index = static_cast<uint32_t>(m_slots.size());
+            if (index > REGISTRY_INDEX_MASK) {
+                Handle<T> none = { 0 };
+                return none;
+            }
+            Slot slot = { 0, 1 };
+            m_slots.push_back(slot);
+        }
+
+        m_slots[index].dense = static_cast<uint32_t>(m_values.size());
+        m_values.push_back(value);
+        m_owners.push_back(index);
+
+        Handle<T> handle = {
+          (m_slots[index].generation << REGISTRY_INDEX_BITS) | index };
+        return handle;
+    }
+
+    bool Remove(Handle<T> handle, T* out)
+    {
+        const T* value = Find(handle);
+        if (value == nullptr) {
+            return false;
+        }
+        if (out != nullptr) {
+            *out = *value;
+        }
+
+        uint32_t index = handle.Index();
+        uint32_t dense = m_slots[index].dense;
+        uint32_t last = static_cast<uint32_t>(m_values.size() - 1);
+        if (dense != last) {
+            m_values[dense] = m_values[last];
+            m_owners[dense] = m_owners[last];
+            m_slots[m_owners[dense]].dense = dense;
+        }
+        m_values.pop_back();
+        m_owners.pop_back();
+
+        /* Generation 0 is skipped, which keeps handle 0 invalid. */
+        Slot& slot = m_slots[index];
+        slot.generation = (slot.generation + 1) % REGISTRY_GENERATIONS;
+        if (slot.generation == 0) {
+            slot.generation = 1;
+        }
+        slot.dense = m_free;
+        m_free = index;
+
+        return true;
+    }
+
+    T* Find(Handle<T> handle)
+    {
+        uint32_t index = handle.Index();
+        if (handle.bits == 0 || index >= m_slots.size() ||
+          m_slots[index].generation != handle.Generation() ||
+          m_slots[index].dense >= m_values.size() ||
+          m_owners[m_slots[index].dense] != index) {
+            return nullptr;
+        }
+
+        return &m_values[m_slots[index].dense];
+    }
+
+    size_t Size(void) const { return m_values.size(); }
+    T* Data(void) { return m_values.data(); }
+
+private:
+    struct Slot {
+        uint32_t dense;         // into m_values, or the next free slot
+        uint32_t generation;
+    };
+
+    std::vector<T> m_values;
+    std::vector<uint32_t> m_owners;     // the slot of each value
+    std::vector<Slot> m_slots;
+    uint32_t m_free;
+};
+
+/*
+* Owns the renderer's buffers, images, samplers and meshes, and hands out
+* Handles to them in place of the raw Vulkan objects.  Get() copies a
+* resource out, or says the handle has gone stale.  Destroy() takes it out
+* of the registry at once, and gives its Vulkan objects to the
+* DeletionQueue: an image waits for the last frame that sampled it, the
+* rest for whatever's been submitted so far.  A mesh owns its buffers.
+*
+* Every call takes the registry's lock, since the startup steps fill it in
+* from more than one thread.  Release() destroys whatever is left straight
+* away, so the device has to be idle by then.
+*/
+class ResourceRegistry {
+public:
+    struct Buffer {
+        VkBuffer buffer;
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+    };
+
+    struct Image {
+        VkImage image;
+        VkImageView view;
+        VkDeviceMemory memory;
+        uint64_t last_use;      // Scheduler value of the last frame to read it
+    };
+
+    struct Sampler {
+        VkSampler sampler;
+    };
+
+    struct Mesh {
+        Handle<Buffer> vertices;
+        Handle<Buffer> indices;
+        uint32_t index_count;
+        VkIndexType index_type;
+    };
+
+    typedef Handle<Buffer> BufferHandle;
+    typedef Handle<Image> ImageHandle;
+    typedef Handle<Sampler> SamplerHandle;
+    typedef Handle<Mesh> MeshHandle;
+
+    struct Stats {
+        uint32_t buffers;
+        uint32_t images;
+        uint32_t samplers;
+        uint32_t meshes;
+        uint64_t stale;         // lookups with a handle that had gone
+    };
+
+    static ResourceRegistry* Init(VkDevice device, DeletionQueue* deletions);
+    static void Release(ResourceRegistry* registry);
+
+    BufferHandle Add(const Buffer& buffer);
+    ImageHandle Add(const Image& image);
+    SamplerHandle Add(const Sampler& sampler);
+    MeshHandle Add(const Mesh& mesh);
+
+    bool Get(BufferHandle handle, Buffer* out);
+    bool Get(ImageHandle handle, Image* out);
+    bool Get(SamplerHandle handle, Sampler* out);
+    bool Get(MeshHandle handle, Mesh* out);
+
+    /* Marks an image as read by the submit with Scheduler value 'value'. */
+    void Touch(ImageHandle handle, uint64_t value);
+
+    bool Destroy(BufferHandle handle);
+    bool Destroy(ImageHandle handle);
+    bool Destroy(SamplerHandle handle);
+    bool Destroy(MeshHandle handle);
+
+    void GetStats(Stats* out);
+
+private:
+    VkDevice m_device;
+    DeletionQueue* m_deletions;
+    std::mutex m_lock;
+
+    SlotPool<Buffer> m_buffers;
+    SlotPool<Image> m_images;
+    SlotPool<Sampler> m_samplers;
+    SlotPool<Mesh> m_meshes;
+    uint64_t m_stale;
+
+    template <typename T>
+    bool get(SlotPool<T>* pool, Handle<T> handle, T* out);
+
+    /* Called with m_lock held. */
+    bool destroy_buffer(BufferHandle handle);
+};
+
+#endif  /* VKTEST_REGISTRY_H */
@@ -1,13 +1,64 @@
 #include "renderer.h"
 
+/*
+* What a box can look like.  Each is a pipeline state, and the fragment
+* shader gets its features as specialization constants, so these cost a
+* variant each rather than a branch per pixel.
+*/
+static const struct {
+    const char* name;
+    uint8_t blend;
+    uint8_t depth;
+    uint8_t features;
+} materials[] = {
+    { "textured", PipelineState::BLEND_OPAQUE,
+      PipelineState::DEPTH_TEST | PipelineState::DEPTH_WRITE,
+      PipelineState::FEATURE_TEXTURE | PipelineState::FEATURE_FLIP_U },
+    { "tinted", PipelineState::BLEND_OPAQUE,
+      PipelineState::DEPTH_TEST | PipelineState::DEPTH_WRITE,
+      PipelineState::FEATURE_TEXTURE | PipelineState::FEATURE_FLIP_U |
+      PipelineState::FEATURE_VERTEX_COLOR },
+    { "flat", PipelineState::BLEND_OPAQUE,
+      PipelineState::DEPTH_TEST | PipelineState::DEPTH_WRITE,
+      PipelineState::FEATURE_VERTEX_COLOR },
+    { "cutout", PipelineState::BLEND_OPAQUE,
+      PipelineState::DEPTH_TEST | PipelineState::DEPTH_WRITE,
+      PipelineState::FEATURE_TEXTURE | PipelineState::FEATURE_FLIP_U |
+      PipelineState::FEATURE_ALPHA_TEST },
+    { "glass", PipelineState::BLEND_ALPHA, PipelineState::DEPTH_TEST,
+      PipelineState::FEATURE_TEXTURE | PipelineState::FEATURE_FLIP_U |
+      PipelineState::FEATURE_VERTEX_COLOR }
+};
+
+static bool find_material(const char* name, PipelineState* out)
+{
+    for (size_t i = 0; i < sizeof(materials) / sizeof(materials[0]); i++) {
+        if (std::strcmp(materials[i].name, name) != 0) {
+            continue;
+        }
+        *out = PipelineState::Default();
+        out->blend = materials[i].blend;
+        out->depth = materials[i].depth;
+        out->features = materials[i].features;
+        return true;
+    }
+
+    return false;
+}
+
 Renderer* Renderer::Init(CreateInfo* info)
 {
+    PROFILE_ZONE("Renderer::Init");
+
     /* Check to see if the video subsystem was initialized before proceeding. */
     if (!SDL_WasInit(SDL_INIT_VIDEO)) {
         return nullptr;
     }
 
     Renderer* ret = new Renderer();
+    ret->m_clock.ms_per_tick = 1000.0 / Timer::Frequency();
+    uint64_t start = Timer::Ticks();
+    uint64_t stage = start;
 
     /* If we don't receive anything in the parameter,
      * just fill with safe default values */
@@ -18,51 +69,343 @@ Renderer* Renderer::Init(CreateInfo* info)
     } else {
         memcpy(&ret->m_cinfo, info, sizeof(CreateInfo));
     }
+    ret->m_cinfo.objects = std::max(ret->m_cinfo.objects, 1u);
+    ret->m_cinfo.textures = std::max(ret->m_cinfo.textures, 1u);
 
     ret->m_window = ret->create_window();
 
-    Assert(ret->create_instance(), "create_instance", ret->m_window);
-    Assert(ret->init_debug(), "init_debug", ret->m_window);
-    Assert(ret->create_surface(), "create_surface", ret->m_window);
-    Assert(ret->create_device(), "create_device", ret->m_window);
+    /* Anything slower than one refresh counts against the budget. */
+    SDL_DisplayMode mode = {};
+    int refresh = RENDERER_DEFAULT_REFRESH;
+    if (SDL_GetWindowDisplayMode(ret->m_window, &mode) == 0 &&
+      mode.refresh_rate > 0) {
+        refresh = mode.refresh_rate;
+    }
+    ret->m_framestats = FrameStats::Init(1000.0 / refresh);
 
-    ret->m_swapchain = Swapchain::Init(ret->m_surface, ret->m_device,
-      ret->m_gpu.device);
-    if (ret->m_swapchain == nullptr) {
-        Assert(VK_ERROR_FEATURE_NOT_PRESENT, "Unable to create swapchain.",
-          ret->m_window);
-    }
-
-    Assert(ret->m_swapchain->CreateImageViews(ret->m_device, nullptr),
-      "Swapchain::CreateImageViews", ret->m_window);
-
-    Assert(ret->create_renderpass(), "create_renderpass", ret->m_window);
-    Assert(ret->create_descriptorset_layout(), "create_descriptorset_layout",
-      ret->m_window);
-    Assert(ret->create_pipeline(), "create_pipeline", ret->m_window);
-    Assert(ret->create_cmdpool(), "create_cmdpool", ret->m_window);
-    Assert(ret->create_depthresources(), "create_depthresources",
-      ret->m_window);
-    Assert(ret->create_framebuffers(), "create_framebuffers", ret->m_window);
-    Assert(ret->create_texture(), "create_texture", ret->m_window);
-    Assert(ret->create_textureimageview(), "create_textureimageview",
-      ret->m_window);
-    Assert(ret->create_sampler(), "create_sampler", ret->m_window);
-    Assert(ret->create_vertexbuffer(), "create_vertexbuffer", ret->m_window);
-    Assert(ret->create_indexbuffer(), "create_indexbuffer", ret->m_window);
-    Assert(ret->create_uniformbuffer(), "create_uniformbuffer", ret->m_window);
-    Assert(ret->create_descriptorpool(), "create_descriptorpool",
-      ret->m_window);
-    Assert(ret->create_descriptorset(), "create_descriptorset", ret->m_window);
-    Assert(ret->create_cmdbuffers(), "create_cmdbuffers", ret->m_window);
-    Assert(ret->create_synchronizers(), "create_synchronizers",
-      ret->m_window);
+    ret->m_camera.eye = glm::vec3(2.0f, 2.0f, 2.0f);
+    ret->m_camera.target = glm::vec3(0.0f, 0.0f, 0.0f);
+    ret->m_camera.up = glm::vec3(0.0f, 0.0f, 1.0f);
+    ret->m_camera.fov = glm::radians(45.0f);
+    ret->m_camera.dirty = true;
+
+    /*
+    * The boxes go on a square grid that stays the size of one box at the
+    * origin, so the camera sees all of them however many there are.  A
+    * single box is left exactly where it always was.
+    */
+    uint32_t side = 1;
+    while (side * side < ret->m_cinfo.objects) {
+        side++;
+    }
+    float scale = 1.0f / side;
+    float spacing = 1.5f / side;
+    for (uint32_t i = 0; i < ret->m_cinfo.objects; i++) {
+        glm::vec3 at((i % side - (side - 1) * 0.5f) * spacing,
+          (i / side - (side - 1) * 0.5f) * spacing, 0.0f);
+        ret->m_box.placements.push_back(glm::scale(glm::translate(
+          glm::mat4(), at), glm::vec3(scale)));
+    }
+    ret->m_box.objects.resize(ret->m_box.placements.size());
+    for (size_t i = 0; i < ret->m_box.placements.size(); i++) {
+        ret->m_box.objects[i].model = ret->m_box.placements[i];
+    }
+
+    /* Read by the pipeline step, so it's settled before the graph runs. */
+    const char* material = ret->m_cinfo.material != nullptr ?
+      ret->m_cinfo.material : "textured";
+    if (!find_material(material, &ret->m_box.state)) {
+        Log::Write(Log::WARNING, "Renderer -> no material called {}, the "
+          "box is textured.", material);
+        find_material("textured", &ret->m_box.state);
+    }
+
+    ret->startup_stage("window", &stage);
+
+    /*
+    * Everything else is a graph of steps.  The critical path runs through
+    * the device, the swapchain and the uploads on this thread, while
+    * mapping the pack, reading the shaders and the pipeline cache, and
+    * compiling the pipeline happen alongside it on the workers.  Anything
+    * that touches the window, the queue or the command pool stays here.
+    */
+    uint32_t cores = std::thread::hardware_concurrency();
+    ret->m_jobs = JobSystem::Init(cores > 0 ? cores : 1);
+
+    TaskGraph* graph = TaskGraph::Init(std::min<uint32_t>(
+      cores > 1 ? cores - 1 : 1, RENDERER_STARTUP_THREADS));
+    typedef TaskGraph::Task Task;
+
+    Task pack = graph->Add("pack", [ret]() -> VkResult {
+        ret->m_pack = AssetPack::Init(RENDERER_ASSET_PACK);
+        if (ret->m_pack == nullptr) {
+            return VK_SUCCESS;
+        }
+
+        Log::Write(Log::ROUTINE, "Renderer::Init -> mapped {}, {} files, "
+          "{} KiB.", RENDERER_ASSET_PACK, ret->m_pack->GetCount(),
+          ret->m_pack->GetSize() / 1024);
+
+#if defined(VKTEST_DEBUG)
+        std::string bad;
+        if (!ret->m_pack->Verify(&bad)) {
+            Log::Write(Log::SEVERE, "Renderer::Init -> asset pack is "
+              "corrupt at {}. Run vktest-cook again.", bad);
+            return VK_INCOMPLETE;
+        }
+#endif
+        return VK_SUCCESS;
+    });
+
+    Task shaders = graph->Add("shaders", [ret]() {
+        return ret->load_shaders();
+    }, { pack });
+
+    Task instance = graph->Add("instance", [ret]() -> VkResult {
+        VkResult result = ret->create_instance();
+        if (result) {
+            return result;
+        }
+
+        return ret->init_debug();
+    }, {}, TaskGraph::MAIN);
+
+    Task device = graph->Add("device", [ret]() -> VkResult {
+        VkResult result = ret->create_surface();
+        if (result) {
+            return result;
+        }
+
+        result = ret->create_device();
+        if (result) {
+            return result;
+        }
+
+        ret->m_scheduler = Scheduler::Init(ret->m_device, ret->m_renderqueue,
+          ret->m_gpu.timeline);
+        ret->m_deletions = DeletionQueue::Init(ret->m_device,
+          ret->m_scheduler);
+        ret->m_registry = ResourceRegistry::Init(ret->m_device,
+          ret->m_deletions);
+
+        return VK_SUCCESS;
+    }, { instance }, TaskGraph::MAIN);
+
+    Task cache = graph->Add("pipeline_cache", [ret]() {
+        return ret->create_pipeline_cache();
+    }, { device });
+
+    Task swapchain = graph->Add("swapchain", [ret]() -> VkResult {
+        ret->m_swapchain = Swapchain::Init(ret->m_surface, ret->m_device,
+          ret->m_gpu.device);
+        if (ret->m_swapchain == nullptr) {
+            return VK_ERROR_FEATURE_NOT_PRESENT;
+        }
+
+        return ret->m_swapchain->CreateImageViews(ret->m_device, nullptr);
+    }, { device }, TaskGraph::MAIN);
+
+    /* The layouts come out of the shaders themselves (see spirv.h). */
+    Task descriptors = graph->Add("descriptors", [ret]() -> VkResult {
+        const char* vpath = nullptr;
+        const char* fpath = nullptr;
+        ret->shader_paths(&vpath, &fpath);
+
+        VkResult result = ret->reflect_shaders(ret->find_shader(vpath),
+          ret->find_shader(fpath), &ret->m_pipeline.iface);
+        if (result) {
+            return result;
+        }
+
+        result = ret->create_descriptor_allocator();
+        if (result) {
+            return result;
+        }
+
+        result = ret->create_descriptorset_layout();
+        if (result) {
+            return result;
+        }
+
+        result = ret->create_descriptor_writer();
+        if (result) {
+            return result;
+        }
+
+        return ret->create_pipeline_layout();
+    }, { shaders, device });
+
+    Task renderpass = graph->Add("renderpass", [ret]() {
+        return ret->create_renderpass();
+    }, { swapchain });
+
+    graph->Add("pipeline", [ret]() {
+        return ret->create_pipeline();
+    }, { shaders, cache, descriptors, renderpass });
+
+    Task cmdpool = graph->Add("cmdpool", [ret]() -> VkResult {
+        VkResult result = ret->create_cmdpool();
+        if (result) {
+            return result;
+        }
+
+        ret->m_gpuprof = GpuProfiler::Init(ret->m_device,
+          &ret->m_gpu.properties,
+          ret->m_gpu.queue_properties.timestampValidBits,
+          RENDERER_PROFILER_FRAMES, RENDERER_PROFILER_SCOPES);
+        if (ret->m_gpuprof == nullptr) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        if (!ret->m_gpuprof->IsEnabled()) {
+            Log::Write(Log::WARNING, "Renderer::Init -> the render queue "
+              "has no timestamp support, GPU timings are off.");
+        }
+
+        return VK_SUCCESS;
+    }, { device }, TaskGraph::MAIN);
+
+    Task depth = graph->Add("depth", [ret]() {
+        return ret->create_depthresources();
+    }, { swapchain, cmdpool }, TaskGraph::MAIN);
+
+    Task framebuffers = graph->Add("framebuffers", [ret]() {
+        return ret->create_framebuffers();
+    }, { renderpass, depth }, TaskGraph::MAIN);
+
+    /*
+    * Leave one core for the render thread, but always have one decoder.
+    * Without BC support the decoders also unpack compressed textures.
+    */
+    Task streamer = graph->Add("streamer", [ret, cores]() {
+        bool decompress = !ret->m_gpu.features.textureCompressionBC;
+        if (decompress) {
+            Log::Write(Log::WARNING, "Renderer::Init -> no BC texture "
+              "support, compressed textures will be unpacked on the CPU.");
+        }
+        ret->m_streamer = TextureStreamer::Init(cores > 1 ? cores - 1 : 1,
+          decompress, ret->m_pack);
+
+        return VK_SUCCESS;
+    }, { pack, device });
+
+    Task texture = graph->Add("texture", [ret]() {
+        return ret->create_texture();
+    }, { streamer, cmdpool }, TaskGraph::MAIN);
+
+    Task sampler = graph->Add("sampler", [ret]() {
+        return ret->create_sampler();
+    }, { device });
+
+    Task buffers = graph->Add("buffers", [ret]() -> VkResult {
+        ResourceRegistry::Mesh mesh = {};
+        VkResult result = ret->create_vertexbuffer(&mesh.vertices);
+        if (result) {
+            return result;
+        }
+
+        result = ret->create_indexbuffer(&mesh.indices);
+        if (result) {
+            return result;
+        }
+
+        mesh.index_count = static_cast<uint32_t>(ret->m_box.indices.size());
+        mesh.index_type = VK_INDEX_TYPE_UINT16;
+        ret->m_box.mesh = ret->m_registry->Add(mesh);
+
+        return ret->create_uniformbuffer();
+    }, { cmdpool }, TaskGraph::MAIN);
+
+    Task instances = graph->Add("instances", [ret]() {
+        return ret->create_instancebuffer();
+    }, { texture });
+
+    graph->Add("descriptorset", [ret]() {
+        return ret->create_descriptorset();
+    }, { descriptors, texture, sampler, buffers, instances });
+
+    graph->Add("cmdbuffers", [ret]() {
+        return ret->create_cmdbuffers();
+    }, { framebuffers }, TaskGraph::MAIN);
+
+    graph->Add("synchronizers", [ret]() {
+        return ret->create_synchronizers();
+    }, { device });
+
+    const char* failed = nullptr;
+    VkResult result = graph->Run(&failed);
+    if (result) {
+        Assert(result, std::string("Renderer::Init failed at ") + failed +
+          ".", ret->m_window);
+    }
+
+    /* Nothing is left running: the first frame can go as soon as we return. */
+    std::vector<TaskGraph::Span> spans;
+    graph->GetTimeline(&spans);
+    TaskGraph::Release(graph);
+
+    double window_ms = ret->m_startup.back().ms;
+    for (size_t i = 0; i < spans.size(); i++) {
+        Log::Write(Log::ROUTINE, "Renderer::Init -> {} ran from {} to {} ms "
+          "on thread {}.", spans[i].name, window_ms + spans[i].start_ms,
+          window_ms + spans[i].end_ms, spans[i].thread);
+
+        StartupStage step = { spans[i].name,
+          spans[i].end_ms - spans[i].start_ms };
+        ret->m_startup.push_back(step);
+    }
+
+    Log::Write(Log::ROUTINE, "Renderer::Init -> done after {} ms.",
+      ret->clock_ms(start, Timer::Ticks()));
+
+    if (ret->m_cinfo.flags & HOT_RELOAD) {
+        ret->start_reload();
+    }
 
     return ret;
 }
 
 void Renderer::Release(Renderer* state)
 {
+    TextureStreamer::Stats stats;
+    state->m_streamer->GetStats(&stats);
+
+    Log::Write(Log::ROUTINE, "Textures: {} resident, {} KiB of video memory, "
+      "{} KiB saved by block compression.", stats.resident,
+      stats.bytes_resident / 1024, stats.bytes_saved / 1024);
+
+    DescriptorAllocator::Stats dstats;
+    state->m_descriptors->GetStats(&dstats);
+
+    Log::Write(Log::ROUTINE, "Descriptors: {} pools, {} layouts, {} "
+      "pipeline layouts, {} cached sets, {} allocations.", dstats.pools,
+      dstats.layouts, dstats.pipeline_layouts, dstats.cached_sets,
+      dstats.allocations);
+
+    PipelineVariants::Stats pstats;
+    state->m_variants->GetStats(&pstats);
+
+    Log::Write(Log::ROUTINE, "Pipelines: {} variants, {} built in the "
+      "background, {} failed, {} fallbacks.", pstats.ready, pstats.built,
+      pstats.failed, pstats.fallbacks);
+
+    std::stringstream out;
+    state->m_framestats->Print(out);
+    Log::Write(Log::ROUTINE, out.str());
+    std::cout << out.str();
+    FrameStats::Release(state->m_framestats);
+
+    if (state->m_cinfo.gpu_trace != nullptr) {
+        if (!state->m_gpuprof->WriteTrace(state->m_cinfo.gpu_trace)) {
+            Log::Write(Log::WARNING, "Renderer::Release -> could not "
+              "write {}", state->m_cinfo.gpu_trace);
+        }
+    }
+
+    /* Stop the decoders first so nothing new shows up mid-teardown. */
+    TextureStreamer::Release(state->m_streamer);
+    JobSystem::Release(state->m_jobs);
+    state->stop_reload();
+
     vkDeviceWaitIdle(state->m_device);
 
     state->release_render_objects();
@@ -70,6 +413,11 @@ void Renderer::Release(Renderer* state)
     state->release_device_objects();
     state->release_instance_objects();
 
+    /* Last to go: decoded textures may still have pointed into it. */
+    if (state->m_pack != nullptr) {
+        AssetPack::Release(state->m_pack);
+    }
+
     SDL_DestroyWindow(state->m_window);
     delete(state);
 }
@@ -81,66 +429,116 @@ void Renderer::PushEvent(SDL_WindowEvent event)
 
 void Renderer::RecreateSwapchain(void)
 {
-    vkDeviceWaitIdle(m_device);
+    PROFILE_ZONE("Renderer::RecreateSwapchain");
+
+    /*
+    * A shader reload in flight may be building against the render pass
+    * about to go away, so wait it out.  Its code is kept, and the pipeline
+    * made below picks it up.
+    */
+    std::lock_guard<std::mutex> guard(m_reload.build);
+    discard_reloaded();
+
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    m_swapchain->GetFormat(&format);
 
-    /* Release command buffers */
-    vkFreeCommandBuffers(m_device, m_cmdpool, m_cmdbuffers.size(),
-      m_cmdbuffers.data());
-    m_cmdbuffers.clear();
+    /*
+    * Nothing here waits on the GPU.  Whatever the last frame drew with goes
+    * to m_deletions, and is destroyed once that frame has finished.
+    */
+    VkDevice device = m_device;
+    VkCommandPool pool = m_cmdpool;
+    std::vector<VkCommandBuffer> cmdbuffers;
+    cmdbuffers.swap(m_cmdbuffers);
+    m_deletions->Defer([device, pool, cmdbuffers]() {
+        vkFreeCommandBuffers(device, pool, cmdbuffers.size(),
+          cmdbuffers.data());
+    });
 
-    /* Release framebuffers */
     for (uint32_t i = 0; i < m_fbuffers.size(); i++) {
-        vkDestroyFramebuffer(m_device, m_fbuffers[i], nullptr);
+        m_deletions->DestroyFramebuffer(m_fbuffers[i]);
     }
     m_fbuffers.clear();
 
-    /* Release depth resources */
-    vkDestroyImageView(m_device, m_depthview, nullptr);
-    vkDestroyImage(m_device, m_depthimage, nullptr);
-    vkFreeMemory(m_device, m_depthmem, nullptr);
-
-    /* Free the rendering pipeline, along with the shader modules */
-    vkDestroyPipeline(m_device, m_pipeline.gpipeline, nullptr);
-    vkDestroyPipelineLayout(m_device, m_pipeline.layout, nullptr);
-    vkDestroyShaderModule(m_device, m_pipeline.vshadermodule, nullptr);
-    vkDestroyShaderModule(m_device, m_pipeline.fshadermodule, nullptr);
-
-    /* Destroy the render pass */
-    vkDestroyRenderPass(m_device, m_pipeline.renderpass, nullptr);
-
-    /* Destroy the swapchain (deletes imageviews as well) */
-    Swapchain::Release(m_device, m_swapchain);
+    m_deletions->DestroyImageView(m_depthview);
+    m_deletions->DestroyImage(m_depthimage);
+    m_deletions->FreeMemory(m_depthmem);
 
-    /* now the actual swapchain creation code again */
-    m_swapchain = Swapchain::Init(m_surface, m_device, m_gpu.device);
+    /*
+    * The new swapchain retires the old one, which can then go whenever;
+    * its image views go with it.
+    */
+    Swapchain* old = m_swapchain;
+    m_swapchain = Swapchain::Init(m_surface, m_device, m_gpu.device, old);
     if (m_swapchain == nullptr) {
         Assert(VK_ERROR_FEATURE_NOT_PRESENT, "Unable to create swapchain.",
           m_window);
     }
+    m_deletions->Defer([device, old]() {
+        Swapchain::Release(device, old);
+    });
 
     /* All this needs to be created again, but not the other stuff in Init() */
     Assert(m_swapchain->CreateImageViews(m_device, nullptr),
       "Swapchain::CreateImageViews", m_window);
-    Assert(create_renderpass(), "create_renderpass", m_window);
-    Assert(create_pipeline(), "create_pipeline", m_window);
+
+    /*
+    * Viewport and scissor are dynamic, so the pipelines only care about
+    * the render pass, and that only changes along with the surface format.
+    * A plain resize keeps every variant.  Render() waits for each frame it
+    * submits, so no pipeline is still in use by the time this runs.
+    */
+    VkFormat newformat = VK_FORMAT_UNDEFINED;
+    m_swapchain->GetFormat(&newformat);
+    if (newformat != format) {
+        std::vector<PipelineState> known;
+        m_variants->Clear(&known);
+        m_deletions->DestroyRenderPass(m_pipeline.renderpass);
+
+        Assert(create_renderpass(), "create_renderpass", m_window);
+        Assert(m_variants->Build(m_box.state), "PipelineVariants::Build",
+          m_window);
+        m_variants->Prepare(known);
+    }
+
     Assert(create_depthresources(), "create_depthresources", m_window);
     Assert(create_framebuffers(), "create_framebuffers", m_window);
     Assert(create_cmdbuffers(), "create_cmdbuffers", m_window);
 
-    /* wait to finish before we start rendering again */
-    vkDeviceWaitIdle(m_device);
+    /* The aspect ratio went with the old extent. */
+    m_camera.dirty = true;
+
+    VkExtent2D extent = {};
+    m_swapchain->GetExtent(&extent);
+    FlightRecorder::Record(FLIGHT_SWAPCHAIN, extent.width, extent.height);
 }
 
 void Renderer::Render(void)
 {
+    PROFILE_ZONE("Renderer::Render");
+
     VkResult result = VK_SUCCESS;
 
+    /* A reloaded pipeline goes in before anything records with the old. */
+    swap_reloaded();
+
     VkSwapchainKHR sc_handle;
     m_swapchain->GetHandle(&sc_handle);
 
     uint32_t idx = 0;
-    vkAcquireNextImageKHR(m_device, sc_handle, UINT64_MAX,
-      m_swapready, VK_NULL_HANDLE, &idx);
+    uint64_t wait = Timer::Ticks();
+    {
+        PROFILE_ZONE("vkAcquireNextImageKHR");
+        result = vkAcquireNextImageKHR(m_device, sc_handle, UINT64_MAX,
+          m_swapready, VK_NULL_HANDLE, &idx);
+    }
+    FlightRecorder::Record(FLIGHT_ACQUIRE, idx,
+      static_cast<uint32_t>(result));
+    double acquire_ms = clock_ms(wait, Timer::Ticks());
+
+    /* Last frame was waited for at its end, so this is free. */
+    result = record_cmdbuffer(idx);
+    Assert(result, "record_cmdbuffer", m_window);
 
     VkSemaphore waitsems[] = { m_swapready };
     VkSemaphore sigsems[] = { m_swapfinished };
@@ -157,8 +555,11 @@ void Renderer::Render(void)
     si.signalSemaphoreCount = 1;
     si.pSignalSemaphores = sigsems;
 
-    result = vkQueueSubmit(m_renderqueue, 1, &si, VK_NULL_HANDLE);
-    Assert(result, "vkQueueSubmit", m_window);
+    uint64_t frame = 0;
+    FlightRecorder::Record(FLIGHT_SUBMIT, idx);
+    result = m_scheduler->Submit(&si, &frame);
+    Assert(result, "Scheduler::Submit", m_window);
+    stamp_textures(frame);
 
     VkSwapchainKHR swapchains[] = { sc_handle };
 
@@ -170,14 +571,48 @@ void Renderer::Render(void)
     pi.pSwapchains = swapchains;
     pi.pImageIndices = &idx;
 
-    vkQueuePresentKHR(m_renderqueue, &pi);
-    vkQueueWaitIdle(m_renderqueue);
+    wait = Timer::Ticks();
+    {
+        PROFILE_ZONE("vkQueuePresentKHR");
+        result = vkQueuePresentKHR(m_renderqueue, &pi);
+    }
+    FlightRecorder::Record(FLIGHT_PRESENT, idx,
+      static_cast<uint32_t>(result));
+    uint64_t presented = Timer::Ticks();
+
+    /* Just this frame's batch, not whatever else the queue has on. */
+    {
+        PROFILE_ZONE("Scheduler::Wait");
+        result = m_scheduler->Wait(frame);
+        Assert(result, "Scheduler::Wait", m_window);
+    }
+    uint64_t end = Timer::Ticks();
+    double present_ms = clock_ms(wait, presented);
+    double wait_ms = clock_ms(presented, end);
+
+    m_framestats->Record(FrameStats::ACQUIRE, acquire_ms);
+    m_framestats->Record(FrameStats::PRESENT, present_ms);
+    m_framestats->Record(FrameStats::WAIT, wait_ms);
+    m_framestats->Record(FrameStats::CPU, clock_ms(m_clock.begin, end) -
+      acquire_ms - present_ms - wait_ms);
+    if (m_clock.last_end != 0) {
+        m_framestats->Record(FrameStats::FRAME,
+          clock_ms(m_clock.last_end, end));
+    }
+    m_clock.last_end = end;
 
+    FlightRecorder::Record(FLIGHT_FRAME_END, m_clock.frame++);
     m_fpsinfo.framecount++;
 }
 
 void Renderer::Update(double elapsed)
 {
+    PROFILE_ZONE("Renderer::Update");
+    m_clock.begin = Timer::Ticks();
+    FlightRecorder::Record(FLIGHT_FRAME_BEGIN, m_clock.frame);
+
+    /* Whatever the GPU has finished with since last time goes now. */
+    m_deletions->Flush();
 
     /*
     * The only event I'm really watching for is the resize event,
@@ -194,60 +629,132 @@ void Renderer::Update(double elapsed)
         m_events.pop();
     }
 
-    UniformBufferObject ubo = {};
-
-    ubo.model = glm::rotate(glm::mat4(), static_cast<float>(elapsed) *
-      glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-
-    ubo.view = glm::lookAt(
-      glm::vec3(2.0f, 2.0f, 2.0f),
-      glm::vec3(0.0f, 0.0f, 0.0f),
-      glm::vec3(0.0f, 0.0f, 1.0f)
-    );
-
-    VkExtent2D extent;
-    m_swapchain->GetExtent(&extent);
-    float ratio = static_cast<float>(extent.width) /
-      static_cast<float>(extent.height);
-
-    ubo.proj = glm::perspective(glm::radians(45.0f), ratio, 0.1f, 10.0f);
-    ubo.proj[1][1] *= -1;       // y-axis is opposite of OpenGL in Vulkan.
-
-    void* data = nullptr;
-    vkMapMemory(m_device, m_box.usbuffermem, 0, sizeof(ubo), 0, &data);
-    std::memcpy(data, &ubo, sizeof(ubo));
-    vkUnmapMemory(m_device, m_box.usbuffermem);
+    /*
+    * A frame's GPU scopes start with its uploads, right below.  Whatever
+    * gets read back on the way is a few frames old, but it still goes in
+    * the histogram.
+    */
+    if (m_gpuprof->BeginFrame()) {
+        const std::vector<GpuProfiler::Timing>& timings =
+          m_gpuprof->GetTimings();
+        double gpu_ms = 0.0;
+        for (size_t i = 0; i < timings.size(); i++) {
+            if (timings[i].depth == 0) {
+                gpu_ms += timings[i].duration_ms;
+            }
+        }
+        m_framestats->Record(FrameStats::GPU, gpu_ms);
+    }
 
-    VkResult result = Utility::CopyBuffer(m_device, m_box.usbuffer,
-      m_box.ubuffer, sizeof(ubo), m_cmdpool, m_renderqueue);
+    VkResult result = stream_textures();
     if (result) {
         Log::Write(Log::SEVERE, "Renderer::Update -> call to "
-          "Utility::CopyBuffer failed.");
+          "stream_textures failed.");
+    }
+
+    /* Goes out as push constants when Render() records the frame. */
+    m_box.object.model = glm::rotate(glm::mat4(),
+      static_cast<float>(elapsed) * glm::radians(90.0f),
+      glm::vec3(0.0f, 0.0f, 1.0f));
+
+    {
+        PROFILE_ZONE("Renderer::Update transforms");
+        const glm::mat4& model = m_box.object.model;
+        m_jobs->ParallelFor(static_cast<uint32_t>(m_box.objects.size()),
+          RENDERER_TRANSFORM_GRAIN, [this, &model](uint32_t begin,
+          uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                m_box.objects[i].model = m_box.placements[i] * model;
+            }
+        });
+    }
+
+    if (m_camera.dirty) {
+        result = update_camera();
+        if (result) {
+            Log::Write(Log::SEVERE, "Renderer::Update -> call to "
+              "update_camera failed.");
+        }
     }
 
     /*
-    * Print the FPS statistics.  This will be compiled out before anything
-    * would ship.
+    * Once a second.  The real numbers are in m_framestats and get printed
+    * on the way out; this is just something to look at in the title bar.
     */
     if (elapsed - m_fpsinfo.last >= 1.0) {
-        std::stringstream out;
-        out << RENDERER_WINDOW_NAME << " | ";
-        out << "FPS: " << m_fpsinfo.framecount;
-
-        m_fpsinfo.framecount = 0;
-        m_fpsinfo.last = elapsed;
-
         /* temporary solution.  I would eventually like to render test
         * in the window.  But that's a story for another day. */
         if (m_cinfo.flags & Renderer::FPS_ON) {
+            FrameStats::Summary frame;
+            FrameStats::Summary gpu;
+            m_framestats->GetSummary(FrameStats::FRAME, &frame);
+            m_framestats->GetSummary(FrameStats::GPU, &gpu);
+
+            std::stringstream out;
+            out << RENDERER_WINDOW_NAME << " | ";
+            out << "FPS: " << m_fpsinfo.framecount;
+            out << std::fixed << std::setprecision(2);
+            out << " | p99: " << frame.p99_ms << " ms";
+            out << " | max: " << frame.max_ms << " ms";
+            if (gpu.count > 0) {
+                out << " | GPU p50/p99: " << gpu.p50_ms << "/";
+                out << gpu.p99_ms << " ms";
+            }
+
+            /* GPU side, from a frame a few frames back. */
+            const std::vector<GpuProfiler::Timing>& timings =
+              m_gpuprof->GetTimings();
+            for (size_t i = 0; i < timings.size(); i++) {
+                if (timings[i].depth == 0) {
+                    out << " | " << timings[i].name << ": ";
+                    out << timings[i].duration_ms << " ms";
+                }
+            }
+
             SDL_SetWindowTitle(m_window, out.str().c_str());
         }
 
-        /* log to stdout regardless. */
-        std::cout << out.str() << std::endl;
+        m_fpsinfo.framecount = 0;
+        m_fpsinfo.last = elapsed;
+
+        /* Keeps the per-thread CPU zone rings from filling up. */
+#if CPU_PROFILER_ENABLED
+        CpuProfiler::Flush();
+#endif
     }
 }
 
+const FrameStats* Renderer::GetFrameStats(void) const
+{
+    return m_framestats;
+}
+
+void Renderer::ResetFrameStats(void)
+{
+    m_framestats->Reset();
+    m_clock.last_end = 0;
+}
+
+void Renderer::GetInfo(Info* out)
+{
+    out->properties = m_gpu.properties;
+    out->bindless = m_gpu.bindless;
+    out->objects = m_cinfo.objects;
+    out->textures = m_cinfo.textures;
+    m_streamer->GetStats(&out->streaming);
+    m_registry->GetStats(&out->resources);
+    out->startup = m_startup;
+}
+
+bool Renderer::StreamingIdle(void)
+{
+    TextureStreamer::Stats stats;
+    m_streamer->GetStats(&stats);
+
+    return stats.resident + stats.failed + stats.cancelled >=
+      stats.requested;
+}
+
 VkResult Renderer::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
   VkMemoryPropertyFlags properties, VkBuffer* buffer,
   VkDeviceMemory* buffer_memory)
@@ -277,12 +784,33 @@ VkResult Renderer::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
     if (result) {
         return result;
     }
+    FlightRecorder::Record(FLIGHT_ALLOC, (uint64_t)*buffer_memory,
+      mai.allocationSize, mai.memoryTypeIndex);
 
     return vkBindBufferMemory(m_device, *buffer, *buffer_memory, 0);
 }
 
+/* The same, but the buffer belongs to m_registry from here on. */
+VkResult Renderer::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
+  VkMemoryPropertyFlags properties, BufferHandle* out)
+{
+    ResourceRegistry::Buffer buffer = {};
+    buffer.size = size;
+
+    VkResult result = create_buffer(size, usage, properties, &buffer.buffer,
+      &buffer.memory);
+    if (result) {
+        return result;
+    }
+
+    *out = m_registry->Add(buffer);
+    return result;
+}
+
 VkResult Renderer::create_depthresources(void)
 {
+    PROFILE_ZONE("Renderer::create_depthresources");
+
     VkResult result = VK_SUCCESS;
 
     VkFormat format;
@@ -309,113 +837,262 @@ VkResult Renderer::create_depthresources(void)
 
 VkResult Renderer::create_descriptorset(void)
 {
+    PROFILE_ZONE("Renderer::create_descriptorset");
+
     VkResult result = VK_SUCCESS;
 
-    VkDescriptorSetLayout layouts[] = { m_box.dslayout };
-    VkDescriptorSetAllocateInfo allocinfo = {};
-    allocinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocinfo.descriptorPool = m_box.dpool;
-    allocinfo.descriptorSetCount = 1;
-    allocinfo.pSetLayouts = layouts;
+    ResourceRegistry::Buffer camera = {};
+    ResourceRegistry::Image texture = {};
+    ResourceRegistry::Sampler sampler = {};
+    m_registry->Get(m_box.ubuffer, &camera);
+    m_registry->Get(find_texture(m_box.texture), &texture);
+    m_registry->Get(m_sampler, &sampler);
+
+    BoxDescriptors data = {};
+    data.camera.buffer = camera.buffer;
+    data.camera.offset = 0;
+    data.camera.range = sizeof(CameraData);
+    data.texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    data.texture.imageView = texture.view;
+    data.texture.sampler = sampler.sampler;
 
-    result =  vkAllocateDescriptorSets(m_device, &allocinfo, &m_box.dset);
+    /*
+    * One set per buffer and texture pairing, which never changes once it's
+    * written.  Swapping textures just picks out a different set.
+    */
+    if (!m_gpu.bindless) {
+        return m_descriptors->GetSet(m_box.dslayout, m_boxwriter, &data,
+          &m_box.dset);
+    }
+
+    result = m_descriptors->Allocate(m_box.dslayout, &m_box.dset);
     if (result) {
         return result;
     }
 
-    VkDescriptorBufferInfo bi = {};
-    bi.buffer = m_box.ubuffer;
-    bi.offset = 0;
-    bi.range = sizeof(UniformBufferObject);
+    m_boxwriter->Write(m_box.dset, &data);
+    if (m_pipeline.iface.Find(0, 1) == nullptr) {
+        return result;
+    }
 
-    VkDescriptorImageInfo ii = {};
-    ii.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    ii.imageView = m_texture.view;
-    ii.sampler = m_texture.sampler;
-
-    std::array<VkWriteDescriptorSet, 2> dw = {};
-    dw[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    dw[0].dstSet = m_box.dset;
-    dw[0].dstBinding = 0;
-    dw[0].dstArrayElement = 0;
-    dw[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    dw[0].descriptorCount = 1;
-    dw[0].pBufferInfo = &bi;
-    dw[0].pImageInfo = nullptr;
-    dw[0].pTexelBufferView = nullptr;
-
-    dw[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    dw[1].dstSet = m_box.dset;
-    dw[1].dstBinding = 1;
-    dw[1].dstArrayElement = 0;
-    dw[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    dw[1].descriptorCount = 1;
-    dw[1].pImageInfo = &ii;
-
-    vkUpdateDescriptorSets(m_device, dw.size(), dw.data(), 0, nullptr);
+    /*
+    * The array is partially bound, so only the slots that are handed
+    * out need to be filled in.  Until the streamer delivers, every one
+    * of them shows the placeholder.
+    */
+    write_slot(0, m_placeholder);
+    std::map<TextureStreamer::Handle, uint32_t>::iterator it;
+    for (it = m_slots.begin(); it != m_slots.end(); ++it) {
+        write_slot(it->second, find_texture(it->first));
+    }
 
     return result;
 }
 
-VkResult Renderer::create_descriptorpool(void)
+VkResult Renderer::create_descriptor_allocator(void)
 {
-    VkResult result = VK_SUCCESS;
+    PROFILE_ZONE("Renderer::create_descriptor_allocator");
 
-    std::array<VkDescriptorPoolSize, 2> pool_sizes = {};
-    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    pool_sizes[0].descriptorCount = 1;
-    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    pool_sizes[1].descriptorCount = 1;
+    DescriptorAllocator::CreateInfo ci = {};
+    ci.sets_per_pool = RENDERER_DESCRIPTOR_SETS_PER_POOL;
 
-    VkDescriptorPoolCreateInfo poolinfo = {};
-    poolinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolinfo.poolSizeCount = pool_sizes.size();
-    poolinfo.pPoolSizes = pool_sizes.data();
-    poolinfo.maxSets = 1;
+#if defined(VK_EXT_descriptor_indexing)
+    if (m_gpu.bindless) {
+        ci.sets_per_pool = 1;
+        ci.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    }
+#endif
+
+    /* Room for one of whatever the shaders declare, per set. */
+    const std::vector<ShaderInterface::Binding>& bindings =
+      m_pipeline.iface.bindings;
+    for (size_t i = 0; i < bindings.size(); i++) {
+        uint32_t count = bindings[i].count != 0 ? bindings[i].count :
+          m_gpu.max_textures;
+
+        size_t j = 0;
+        while (j < ci.sizes.size() && ci.sizes[j].type != bindings[i].type) {
+            j++;
+        }
+        if (j == ci.sizes.size()) {
+            DescriptorAllocator::PoolSize size = { bindings[i].type, 0 };
+            ci.sizes.push_back(size);
+        }
+        ci.sizes[j].count += count;
+    }
 
-    result = vkCreateDescriptorPool(m_device, &poolinfo, nullptr, &m_box.dpool);
+    m_descriptors = DescriptorAllocator::Init(m_device, &ci);
+    if (m_descriptors == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
 
-    return result;
+    return VK_SUCCESS;
 }
 
+/*
+* One entry for each binding the shaders declare that BoxDescriptors has a
+* member for.  Which is all of them, bar the bindless texture table.
+*/
+VkResult Renderer::create_descriptor_writer(void)
+{
+    PROFILE_ZONE("Renderer::create_descriptor_writer");
+
+    struct Member {
+        uint32_t binding;
+        VkDescriptorType type;
+        size_t offset;
+        size_t size;
+    };
+    static const Member members[] = {
+        { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+          offsetof(BoxDescriptors, camera), sizeof(VkDescriptorBufferInfo) },
+        { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          offsetof(BoxDescriptors, texture), sizeof(VkDescriptorImageInfo) }
+    };
+    const size_t member_count = sizeof(members) / sizeof(members[0]);
+
+    std::vector<DescriptorWriter::Entry> entries;
+    const std::vector<ShaderInterface::Binding>& declared =
+      m_pipeline.iface.bindings;
+    for (size_t i = 0; i < declared.size(); i++) {
+        if (declared[i].count == 0) {
+            continue;
+        }
+
+        size_t j = 0;
+        while (j < member_count && members[j].binding != declared[i].binding) {
+            j++;
+        }
+        if (j == member_count || members[j].type != declared[i].type ||
+          declared[i].count != 1) {
+            Log::Write(Log::SEVERE, "Renderer::create_descriptor_writer -> "
+              "nothing to put in binding {}.", declared[i].binding);
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+
+        DescriptorWriter::Entry e = {};
+        e.binding = declared[i].binding;
+        e.count = declared[i].count;
+        e.type = declared[i].type;
+        e.offset = members[j].offset;
+        e.stride = members[j].size;
+        entries.push_back(e);
+    }
+
+    m_boxwriter = DescriptorWriter::Init(m_device, m_box.dslayout, entries,
+      m_gpu.update_templates);
+    if (m_boxwriter->UsesTemplate()) {
+        Log::Write(Log::ROUTINE, "Renderer::create_descriptor_writer -> "
+          "writing sets through an update template.");
+    }
+
+    return VK_SUCCESS;
+}
+
+/*
+* Set 0, as the shaders declare it.  The one runtime sized array, the
+* bindless texture table, gets as many slots as the device allows.
+*/
 VkResult Renderer::create_descriptorset_layout(void)
 {
-    VkResult result = VK_SUCCESS;
+    PROFILE_ZONE("Renderer::create_descriptorset_layout");
 
-    VkDescriptorSetLayoutBinding sampler_layout_binding = {};
-    sampler_layout_binding.binding = 1;
-    sampler_layout_binding.descriptorCount = 1;
-    sampler_layout_binding.descriptorType =
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    sampler_layout_binding.pImmutableSamplers = nullptr;
-    sampler_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    VkResult result = VK_SUCCESS;
 
-    VkDescriptorSetLayoutBinding ubo_layout_binding = {};
-    ubo_layout_binding.binding = 0;
-    ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    ubo_layout_binding.descriptorCount = 1;
-    ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    ubo_layout_binding.pImmutableSamplers = nullptr;
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    std::vector<VkFlags> binding_flags;
+    bool unbounded = false;
+
+    const std::vector<ShaderInterface::Binding>& declared =
+      m_pipeline.iface.bindings;
+    for (size_t i = 0; i < declared.size(); i++) {
+        if (declared[i].set != 0 ||
+          (declared[i].count == 0 && !m_gpu.bindless)) {
+            Log::Write(Log::SEVERE, "Renderer::create_descriptorset_layout "
+              "-> the shaders want set {} binding {}, which vktest doesn't "
+              "provide.", declared[i].set, declared[i].binding);
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
 
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings =
-      { ubo_layout_binding, sampler_layout_binding };
+        VkDescriptorSetLayoutBinding lb = {};
+        lb.binding = declared[i].binding;
+        lb.descriptorType = declared[i].type;
+        lb.descriptorCount = declared[i].count != 0 ? declared[i].count :
+          m_gpu.max_textures;
+        lb.stageFlags = declared[i].stages;
+        lb.pImmutableSamplers = nullptr;
+        bindings.push_back(lb);
+
+        binding_flags.push_back(0);
+        unbounded = unbounded || declared[i].count == 0;
+    }
 
     VkDescriptorSetLayoutCreateInfo li = {};
     li.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     li.bindingCount = bindings.size();
     li.pBindings = bindings.data();
 
-    result = vkCreateDescriptorSetLayout(m_device, &li, nullptr,
-      &m_box.dslayout);
-    if (result) {
-        return result;
+#if defined(VK_EXT_descriptor_indexing)
+    /*
+    * In bindless mode the sampler array doesn't have to be full, and slots
+    * can be rewritten after the set is bound in a recorded command buffer.
+    */
+    for (size_t i = 0; i < declared.size(); i++) {
+        if (declared[i].count == 0) {
+            binding_flags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+              VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+        }
     }
 
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bfci = {};
+    bfci.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bfci.bindingCount = binding_flags.size();
+    bfci.pBindingFlags = binding_flags.data();
+
+    if (unbounded) {
+        li.flags =
+          VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        li.pNext = &bfci;
+    }
+#else
+    (void)unbounded;
+#endif
+
+    result = m_descriptors->GetLayout(&li, &m_box.dslayout);
+
     return result;
 }
 
+VkResult Renderer::create_pipeline_layout(void)
+{
+    PROFILE_ZONE("Renderer::create_pipeline_layout");
+
+    /* record_cmdbuffer() pushes an ObjectData; there's nothing more. */
+    VkPushConstantRange pcr = m_pipeline.iface.push;
+    if (pcr.offset + pcr.size > sizeof(ObjectData)) {
+        Log::Write(Log::SEVERE, "Renderer::create_pipeline_layout -> the "
+          "shaders want {} bytes of push constants, there are only {}.",
+          pcr.offset + pcr.size, sizeof(ObjectData));
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkDescriptorSetLayout set_layouts[] = { m_box.dslayout };
+
+    VkPipelineLayoutCreateInfo plci = {};
+    plci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    plci.setLayoutCount = 1;
+    plci.pSetLayouts = set_layouts;
+    plci.pushConstantRangeCount = pcr.size != 0 ? 1 : 0;
+    plci.pPushConstantRanges = &pcr;
+
+    return m_descriptors->GetPipelineLayout(&plci, &m_pipeline.layout);
+}
+
 VkResult Renderer::create_sampler(void)
 {
+    PROFILE_ZONE("Renderer::create_sampler");
+
     VkSamplerCreateInfo ci = {};
     ci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
     ci.magFilter = VK_FILTER_LINEAR;
@@ -432,86 +1109,511 @@ VkResult Renderer::create_sampler(void)
     ci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     ci.mipLodBias = 0.0f;
     ci.minLod = 0.0f;
-    ci.maxLod = 0.0f;
+    ci.maxLod = VK_LOD_CLAMP_NONE;
+
+    ResourceRegistry::Sampler sampler = {};
+    VkResult result = vkCreateSampler(m_device, &ci, nullptr,
+      &sampler.sampler);
+    if (result) {
+        return result;
+    }
 
-    return vkCreateSampler(m_device, &ci, nullptr, &m_texture.sampler);
+    m_sampler = m_registry->Add(sampler);
+    return result;
 }
 
 VkResult Renderer::create_texture(void)
 {
+    PROFILE_ZONE("Renderer::create_texture");
+
     VkResult result = VK_SUCCESS;
-    STBImage img;
 
-    if (!ReadImage(&img, "./textures/bitcoin.png")) {
-        return VK_ERROR_FEATURE_NOT_PRESENT;
+    /*
+    * A small grey checkerboard stands in for every texture that hasn't
+    * finished streaming in yet.  It's built right here, so there's no
+    * file I/O standing between us and the first frame.
+    */
+    const uint32_t size = 8;
+    MipImage checker;
+    checker.format = MipImage::RGBA8;
+    checker.srgb = false;
+    MipImageLayout(&checker, size, size, 1);
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            unsigned char shade = ((x ^ y) & 1) ? 0x60 : 0xa0;
+            unsigned char* px = &checker.data[(y * size + x) * 4];
+            px[0] = shade;
+            px[1] = shade;
+            px[2] = shade;
+            px[3] = 0xff;
+        }
+    }
+
+    result = upload_texture(&checker, &m_placeholder);
+    if (result) {
+        return result;
+    }
+
+    /* Prefer the cooked copy when vktest-cook has produced one. */
+    std::string path = "./textures/bitcoin.dds";
+    AssetPack::Span span;
+    if (!(m_pack != nullptr && m_pack->Find(path, &span)) &&
+      !std::ifstream(path.c_str()).good()) {
+        path = "./textures/bitcoin.png";
+    }
+
+    /*
+    * Every copy is a separate request, and so a separate texture as far
+    * as the streamer and the GPU are concerned.  Without bindless only the
+    * first one is ever bound.
+    */
+    for (uint32_t i = 0; i < m_cinfo.textures; i++) {
+        m_box.textures.push_back(m_streamer->Request(path, 0));
+    }
+    m_box.texture = m_box.textures[0];
+
+    if (m_gpu.bindless) {
+        /* Hand out low slots first; 0 belongs to the placeholder. */
+        for (uint32_t i = m_gpu.max_textures - 1; i > 0; i--) {
+            m_free_slots.push_back(i);
+        }
+
+        for (size_t i = 0; i < m_box.textures.size(); i++) {
+            InstanceData box = {};
+            box.texture = acquire_slot(m_box.textures[i]);
+            m_box.instances.push_back(box);
+        }
+    }
+
+    return result;
+}
+
+AssetPack::Span Renderer::load_asset(std::string path,
+  std::vector<char>* storage)
+{
+    AssetPack::Span span;
+    if (m_pack != nullptr && m_pack->Find(path, &span)) {
+        m_pack->Prefetch(span);
+        return span;
     }
 
-    VkDeviceSize img_size = img.width * img.height * 4;
-    VkImage staging_image;
-    VkDeviceMemory staging_memory;
+    storage[0] = ReadFile(path);
+    span.data = reinterpret_cast<const unsigned char*>(storage->data());
+    span.size = storage->size();
+
+    return span;
+}
+
+/*
+* Both pipelines' shaders get loaded, since which one create_pipeline()
+* wants depends on the device, and this runs before there is one.  They're
+* normally compiled in (see shaderlib.h), which costs no I/O at all; the
+* pack and the loose files are for builds made without a shader compiler.
+* Anything that isn't anywhere is skipped here; find_shader() complains
+* about it if it turns out to be needed.
+*/
+VkResult Renderer::load_shaders(void)
+{
+    PROFILE_ZONE("Renderer::load_shaders");
+
+    const char* paths[] = {
+        "./shaders/test.vert.spv",
+        "./shaders/test.frag.spv",
+        "./shaders/bindless.vert.spv",
+        "./shaders/bindless.frag.spv"
+    };
+    size_t count = sizeof(paths) / sizeof(paths[0]);
+    if (m_cinfo.flags & NO_BINDLESS) {
+        count = 2;
+    }
+
+    size_t embedded = 0;
+    for (size_t i = 0; i < count; i++) {
+        AssetPack::Span span;
+        if (ShaderLibrary::Find(ShaderLibrary::NameOf(paths[i]), &span)) {
+            m_shaders[paths[i]].span = span;
+            embedded++;
+            continue;
+        }
+
+        bool packed = m_pack != nullptr && m_pack->Find(paths[i], &span);
+        if (!packed && !std::ifstream(paths[i]).good()) {
+            continue;
+        }
+
+        ShaderCode* code = &m_shaders[paths[i]];
+        code->span = load_asset(paths[i], &code->storage);
+    }
 
-    result = create_image(img.width, img.height, VK_FORMAT_R8G8B8A8_UNORM,
-      VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+    if (embedded < count) {
+        Log::Write(Log::WARNING, "Renderer -> {} of {} shaders aren't "
+          "compiled in, so they come off the disk.", count - embedded,
+          count);
+    }
+
+    return VK_SUCCESS;
+}
+
+AssetPack::Span Renderer::find_shader(std::string path)
+{
+    std::map<std::string, ShaderCode>::iterator it = m_shaders.find(path);
+    if (it != m_shaders.end()) {
+        return it->second.span;
+    }
+
+    ShaderCode* code = &m_shaders[path];
+    if (!ShaderLibrary::Find(ShaderLibrary::NameOf(path), &code->span)) {
+        code->span = load_asset(path, &code->storage);
+    }
+
+    return code->span;
+}
+
+static VkFormat texture_format(const MipImage* img)
+{
+    switch (img->format) {
+    case MipImage::BC1:
+        return img->srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK :
+          VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case MipImage::BC3:
+        return img->srgb ? VK_FORMAT_BC3_SRGB_BLOCK :
+          VK_FORMAT_BC3_UNORM_BLOCK;
+    case MipImage::BC7:
+        return img->srgb ? VK_FORMAT_BC7_SRGB_BLOCK :
+          VK_FORMAT_BC7_UNORM_BLOCK;
+    default:
+        return img->srgb ? VK_FORMAT_R8G8B8A8_SRGB :
+          VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+VkResult Renderer::upload_texture(const MipImage* img, ImageHandle* out)
+{
+    VkResult result = VK_SUCCESS;
+    ResourceRegistry::Image texture = {};
+
+    VkFormat format = texture_format(img);
+    VkDeviceSize img_size = MipImageSize(img);
+    uint32_t levels = static_cast<uint32_t>(img->levels.size());
+
+    VkBuffer staging_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory staging_memory = VK_NULL_HANDLE;
+
+    /*
+    * Every way out goes through here.  The staging buffer always goes, and
+    * on an error so does whatever of the texture got made; the
+    * DeletionQueue holds on to it all until any copy that did get
+    * submitted is done.
+    */
+    auto cleanup = [&](VkResult ret) {
+        if (staging_buffer != VK_NULL_HANDLE) {
+            m_deletions->DestroyBuffer(staging_buffer);
+        }
+        if (staging_memory != VK_NULL_HANDLE) {
+            m_deletions->FreeMemory(staging_memory);
+        }
+        if (ret == VK_SUCCESS) {
+            return ret;
+        }
+
+        if (texture.view != VK_NULL_HANDLE) {
+            m_deletions->DestroyImageView(texture.view);
+        }
+        if (texture.image != VK_NULL_HANDLE) {
+            m_deletions->DestroyImage(texture.image);
+        }
+        if (texture.memory != VK_NULL_HANDLE) {
+            m_deletions->FreeMemory(texture.memory);
+        }
+        return ret;
+    };
+
+    /*
+    * Every level sits in one staging buffer and goes over with one copy
+    * region apiece.  Compressed blocks are copied as-is, so a BC texture
+    * never exists as RGBA8 anywhere on the way to the GPU.
+    */
+    result = create_buffer(img_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_image, &staging_memory);
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer,
+      &staging_memory);
     if (result) {
-        return result;
+        return cleanup(result);
     }
 
     void* data = nullptr;
     vkMapMemory(m_device, staging_memory, 0, img_size, 0, &data);
-    std::memcpy(data, img.data, (size_t)img_size);
+    std::memcpy(data, MipImageBytes(img), (size_t)img_size);
     vkUnmapMemory(m_device, staging_memory);
 
-    result = create_image(img.width, img.height, VK_FORMAT_R8G8B8A8_UNORM,
+    /* A DDS viewed straight out of the pack is read this once. */
+    if (m_pack != nullptr && img->view != nullptr) {
+        AssetPack::Span span = { img->view, (size_t)img_size };
+        m_pack->Done(span);
+    }
+
+    result = create_image(img->width, img->height, format,
       VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT |
       VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-      &m_texture.image, &m_texture.memory);
+      &texture.image, &texture.memory, levels);
     if (result) {
-        return result;
+        return cleanup(result);
     }
 
-    result = transition_image_layout(staging_image,
+    result = transition_image_layout(texture.image,
       VK_IMAGE_LAYOUT_PREINITIALIZED,
-      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levels);
     if (result) {
-        return result;
+        return cleanup(result);
     }
 
-    result = transition_image_layout(m_texture.image,
-      VK_IMAGE_LAYOUT_PREINITIALIZED,
-      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    std::vector<VkBufferImageCopy> regions(levels);
+    for (uint32_t i = 0; i < levels; i++) {
+        VkBufferImageCopy& region = regions[i];
+        region = {};
+        region.bufferOffset = img->levels[i].offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent.width = img->levels[i].width;
+        region.imageExtent.height = img->levels[i].height;
+        region.imageExtent.depth = 1;
+    }
+
+    /* Spelled out rather than Utility::CopyBufferToImage for the scope. */
+    VkCommandBuffer cbuff;
+    result = Utility::BufferSingleUseBegin(m_device, m_cmdpool, &cbuff);
     if (result) {
-        return result;
+        return cleanup(result);
     }
 
-    VkExtent2D extent;
-    extent.width = static_cast<uint32_t>(img.width);
-    extent.height = static_cast<uint32_t>(img.height);
-    result = Utility::CopyImage(m_device, staging_image, m_texture.image,
-      extent, m_cmdpool, m_renderqueue);
+    uint32_t scope = m_gpuprof->Begin(cbuff, "upload");
+    vkCmdCopyBufferToImage(cbuff, staging_buffer, texture.image,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levels, regions.data());
+    m_gpuprof->End(cbuff, scope);
+
+    result = Utility::BufferSingleUseEnd(m_device, m_scheduler, m_cmdpool,
+      cbuff);
     if (result) {
-        Log::Write(Log::SEVERE, "Renderer::create_texture -> Call to "
-          "Utility::CopyImage failed.");
-        return result;
+        Log::Write(Log::SEVERE, "Renderer::upload_texture -> Call to "
+          "Utility::BufferSingleUseEnd failed.");
+        return cleanup(result);
     }
 
-    result = transition_image_layout(m_texture.image,
+    result = transition_image_layout(texture.image,
       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levels);
     if (result) {
-        return result;
+        return cleanup(result);
     }
 
-    ReleaseImage(&img);
-    vkDestroyImage(m_device, staging_image, nullptr);
-    vkFreeMemory(m_device, staging_memory, nullptr);
+    result = create_imageview(texture.image, format,
+      VK_IMAGE_ASPECT_COLOR_BIT, &texture.view, levels);
+    if (result) {
+        return cleanup(result);
+    }
+
+    *out = m_registry->Add(texture);
+    if (out->bits == 0) {
+        Log::Write(Log::SEVERE, "Renderer::upload_texture -> the registry "
+          "is out of image slots.");
+        return cleanup(VK_ERROR_OUT_OF_HOST_MEMORY);
+    }
+
+    return cleanup(VK_SUCCESS);
+}
+
+Renderer::ImageHandle Renderer::find_texture(TextureStreamer::Handle handle)
+{
+    std::map<TextureStreamer::Handle, ImageHandle>::iterator it =
+      m_textures.find(handle);
+    if (it == m_textures.end()) {
+        return m_placeholder;
+    }
+
+    return it->second;
+}
+
+/*
+* Marks everything the frame just submitted can sample with its value.  In
+* bindless mode that's the whole table, since any instance can pick any
+* slot.
+*/
+void Renderer::stamp_textures(uint64_t value)
+{
+    if (!m_gpu.bindless) {
+        m_registry->Touch(find_texture(m_box.texture), value);
+        return;
+    }
+
+    m_registry->Touch(m_placeholder, value);
+    std::map<TextureStreamer::Handle, uint32_t>::iterator it;
+    for (it = m_slots.begin(); it != m_slots.end(); ++it) {
+        m_registry->Touch(find_texture(it->first), value);
+    }
+}
+
+VkResult Renderer::stream_textures(void)
+{
+    VkResult result = VK_SUCCESS;
+    bool rebind = false;
+
+    /*
+    * Each upload still goes through the single-use command buffer path,
+    * which waits on the queue.  Capping the number of uploads per frame
+    * keeps a burst of finished decodes from turning into a visible hitch.
+    */
+    for (uint32_t i = 0; i < RENDERER_STREAM_UPLOADS_PER_FRAME; i++) {
+        TextureStreamer::Handle handle;
+        MipImage img;
+        if (!m_streamer->PopDecoded(&handle, &img)) {
+            break;
+        }
+
+        if (img.levels.empty()) {
+            Log::Write(Log::WARNING, "Renderer::stream_textures -> texture "
+              "{} failed to decode, keeping the placeholder.", handle);
+
+            /*
+            * Point its users at slot 0 and let somebody else have it.  A
+            * handle that never got a slot of its own is already there.
+            */
+            std::map<TextureStreamer::Handle, uint32_t>::iterator it =
+              m_slots.find(handle);
+            if (m_gpu.bindless && it != m_slots.end() && it->second != 0) {
+                uint32_t slot = it->second;
+                release_slot(handle);
+                for (size_t j = 0; j < m_box.instances.size(); j++) {
+                    if (m_box.instances[j].texture == slot) {
+                        m_box.instances[j].texture = 0;
+                    }
+                }
+
+                result = write_instances();
+                if (result) {
+                    return result;
+                }
+            }
+            continue;
+        }
+
+        ImageHandle texture = {};
+        result = upload_texture(&img, &texture);
+        if (result) {
+            return result;
+        }
+
+        /*
+        * A handle delivered twice swaps its old copy out, which the
+        * registry holds on to until the last frame to sample it is done.
+        * The cached sets that point at it are forgotten now, before its
+        * view's handle value can come round again.
+        */
+        std::map<TextureStreamer::Handle, ImageHandle>::iterator old =
+          m_textures.find(handle);
+        if (old != m_textures.end()) {
+            ResourceRegistry::Image image = {};
+            if (m_registry->Get(old->second, &image)) {
+                m_descriptors->Forget(image.view);
+            }
+            m_registry->Destroy(old->second);
+        }
+
+        m_textures[handle] = texture;
+        m_streamer->MarkResident(handle);
+
+        if (m_gpu.bindless) {
+            std::map<TextureStreamer::Handle, uint32_t>::iterator it =
+              m_slots.find(handle);
+            if (it != m_slots.end()) {
+                write_slot(it->second, texture);
+            }
+        } else if (handle == m_box.texture) {
+            rebind = true;
+        }
+    }
+
+    if (rebind) {
+        result = update_texture_descriptor();
+    }
 
     return result;
 }
 
+uint32_t Renderer::acquire_slot(TextureStreamer::Handle handle)
+{
+    if (m_free_slots.empty()) {
+        Log::Write(Log::WARNING, "Renderer::acquire_slot -> out of bindless "
+          "texture slots, sharing the placeholder's.");
+        return 0;
+    }
+
+    uint32_t slot = m_free_slots.back();
+    m_free_slots.pop_back();
+    m_slots[handle] = slot;
+
+    return slot;
+}
+
+void Renderer::release_slot(TextureStreamer::Handle handle)
+{
+    std::map<TextureStreamer::Handle, uint32_t>::iterator it =
+      m_slots.find(handle);
+    if (it == m_slots.end()) {
+        return;
+    }
+
+    /*
+    * Never leave a stale view behind in a slot that's up for grabs, and
+    * never give away the placeholder's own.
+    */
+    if (it->second != 0) {
+        write_slot(it->second, m_placeholder);
+        m_free_slots.push_back(it->second);
+    }
+    m_slots.erase(it);
+}
+
+void Renderer::write_slot(uint32_t slot, ImageHandle image)
+{
+    ResourceRegistry::Image texture = {};
+    ResourceRegistry::Sampler sampler = {};
+    m_registry->Get(image, &texture);
+    m_registry->Get(m_sampler, &sampler);
+
+    VkDescriptorImageInfo ii = {};
+    ii.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    ii.imageView = texture.view;
+    ii.sampler = sampler.sampler;
+
+    VkWriteDescriptorSet dw = {};
+    dw.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    dw.dstSet = m_box.dset;
+    dw.dstBinding = 1;
+    dw.dstArrayElement = slot;
+    dw.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    dw.descriptorCount = 1;
+    dw.pImageInfo = &ii;
+
+    /*
+    * The binding is update-after-bind, and Render() waits for every frame
+    * it submits, so this is safe with the command buffers left as they are.
+    */
+    vkUpdateDescriptorSets(m_device, 1, &dw, 0, nullptr);
+}
+
+VkResult Renderer::update_texture_descriptor(void)
+{
+    /* Picked up by the next record_cmdbuffer(). */
+    return create_descriptorset();
+}
+
 VkResult Renderer::create_imageview(VkImage image, VkFormat format,
-  VkImageAspectFlags aflags, VkImageView* view)
+  VkImageAspectFlags aflags, VkImageView* view, uint32_t levels)
 {
     VkImageViewCreateInfo ci = {};
     ci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -520,48 +1622,136 @@ VkResult Renderer::create_imageview(VkImage image, VkFormat format,
     ci.format = format;
     ci.subresourceRange.aspectMask = aflags;
     ci.subresourceRange.baseMipLevel = 0;
-    ci.subresourceRange.levelCount = 1;
+    ci.subresourceRange.levelCount = levels;
     ci.subresourceRange.baseArrayLayer = 0;
     ci.subresourceRange.layerCount = 1;
 
     return vkCreateImageView(m_device, &ci, nullptr, view);
 }
 
-VkResult Renderer::create_textureimageview(void)
+VkResult Renderer::update_camera(void)
 {
-    VkResult result = VK_SUCCESS;
+    VkExtent2D extent;
+    m_swapchain->GetExtent(&extent);
+    float ratio = static_cast<float>(extent.width) /
+      static_cast<float>(extent.height);
+
+    glm::mat4 view = glm::lookAt(m_camera.eye, m_camera.target,
+      m_camera.up);
+    glm::mat4 proj = glm::perspective(m_camera.fov, ratio, 0.1f, 10.0f);
+    proj[1][1] *= -1;       // y-axis is opposite of OpenGL in Vulkan.
+
+    CameraData camera = {};
+    camera.view_proj = proj * view;
 
-    result = create_imageview(m_texture.image, VK_FORMAT_R8G8B8A8_UNORM,
-      VK_IMAGE_ASPECT_COLOR_BIT, &m_texture.view);
+    ResourceRegistry::Buffer staging = {};
+    ResourceRegistry::Buffer uniform = {};
+    if (!m_registry->Get(m_box.usbuffer, &staging) ||
+      !m_registry->Get(m_box.ubuffer, &uniform)) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    void* data = nullptr;
+    VkResult result = vkMapMemory(m_device, staging.memory, 0,
+      sizeof(camera), 0, &data);
     if (result) {
         return result;
     }
+    std::memcpy(data, &camera, sizeof(camera));
+    vkUnmapMemory(m_device, staging.memory);
+
+    result = Utility::CopyBuffer(m_device, staging.buffer, uniform.buffer,
+      sizeof(camera), m_cmdpool, m_scheduler);
+    if (result == VK_SUCCESS) {
+        m_camera.dirty = false;
+    }
 
     return result;
 }
 
+double Renderer::clock_ms(uint64_t from, uint64_t to) const
+{
+    return static_cast<double>(to - from) * m_clock.ms_per_tick;
+}
+
+void Renderer::startup_stage(const char* name, uint64_t* since)
+{
+    uint64_t now = Timer::Ticks();
+    StartupStage stage = { name, clock_ms(*since, now) };
+    m_startup.push_back(stage);
+    *since = now;
+}
+
 VkResult Renderer::create_uniformbuffer(void)
 {
+    PROFILE_ZONE("Renderer::create_uniformbuffer");
+
     VkResult result = VK_SUCCESS;
-    VkDeviceSize buffersize = sizeof(UniformBufferObject);
+    VkDeviceSize buffersize = sizeof(CameraData);
 
     result = create_buffer(buffersize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &m_box.usbuffer,
-      &m_box.usbuffermem);
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &m_box.usbuffer);
     if (result) {
         return result;
     }
 
     result = create_buffer(buffersize, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-      &m_box.ubuffer, &m_box.ubuffermem);
+      &m_box.ubuffer);
 
     return result;
 }
 
-VkResult Renderer::create_vertexbuffer(void)
+VkResult Renderer::create_instancebuffer(void)
 {
+    PROFILE_ZONE("Renderer::create_instancebuffer");
+
+    if (!m_gpu.bindless) {
+        return VK_SUCCESS;
+    }
+
+    /*
+    * Small and rewritten whenever an instance changes texture, so it just
+    * lives in host visible memory.
+    */
+    VkResult result = create_buffer(
+      sizeof(InstanceData) * m_box.instances.size(),
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &m_box.instbuffer);
+    if (result) {
+        return result;
+    }
+
+    return write_instances();
+}
+
+VkResult Renderer::write_instances(void)
+{
+    VkDeviceSize size = sizeof(InstanceData) * m_box.instances.size();
+
+    ResourceRegistry::Buffer buffer = {};
+    if (!m_registry->Get(m_box.instbuffer, &buffer)) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    void* data = nullptr;
+    VkResult result = vkMapMemory(m_device, buffer.memory, 0, size, 0,
+      &data);
+    if (result) {
+        return result;
+    }
+
+    std::memcpy(data, m_box.instances.data(), (size_t)size);
+    vkUnmapMemory(m_device, buffer.memory);
+
+    return result;
+}
+
+VkResult Renderer::create_vertexbuffer(BufferHandle* out)
+{
+    PROFILE_ZONE("Renderer::create_vertexbuffer");
+
     VkResult result = VK_SUCCESS;
 
     m_box.vertices = {
@@ -598,17 +1788,20 @@ VkResult Renderer::create_vertexbuffer(void)
 
     result = create_buffer(buffersize, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-      &m_box.vbuffer, &m_box.vbuffermem);
+      out);
     if (result) {
         return result;
     }
 
-    result = Utility::CopyBuffer(m_device, stagingbuffer, m_box.vbuffer,
-      buffersize, m_cmdpool, m_renderqueue);
+    ResourceRegistry::Buffer vbuffer = {};
+    m_registry->Get(*out, &vbuffer);
+    result = Utility::CopyBuffer(m_device, stagingbuffer, vbuffer.buffer,
+      buffersize, m_cmdpool, m_scheduler);
     if (result) {
         return result;
     }
 
+    FlightRecorder::Record(FLIGHT_FREE, (uint64_t)stagingbuffermemory);
     vkFreeMemory(m_device, stagingbuffermemory, nullptr);
     vkDestroyBuffer(m_device, stagingbuffer, nullptr);
 
@@ -617,7 +1810,8 @@ VkResult Renderer::create_vertexbuffer(void)
 
 VkResult Renderer::create_image(uint32_t w, uint32_t h, VkFormat fmt,
   VkImageTiling tiling, VkImageUsageFlags usage,
-  VkMemoryPropertyFlags properties, VkImage* image, VkDeviceMemory* mem)
+  VkMemoryPropertyFlags properties, VkImage* image, VkDeviceMemory* mem,
+  uint32_t levels)
 {
     VkResult result = VK_SUCCESS;
 
@@ -627,7 +1821,7 @@ VkResult Renderer::create_image(uint32_t w, uint32_t h, VkFormat fmt,
     image_info.extent.width = w;
     image_info.extent.height = h;
     image_info.extent.depth = 1;
-    image_info.mipLevels = 1;
+    image_info.mipLevels = levels;
     image_info.arrayLayers = 1;
     image_info.format = fmt;
     image_info.tiling = tiling;
@@ -654,13 +1848,17 @@ VkResult Renderer::create_image(uint32_t w, uint32_t h, VkFormat fmt,
     if (result) {
         return result;
     }
+    FlightRecorder::Record(FLIGHT_ALLOC, (uint64_t)*mem,
+      alloc_info.allocationSize, alloc_info.memoryTypeIndex);
 
     vkBindImageMemory(m_device, *image, *mem, 0);
     return VK_SUCCESS;
 }
 
-VkResult Renderer::create_indexbuffer(void)
+VkResult Renderer::create_indexbuffer(BufferHandle* out)
 {
+    PROFILE_ZONE("Renderer::create_indexbuffer");
+
     VkResult result = VK_SUCCESS;
 
     m_box.indices = {
@@ -686,13 +1884,16 @@ VkResult Renderer::create_indexbuffer(void)
 
     result = create_buffer(bsize, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
       VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-      &m_box.ibuffer, &m_box.ibuffermem);
-    Assert(result, "create_buffer: m_ibuffer and m_ibuffermem", m_window);
+      out);
+    Assert(result, "create_buffer: index buffer", m_window);
 
-    result = Utility::CopyBuffer(m_device, stagingbuffer, m_box.ibuffer, bsize,
-      m_cmdpool, m_renderqueue);
+    ResourceRegistry::Buffer ibuffer = {};
+    m_registry->Get(*out, &ibuffer);
+    result = Utility::CopyBuffer(m_device, stagingbuffer, ibuffer.buffer,
+      bsize, m_cmdpool, m_scheduler);
     Assert(result, "Utility::CopyBuffer -> stagingbuffer to m_ibuffer");
 
+    FlightRecorder::Record(FLIGHT_FREE, (uint64_t)stagingbuffermemory);
     vkFreeMemory(m_device, stagingbuffermemory, nullptr);
     vkDestroyBuffer(m_device, stagingbuffer, nullptr);
 
@@ -760,7 +1961,7 @@ VkResult Renderer::find_supported_format(VkPhysicalDevice gpu,
 }
 
 VkResult Renderer::transition_image_layout(VkImage img, VkImageLayout old,
-  VkImageLayout _new)
+  VkImageLayout _new, uint32_t levels)
 {
     VkResult result = VK_SUCCESS;
 
@@ -781,7 +1982,7 @@ VkResult Renderer::transition_image_layout(VkImage img, VkImageLayout old,
     barrier.image = img;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = levels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
@@ -815,7 +2016,7 @@ VkResult Renderer::transition_image_layout(VkImage img, VkImageLayout old,
     vkCmdPipelineBarrier(cbuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
       0, nullptr, 0, nullptr, 1, &barrier);
-    result = Utility::BufferSingleUseEnd(m_device, m_renderqueue, m_cmdpool,
+    result = Utility::BufferSingleUseEnd(m_device, m_scheduler, m_cmdpool,
       cbuff);
     if (result) {
         Log::Write(Log::SEVERE, "transition_image_layout -> Call to "
@@ -1,12 +1,19 @@
 #ifndef VKATTEMPT_RENDERER_H
 #define VKATTEMPT_RENDERER_H
 
+#include <cstddef>
 #include <cstring>
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
 #include <queue>
 #include <string>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 #ifdef __linux__
@@ -31,8 +38,74 @@
 #define RENDERER_DEFAULT_HEIGHT     (600)
 #define RENDERER_WINDOW_NAME        ("Vulkan Renderer")
 
+/* How many streamed textures may be pushed to the GPU in a single frame. */
+#define RENDERER_STREAM_UPLOADS_PER_FRAME   (4)
+
+/*
+* Upper bound on the bindless sampler array.  The real size is whichever is
+* smaller, this or what the device says it can do.  Slot 0 always holds the
+* placeholder texture.
+*/
+#define RENDERER_BINDLESS_TEXTURES  (4096)
+
+/*
+* Descriptor pools are chained on as they fill up, this many sets apiece.
+* In bindless mode each set carries the whole texture array, so there it's
+* one set per pool instead.
+*/
+#define RENDERER_DESCRIPTOR_SETS_PER_POOL   (64)
+
+/*
+* GPU timestamps are read back this many frames after they're written, and
+* no frame may open more scopes than this.
+*/
+#define RENDERER_PROFILER_FRAMES    (3)
+#define RENDERER_PROFILER_SCOPES    (64)
+
+/* Frame budget when the display doesn't say what its refresh rate is. */
+#define RENDERER_DEFAULT_REFRESH    (60)
+
+/* Built by vktest-cook.  Loose files are used for anything not in it. */
+#define RENDERER_ASSET_PACK         ("./assets.vpk")
+
+/*
+* Whatever the driver compiled last run, handed back to it at startup so
+* pipelines it has seen before come out of its cache.
+*/
+#define RENDERER_PIPELINE_CACHE     ("./pipeline.cache")
+
+/* Init() never has more than this much independent work in flight. */
+#define RENDERER_STARTUP_THREADS    (3)
+
+/* Objects per job when Update() spreads the transforms over m_jobs. */
+#define RENDERER_TRANSFORM_GRAIN    (256)
+
+/*
+* Shader hot reload looks for changes in here this often, and then waits a
+* little for whatever wrote one file to write the rest.
+*/
+#define RENDERER_SHADER_DIR         ("./shaders")
+#define RENDERER_RELOAD_POLL_MS     (100)
+#define RENDERER_RELOAD_SETTLE_MS   (50)
+
+#include "cpuprofiler.h"
+#include "deletion.h"
+#include "descriptors.h"
+#include "dirwatch.h"
+#include "flightrec.h"
+#include "framestats.h"
 #include "global.h"
+#include "gpuprofiler.h"
+#include "jobs.h"
+#include "pack.h"
+#include "pipelines.h"
+#include "registry.h"
+#include "scheduler.h"
+#include "shaderlib.h"
+#include "spirv.h"
 #include "swapchain.h"
+#include "taskgraph.h"
+#include "texstream.h"
 #include "utility.h"
 
 class Renderer {
@@ -42,13 +115,44 @@ public:
         FULLSCREEN  = 0x01,
         RESIZABLE   = 0x02,
         VSYNC_ON    = 0x04,
-        FPS_ON      = 0x08
+        FPS_ON      = 0x08,
+        NO_BINDLESS = 0x10,
+        HOT_RELOAD  = 0x20,
+        NO_TIMELINE = 0x40
     };
 
     struct CreateInfo {
         uint16_t width, height;
         Flags flags;
         int dlevel;
+        const char* gpu_trace;      // Chrome trace written on Release
+        uint32_t objects;           // boxes drawn, laid out on a grid
+        uint32_t textures;          // textures streamed in and sampled
+        const char* material;       // the box's, "textured" if null
+
+        /* Pipeline variants to build in the background from the start. */
+        const PipelineState* precompile;
+        uint32_t precompile_count;
+    };
+
+    /*
+    * How long a step of Init() took.  Most of them run alongside each
+    * other, so these add up to more than the time Init() took.
+    */
+    struct StartupStage {
+        const char* name;
+        double ms;
+    };
+
+    /* Everything a benchmark report wants to say about the renderer. */
+    struct Info {
+        VkPhysicalDeviceProperties properties;
+        bool bindless;
+        uint32_t objects;
+        uint32_t textures;
+        TextureStreamer::Stats streaming;
+        ResourceRegistry::Stats resources;
+        std::vector<StartupStage> startup;
     };
 
     /* static initializers so I can have a bit more control */
@@ -61,6 +165,14 @@ public:
     void Render(void);
     void Update(double elapsed);
 
+    /* Frame timing histograms since Init(), or the last reset. */
+    const FrameStats* GetFrameStats(void) const;
+    void ResetFrameStats(void);
+
+    void GetInfo(Info* out);
+    /* Every requested texture is resident, or has failed to load. */
+    bool StreamingIdle(void);
+
 private:
     SDL_Window* m_window;
     std::queue<SDL_WindowEvent> m_events;
@@ -70,6 +182,20 @@ private:
         double last;
     } m_fpsinfo;
 
+    /*
+    * Performance counter readings for the frame in flight.  A frame starts
+    * at the top of Update() and ends after Render() presents.
+    */
+    FrameStats* m_framestats;
+    struct FrameClock {
+        double ms_per_tick;
+        uint64_t begin;
+        uint64_t last_end;
+        uint64_t frame;         // for the flight recorder
+    } m_clock;
+
+    std::vector<StartupStage> m_startup;
+
     VkInstance m_instance;
     VkDevice m_device;
     VkSurfaceKHR m_surface;
@@ -77,6 +203,27 @@ private:
     std::vector<VkFramebuffer> m_fbuffers;
     VkQueue m_renderqueue;
 
+    /*
+    * One worker per core, for per-frame work that splits up by object.
+    * Its thread 0 is the one that called Init(), which is also the only
+    * one that may call Update() and Render().
+    */
+    JobSystem* m_jobs;
+
+    /* Everything bound for m_renderqueue goes through here. */
+    Scheduler* m_scheduler;
+    DeletionQueue* m_deletions;
+
+    /*
+    * Owns the box's buffers and every texture and sampler; the members
+    * below only keep handles into it.
+    */
+    typedef ResourceRegistry::BufferHandle BufferHandle;
+    typedef ResourceRegistry::ImageHandle ImageHandle;
+    typedef ResourceRegistry::SamplerHandle SamplerHandle;
+    typedef ResourceRegistry::MeshHandle MeshHandle;
+    ResourceRegistry* m_registry;
+
     Swapchain* m_swapchain;
     VkSemaphore m_swapready;
     VkSemaphore m_swapfinished;
@@ -88,41 +235,146 @@ private:
         VkPhysicalDeviceProperties properties;
         VkPhysicalDeviceMemoryProperties memory_properties;
         VkQueueFamilyProperties queue_properties;
+
+        /* VK_EXT_descriptor_indexing is there and bindless is turned on. */
+        bool bindless;
+        uint32_t max_textures;
+
+        /* VK_KHR_descriptor_update_template is enabled. */
+        bool update_templates;
+
+        /* VK_KHR_timeline_semaphore is enabled, along with its feature. */
+        bool timeline;
     } m_gpu;
 
+    /* VK_KHR_get_physical_device_properties2 was enabled on the instance. */
+    bool m_properties2;
+
+    /*
+    * What every pipeline variant has in common.  The variants themselves
+    * live in m_variants, one per PipelineState anything has asked for.
+    */
     struct GraphicsPipline {
+        ShaderInterface iface;          // both stages, merged
         VkRenderPass renderpass;
-        VkPipeline gpipeline;
-        VkPipelineLayout layout;
+        VkPipelineLayout layout;        // owned by m_descriptors
         VkShaderModule vshadermodule;
         VkShaderModule fshadermodule;
     } m_pipeline;
+    PipelineVariants* m_variants;
+
+    /* Outlives swapchain rebuilds; written to disk on Release(). */
+    VkPipelineCache m_pipelinecache;
+
+    /* A pipeline and the modules it was built from. */
+    struct PipelineBuild {
+        PipelineState state;
+        VkPipeline pipeline;
+        VkShaderModule vmodule;
+        VkShaderModule fmodule;
+    };
+
+    /*
+    * Shader hot reload (HOT_RELOAD).  A thread waits on the shaders
+    * directory and rebuilds the pipeline when the SPIR-V it uses is
+    * written, leaving the result in 'ready' for Render() to swap in
+    * between frames.  'build' is held for as long as a build runs, and by
+    * the main thread whenever it changes something a build reads.
+    */
+    struct ShaderReload {
+        DirWatcher* watcher;
+        std::thread thread;
+        std::atomic<bool> quit;
+        std::mutex build;
+        std::mutex lock;                // guards 'ready'
+        std::atomic<bool> pending;      // 'ready' holds a new pipeline
+        PipelineBuild ready;
+    } m_reload;
+
+    /*
+    * SPIR-V for everything create_pipeline() might build, by path.  Mostly
+    * it points into the executable (see shaderlib.h); a hot reload swaps in
+    * what it read off the disk.
+    */
+    struct ShaderCode {
+        AssetPack::Span span;
+        std::vector<char> storage;      // loose files only
+    };
+    std::map<std::string, ShaderCode> m_shaders;
 
     VkCommandPool m_cmdpool;
     std::vector<VkCommandBuffer> m_cmdbuffers;
 
+    /* Owns every descriptor set layout, pool and set. */
+    DescriptorAllocator* m_descriptors;
+
+    /*
+    * What set 0 points at, in the shape m_boxwriter reads it.  Runtime
+    * sized arrays aren't in here; write_slot() fills those in one by one.
+    */
+    struct BoxDescriptors {
+        VkDescriptorBufferInfo camera;      // binding 0
+        VkDescriptorImageInfo texture;      // binding 1
+    };
+    DescriptorWriter* m_boxwriter;
+
+    GpuProfiler* m_gpuprof;
+
     struct Box {
         std::vector<Vertex> vertices;
         std::vector<uint16_t> indices;
-        VkBuffer vbuffer;                 // vertex buffer
-        VkBuffer ibuffer;                 // index buffer
-        VkBuffer ubuffer;                 // uniform buffer
-        VkBuffer usbuffer;                // uniform staging buffer
-        VkDeviceMemory vbuffermem;
-        VkDeviceMemory ibuffermem;
-        VkDeviceMemory ubuffermem;
-        VkDeviceMemory usbuffermem;
+        MeshHandle mesh;                  // vertex and index buffers
+        BufferHandle ubuffer;             // camera uniform buffer
+        BufferHandle usbuffer;            // camera staging buffer
+        BufferHandle instbuffer;          // per-instance data (bindless)
+        std::vector<InstanceData> instances;
         VkDescriptorSetLayout dslayout;
-        VkDescriptorPool dpool;
         VkDescriptorSet dset;
+        TextureStreamer::Handle texture;
+        ObjectData object;
+        PipelineState state;              // blending, culling and depth
+
+        /*
+        * CreateInfo::objects copies of the box, each placed by its own
+        * matrix and drawn with m_box.object applied on top.  Bindless
+        * mode has one instance per texture, and copy i samples instance
+        * i % instances.size().
+        */
+        std::vector<glm::mat4> placements;
+        std::vector<TextureStreamer::Handle> textures;
+
+        /* placements[i] with 'object' applied, worked out by Update(). */
+        std::vector<ObjectData> objects;
     } m_box;
 
-    struct Texture {
-        VkImage image;
-        VkImageView view;
-        VkDeviceMemory memory;
-        VkSampler sampler;
-    } m_texture;
+    /* Only re-uploaded by Update() once something marks it dirty. */
+    struct Camera {
+        glm::vec3 eye;
+        glm::vec3 target;
+        glm::vec3 up;
+        float fov;
+        bool dirty;
+    } m_camera;
+
+    /*
+    * Streamed textures are keyed by their TextureStreamer handle.  Until a
+    * handle shows up in m_textures, anything using it samples from the
+    * placeholder instead.
+    */
+    AssetPack* m_pack;
+    TextureStreamer* m_streamer;
+    std::map<TextureStreamer::Handle, ImageHandle> m_textures;
+    ImageHandle m_placeholder;
+    SamplerHandle m_sampler;
+
+    /*
+    * Bindless mode only.  Every requested texture gets a slot in the
+    * sampler array as soon as it's requested; the slot shows the
+    * placeholder until the upload lands, and then it's rewritten in place.
+    * Nothing has to be re-recorded when that happens.
+    */
+    std::map<TextureStreamer::Handle, uint32_t> m_slots;
+    std::vector<uint32_t> m_free_slots;
 
     VkImage m_depthimage;
     VkImageView m_depthview;
@@ -130,48 +382,96 @@ private:
 
     VkResult create_depthresources(void);
     VkResult create_descriptorset_layout(void);
-    VkResult create_descriptorpool(void);
+    VkResult create_pipeline_layout(void);
+    VkResult create_descriptor_allocator(void);
+    VkResult create_descriptor_writer(void);
     VkResult create_descriptorset(void);
-    VkResult create_vertexbuffer(void);
-    VkResult create_indexbuffer(void);
+    VkResult create_vertexbuffer(BufferHandle* out);
+    VkResult create_indexbuffer(BufferHandle* out);
     VkResult create_sampler(void);
     VkResult create_texture(void);
-    VkResult create_textureimageview(void);
     VkResult create_uniformbuffer(void);
+    VkResult create_instancebuffer(void);
 
     VkResult create_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties, VkBuffer* buffer,
       VkDeviceMemory* buffer_memory);
+    VkResult create_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
+      VkMemoryPropertyFlags properties, BufferHandle* out);
     VkResult create_image(uint32_t w, uint32_t h, VkFormat fmt,
       VkImageTiling tiling, VkImageUsageFlags usage,
-      VkMemoryPropertyFlags properties, VkImage* img, VkDeviceMemory* mem);
+      VkMemoryPropertyFlags properties, VkImage* img, VkDeviceMemory* mem,
+      uint32_t levels = 1);
     VkResult create_imageview(VkImage image, VkFormat format,
-      VkImageAspectFlags aflags, VkImageView* view);
+      VkImageAspectFlags aflags, VkImageView* view, uint32_t levels = 1);
     VkResult find_depth_format(VkFormat* format);
     uint32_t find_memory_type(uint32_t filter, VkMemoryPropertyFlags flags);
     VkResult find_supported_format(VkPhysicalDevice gpu,
       std::vector<VkFormat> candidates, VkImageTiling tiling,
       VkFormatFeatureFlags features, VkFormat *out);
     VkResult transition_image_layout(VkImage img, VkImageLayout old,
-      VkImageLayout _new);
+      VkImageLayout _new, uint32_t levels = 1);
+
+    /*
+    * Hands back the bytes of an asset, straight out of the pack mapping if
+    * it's in there, or read into 'storage' from the loose file if not.
+    */
+    AssetPack::Span load_asset(std::string path, std::vector<char>* storage);
+    VkResult load_shaders(void);
+    AssetPack::Span find_shader(std::string path);
+    void shader_paths(const char** vert, const char** frag);
+
+    /* Texture streaming helpers */
+    ImageHandle find_texture(TextureStreamer::Handle handle);
+    VkResult stream_textures(void);
+    VkResult update_texture_descriptor(void);
+    VkResult upload_texture(const MipImage* img, ImageHandle* out);
+    void stamp_textures(uint64_t value);
+
+    /* Bindless slot management */
+    uint32_t acquire_slot(TextureStreamer::Handle handle);
+    void release_slot(TextureStreamer::Handle handle);
+    void write_slot(uint32_t slot, ImageHandle image);
+    VkResult write_instances(void);
+
+    VkResult update_camera(void);
+    double clock_ms(uint64_t from, uint64_t to) const;
+    void startup_stage(const char* name, uint64_t* since);
 
     /* Only initialization functions. Look in renderer_init.cpp */
     VkResult create_cmdpool(void);
     VkResult create_cmdbuffers(void);
+    VkResult record_cmdbuffer(uint32_t i);
     VkResult create_device(void);
     VkResult create_framebuffers(void);
     VkResult create_instance(void);
     VkResult create_pipeline(void);
+    VkResult reflect_shaders(AssetPack::Span vshader, AssetPack::Span fshader,
+      ShaderInterface* out);
+    VkResult create_pipeline_cache(void);
+    VkResult create_shader_modules(AssetPack::Span vshader,
+      AssetPack::Span fshader, VkShaderModule* vmodule,
+      VkShaderModule* fmodule);
+    VkResult build_variant(const PipelineState& state, VkShaderModule vmodule,
+      VkShaderModule fmodule, VkPipeline* out);
     VkResult create_renderpass(void);
     VkResult create_surface(void);
     VkResult create_synchronizers(void);
     SDL_Window* create_window(void);
 
+    /* Shader hot reload.  Look in renderer_reload.cpp */
+    void start_reload(void);
+    void stop_reload(void);
+    void reload_worker(void);
+    void swap_reloaded(void);
+    void discard_reloaded(void);
+
     /* Vulkan object releasing functions.  Look in renderer_release.cpp */
     VkResult release_device_objects(void);
     VkResult release_instance_objects(void);
     VkResult release_render_objects(void);
     VkResult release_sync_objects(void);
+    void save_pipeline_cache(void);
 
     /*
     * While these are debug functions, I was trying to avoid #ifdef guards in
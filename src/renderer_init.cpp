@@ -2,6 +2,8 @@
 
 VkResult Renderer::create_cmdbuffers(void)
 {
+    PROFILE_ZONE("Renderer::create_cmdbuffers");
+
     VkResult result = VK_SUCCESS;
 
     /*
@@ -22,61 +24,127 @@ VkResult Renderer::create_cmdbuffers(void)
         return result;
     }
 
-    /* I'm not sure what this is...will figure out. */
-    for (uint32_t i = 0; i < m_cmdbuffers.size(); i++) {
-        VkCommandBufferBeginInfo begin_info = {};
-        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    /* Nothing to record yet: Render() does that for each frame. */
+    return VK_SUCCESS;
+}
 
-        vkBeginCommandBuffer(m_cmdbuffers[i], &begin_info);
+VkResult Renderer::record_cmdbuffer(uint32_t i)
+{
+    /*
+    * Everything the draws need is looked up before anything's recorded;
+    * bailing out later would leave the buffer open mid render pass.
+    */
+    ResourceRegistry::Mesh mesh = {};
+    ResourceRegistry::Buffer vbuffer = {};
+    ResourceRegistry::Buffer ibuffer = {};
+    ResourceRegistry::Buffer instbuffer = {};
+    if (!m_registry->Get(m_box.mesh, &mesh) ||
+      !m_registry->Get(mesh.vertices, &vbuffer) ||
+      !m_registry->Get(mesh.indices, &ibuffer) ||
+      (!m_registry->Get(m_box.instbuffer, &instbuffer) && m_gpu.bindless)) {
+        Log::Write(Log::SEVERE, "Renderer::record_cmdbuffer -> the box's "
+          "buffers have gone stale.");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
 
-        std::vector<VkClearValue> clear_values;
-        clear_values.resize(2);
-        clear_values[0].color = { 0.2f, 0.2f, 0.2f, 1.0f };
-        clear_values[1].depthStencil = { 1.0f, 0 };
+    /*
+    * Render() records the buffer for the image it's about to draw every
+    * frame, so the push constants always carry this frame's model matrix.
+    * The pool was made with RESET_COMMAND_BUFFER, which lets begin reset
+    * the old contents.
+    */
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        VkExtent2D extent;
-        m_swapchain->GetExtent(&extent);
+    vkBeginCommandBuffer(m_cmdbuffers[i], &begin_info);
 
-        VkRenderPassBeginInfo rpi = {};
-        rpi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        rpi.renderPass = m_pipeline.renderpass;
-        rpi.framebuffer = m_fbuffers[i];
-        rpi.renderArea.offset = { 0, 0 };
-        rpi.renderArea.extent = extent;
-        rpi.clearValueCount = clear_values.size();
-        rpi.pClearValues = clear_values.data();
+    std::vector<VkClearValue> clear_values;
+    clear_values.resize(2);
+    clear_values[0].color = { 0.2f, 0.2f, 0.2f, 1.0f };
+    clear_values[1].depthStencil = { 1.0f, 0 };
 
-        vkCmdBeginRenderPass(m_cmdbuffers[i], &rpi,
-          VK_SUBPASS_CONTENTS_INLINE);
+    VkExtent2D extent;
+    m_swapchain->GetExtent(&extent);
 
-        vkCmdBindPipeline(m_cmdbuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-          m_pipeline.gpipeline);
+    VkRenderPassBeginInfo rpi = {};
+    rpi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rpi.renderPass = m_pipeline.renderpass;
+    rpi.framebuffer = m_fbuffers[i];
+    rpi.renderArea.offset = { 0, 0 };
+    rpi.renderArea.extent = extent;
+    rpi.clearValueCount = clear_values.size();
+    rpi.pClearValues = clear_values.data();
+
+    uint32_t scope = m_gpuprof->Begin(m_cmdbuffers[i], "main pass");
+    vkCmdBeginRenderPass(m_cmdbuffers[i], &rpi, VK_SUBPASS_CONTENTS_INLINE);
+
+    /* Nothing compatible is ready yet, so there's only the clear. */
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    m_variants->Get(m_box.state, &pipeline);
+    if (pipeline == VK_NULL_HANDLE) {
+        vkCmdEndRenderPass(m_cmdbuffers[i]);
+        m_gpuprof->End(m_cmdbuffers[i], scope);
+        return vkEndCommandBuffer(m_cmdbuffers[i]);
+    }
 
-        VkBuffer buffs[] = { m_box.vbuffer };
-        VkDeviceSize offsets[] = { 0 };
+    vkCmdBindPipeline(m_cmdbuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
+      pipeline);
 
-        vkCmdBindVertexBuffers(m_cmdbuffers[i], 0, 1, buffs, offsets);
-        vkCmdBindIndexBuffer(m_cmdbuffers[i], m_box.ibuffer, 0,
-          VK_INDEX_TYPE_UINT16);
-        vkCmdBindDescriptorSets(m_cmdbuffers[i],
-          VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.layout, 0, 1,
-          &m_box.dset, 0, nullptr);
-    
-        vkCmdDrawIndexed(m_cmdbuffers[i], m_box.indices.size(), 1, 0, 0, 0);
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(m_cmdbuffers[i], 0, 1, &viewport);
 
-        vkCmdEndRenderPass(m_cmdbuffers[i]);
+    VkRect2D scissor = {};
+    scissor.offset = { 0, 0 };
+    scissor.extent = extent;
+    vkCmdSetScissor(m_cmdbuffers[i], 0, 1, &scissor);
+
+    VkBuffer buffs[] = { vbuffer.buffer, instbuffer.buffer };
+    VkDeviceSize offsets[] = { 0, 0 };
+    uint32_t nbuffs = m_gpu.bindless ? 2 : 1;
+
+    vkCmdBindVertexBuffers(m_cmdbuffers[i], 0, nbuffs, buffs, offsets);
+    vkCmdBindIndexBuffer(m_cmdbuffers[i], ibuffer.buffer, 0,
+      mesh.index_type);
+    vkCmdBindDescriptorSets(m_cmdbuffers[i],
+      VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.layout, 0, 1,
+      &m_box.dset, 0, nullptr);
 
-        result = vkEndCommandBuffer(m_cmdbuffers[i]);
-        Assert(result, "vkEndCommandBuffer", m_window);
+    /*
+    * One draw per copy, each with its own model matrix.  In bindless mode
+    * firstInstance picks which texture the copy gets.
+    */
+    for (size_t j = 0; j < m_box.objects.size(); j++) {
+        const ObjectData& object = m_box.objects[j];
+        const VkPushConstantRange& push = m_pipeline.iface.push;
+        if (push.size != 0) {
+            vkCmdPushConstants(m_cmdbuffers[i], m_pipeline.layout,
+              push.stageFlags, push.offset, push.size,
+              reinterpret_cast<const char*>(&object) + push.offset);
+        }
+
+        uint32_t instance = m_gpu.bindless ?
+          j % m_box.instances.size() : 0;
+        vkCmdDrawIndexed(m_cmdbuffers[i], mesh.index_count, 1, 0, 0,
+          instance);
     }
 
-    return VK_SUCCESS;
+    vkCmdEndRenderPass(m_cmdbuffers[i]);
+    m_gpuprof->End(m_cmdbuffers[i], scope);
 
+    return vkEndCommandBuffer(m_cmdbuffers[i]);
 }
 
 VkResult Renderer::create_cmdpool(void)
 {
+    PROFILE_ZONE("Renderer::create_cmdpool");
+
     /* Command pool creation */
     VkCommandPoolCreateInfo cpci = {};
     cpci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -87,8 +155,22 @@ VkResult Renderer::create_cmdpool(void)
     return vkCreateCommandPool(m_device, &cpci, nullptr, &m_cmdpool);
 }
 
+static bool has_extension(const std::vector<VkExtensionProperties>& props,
+  const char* name)
+{
+    for (size_t i = 0; i < props.size(); i++) {
+        if (std::strcmp(props[i].extensionName, name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 VkResult Renderer::create_device(void)
 {
+    PROFILE_ZONE("Renderer::create_device");
+
     VkResult result = VK_SUCCESS;
     /*
      * Next, we must get all the physical devices that are compatible with
@@ -213,16 +295,177 @@ VkResult Renderer::create_device(void)
 
     m_gpu.features.shaderClipDistance = VK_TRUE;
 
+    std::vector<const char*> dev_extensions(swap_extension,
+      swap_extension + 1);
+
+    uint32_t ext_count = 0;
+    vkEnumerateDeviceExtensionProperties(m_gpu.device, nullptr, &ext_count,
+      nullptr);
+    std::vector<VkExtensionProperties> ext_props(ext_count);
+    vkEnumerateDeviceExtensionProperties(m_gpu.device, nullptr, &ext_count,
+      ext_props.data());
+
+    /*
+    * Bindless textures need VK_EXT_descriptor_indexing, which means asking
+    * for its features and limits through the properties2 entry points.  If
+    * any piece of it is missing, the renderer falls back to one descriptor
+    * per texture and re-records the command buffers when one changes.
+    */
+    m_gpu.bindless = false;
+    m_gpu.max_textures = 1;
+#if defined(VK_EXT_descriptor_indexing)
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing = {};
+    indexing.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+    PFN_vkGetPhysicalDeviceFeatures2KHR get_features2 =
+      (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(m_instance,
+      "vkGetPhysicalDeviceFeatures2KHR");
+    PFN_vkGetPhysicalDeviceProperties2KHR get_properties2 =
+      (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(
+      m_instance, "vkGetPhysicalDeviceProperties2KHR");
+
+    if (m_properties2 && !(m_cinfo.flags & NO_BINDLESS) &&
+      get_features2 != nullptr && get_properties2 != nullptr &&
+      has_extension(ext_props, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+      has_extension(ext_props, VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2KHR features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features2.pNext = &indexing;
+        get_features2(m_gpu.device, &features2);
+
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits = {};
+        limits.sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2KHR properties2 = {};
+        properties2.sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+        properties2.pNext = &limits;
+        get_properties2(m_gpu.device, &properties2);
+
+        uint32_t count = RENDERER_BINDLESS_TEXTURES;
+        count = std::min(count,
+          limits.maxPerStageDescriptorUpdateAfterBindSamplers);
+        count = std::min(count,
+          limits.maxPerStageDescriptorUpdateAfterBindSampledImages);
+        count = std::min(count,
+          limits.maxDescriptorSetUpdateAfterBindSamplers);
+        count = std::min(count,
+          limits.maxDescriptorSetUpdateAfterBindSampledImages);
+
+        m_gpu.bindless = count >= 2 &&
+          indexing.shaderSampledImageArrayNonUniformIndexing &&
+          indexing.descriptorBindingSampledImageUpdateAfterBind &&
+          indexing.descriptorBindingPartiallyBound &&
+          indexing.runtimeDescriptorArray;
+        if (m_gpu.bindless) {
+            m_gpu.max_textures = count;
+        }
+    }
+
+    /* Only turn on the bits that are actually used. */
+    indexing = VkPhysicalDeviceDescriptorIndexingFeaturesEXT();
+    indexing.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    indexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexing.descriptorBindingPartiallyBound = VK_TRUE;
+    indexing.runtimeDescriptorArray = VK_TRUE;
+
+    if (m_gpu.bindless) {
+        dev_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        dev_extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+    }
+#endif
+
+    if (m_gpu.bindless) {
+        Log::Write(Log::ROUTINE, "Renderer::create_device -> bindless "
+          "textures, {} slots.", m_gpu.max_textures);
+    } else {
+        Log::Write(Log::ROUTINE, "Renderer::create_device -> one descriptor "
+          "set binding per texture.");
+    }
+
+    /*
+    * Update templates are core in 1.1, but the instance asks for 1.0, so
+    * it's the KHR extension or nothing.  Without it DescriptorWriter goes
+    * back to vkUpdateDescriptorSets.
+    */
+    m_gpu.update_templates = false;
+#if defined(VK_KHR_descriptor_update_template)
+    m_gpu.update_templates = has_extension(ext_props,
+      VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+    if (m_gpu.update_templates) {
+        dev_extensions.push_back(
+          VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+    }
+#endif
+
+    /*
+    * Timeline semaphores are how the Scheduler waits on one submit rather
+    * than the whole queue.  Core in 1.2, but as with update templates it's
+    * the KHR extension here, and the feature has to be asked for as well.
+    * Without them it keeps a fence per submit instead.
+    */
+    m_gpu.timeline = false;
+#if defined(VK_KHR_timeline_semaphore)
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline = {};
+    timeline.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+    PFN_vkGetPhysicalDeviceFeatures2KHR get_timeline =
+      (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(m_instance,
+      "vkGetPhysicalDeviceFeatures2KHR");
+    if (m_properties2 && !(m_cinfo.flags & NO_TIMELINE) &&
+      get_timeline != nullptr &&
+      has_extension(ext_props, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2KHR features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features2.pNext = &timeline;
+        get_timeline(m_gpu.device, &features2);
+
+        m_gpu.timeline = timeline.timelineSemaphore == VK_TRUE;
+    }
+
+    if (m_gpu.timeline) {
+        dev_extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    }
+    timeline.pNext = nullptr;
+    timeline.timelineSemaphore = VK_TRUE;
+#endif
+
+    if (m_gpu.timeline) {
+        Log::Write(Log::ROUTINE, "Renderer::create_device -> submits are "
+          "tracked on a timeline semaphore.");
+    } else {
+        Log::Write(Log::ROUTINE, "Renderer::create_device -> submits are "
+          "tracked with fences.");
+    }
+
+    /* Feature structs for the extensions, chained onto the create info. */
+    void* features = nullptr;
+#if defined(VK_EXT_descriptor_indexing)
+    if (m_gpu.bindless) {
+        features = &indexing;
+    }
+#endif
+#if defined(VK_KHR_timeline_semaphore)
+    if (m_gpu.timeline) {
+        timeline.pNext = features;
+        features = &timeline;
+    }
+#endif
+
     VkDeviceCreateInfo d_create_info = {};
     d_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    d_create_info.pNext = nullptr;
+    d_create_info.pNext = features;
     d_create_info.flags = 0;
     d_create_info.queueCreateInfoCount = 1;
     d_create_info.pQueueCreateInfos = &q_create_info;
     d_create_info.enabledLayerCount = layer_count;
     d_create_info.ppEnabledLayerNames = dev_layers;
-    d_create_info.enabledExtensionCount = 1;
-    d_create_info.ppEnabledExtensionNames = swap_extension;
+    d_create_info.enabledExtensionCount = dev_extensions.size();
+    d_create_info.ppEnabledExtensionNames = dev_extensions.data();
     d_create_info.pEnabledFeatures = &m_gpu.features;
 
     result = vkCreateDevice(m_gpu.device, &d_create_info, NULL, 
@@ -247,6 +490,8 @@ VkResult Renderer::create_device(void)
 
 VkResult Renderer::create_framebuffers(void)
 {
+    PROFILE_ZONE("Renderer::create_framebuffers");
+
     VkResult result = VK_SUCCESS;
 
     uint32_t count;
@@ -280,6 +525,8 @@ VkResult Renderer::create_framebuffers(void)
 
 VkResult Renderer::create_instance(void)
 {
+    PROFILE_ZONE("Renderer::create_instance");
+
     /* in a sane application, you would verify these extensions are present
      * before barreling away creating your instance.  But because I know
      * they exist on my development machine (just run vulkaninfo.. ) I'm
@@ -303,6 +550,21 @@ VkResult Renderer::create_instance(void)
     extensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #endif
 
+    /* Needed to query descriptor indexing support in create_device(). */
+    m_properties2 = false;
+#if defined(VK_KHR_get_physical_device_properties2)
+    uint32_t count = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> props(count);
+    vkEnumerateInstanceExtensionProperties(nullptr, &count, props.data());
+    if (has_extension(props,
+      VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+        extensions.push_back(
+          VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        m_properties2 = true;
+    }
+#endif
+
     std::vector<const char*> layers;
 #if defined(VKTEST_DEBUG)
     layers.push_back("VK_LAYER_LUNARG_standard_validation");
@@ -320,53 +582,237 @@ VkResult Renderer::create_instance(void)
     return vkCreateInstance(&create_info, NULL, &m_instance);
 }
 
+/*
+* Both stages' interfaces, merged into what the pipeline layout has to
+* offer.  Runs before there's a layout at all, and again for every shader
+* hot reload to check the new code still fits it.
+*/
+VkResult Renderer::reflect_shaders(AssetPack::Span vshader,
+  AssetPack::Span fshader, ShaderInterface* out)
+{
+    PROFILE_ZONE("Renderer::reflect_shaders");
+
+    ShaderInterface fragment;
+    if (!ShaderInterface::Reflect(vshader.data, vshader.size, out) ||
+      !ShaderInterface::Reflect(fshader.data, fshader.size, &fragment)) {
+        Log::Write(Log::SEVERE, "Renderer::reflect_shaders -> can't make "
+          "sense of the SPIR-V.");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    if (!out->Merge(fragment)) {
+        Log::Write(Log::SEVERE, "Renderer::reflect_shaders -> the stages "
+          "disagree about a descriptor binding.");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    /*
+    * SPIR-V from before the material constants (a stale .spv baked in
+    * without glslangValidator, say) still works, but only ever draws the
+    * default material.  Say so rather than quietly ignoring the choice.
+    */
+    const uint32_t wanted = (1u << PipelineState::SPEC_COUNT) - 1;
+    PipelineState fallback = PipelineState::Default();
+    if ((fragment.spec_ids & wanted) != wanted &&
+      (m_box.state.features != fallback.features ||
+      m_box.state.alpha_ref != fallback.alpha_ref)) {
+        Log::Write(Log::WARNING, "Renderer::reflect_shaders -> the fragment "
+          "shader has no material constants; the box is drawn textured. "
+          "Rebuild the SPIR-V from shaders/src.");
+    }
+
+    return VK_SUCCESS;
+}
+
 VkResult Renderer::create_pipeline(void)
 {
+    PROFILE_ZONE("Renderer::create_pipeline");
+
     VkResult result = VK_SUCCESS;
 
-    std::vector<char> vshader = ReadFile("./shaders/test.vert.spv");
-    std::vector<char> fshader = ReadFile("./shaders/test.frag.spv");
+    /*
+    * This runs on a worker thread during Init(), so failures go back to
+    * the caller rather than through Assert().
+    */
+    const char* vpath = nullptr;
+    const char* fpath = nullptr;
+    shader_paths(&vpath, &fpath);
+
+    result = create_shader_modules(find_shader(vpath), find_shader(fpath),
+      &m_pipeline.vshadermodule, &m_pipeline.fshadermodule);
+    if (result) {
+        return result;
+    }
+
+    m_variants = PipelineVariants::Init(m_device,
+      [this](const PipelineState& state, VkPipeline* out) {
+        return build_variant(state, m_pipeline.vshadermodule,
+          m_pipeline.fshadermodule, out);
+      });
+
+    /* The first frame needs this one; the others can take their time. */
+    result = m_variants->Build(m_box.state);
+    if (result) {
+        return result;
+    }
+
+    if (m_cinfo.precompile != nullptr) {
+        m_variants->Prepare(std::vector<PipelineState>(m_cinfo.precompile,
+          m_cinfo.precompile + m_cinfo.precompile_count));
+    }
+
+    return result;
+}
+
+void Renderer::shader_paths(const char** vert, const char** frag)
+{
+    *vert = m_gpu.bindless ? "./shaders/bindless.vert.spv" :
+      "./shaders/test.vert.spv";
+    *frag = m_gpu.bindless ? "./shaders/bindless.frag.spv" :
+      "./shaders/test.frag.spv";
+}
 
+/*
+* Blobs in the pack are page aligned, so pCode can point right at the
+* mapping.  Nothing is left behind if the second one fails.
+*/
+VkResult Renderer::create_shader_modules(AssetPack::Span vshader,
+  AssetPack::Span fshader, VkShaderModule* vmodule, VkShaderModule* fmodule)
+{
     VkShaderModuleCreateInfo smci = {};
     smci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    smci.codeSize = vshader.size();
-    smci.pCode = (const uint32_t*)vshader.data();
-    result = vkCreateShaderModule(m_device, &smci, nullptr,
-      &m_pipeline.vshadermodule);
-    Assert(result, "vkCreateShaderModule: vertex shader.", m_window);
-
-    smci.codeSize = fshader.size();
-    smci.pCode = (const uint32_t*)fshader.data();
-    result = vkCreateShaderModule(m_device, &smci, nullptr,
-      &m_pipeline.fshadermodule);
-    Assert(result, "vkCreateShaderModule: fragment shader.", m_window);
+    smci.codeSize = vshader.size;
+    smci.pCode = (const uint32_t*)vshader.data;
+    VkResult result = vkCreateShaderModule(m_device, &smci, nullptr,
+      vmodule);
+    if (result) {
+        return result;
+    }
+
+    smci.codeSize = fshader.size;
+    smci.pCode = (const uint32_t*)fshader.data;
+    result = vkCreateShaderModule(m_device, &smci, nullptr, fmodule);
+    if (result) {
+        vkDestroyShaderModule(m_device, *vmodule, nullptr);
+    }
+
+    return result;
+}
+
+/* Laid out in the order of PipelineState::SpecConstant. */
+struct SpecData {
+    VkBool32 flags[PipelineState::SPEC_ALPHA_REF];
+    float alpha_ref;
+};
+
+/*
+* One variant of the pipeline.  This runs on the variant builder and the
+* shader reload threads as well as the main thread, so it only reads what
+* the main thread leaves alone until PipelineVariants::Clear() has returned
+* and m_reload.build is free.  Viewport and scissor are dynamic, which
+* leaves the render pass as the only thing tying a variant to the
+* swapchain.
+*/
+VkResult Renderer::build_variant(const PipelineState& state,
+  VkShaderModule vmodule, VkShaderModule fmodule, VkPipeline* out)
+{
+    PROFILE_ZONE("Renderer::build_variant");
+
+    /* There's only the one render pass so far. */
+    if (state.pass != 0) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
 
     VkPipelineShaderStageCreateInfo vssi = {};
     vssi.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vssi.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vssi.module = m_pipeline.vshadermodule;
+    vssi.module = vmodule;
     vssi.pName = "main";
 
+    /*
+    * The fragment shader's features.  Shaders built before they had these
+    * constants just ignore them; reflect_shaders() warns about that.
+    */
+    SpecData data = {};
+    data.flags[PipelineState::SPEC_TEXTURE] =
+      (state.features & PipelineState::FEATURE_TEXTURE) ? VK_TRUE : VK_FALSE;
+    data.flags[PipelineState::SPEC_VERTEX_COLOR] =
+      (state.features & PipelineState::FEATURE_VERTEX_COLOR) ?
+      VK_TRUE : VK_FALSE;
+    data.flags[PipelineState::SPEC_ALPHA_TEST] =
+      (state.features & PipelineState::FEATURE_ALPHA_TEST) ?
+      VK_TRUE : VK_FALSE;
+    data.flags[PipelineState::SPEC_FLIP_U] =
+      (state.features & PipelineState::FEATURE_FLIP_U) ? VK_TRUE : VK_FALSE;
+    data.alpha_ref = state.alpha_ref / 255.0f;
+
+    std::array<VkSpecializationMapEntry, PipelineState::SPEC_COUNT> entries;
+    for (uint32_t i = 0; i < PipelineState::SPEC_ALPHA_REF; i++) {
+        entries[i].constantID = i;
+        entries[i].offset = i * sizeof(VkBool32);
+        entries[i].size = sizeof(VkBool32);
+    }
+    entries[PipelineState::SPEC_ALPHA_REF].constantID =
+      PipelineState::SPEC_ALPHA_REF;
+    entries[PipelineState::SPEC_ALPHA_REF].offset =
+      offsetof(SpecData, alpha_ref);
+    entries[PipelineState::SPEC_ALPHA_REF].size = sizeof(float);
+
+    VkSpecializationInfo spec = {};
+    spec.mapEntryCount = entries.size();
+    spec.pMapEntries = entries.data();
+    spec.dataSize = sizeof(SpecData);
+    spec.pData = &data;
+
     VkPipelineShaderStageCreateInfo fssi = {};
     fssi.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fssi.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fssi.module = m_pipeline.fshadermodule;
+    fssi.module = fmodule;
     fssi.pName = "main";
+    fssi.pSpecializationInfo = &spec;
 
     std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
     shader_stages.push_back(vssi);
     shader_stages.push_back(fssi);
 
     /* grab the vertex data descriptions. */
-    VkVertexInputBindingDescription bdesc = Vertex::getBindDesc();
-    std::array<VkVertexInputAttributeDescription, 3> adescs =
+    std::vector<VkVertexInputBindingDescription> bdescs;
+    bdescs.push_back(Vertex::getBindDesc());
+    std::array<VkVertexInputAttributeDescription, 3> vadescs =
       Vertex::getAttrDesc();
+    std::vector<VkVertexInputAttributeDescription> available(vadescs.begin(),
+      vadescs.end());
+
+    /* The bindless shaders also read a texture slot per instance. */
+    if (m_gpu.bindless) {
+        bdescs.push_back(InstanceData::getBindDesc());
+        available.push_back(InstanceData::getAttrDesc());
+    }
+
+    /* Only the attributes the vertex shader actually reads. */
+    std::vector<VkVertexInputAttributeDescription> adescs;
+    const std::vector<ShaderInterface::Input>& inputs =
+      m_pipeline.iface.inputs;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        size_t j = 0;
+        while (j < available.size() &&
+          available[j].location != inputs[i].location) {
+            j++;
+        }
+        if (j == available.size() || available[j].format != inputs[i].format) {
+            Log::Write(Log::SEVERE, "Renderer::build_variant -> the vertex "
+              "shader's input {} doesn't match any vertex attribute.",
+              inputs[i].location);
+            return VK_ERROR_FORMAT_NOT_SUPPORTED;
+        }
+        adescs.push_back(available[j]);
+    }
 
     VkPipelineVertexInputStateCreateInfo vertinputinfo = {};
     vertinputinfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertinputinfo.vertexBindingDescriptionCount = 1;
-    vertinputinfo.pVertexBindingDescriptions = &bdesc;
+    vertinputinfo.vertexBindingDescriptionCount = bdescs.size();
+    vertinputinfo.pVertexBindingDescriptions = bdescs.data();
     vertinputinfo.vertexAttributeDescriptionCount = adescs.size();
     vertinputinfo.pVertexAttributeDescriptions = adescs.data();
 
@@ -375,27 +821,18 @@ VkResult Renderer::create_pipeline(void)
     piasci.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     piasci.primitiveRestartEnable = VK_FALSE;
 
-    VkExtent2D extent;
-    m_swapchain->GetExtent(&extent);
-
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)extent.width;
-    viewport.height = (float)extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = extent;
-
     VkPipelineViewportStateCreateInfo vstate = {};
     vstate.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     vstate.viewportCount = 1;
-    vstate.pViewports = &viewport;
     vstate.scissorCount = 1;
-    vstate.pScissors = &scissor;
+
+    std::array<VkDynamicState, 2> dynamic = {
+      { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR } };
+
+    VkPipelineDynamicStateCreateInfo dsci = {};
+    dsci.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dsci.dynamicStateCount = dynamic.size();
+    dsci.pDynamicStates = dynamic.data();
 
     VkPipelineRasterizationStateCreateInfo rast = {};
     rast.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -403,7 +840,7 @@ VkResult Renderer::create_pipeline(void)
     rast.rasterizerDiscardEnable = VK_FALSE;
     rast.polygonMode = VK_POLYGON_MODE_FILL;
     rast.lineWidth = 1.0f;
-    rast.cullMode = VK_CULL_MODE_BACK_BIT;
+    rast.cullMode = state.cull;
     rast.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
     rast.depthBiasEnable = VK_FALSE;
     rast.depthBiasConstantFactor = 0.0f;
@@ -421,9 +858,11 @@ VkResult Renderer::create_pipeline(void)
 
     VkPipelineDepthStencilStateCreateInfo dci = {};
     dci.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    dci.depthTestEnable = VK_TRUE;
-    dci.depthWriteEnable = VK_TRUE;
-    dci.depthCompareOp = VK_COMPARE_OP_LESS;
+    dci.depthTestEnable = (state.depth & PipelineState::DEPTH_TEST) ?
+      VK_TRUE : VK_FALSE;
+    dci.depthWriteEnable = (state.depth & PipelineState::DEPTH_WRITE) ?
+      VK_TRUE : VK_FALSE;
+    dci.depthCompareOp = static_cast<VkCompareOp>(state.compare);
     dci.depthBoundsTestEnable = VK_FALSE;
     dci.stencilTestEnable = VK_FALSE;
 
@@ -440,6 +879,21 @@ VkResult Renderer::create_pipeline(void)
     cba.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
     cba.alphaBlendOp = VK_BLEND_OP_ADD;
 
+    switch (state.blend) {
+    case PipelineState::BLEND_ALPHA:
+        cba.blendEnable = VK_TRUE;
+        cba.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        cba.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        cba.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        break;
+    case PipelineState::BLEND_ADDITIVE:
+        cba.blendEnable = VK_TRUE;
+        cba.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        cba.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        cba.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        break;
+    }
+
     VkPipelineColorBlendStateCreateInfo cbsci = {};
     cbsci.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     cbsci.logicOpEnable = VK_FALSE;
@@ -451,19 +905,6 @@ VkResult Renderer::create_pipeline(void)
     cbsci.blendConstants[2] = 0.0f;
     cbsci.blendConstants[3] = 0.0f;
 
-    VkDescriptorSetLayout set_layouts[] = { m_box.dslayout };
-
-    VkPipelineLayoutCreateInfo plci = {};
-    plci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    plci.setLayoutCount = 1;
-    plci.pSetLayouts = set_layouts;
-    plci.pushConstantRangeCount = 0;
-    plci.pPushConstantRanges = nullptr;
-
-    result = vkCreatePipelineLayout(m_device, &plci, nullptr,
-      &m_pipeline.layout);
-    Assert(result, "vkCreatePipelineLayout", m_window);
-
     VkGraphicsPipelineCreateInfo pci = {};
     pci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pci.stageCount = 2;
@@ -475,22 +916,83 @@ VkResult Renderer::create_pipeline(void)
     pci.pMultisampleState = &ms;
     pci.pDepthStencilState = &dci;
     pci.pColorBlendState = &cbsci;
-    pci.pDynamicState = nullptr;
+    pci.pDynamicState = &dsci;
     pci.layout = m_pipeline.layout;
     pci.renderPass = m_pipeline.renderpass;
     pci.subpass = 0;
     pci.basePipelineHandle = VK_NULL_HANDLE;
     pci.basePipelineIndex = -1;
 
-    result = vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1,
-      &pci, nullptr, &m_pipeline.gpipeline);
-    Assert(result, "vkCreateGraphicsPipelines", m_window);
+    return vkCreateGraphicsPipelines(m_device, m_pipelinecache, 1, &pci,
+      nullptr, out);
+}
+
+VkResult Renderer::create_pipeline_cache(void)
+{
+    PROFILE_ZONE("Renderer::create_pipeline_cache");
+
+    std::vector<char> data;
+    std::ifstream f(RENDERER_PIPELINE_CACHE, std::ifstream::in |
+      std::ifstream::binary);
+    if (f.is_open()) {
+        f.seekg(0L, f.end);
+        std::streamoff len = f.tellg();
+        f.seekg(0L, f.beg);
+        if (len > 0) {
+            data.resize(static_cast<size_t>(len));
+            f.read(data.data(), len);
+        }
+        if (!f) {
+            data.clear();
+        }
+    }
+
+    /*
+    * Drivers are meant to ignore a cache from somewhere else, but not all
+    * of them manage it, so anything that isn't from this exact device and
+    * driver build gets thrown away here first.  The header is the length,
+    * the version, vendor and device IDs, then the cache UUID.
+    */
+    const size_t header = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (!data.empty()) {
+        uint32_t fields[4];
+        bool ok = data.size() >= header;
+        if (ok) {
+            std::memcpy(fields, data.data(), sizeof(fields));
+            ok = fields[0] >= header &&
+              fields[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+              fields[2] == m_gpu.properties.vendorID &&
+              fields[3] == m_gpu.properties.deviceID &&
+              std::memcmp(data.data() + sizeof(fields),
+              m_gpu.properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+        if (!ok) {
+            Log::Write(Log::WARNING, "Renderer::create_pipeline_cache -> {} "
+              "is from another device or driver, starting over.",
+              RENDERER_PIPELINE_CACHE);
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo ci = {};
+    ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    ci.initialDataSize = data.size();
+    ci.pInitialData = data.empty() ? nullptr : data.data();
+
+    VkResult result = vkCreatePipelineCache(m_device, &ci, nullptr,
+      &m_pipelinecache);
+    if (result == VK_SUCCESS && !data.empty()) {
+        Log::Write(Log::ROUTINE, "Renderer::create_pipeline_cache -> loaded "
+          "{} KiB from {}.", data.size() / 1024, RENDERER_PIPELINE_CACHE);
+    }
 
     return result;
 }
 
 VkResult Renderer::create_renderpass(void)
 {
+    PROFILE_ZONE("Renderer::create_renderpass");
+
     VkFormat sc_format;
     m_swapchain->GetFormat(&sc_format);
 
@@ -560,6 +1062,8 @@ VkResult Renderer::create_renderpass(void)
 
 VkResult Renderer::create_surface(void)
 {
+    PROFILE_ZONE("Renderer::create_surface");
+
     VkResult result = VK_SUCCESS;
 
     /*
@@ -602,6 +1106,8 @@ VkResult Renderer::create_surface(void)
 
 VkResult Renderer::create_synchronizers(void)
 {
+    PROFILE_ZONE("Renderer::create_synchronizers");
+
     VkResult result = VK_SUCCESS;
 
     VkSemaphoreCreateInfo semci = {};
@@ -620,6 +1126,8 @@ VkResult Renderer::create_synchronizers(void)
 
 SDL_Window* Renderer::create_window(void)
 {
+    PROFILE_ZONE("Renderer::create_window");
+
     SDL_DisplayMode displaymode;
     int r = SDL_GetCurrentDisplayMode(0, &displaymode);
     if (r) {
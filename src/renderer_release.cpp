@@ -1,5 +1,7 @@
 #include "renderer.h"
 
+#include <cstdio>
+
 VkResult Renderer::release_device_objects(void)
 {
     Swapchain::Release(m_device, m_swapchain);
@@ -19,8 +21,12 @@ VkResult Renderer::release_instance_objects(void)
 
 VkResult Renderer::release_render_objects(void)
 {
-    vkDestroyDescriptorSetLayout(m_device, m_box.dslayout, nullptr);
-    vkDestroyDescriptorPool(m_device, m_box.dpool, nullptr);
+    /* The device is idle, so whatever's still waiting can go. */
+    DeletionQueue::Release(m_deletions);
+    ResourceRegistry::Release(m_registry);
+    DescriptorWriter::Release(m_boxwriter);
+    DescriptorAllocator::Release(m_descriptors);
+    GpuProfiler::Release(m_gpuprof);
     vkResetCommandPool(m_device, m_cmdpool,
       VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
 
@@ -31,27 +37,15 @@ VkResult Renderer::release_render_objects(void)
 
     vkDestroyImageView(m_device, m_depthview, nullptr);
     vkDestroyImage(m_device, m_depthimage, nullptr);
+    FlightRecorder::Record(FLIGHT_FREE, (uint64_t)m_depthmem);
     vkFreeMemory(m_device, m_depthmem, nullptr);
 
-    vkDestroySampler(m_device, m_texture.sampler, nullptr);
-    vkDestroyImageView(m_device, m_texture.view, nullptr);
-    vkDestroyImage(m_device, m_texture.image, nullptr);
-    vkFreeMemory(m_device, m_texture.memory, nullptr);
-
-    vkFreeMemory(m_device, m_box.vbuffermem, nullptr);
-    vkDestroyBuffer(m_device, m_box.vbuffer, nullptr);
-
-    vkFreeMemory(m_device, m_box.ibuffermem, nullptr);
-    vkDestroyBuffer(m_device, m_box.ibuffer, nullptr);
-
-    vkFreeMemory(m_device, m_box.ubuffermem, nullptr);
-    vkDestroyBuffer(m_device, m_box.ubuffer, nullptr);
+    /* Every handle into the registry is dead from here on. */
+    m_textures.clear();
 
-    vkFreeMemory(m_device, m_box.usbuffermem, nullptr);
-    vkDestroyBuffer(m_device, m_box.usbuffer, nullptr);
-
-    vkDestroyPipeline(m_device, m_pipeline.gpipeline, nullptr);
-    vkDestroyPipelineLayout(m_device, m_pipeline.layout, nullptr);
+    PipelineVariants::Release(m_variants);
+    save_pipeline_cache();
+    vkDestroyPipelineCache(m_device, m_pipelinecache, nullptr);
     vkDestroyRenderPass(m_device, m_pipeline.renderpass, nullptr);
     vkDestroyShaderModule(m_device, m_pipeline.vshadermodule, nullptr);
     vkDestroyShaderModule(m_device, m_pipeline.fshadermodule, nullptr);
@@ -67,6 +61,40 @@ VkResult Renderer::release_sync_objects(void)
 {
     vkDestroySemaphore(m_device, m_swapready, nullptr);
     vkDestroySemaphore(m_device, m_swapfinished, nullptr);
+    Scheduler::Release(m_scheduler);
 
     return VK_SUCCESS;
 }
+
+void Renderer::save_pipeline_cache(void)
+{
+    size_t size = 0;
+    VkResult result = vkGetPipelineCacheData(m_device, m_pipelinecache,
+      &size, nullptr);
+    if (result || size == 0) {
+        return;
+    }
+
+    std::vector<char> data(size);
+    result = vkGetPipelineCacheData(m_device, m_pipelinecache, &size,
+      data.data());
+    if (result) {
+        return;
+    }
+
+    /* Written aside and renamed, so a crash can't leave half a cache. */
+    std::string temp = std::string(RENDERER_PIPELINE_CACHE) + ".tmp";
+    std::ofstream f(temp.c_str(), std::ofstream::out | std::ofstream::binary |
+      std::ofstream::trunc);
+    f.write(data.data(), size);
+    f.close();
+    if (!f) {
+        Log::Write(Log::WARNING, "Renderer::save_pipeline_cache -> could "
+          "not write {}", temp);
+        std::remove(temp.c_str());
+        return;
+    }
+
+    std::remove(RENDERER_PIPELINE_CACHE);
+    std::rename(temp.c_str(), RENDERER_PIPELINE_CACHE);
+}
@@ -0,0 +1,210 @@
+#include "renderer.h"
+
+/*
+* Reads a shader the editor or compiler just wrote.  Always from the disk,
+* even when the pack has a copy: the pack is what the last build cooked,
+* and this is what changed since.
+*/
+static bool read_spirv(std::string path, std::vector<char>* out)
+{
+    std::ifstream f(path.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!f.is_open()) {
+        return false;
+    }
+
+    f.seekg(0L, f.end);
+    std::streamoff len = f.tellg();
+    f.seekg(0L, f.beg);
+    if (len < 20 || len % 4 != 0) {
+        return false;
+    }
+
+    out->resize(static_cast<size_t>(len));
+    f.read(out->data(), len);
+    if (!f) {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    std::memcpy(&magic, out->data(), sizeof(magic));
+
+    return magic == 0x07230203;
+}
+
+void Renderer::start_reload(void)
+{
+    m_reload.quit = false;
+    m_reload.pending = false;
+
+    m_reload.watcher = DirWatcher::Init(RENDERER_SHADER_DIR);
+    if (m_reload.watcher == nullptr) {
+        Log::Write(Log::WARNING, "Renderer -> can't watch {}, shader hot "
+          "reload is off.", RENDERER_SHADER_DIR);
+        return;
+    }
+
+    m_reload.thread = std::thread(&Renderer::reload_worker, this);
+    Log::Write(Log::ROUTINE, "Renderer -> watching {} for shader changes.",
+      RENDERER_SHADER_DIR);
+}
+
+void Renderer::stop_reload(void)
+{
+    if (m_reload.watcher == nullptr) {
+        return;
+    }
+
+    m_reload.quit = true;
+    m_reload.thread.join();
+    DirWatcher::Release(m_reload.watcher);
+    m_reload.watcher = nullptr;
+
+    discard_reloaded();
+}
+
+void Renderer::reload_worker(void)
+{
+    PROFILE_THREAD("shader reload");
+
+    while (!m_reload.quit) {
+        std::vector<std::string> changed;
+        if (!m_reload.watcher->Wait(RENDERER_RELOAD_POLL_MS, &changed)) {
+            continue;
+        }
+
+        /* A compile usually writes both stages; take them as one change. */
+        m_reload.watcher->Wait(RENDERER_RELOAD_SETTLE_MS, &changed);
+
+        std::lock_guard<std::mutex> guard(m_reload.build);
+        PROFILE_ZONE("Renderer::reload_worker");
+
+        const char* paths[2] = { nullptr, nullptr };
+        shader_paths(&paths[0], &paths[1]);
+
+        std::vector<char> code[2];
+        AssetPack::Span spans[2];
+        bool any = false;
+        bool ok = true;
+        for (int i = 0; i < 2; i++) {
+            bool hit = std::find(changed.begin(), changed.end(),
+              std::string(paths[i])) != changed.end();
+            if (!hit) {
+                spans[i] = find_shader(paths[i]);
+                continue;
+            }
+
+            any = true;
+            if (!read_spirv(paths[i], &code[i])) {
+                Log::Write(Log::WARNING, "Renderer -> {} isn't SPIR-V, "
+                  "keeping the old pipeline.", paths[i]);
+                ok = false;
+                break;
+            }
+            spans[i].data =
+              reinterpret_cast<const unsigned char*>(code[i].data());
+            spans[i].size = code[i].size();
+        }
+        if (!any || !ok) {
+            continue;
+        }
+
+        /* The layout and the vertex attributes stay as they are. */
+        ShaderInterface iface;
+        if (reflect_shaders(spans[0], spans[1], &iface) ||
+          iface != m_pipeline.iface) {
+            Log::Write(Log::WARNING, "Renderer -> the new shaders need a "
+              "different pipeline layout; restart to pick them up.");
+            continue;
+        }
+
+        /*
+        * Only the variant the box draws with gets built here; the others
+        * go back to the variant builder once this one is swapped in.
+        */
+        uint64_t start = Timer::Ticks();
+        PipelineBuild build = {};
+        build.state = m_box.state;
+        VkResult result = create_shader_modules(spans[0], spans[1],
+          &build.vmodule, &build.fmodule);
+        if (result == VK_SUCCESS) {
+            result = build_variant(build.state, build.vmodule, build.fmodule,
+              &build.pipeline);
+            if (result) {
+                vkDestroyShaderModule(m_device, build.vmodule, nullptr);
+                vkDestroyShaderModule(m_device, build.fmodule, nullptr);
+            }
+        }
+        if (result) {
+            Log::Write(Log::WARNING, "Renderer -> shader reload failed with "
+              "{}, keeping the old pipeline.", result);
+            continue;
+        }
+
+        /* Swapchain rebuilds from here on get the new code as well. */
+        for (int i = 0; i < 2; i++) {
+            if (code[i].empty()) {
+                continue;
+            }
+            ShaderCode* shader = &m_shaders[paths[i]];
+            shader->storage.swap(code[i]);
+            shader->span.data = reinterpret_cast<const unsigned char*>(
+              shader->storage.data());
+            shader->span.size = shader->storage.size();
+        }
+
+        Log::Write(Log::ROUTINE, "Renderer -> rebuilt the pipeline in {} ms.",
+          clock_ms(start, Timer::Ticks()));
+
+        /* Render() may not have picked up the last one yet; this wins. */
+        discard_reloaded();
+
+        std::lock_guard<std::mutex> hand(m_reload.lock);
+        m_reload.ready = build;
+        m_reload.pending = true;
+    }
+}
+
+/*
+* Called at the top of Render().  The last frame was waited for at its
+* end, so the old variants can go right away.  Every one of them was
+* built from the old modules, so they're all queued again against the
+* new ones.  The check up front keeps this to one atomic load on every
+* frame without a new pipeline.
+*/
+void Renderer::swap_reloaded(void)
+{
+    if (!m_reload.pending) {
+        return;
+    }
+
+    PipelineBuild build;
+    {
+        std::lock_guard<std::mutex> hand(m_reload.lock);
+        build = m_reload.ready;
+        m_reload.pending = false;
+    }
+
+    std::vector<PipelineState> known;
+    m_variants->Clear(&known);
+    vkDestroyShaderModule(m_device, m_pipeline.vshadermodule, nullptr);
+    vkDestroyShaderModule(m_device, m_pipeline.fshadermodule, nullptr);
+
+    m_pipeline.vshadermodule = build.vmodule;
+    m_pipeline.fshadermodule = build.fmodule;
+    m_variants->Insert(build.state, build.pipeline);
+    m_variants->Prepare(known);
+}
+
+/* Throws away a pipeline nobody has drawn with yet. */
+void Renderer::discard_reloaded(void)
+{
+    std::lock_guard<std::mutex> hand(m_reload.lock);
+    if (!m_reload.pending) {
+        return;
+    }
+
+    vkDestroyPipeline(m_device, m_reload.ready.pipeline, nullptr);
+    vkDestroyShaderModule(m_device, m_reload.ready.vmodule, nullptr);
+    vkDestroyShaderModule(m_device, m_reload.ready.fmodule, nullptr);
+    m_reload.pending = false;
+}
@@ -0,0 +1,238 @@
+#include "scheduler.h"
+
+#include "global.h"
+
+Scheduler* Scheduler::Init(VkDevice device, VkQueue queue, bool timeline)
+{
+    Scheduler* ret = new Scheduler();
+    ret->m_device = device;
+    ret->m_queue = queue;
+    ret->m_submitted = 0;
+    ret->m_completed = 0;
+    ret->m_timeline = VK_NULL_HANDLE;
+
+#if defined(VK_KHR_timeline_semaphore)
+    ret->m_wait = nullptr;
+    ret->m_counter = nullptr;
+    if (timeline) {
+        ret->m_wait = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device,
+          "vkWaitSemaphoresKHR");
+        ret->m_counter = (PFN_vkGetSemaphoreCounterValueKHR)
+          vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+    }
+
+    if (ret->m_wait != nullptr && ret->m_counter != nullptr) {
+        VkSemaphoreTypeCreateInfoKHR ti = {};
+        ti.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        ti.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        ti.initialValue = 0;
+
+        VkSemaphoreCreateInfo ci = {};
+        ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        ci.pNext = &ti;
+
+        VkResult result = vkCreateSemaphore(device, &ci, nullptr,
+          &ret->m_timeline);
+        if (result) {
+            Log::Write(Log::WARNING, "Scheduler::Init -> making the timeline "
+              "semaphore failed with {}; using fences.", result);
+            ret->m_timeline = VK_NULL_HANDLE;
+        }
+    }
+#else
+    (void)timeline;
+#endif
+
+    return ret;
+}
+
+void Scheduler::Release(Scheduler* scheduler)
+{
+    VkDevice device = scheduler->m_device;
+
+    if (scheduler->m_timeline != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device, scheduler->m_timeline, nullptr);
+    }
+
+    for (size_t i = 0; i < scheduler->m_pending.size(); i++) {
+        vkDestroyFence(device, scheduler->m_pending[i].fence, nullptr);
+    }
+    for (size_t i = 0; i < scheduler->m_fences.size(); i++) {
+        vkDestroyFence(device, scheduler->m_fences[i], nullptr);
+    }
+
+    delete(scheduler);
+}
+
+VkResult Scheduler::Submit(const VkSubmitInfo* info, uint64_t* value)
+{
+    VkResult result = VK_SUCCESS;
+    uint64_t next = m_submitted + 1;
+
+#if defined(VK_KHR_timeline_semaphore)
+    if (m_timeline != VK_NULL_HANDLE) {
+        std::vector<VkSemaphore> signals(info->pSignalSemaphores,
+          info->pSignalSemaphores + info->signalSemaphoreCount);
+        signals.push_back(m_timeline);
+
+        /* Values for binary semaphores are ignored, but still counted. */
+        std::vector<uint64_t> values(signals.size(), 0);
+        values.back() = next;
+
+        VkTimelineSemaphoreSubmitInfoKHR tsi = {};
+        tsi.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        tsi.pNext = info->pNext;
+        tsi.signalSemaphoreValueCount = values.size();
+        tsi.pSignalSemaphoreValues = values.data();
+
+        VkSubmitInfo si = *info;
+        si.pNext = &tsi;
+        si.signalSemaphoreCount = signals.size();
+        si.pSignalSemaphores = signals.data();
+
+        result = vkQueueSubmit(m_queue, 1, &si, VK_NULL_HANDLE);
+        if (result) {
+            return result;
+        }
+
+        m_submitted = next;
+        *value = next;
+        return result;
+    }
+#endif
+
+    /* Whatever's come back by now goes back in the pool first. */
+    retire();
+
+    VkFence fence = VK_NULL_HANDLE;
+    if (!m_fences.empty()) {
+        fence = m_fences.back();
+        m_fences.pop_back();
+    } else {
+        VkFenceCreateInfo ci = {};
+        ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        result = vkCreateFence(m_device, &ci, nullptr, &fence);
+        if (result) {
+            return result;
+        }
+    }
+
+    result = vkQueueSubmit(m_queue, 1, info, fence);
+    if (result) {
+        m_fences.push_back(fence);
+        return result;
+    }
+
+    Pending pending = { next, fence };
+    m_pending.push_back(pending);
+    m_submitted = next;
+    *value = next;
+
+    return result;
+}
+
+VkResult Scheduler::Wait(uint64_t value)
+{
+    /* Nothing would ever signal it. */
+    if (value > m_submitted) {
+        return VK_NOT_READY;
+    }
+    if (value <= m_completed) {
+        return VK_SUCCESS;
+    }
+
+    VkResult result = VK_SUCCESS;
+
+#if defined(VK_KHR_timeline_semaphore)
+    if (m_timeline != VK_NULL_HANDLE) {
+        VkSemaphoreWaitInfoKHR wi = {};
+        wi.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        wi.semaphoreCount = 1;
+        wi.pSemaphores = &m_timeline;
+        wi.pValues = &value;
+
+        result = m_wait(m_device, &wi, UINT64_MAX);
+        if (result == VK_SUCCESS) {
+            m_completed = value;
+        }
+        return result;
+    }
+#endif
+
+    size_t i = 0;
+    while (m_pending[i].value < value) {
+        i++;
+    }
+
+    result = vkWaitForFences(m_device, 1, &m_pending[i].fence, VK_TRUE,
+      UINT64_MAX);
+    if (result) {
+        return result;
+    }
+
+    /*
+    * A fence covers every batch submitted to the queue before its own, so
+    * the older ones are done too, signalled or not.
+    */
+    while (!m_pending.empty() && m_pending.front().value <= value) {
+        VkFence fence = m_pending.front().fence;
+        vkResetFences(m_device, 1, &fence);
+        m_fences.push_back(fence);
+        m_pending.pop_front();
+    }
+    m_completed = value;
+
+    return result;
+}
+
+VkResult Scheduler::WaitIdle(void)
+{
+    return Wait(m_submitted);
+}
+
+uint64_t Scheduler::GetCompleted(void)
+{
+#if defined(VK_KHR_timeline_semaphore)
+    if (m_timeline != VK_NULL_HANDLE) {
+        uint64_t value = 0;
+        if (m_counter(m_device, m_timeline, &value) == VK_SUCCESS) {
+            m_completed = value;
+        }
+        return m_completed;
+    }
+#endif
+
+    retire();
+    return m_completed;
+}
+
+bool Scheduler::Finished(uint64_t value)
+{
+    return value <= m_completed || value <= GetCompleted();
+}
+
+uint64_t Scheduler::GetSubmitted(void) const
+{
+    return m_submitted;
+}
+
+bool Scheduler::UsesTimeline(void) const
+{
+    return m_timeline != VK_NULL_HANDLE;
+}
+
+/* Oldest first, stopping at the first fence that's still out. */
+void Scheduler::retire(void)
+{
+    while (!m_pending.empty()) {
+        VkFence fence = m_pending.front().fence;
+        if (vkGetFenceStatus(m_device, fence) != VK_SUCCESS) {
+            break;
+        }
+
+        vkResetFences(m_device, 1, &fence);
+        m_fences.push_back(fence);
+        m_completed = m_pending.front().value;
+        m_pending.pop_front();
+    }
+}
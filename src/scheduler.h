@@ -0,0 +1,71 @@
+#ifndef VKTEST_SCHEDULER_H
+#define VKTEST_SCHEDULER_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/*
+* Every batch that goes to a queue through the Scheduler signals the next
+* value of a counter, so "is the GPU done with this?" comes down to
+* comparing the value of the submit that last used something against
+* GetCompleted().  Waiting on the CPU is waiting for one value, rather than
+* for the whole queue to go idle.
+*
+* With VK_KHR_timeline_semaphore the counter is a timeline semaphore: the
+* value rides along with whatever binary semaphores the batch already
+* signals, Wait() is vkWaitSemaphoresKHR and GetCompleted() is a counter
+* read.  Without it, each batch gets a fence out of a small pool, and the
+* counter moves on as the oldest of them come back signalled.
+*
+* One Scheduler per queue.  It isn't thread safe; the render thread owns it.
+*/
+class Scheduler {
+public:
+    static Scheduler* Init(VkDevice device, VkQueue queue, bool timeline);
+    static void Release(Scheduler* scheduler);
+
+    /*
+    * Submits one batch and hands back the value that it signals.  Binary
+    * semaphores, and anything else on the pNext chain, are kept as given.
+    */
+    VkResult Submit(const VkSubmitInfo* info, uint64_t* value);
+
+    /* Blocks until the GPU has got as far as 'value'. */
+    VkResult Wait(uint64_t value);
+    VkResult WaitIdle(void);
+
+    /* The last value the GPU is known to have reached, and a shorthand. */
+    uint64_t GetCompleted(void);
+    bool Finished(uint64_t value);
+
+    uint64_t GetSubmitted(void) const;
+    bool UsesTimeline(void) const;
+
+private:
+    struct Pending {
+        uint64_t value;
+        VkFence fence;
+    };
+
+    VkDevice m_device;
+    VkQueue m_queue;
+    uint64_t m_submitted;
+    uint64_t m_completed;
+
+    /* Timeline path */
+    VkSemaphore m_timeline;
+#if defined(VK_KHR_timeline_semaphore)
+    PFN_vkWaitSemaphoresKHR m_wait;
+    PFN_vkGetSemaphoreCounterValueKHR m_counter;
+#endif
+
+    /* Fence path, oldest first */
+    std::deque<Pending> m_pending;
+    std::vector<VkFence> m_fences;
+
+    void retire(void);
+};
+
+#endif  /* VKTEST_SCHEDULER_H */
@@ -0,0 +1,33 @@
+#include "shaderlib.h"
+
+#include "shaders_embedded.h"
+
+bool ShaderLibrary::Find(std::string name, AssetPack::Span* out)
+{
+    for (size_t i = 0; embedded_shaders[i].name != nullptr; i++) {
+        if (name == embedded_shaders[i].name) {
+            out->data = reinterpret_cast<const unsigned char*>(
+              embedded_shaders[i].code);
+            out->size = embedded_shaders[i].size;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+size_t ShaderLibrary::GetCount(void)
+{
+    return sizeof(embedded_shaders) / sizeof(embedded_shaders[0]) - 1;
+}
+
+std::string ShaderLibrary::NameOf(std::string path)
+{
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    size_t ext = name.rfind(".spv");
+    if (ext != std::string::npos && ext + 4 == name.size()) {
+        name.erase(ext);
+    }
+
+    return name;
+}
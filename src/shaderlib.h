@@ -0,0 +1,32 @@
+#ifndef VKTEST_SHADERLIB_H
+#define VKTEST_SHADERLIB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "pack.h"
+
+/* One entry in the manifest vktest-embed writes. */
+struct EmbeddedShader {
+    const char* name;           // "test.vert" for shaders/test.vert.spv
+    const uint32_t* code;
+    size_t size;                // in bytes
+};
+
+/*
+* The SPIR-V compiled into the executable at build time (see embed.cpp),
+* looked up by name.  Nothing here touches the disk; a build made without
+* a shader compiler may simply have less in it.
+*/
+class ShaderLibrary {
+public:
+    /* False if 'name' wasn't compiled in. */
+    static bool Find(std::string name, AssetPack::Span* out);
+    static size_t GetCount(void);
+
+    /* "./shaders/test.vert.spv" is "test.vert". */
+    static std::string NameOf(std::string path);
+};
+
+#endif // VKTEST_SHADERLIB_H
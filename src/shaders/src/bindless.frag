@@ -0,0 +1,37 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+/* Set per pipeline variant; see PipelineState::SpecConstant. */
+layout (constant_id = 0) const bool TEXTURE = true;
+layout (constant_id = 1) const bool VERTEX_COLOR = false;
+layout (constant_id = 2) const bool ALPHA_TEST = false;
+layout (constant_id = 3) const bool FLIP_U = true;
+layout (constant_id = 4) const float ALPHA_REF = 0.5;
+
+layout (binding = 1) uniform sampler2D textures[];
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec2 fragTexCoord;
+layout (location = 2) flat in uint fragTexture;
+
+layout (location = 0) out vec4 outColor;
+
+void main(void)
+{
+    vec4 color = vec4(1.0);
+    if (TEXTURE) {
+        vec2 coord = fragTexCoord;
+        if (FLIP_U) {
+            coord.x *= -1.0;
+        }
+        color = texture(textures[nonuniformEXT(fragTexture)], coord);
+    }
+    if (VERTEX_COLOR) {
+        color.rgb *= fragColor;
+    }
+    if (ALPHA_TEST && color.a < ALPHA_REF) {
+        discard;
+    }
+    outColor = color;
+}
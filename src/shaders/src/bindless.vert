@@ -0,0 +1,31 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (binding = 0) uniform CameraData {
+    mat4 viewProj;
+} camera;
+
+layout (push_constant) uniform ObjectData {
+    mat4 model;
+} object;
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inTexCoord;
+layout (location = 3) in uint inTexture;
+
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec2 fragTexCoord;
+layout (location = 2) flat out uint fragTexture;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main(void)
+{
+    gl_Position = camera.viewProj * object.model * vec4(inPosition, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+    fragTexture = inTexture;
+}
@@ -1,6 +1,13 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+/* Set per pipeline variant; see PipelineState::SpecConstant. */
+layout (constant_id = 0) const bool TEXTURE = true;
+layout (constant_id = 1) const bool VERTEX_COLOR = false;
+layout (constant_id = 2) const bool ALPHA_TEST = false;
+layout (constant_id = 3) const bool FLIP_U = true;
+layout (constant_id = 4) const float ALPHA_REF = 0.5;
+
 layout (binding = 1) uniform sampler2D texSampler;
 
 layout (location = 0) in vec3 fragColor;
@@ -10,6 +17,19 @@ layout (location = 0) out vec4 outColor;
 
 void main(void)
 {
-    vec2 coord = vec2(fragTexCoord.x * -1.0, fragTexCoord.y);
-    outColor = texture(texSampler, coord);
+    vec4 color = vec4(1.0);
+    if (TEXTURE) {
+        vec2 coord = fragTexCoord;
+        if (FLIP_U) {
+            coord.x *= -1.0;
+        }
+        color = texture(texSampler, coord);
+    }
+    if (VERTEX_COLOR) {
+        color.rgb *= fragColor;
+    }
+    if (ALPHA_TEST && color.a < ALPHA_REF) {
+        discard;
+    }
+    outColor = color;
 }
@@ -1,11 +1,13 @@
 #version 450
 #extension GL_ARB_seperate_shader_objects : enable
 
-layout (binding = 0) uniform UniformBufferObject {
+layout (binding = 0) uniform CameraData {
+    mat4 viewProj;
+} camera;
+
+layout (push_constant) uniform ObjectData {
     mat4 model;
-    mat4 view;
-    mat4 proj;
-} ubo;
+} object;
 
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec3 inColor;
@@ -20,7 +22,7 @@ out gl_PerVertex {
 
 void main(void)
 {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = camera.viewProj * object.model * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
@@ -0,0 +1,575 @@
+#include "spirv.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define SPIRV_MAGIC         (0x07230203)
+#define SPIRV_MAX_IDS       (1u << 22)  // far beyond any real shader
+#define SPIRV_MAX_MEMBERS   (1024)
+#define SPIRV_MAX_DEPTH     (16)        // type nesting
+
+/* The handful of opcodes and enumerants the layouts need. */
+enum {
+    OP_ENTRY_POINT          = 15,
+    OP_TYPE_BOOL            = 20,
+    OP_TYPE_INT             = 21,
+    OP_TYPE_FLOAT           = 22,
+    OP_TYPE_VECTOR          = 23,
+    OP_TYPE_MATRIX          = 24,
+    OP_TYPE_IMAGE           = 25,
+    OP_TYPE_SAMPLER         = 26,
+    OP_TYPE_SAMPLED_IMAGE   = 27,
+    OP_TYPE_ARRAY           = 28,
+    OP_TYPE_RUNTIME_ARRAY   = 29,
+    OP_TYPE_STRUCT          = 30,
+    OP_TYPE_POINTER         = 32,
+    OP_CONSTANT             = 43,
+    OP_SPEC_CONSTANT        = 50,
+    OP_VARIABLE             = 59,
+    OP_DECORATE             = 71,
+    OP_MEMBER_DECORATE      = 72
+};
+
+enum {
+    DECORATION_SPEC_ID          = 1,
+    DECORATION_BLOCK            = 2,
+    DECORATION_BUFFER_BLOCK     = 3,
+    DECORATION_ARRAY_STRIDE     = 6,
+    DECORATION_MATRIX_STRIDE    = 7,
+    DECORATION_BUILTIN          = 11,
+    DECORATION_LOCATION         = 30,
+    DECORATION_BINDING          = 33,
+    DECORATION_DESCRIPTOR_SET   = 34,
+    DECORATION_OFFSET           = 35
+};
+
+enum {
+    STORAGE_UNIFORM_CONSTANT    = 0,
+    STORAGE_INPUT               = 1,
+    STORAGE_UNIFORM             = 2,
+    STORAGE_PUSH_CONSTANT       = 9,
+    STORAGE_STORAGE_BUFFER      = 12
+};
+
+enum {
+    DIM_BUFFER          = 5,
+    DIM_SUBPASS_DATA    = 6
+};
+
+#define NONE    (0xffffffffu)
+
+/* Everything worth knowing about one result id. */
+struct Id {
+    uint32_t op;
+    uint32_t type;          // component, element, pointee or result type
+    uint32_t storage;       // pointers and variables
+    uint32_t width;         // scalar bits, vector or matrix count, image dim
+    uint32_t flag;          // int signedness, image sampled
+    uint32_t value;         // constants; the length's id for arrays
+    uint32_t set;
+    uint32_t binding;
+    uint32_t location;
+    uint32_t array_stride;
+    bool block;
+    bool buffer_block;
+    bool builtin;
+    std::vector<uint32_t> members;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> matrix_strides;
+};
+
+static VkShaderStageFlags stage_of(uint32_t model)
+{
+    switch (model) {
+    case 0:
+        return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1:
+        return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2:
+        return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3:
+        return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4:
+        return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5:
+        return VK_SHADER_STAGE_COMPUTE_BIT;
+    default:
+        return 0;
+    }
+}
+
+static void decorate_member(Id* id, uint32_t member, uint32_t decoration,
+  uint32_t value)
+{
+    if (member >= SPIRV_MAX_MEMBERS) {
+        return;
+    }
+    if (id->offsets.size() <= member) {
+        id->offsets.resize(member + 1, 0);
+        id->matrix_strides.resize(member + 1, 0);
+    }
+
+    switch (decoration) {
+    case DECORATION_OFFSET:
+        id->offsets[member] = value;
+        break;
+    case DECORATION_MATRIX_STRIDE:
+        id->matrix_strides[member] = value;
+        break;
+    case DECORATION_BUILTIN:
+        id->builtin = true;
+        break;
+    }
+}
+
+/* Bytes a type takes up in a block, as its decorations lay it out. */
+static uint32_t size_of(const std::vector<Id>& ids, uint32_t type,
+  uint32_t matrix_stride, int depth)
+{
+    if (type >= ids.size() || depth > SPIRV_MAX_DEPTH) {
+        return 0;
+    }
+
+    const Id& t = ids[type];
+    switch (t.op) {
+    case OP_TYPE_BOOL:
+        return 4;
+    case OP_TYPE_INT:
+    case OP_TYPE_FLOAT:
+        return t.width / 8;
+    case OP_TYPE_VECTOR:
+        return t.width * size_of(ids, t.type, 0, depth + 1);
+    case OP_TYPE_MATRIX:
+        if (matrix_stride != 0) {
+            return t.width * matrix_stride;
+        }
+        return t.width * size_of(ids, t.type, 0, depth + 1);
+    case OP_TYPE_ARRAY: {
+        uint32_t length = t.value < ids.size() ? ids[t.value].value : 0;
+        uint32_t stride = t.array_stride != 0 ? t.array_stride :
+          size_of(ids, t.type, matrix_stride, depth + 1);
+        return length * stride;
+    }
+    case OP_TYPE_STRUCT: {
+        uint32_t end = 0;
+        for (size_t i = 0; i < t.members.size(); i++) {
+            uint32_t offset = i < t.offsets.size() ? t.offsets[i] : 0;
+            uint32_t stride = i < t.matrix_strides.size() ?
+              t.matrix_strides[i] : 0;
+            end = std::max(end, offset +
+              size_of(ids, t.members[i], stride, depth + 1));
+        }
+        return end;
+    }
+    default:
+        return 0;
+    }
+}
+
+/* Only 32-bit scalars and vectors; nothing else goes in a vertex buffer. */
+static VkFormat format_of(const std::vector<Id>& ids, uint32_t type)
+{
+    static const VkFormat formats[3][4] = {
+        { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+          VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+        { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT,
+          VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT },
+        { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+          VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT }
+    };
+
+    uint32_t components = 1;
+    if (ids[type].op == OP_TYPE_VECTOR) {
+        components = ids[type].width;
+        type = ids[type].type;
+        if (type >= ids.size()) {
+            return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    const Id& scalar = ids[type];
+    if (components < 1 || components > 4 || scalar.width != 32) {
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    switch (scalar.op) {
+    case OP_TYPE_FLOAT:
+        return formats[0][components - 1];
+    case OP_TYPE_INT:
+        return formats[scalar.flag ? 1 : 2][components - 1];
+    default:
+        return VK_FORMAT_UNDEFINED;
+    }
+}
+
+/* What a descriptor of 'type' is, or false if it isn't one. */
+static bool descriptor_type(const std::vector<Id>& ids, uint32_t storage,
+  uint32_t type, VkDescriptorType* out)
+{
+    const Id& t = ids[type];
+
+    if (storage == STORAGE_STORAGE_BUFFER) {
+        *out = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        return true;
+    }
+
+    if (storage == STORAGE_UNIFORM) {
+        if (t.op != OP_TYPE_STRUCT) {
+            return false;
+        }
+        *out = t.buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER :
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        return true;
+    }
+
+    if (storage != STORAGE_UNIFORM_CONSTANT) {
+        return false;
+    }
+
+    switch (t.op) {
+    case OP_TYPE_SAMPLER:
+        *out = VK_DESCRIPTOR_TYPE_SAMPLER;
+        return true;
+    case OP_TYPE_SAMPLED_IMAGE:
+        *out = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        return true;
+    case OP_TYPE_IMAGE:
+        if (t.width == DIM_SUBPASS_DATA) {
+            *out = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        } else if (t.width == DIM_BUFFER) {
+            *out = t.flag == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER :
+              VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        } else {
+            *out = t.flag == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE :
+              VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool binding_less(const ShaderInterface::Binding& a,
+  const ShaderInterface::Binding& b)
+{
+    return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+}
+
+static bool input_less(const ShaderInterface::Input& a,
+  const ShaderInterface::Input& b)
+{
+    return a.location < b.location;
+}
+
+bool ShaderInterface::Reflect(const void* code, size_t size,
+  ShaderInterface* out)
+{
+    if (size % 4 != 0 || size < 20) {
+        return false;
+    }
+
+    /* Copied, since nothing promises the bytes are aligned. */
+    std::vector<uint32_t> words(size / 4);
+    std::memcpy(words.data(), code, size);
+    if (words[0] != SPIRV_MAGIC || words[3] == 0 ||
+      words[3] > SPIRV_MAX_IDS) {
+        return false;
+    }
+
+    Id blank = {};
+    blank.set = NONE;
+    blank.binding = NONE;
+    blank.location = NONE;
+    std::vector<Id> ids(words[3], blank);
+
+    *out = ShaderInterface();
+    for (size_t i = 5; i < words.size(); ) {
+        uint32_t op = words[i] & 0xffff;
+        uint32_t len = words[i] >> 16;
+        if (len == 0 || i + len > words.size()) {
+            return false;
+        }
+        const uint32_t* w = &words[i];
+        i += len;
+
+        /* Every opcode below names its result id in w[1] or w[2]. */
+        uint32_t result = NONE;
+        switch (op) {
+        case OP_ENTRY_POINT:
+            if (len >= 3 && out->stages == 0) {
+                out->stages = stage_of(w[1]);
+            }
+            continue;
+        case OP_CONSTANT:
+        case OP_SPEC_CONSTANT:
+        case OP_VARIABLE:
+            if (len < 4) {
+                return false;
+            }
+            result = w[2];
+            break;
+        case OP_DECORATE:
+        case OP_MEMBER_DECORATE:
+        case OP_TYPE_BOOL:
+        case OP_TYPE_INT:
+        case OP_TYPE_FLOAT:
+        case OP_TYPE_VECTOR:
+        case OP_TYPE_MATRIX:
+        case OP_TYPE_IMAGE:
+        case OP_TYPE_SAMPLER:
+        case OP_TYPE_SAMPLED_IMAGE:
+        case OP_TYPE_ARRAY:
+        case OP_TYPE_RUNTIME_ARRAY:
+        case OP_TYPE_STRUCT:
+        case OP_TYPE_POINTER:
+            if (len < 2) {
+                return false;
+            }
+            result = w[1];
+            break;
+        default:
+            continue;
+        }
+        if (result >= ids.size()) {
+            return false;
+        }
+
+        Id& id = ids[result];
+        switch (op) {
+        case OP_DECORATE:
+            if (len < 3) {
+                return false;
+            }
+            switch (w[2]) {
+            case DECORATION_BLOCK:
+                id.block = true;
+                break;
+            case DECORATION_BUFFER_BLOCK:
+                id.buffer_block = true;
+                break;
+            case DECORATION_BUILTIN:
+                id.builtin = true;
+                break;
+            case DECORATION_ARRAY_STRIDE:
+                id.array_stride = len > 3 ? w[3] : 0;
+                break;
+            case DECORATION_LOCATION:
+                id.location = len > 3 ? w[3] : NONE;
+                break;
+            case DECORATION_BINDING:
+                id.binding = len > 3 ? w[3] : NONE;
+                break;
+            case DECORATION_DESCRIPTOR_SET:
+                id.set = len > 3 ? w[3] : NONE;
+                break;
+            case DECORATION_SPEC_ID:
+                if (len > 3 && w[3] < 32) {
+                    out->spec_ids |= 1u << w[3];
+                }
+                break;
+            }
+            break;
+        case OP_MEMBER_DECORATE:
+            if (len < 4) {
+                return false;
+            }
+            decorate_member(&id, w[2], w[3], len > 4 ? w[4] : 0);
+            break;
+        case OP_CONSTANT:
+        case OP_SPEC_CONSTANT:
+            id.op = op;
+            id.type = w[1];
+            id.value = w[3];
+            break;
+        case OP_VARIABLE:
+            id.op = op;
+            id.type = w[1];
+            id.storage = w[3];
+            break;
+        case OP_TYPE_STRUCT:
+            id.op = op;
+            id.members.assign(w + 2, w + len);
+            break;
+        case OP_TYPE_POINTER:
+            if (len < 4) {
+                return false;
+            }
+            id.op = op;
+            id.storage = w[2];
+            id.type = w[3];
+            break;
+        default:
+            /* result, then (type or width), then (count or flag). */
+            id.op = op;
+            if (op == OP_TYPE_INT || op == OP_TYPE_FLOAT) {
+                id.width = len > 2 ? w[2] : 0;
+                id.flag = len > 3 ? w[3] : 0;
+            } else if (op == OP_TYPE_IMAGE) {
+                id.type = len > 2 ? w[2] : NONE;
+                id.width = len > 3 ? w[3] : 0;
+                id.flag = len > 7 ? w[7] : 0;
+            } else if (op == OP_TYPE_ARRAY) {
+                id.type = len > 2 ? w[2] : NONE;
+                id.value = len > 3 ? w[3] : NONE;
+            } else {
+                id.type = len > 2 ? w[2] : NONE;
+                id.width = len > 3 ? w[3] : 0;
+            }
+            break;
+        }
+    }
+
+    if (out->stages == 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        const Id& var = ids[i];
+        if (var.op != OP_VARIABLE || var.type >= ids.size() ||
+          ids[var.type].op != OP_TYPE_POINTER ||
+          ids[var.type].type >= ids.size()) {
+            continue;
+        }
+        uint32_t type = ids[var.type].type;
+
+        if (var.storage == STORAGE_PUSH_CONSTANT) {
+            const Id& block = ids[type];
+            uint32_t start = NONE;
+            for (size_t m = 0; m < block.members.size(); m++) {
+                start = std::min(start, m < block.offsets.size() ?
+                  block.offsets[m] : 0);
+            }
+            uint32_t end = size_of(ids, type, 0, 0);
+            if (start == NONE || end <= start) {
+                continue;
+            }
+            out->push.stageFlags = out->stages;
+            out->push.offset = start;
+            out->push.size = end - start;
+            continue;
+        }
+
+        if (var.storage == STORAGE_INPUT) {
+            if (out->stages != VK_SHADER_STAGE_VERTEX_BIT || var.builtin ||
+              var.location == NONE) {
+                continue;
+            }
+            Input input = { var.location, format_of(ids, type) };
+            out->inputs.push_back(input);
+            continue;
+        }
+
+        if (var.set == NONE || var.binding == NONE) {
+            continue;
+        }
+
+        Binding binding = {};
+        binding.set = var.set;
+        binding.binding = var.binding;
+        binding.count = 1;
+        binding.stages = out->stages;
+        if (ids[type].op == OP_TYPE_ARRAY) {
+            uint32_t length = ids[type].value;
+            binding.count = length < ids.size() ? ids[length].value : 1;
+            type = ids[type].type;
+        } else if (ids[type].op == OP_TYPE_RUNTIME_ARRAY) {
+            binding.count = 0;
+            type = ids[type].type;
+        }
+        if (type >= ids.size() ||
+          !descriptor_type(ids, var.storage, type, &binding.type)) {
+            continue;
+        }
+        out->bindings.push_back(binding);
+    }
+
+    std::sort(out->bindings.begin(), out->bindings.end(), binding_less);
+    std::sort(out->inputs.begin(), out->inputs.end(), input_less);
+
+    return true;
+}
+
+bool ShaderInterface::Merge(const ShaderInterface& other)
+{
+    for (size_t i = 0; i < other.bindings.size(); i++) {
+        const Binding& theirs = other.bindings[i];
+        Binding* ours = nullptr;
+        for (size_t j = 0; j < bindings.size() && ours == nullptr; j++) {
+            if (bindings[j].set == theirs.set &&
+              bindings[j].binding == theirs.binding) {
+                ours = &bindings[j];
+            }
+        }
+        if (ours == nullptr) {
+            bindings.push_back(theirs);
+            continue;
+        }
+        if (ours->type != theirs.type || ours->count != theirs.count) {
+            return false;
+        }
+        ours->stages |= theirs.stages;
+    }
+    std::sort(bindings.begin(), bindings.end(), binding_less);
+
+    /* One range for everybody, covering what each of them reads. */
+    if (other.push.size != 0) {
+        if (push.size == 0) {
+            push = other.push;
+        } else {
+            uint32_t start = std::min(push.offset, other.push.offset);
+            uint32_t end = std::max(push.offset + push.size,
+              other.push.offset + other.push.size);
+            push.offset = start;
+            push.size = end - start;
+            push.stageFlags |= other.push.stageFlags;
+        }
+    }
+
+    if (other.stages & VK_SHADER_STAGE_VERTEX_BIT) {
+        inputs = other.inputs;
+    }
+    stages |= other.stages;
+    spec_ids |= other.spec_ids;
+
+    return true;
+}
+
+const ShaderInterface::Binding* ShaderInterface::Find(uint32_t set,
+  uint32_t binding) const
+{
+    for (size_t i = 0; i < bindings.size(); i++) {
+        if (bindings[i].set == set && bindings[i].binding == binding) {
+            return &bindings[i];
+        }
+    }
+
+    return nullptr;
+}
+
+bool ShaderInterface::operator==(const ShaderInterface& other) const
+{
+    if (stages != other.stages || bindings.size() != other.bindings.size() ||
+      inputs.size() != other.inputs.size() ||
+      push.offset != other.push.offset || push.size != other.push.size ||
+      push.stageFlags != other.push.stageFlags) {
+        return false;
+    }
+
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const Binding& a = bindings[i];
+        const Binding& b = other.bindings[i];
+        if (a.set != b.set || a.binding != b.binding || a.type != b.type ||
+          a.count != b.count || a.stages != b.stages) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (inputs[i].location != other.inputs[i].location ||
+          inputs[i].format != other.inputs[i].format) {
+            return false;
+        }
+    }
+
+    return true;
+}
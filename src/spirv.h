@@ -0,0 +1,57 @@
+#ifndef VKTEST_SPIRV_H
+#define VKTEST_SPIRV_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/*
+* What a SPIR-V module expects of the pipeline it goes into, read straight
+* out of the module: the descriptors it declares, its push constants, and
+* for a vertex shader, the attributes it reads.  Enough to build the set
+* and pipeline layouts without writing them out by hand next to the GLSL.
+*
+* Only what the layouts need is parsed, plus which specialization constants
+* there are to set.  A binding the shader declares but never reads still
+* shows up, since the compiler keeps it.
+*/
+struct ShaderInterface {
+    struct Binding {
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType type;
+        uint32_t count;             // 0 for a runtime sized array
+        VkShaderStageFlags stages;
+    };
+
+    struct Input {
+        uint32_t location;
+        VkFormat format;
+    };
+
+    VkShaderStageFlags stages;
+    std::vector<Binding> bindings;  // by set, then binding
+    VkPushConstantRange push;       // size is 0 if there are none
+    std::vector<Input> inputs;      // by location
+    uint32_t spec_ids;              // bit n: declares constant_id n < 32
+
+    /* False if 'code' isn't SPIR-V, or is too broken to make sense of. */
+    static bool Reflect(const void* code, size_t size, ShaderInterface* out);
+
+    /*
+    * Folds in another stage's interface, as for two modules going into one
+    * pipeline.  False if the two declare the same binding differently.
+    */
+    bool Merge(const ShaderInterface& other);
+
+    const Binding* Find(uint32_t set, uint32_t binding) const;
+
+    bool operator==(const ShaderInterface& other) const;
+    bool operator!=(const ShaderInterface& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+#endif // VKTEST_SPIRV_H
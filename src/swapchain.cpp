@@ -1,7 +1,7 @@
 #include "swapchain.h"
 
 Swapchain* Swapchain::Init(VkSurfaceKHR surface, VkDevice device,
-  VkPhysicalDevice gpu)
+  VkPhysicalDevice gpu, Swapchain* old)
 {
     VkResult result = VK_SUCCESS;
     uint32_t count = 0;
@@ -130,7 +130,7 @@ Swapchain* Swapchain::Init(VkSurfaceKHR surface, VkDevice device,
     sci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     sci.presentMode = swapchain->m_presentmode;
     sci.clipped = VK_TRUE;
-    sci.oldSwapchain = VK_NULL_HANDLE;
+    sci.oldSwapchain = old != nullptr ? old->m_swapchain : VK_NULL_HANDLE;
 
     result = vkCreateSwapchainKHR(device, &sci, nullptr,
       &swapchain->m_swapchain);
@@ -225,8 +225,6 @@ VkResult Swapchain::GetImageView(uint32_t index, VkImageView* out)
 
 void Swapchain::release(VkDevice device)
 {
-    vkDeviceWaitIdle(device);
-
     for (uint32_t i = 0; i < m_views.size(); i++) {
         vkDestroyImageView(device, m_views[i], nullptr);
     }
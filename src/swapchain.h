@@ -8,8 +8,13 @@
 
 class Swapchain {
 public:
+    /*
+    * Passing the swapchain being replaced retires it, after which it only
+    * waits to be released.  Release() doesn't wait on the GPU; nothing
+    * submitted may still be using the swapchain or its image views.
+    */
     static Swapchain* Init(VkSurfaceKHR surface, VkDevice device,
-      VkPhysicalDevice gpu);
+      VkPhysicalDevice gpu, Swapchain* old = nullptr);
     static void Release(VkDevice device, Swapchain* swapchain);
 
     VkResult CreateImageViews(VkDevice device, uint32_t* count);
@@ -0,0 +1,178 @@
+#include "taskgraph.h"
+
+#include "cpuprofiler.h"
+#include "timer.h"
+
+TaskGraph* TaskGraph::Init(uint32_t threads)
+{
+    TaskGraph* graph = new TaskGraph();
+    graph->m_threads = threads;
+    graph->m_left = 0;
+    graph->m_running = 0;
+    graph->m_result = VK_SUCCESS;
+    graph->m_failed = nullptr;
+    graph->m_origin = 0;
+    graph->m_ms_per_tick = 1000.0 / Timer::Frequency();
+
+    return graph;
+}
+
+void TaskGraph::Release(TaskGraph* graph)
+{
+    delete(graph);
+}
+
+TaskGraph::Task TaskGraph::Add(const char* name,
+  std::function<VkResult(void)> work, std::vector<Task> deps, Flags flags)
+{
+    Task task = static_cast<Task>(m_nodes.size());
+
+    Node node;
+    node.name = name;
+    node.work = work;
+    node.waiting = 0;
+    node.flags = flags;
+    node.done = false;
+    node.span = {};
+    node.span.name = name;
+
+    for (size_t i = 0; i < deps.size(); i++) {
+        if (deps[i] >= task) {
+            Log::Write(Log::SEVERE, "TaskGraph::Add -> {} depends on a "
+              "step that comes after it.", name);
+            continue;
+        }
+        m_nodes[deps[i]].dependents.push_back(task);
+        node.waiting++;
+    }
+
+    m_nodes.push_back(node);
+
+    return task;
+}
+
+VkResult TaskGraph::Run(const char** failed)
+{
+    m_origin = Timer::Ticks();
+    m_left = static_cast<uint32_t>(m_nodes.size());
+    m_running = 0;
+    m_result = VK_SUCCESS;
+    m_failed = nullptr;
+
+    for (Task i = 0; i < m_nodes.size(); i++) {
+        if (m_nodes[i].waiting != 0) {
+            continue;
+        }
+        if (m_nodes[i].flags & MAIN) {
+            m_ready_main.insert(i);
+        } else {
+            m_ready_any.insert(i);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < m_threads; i++) {
+        workers.push_back(std::thread(&TaskGraph::worker, this, i + 1));
+    }
+
+    worker(0);
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    if (failed != nullptr) {
+        *failed = m_failed;
+    }
+
+    return m_result;
+}
+
+void TaskGraph::GetTimeline(std::vector<Span>* out)
+{
+    out->clear();
+    for (size_t i = 0; i < m_nodes.size(); i++) {
+        if (m_nodes[i].done) {
+            out->push_back(m_nodes[i].span);
+        }
+    }
+}
+
+/* The calling thread takes its own steps first, since nobody else can. */
+bool TaskGraph::pick(uint32_t thread, Task* out)
+{
+    if (m_result != VK_SUCCESS) {
+        return false;
+    }
+
+    std::set<Task>* ready = &m_ready_any;
+    if (thread == 0 && !m_ready_main.empty()) {
+        ready = &m_ready_main;
+    }
+    if (ready->empty()) {
+        return false;
+    }
+
+    *out = *ready->begin();
+    ready->erase(ready->begin());
+
+    return true;
+}
+
+void TaskGraph::worker(uint32_t thread)
+{
+    if (thread != 0) {
+        PROFILE_THREAD("startup");
+    }
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (;;) {
+        Task task;
+        if (!pick(thread, &task)) {
+            bool stopped = m_result != VK_SUCCESS && m_running == 0;
+            if (m_left == 0 || stopped) {
+                break;
+            }
+            m_wake.wait(lock);
+            continue;
+        }
+
+        m_running++;
+        Node* node = &m_nodes[task];
+        lock.unlock();
+
+        uint64_t start = Timer::Ticks();
+        VkResult result = node->work();
+        uint64_t end = Timer::Ticks();
+
+        lock.lock();
+        m_running--;
+        m_left--;
+
+        node->done = true;
+        node->span.thread = thread;
+        node->span.start_ms = (start - m_origin) * m_ms_per_tick;
+        node->span.end_ms = (end - m_origin) * m_ms_per_tick;
+
+        if (result != VK_SUCCESS) {
+            if (m_result == VK_SUCCESS) {
+                m_result = result;
+                m_failed = node->name;
+            }
+        } else {
+            for (size_t i = 0; i < node->dependents.size(); i++) {
+                Task next = node->dependents[i];
+                if (--m_nodes[next].waiting != 0) {
+                    continue;
+                }
+                if (m_nodes[next].flags & MAIN) {
+                    m_ready_main.insert(next);
+                } else {
+                    m_ready_any.insert(next);
+                }
+            }
+        }
+
+        m_wake.notify_all();
+    }
+}
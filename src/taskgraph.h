@@ -0,0 +1,91 @@
+#ifndef VKTEST_TASKGRAPH_H
+#define VKTEST_TASKGRAPH_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "global.h"
+
+/*
+* Runs a fixed set of named steps once each, every one as soon as the
+* steps it depends on are done, spread over a few worker threads and the
+* thread that calls Run().  Renderer::Init() uses it to overlap file I/O
+* and pipeline compilation with the rest of device setup.
+*
+* A step can only depend on steps added before it, so there's no way to
+* build a cycle.  Steps flagged MAIN only ever run on the thread that called
+* Run(): anything that talks to the window, submits to a queue or records
+* from a shared command pool goes there, which also keeps those in the order
+* they were added.
+*
+* Steps report failure with a VkResult.  Once one fails nothing new is
+* started; Run() waits for the steps already running and hands back the
+* first failure.  The workers only live for the length of Run().
+*/
+class TaskGraph {
+public:
+    typedef uint32_t Task;
+
+    enum Flags {
+        ANY     = 0x00,
+        MAIN    = 0x01
+    };
+
+    /* When a step ran, in milliseconds since Run() was called. */
+    struct Span {
+        const char* name;
+        uint32_t thread;        // 0 is whoever called Run()
+        double start_ms;
+        double end_ms;
+    };
+
+    static TaskGraph* Init(uint32_t threads);
+    static void Release(TaskGraph* graph);
+
+    /* 'name' isn't copied, so it should be a literal. */
+    Task Add(const char* name, std::function<VkResult(void)> work,
+      std::vector<Task> deps = std::vector<Task>(), Flags flags = ANY);
+
+    /* '*failed' names the step that failed, if one did. */
+    VkResult Run(const char** failed);
+
+    /* Every step that finished, in the order they were added. */
+    void GetTimeline(std::vector<Span>* out);
+
+private:
+    struct Node {
+        const char* name;
+        std::function<VkResult(void)> work;
+        std::vector<Task> dependents;
+        uint32_t waiting;       // dependencies not finished yet
+        Flags flags;
+        bool done;
+        Span span;
+    };
+
+    uint32_t m_threads;
+    std::vector<Node> m_nodes;
+
+    /* Everything below is guarded by m_lock while Run() is going. */
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::set<Task> m_ready_main;
+    std::set<Task> m_ready_any;
+    uint32_t m_left;
+    uint32_t m_running;
+    VkResult m_result;
+    const char* m_failed;
+
+    uint64_t m_origin;
+    double m_ms_per_tick;
+
+    bool pick(uint32_t thread, Task* out);
+    void worker(uint32_t thread);
+};
+
+#endif // VKTEST_TASKGRAPH_H
@@ -0,0 +1,287 @@
+#include "texstream.h"
+
+#include <cstring>
+
+#include "bcn.h"
+#include "cpuprofiler.h"
+
+const TextureStreamer::Handle TextureStreamer::INVALID_HANDLE;
+
+TextureStreamer* TextureStreamer::Init(uint32_t threads, bool decompress,
+  const AssetPack* pack)
+{
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    TextureStreamer* streamer = new TextureStreamer();
+    streamer->m_stats = {};
+    streamer->m_sequence = 0;
+    streamer->m_busy = 0;
+    streamer->m_pack = pack;
+    streamer->m_decompress = decompress;
+    streamer->m_quit = false;
+
+    for (uint32_t i = 0; i < threads; i++) {
+        streamer->m_workers.push_back(
+          std::thread(&TextureStreamer::worker, streamer));
+    }
+
+    return streamer;
+}
+
+void TextureStreamer::Release(TextureStreamer* streamer)
+{
+    {
+        std::lock_guard<std::mutex> guard(streamer->m_lock);
+        streamer->m_quit = true;
+    }
+    streamer->m_wake.notify_all();
+
+    for (size_t i = 0; i < streamer->m_workers.size(); i++) {
+        streamer->m_workers[i].join();
+    }
+
+    delete(streamer);
+}
+
+TextureStreamer::Handle TextureStreamer::Request(std::string path,
+  int priority)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    Slot slot;
+    slot.path = path;
+    slot.priority = priority;
+    slot.state = QUEUED;
+    slot.bytes = 0;
+    slot.rgba_bytes = 0;
+
+    Handle handle = static_cast<Handle>(m_slots.size());
+    m_slots.push_back(slot);
+
+    Job job;
+    job.handle = handle;
+    job.priority = priority;
+    job.sequence = m_sequence++;
+    m_jobs.push(job);
+
+    /* Get the kernel reading ahead while the request waits its turn. */
+    AssetPack::Span span;
+    if (m_pack != nullptr && m_pack->Find(path, &span)) {
+        m_pack->Prefetch(span);
+    }
+
+    m_stats.requested++;
+    m_wake.notify_one();
+
+    return handle;
+}
+
+bool TextureStreamer::Cancel(Handle handle)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (handle >= m_slots.size()) {
+        return false;
+    }
+
+    Slot& slot = m_slots[handle];
+    switch (slot.state) {
+    case QUEUED:
+    case DECODING:
+        /* The worker notices the state change and throws its work away. */
+        break;
+    case DECODED:
+        for (std::deque<Result>::iterator it = m_decoded.begin();
+          it != m_decoded.end(); ++it) {
+            if (it->handle == handle) {
+                m_decoded.erase(it);
+                break;
+            }
+        }
+        break;
+    default:
+        return false;
+    }
+
+    slot.state = CANCELLED;
+    m_stats.cancelled++;
+    return true;
+}
+
+TextureStreamer::State TextureStreamer::GetState(Handle handle)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (handle >= m_slots.size()) {
+        return FAILED;
+    }
+
+    return m_slots[handle].state;
+}
+
+void TextureStreamer::GetStats(Stats* out)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    out[0] = m_stats;
+}
+
+uint32_t TextureStreamer::GetThreadCount(void)
+{
+    return static_cast<uint32_t>(m_workers.size());
+}
+
+bool TextureStreamer::PopDecoded(Handle* handle, MipImage* img)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_decoded.empty()) {
+        return false;
+    }
+
+    Result& front = m_decoded.front();
+    handle[0] = front.handle;
+    img[0] = std::move(front.img);
+    m_decoded.pop_front();
+
+    return true;
+}
+
+void TextureStreamer::MarkResident(Handle handle)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (handle >= m_slots.size() || m_slots[handle].state != DECODED) {
+        return;
+    }
+
+    Slot& slot = m_slots[handle];
+    slot.state = RESIDENT;
+    m_stats.resident++;
+    m_stats.bytes_resident += slot.bytes;
+    m_stats.bytes_saved += slot.rgba_bytes - slot.bytes;
+}
+
+void TextureStreamer::WaitIdle(void)
+{
+    std::unique_lock<std::mutex> guard(m_lock);
+    while (!m_jobs.empty() || m_busy > 0) {
+        m_idle.wait(guard);
+    }
+}
+
+bool TextureStreamer::decode(const AssetPack* pack, std::string path,
+  bool decompress, MipImage* out)
+{
+    size_t dot = path.find_last_of('.');
+    std::string ext = dot == std::string::npos ? "" : path.substr(dot);
+
+    AssetPack::Span span;
+    bool packed = pack != nullptr && pack->Find(path, &span);
+
+    if (ext == ".dds" || ext == ".DDS") {
+        bool ok = packed ? ParseDDSView(out, span.data, span.size) :
+          ReadDDS(out, path);
+        if (!ok) {
+            return false;
+        }
+
+        if (decompress) {
+            MipImage rgba;
+            if (!DecompressImage(out, &rgba)) {
+                return false;
+            }
+            out[0] = std::move(rgba);
+
+            /* Nothing points into the pack any more. */
+            if (packed) {
+                pack->Done(span);
+            }
+        }
+
+        return true;
+    }
+
+    STBImage img;
+    bool ok = packed ? ReadImage(&img, span.data, span.size) :
+      ReadImage(&img, path);
+    if (!ok) {
+        return false;
+    }
+
+    out->format = MipImage::RGBA8;
+    out->srgb = false;
+    MipImageLayout(out, static_cast<uint32_t>(img.width),
+      static_cast<uint32_t>(img.height), 1);
+    std::memcpy(out->data.data(), img.data, out->data.size());
+    ReleaseImage(&img);
+
+    if (packed) {
+        pack->Done(span);
+    }
+
+    return true;
+}
+
+void TextureStreamer::worker(void)
+{
+    PROFILE_THREAD("decoder");
+    std::unique_lock<std::mutex> guard(m_lock);
+
+    while (true) {
+        while (!m_quit && m_jobs.empty()) {
+            m_wake.wait(guard);
+        }
+
+        if (m_quit) {
+            return;
+        }
+
+        Job job = m_jobs.top();
+        m_jobs.pop();
+
+        if (m_slots[job.handle].state != QUEUED) {
+            /* cancelled while it was waiting in line */
+            if (m_jobs.empty() && m_busy == 0) {
+                m_idle.notify_all();
+            }
+            continue;
+        }
+
+        m_slots[job.handle].state = DECODING;
+        std::string path = m_slots[job.handle].path;
+        m_busy++;
+
+        /* stb_image is reentrant, so the decode itself runs unlocked. */
+        guard.unlock();
+        Result result;
+        result.handle = job.handle;
+        {
+            PROFILE_ZONE("TextureStreamer::decode");
+            if (!decode(m_pack, path, m_decompress, &result.img)) {
+                result.img.levels.clear();
+                result.img.data.clear();
+                result.img.view = nullptr;
+            }
+        }
+        guard.lock();
+
+        m_busy--;
+        Slot& slot = m_slots[job.handle];
+        if (slot.state == CANCELLED) {
+            /* dropped on the floor */
+        } else if (result.img.levels.empty()) {
+            slot.state = FAILED;
+            m_stats.failed++;
+            m_decoded.push_back(std::move(result));
+        } else {
+            slot.state = DECODED;
+            slot.bytes = MipImageSize(&result.img);
+            slot.rgba_bytes = MipImageRGBASize(&result.img);
+            m_stats.decoded++;
+            m_stats.bytes_decoded += slot.bytes;
+            m_decoded.push_back(std::move(result));
+        }
+
+        if (m_jobs.empty() && m_busy == 0) {
+            m_idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef VKTEST_TEXSTREAM_H
+#define VKTEST_TEXSTREAM_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dds.h"
+#include "global.h"
+#include "pack.h"
+
+/*
+* The TextureStreamer owns a pool of worker threads that decode images off
+* of the render thread.  Request() hands back a Handle right away, and the
+* decoded pixels show up later through PopDecoded(), which the renderer
+* drains a few at a time to do the actual Vulkan upload.  Until that upload
+* happens, whoever is holding the handle is expected to draw a placeholder.
+*
+* Requests with a higher priority are decoded first.  Anything that hasn't
+* been uploaded yet can be cancelled.
+*
+* Files ending in .dds keep their block-compressed mips as they are, unless
+* the streamer was started with 'decompress' set (for GPUs without BC
+* support), in which case the workers unpack them to RGBA8.  Everything
+* else goes through stb_image.
+*
+* Paths found in the asset pack (if there is one) are read from the pack
+* mapping instead of the disk.  Compressed textures from the pack aren't
+* copied at all: the decoded MipImage is a view into the mapping, so the
+* pack has to outlive the streamer.
+*/
+class TextureStreamer {
+public:
+    typedef uint32_t Handle;
+    static const Handle INVALID_HANDLE = UINT32_MAX;
+
+    enum State {
+        QUEUED,
+        DECODING,
+        DECODED,
+        RESIDENT,
+        CANCELLED,
+        FAILED
+    };
+
+    struct Stats {
+        uint32_t requested;
+        uint32_t decoded;
+        uint32_t resident;
+        uint32_t cancelled;
+        uint32_t failed;
+        uint64_t bytes_decoded;
+        uint64_t bytes_resident;    // what the resident textures occupy
+        uint64_t bytes_saved;       // versus the same mips as RGBA8
+    };
+
+    static TextureStreamer* Init(uint32_t threads, bool decompress,
+      const AssetPack* pack = nullptr);
+    static void Release(TextureStreamer* streamer);
+
+    Handle Request(std::string path, int priority);
+    bool Cancel(Handle handle);
+    State GetState(Handle handle);
+    void GetStats(Stats* out);
+    uint32_t GetThreadCount(void);
+
+    /*
+    * Upload side.  PopDecoded hands over the decoded mip chain; a failed
+    * decode comes through with no levels so that the caller can report it.
+    * Call MarkResident once the image is on the GPU.
+    */
+    bool PopDecoded(Handle* handle, MipImage* img);
+    void MarkResident(Handle handle);
+
+    /* Blocks until every queued request has been decoded (or dropped). */
+    void WaitIdle(void);
+
+private:
+    struct Slot {
+        std::string path;
+        int priority;
+        State state;
+        uint64_t bytes;
+        uint64_t rgba_bytes;
+    };
+
+    struct Job {
+        Handle handle;
+        int priority;
+        uint64_t sequence;
+
+        /* std::priority_queue pops the "largest" element first. Ties go to
+         * whichever request was made first. */
+        bool operator<(const Job& other) const
+        {
+            if (priority != other.priority) {
+                return priority < other.priority;
+            }
+            return sequence > other.sequence;
+        }
+    };
+
+    struct Result {
+        Handle handle;
+        MipImage img;
+    };
+
+    std::vector<Slot> m_slots;
+    std::priority_queue<Job> m_jobs;
+    std::deque<Result> m_decoded;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+
+    Stats m_stats;
+    uint64_t m_sequence;
+    uint32_t m_busy;
+    const AssetPack* m_pack;
+    bool m_decompress;
+    bool m_quit;
+
+    static bool decode(const AssetPack* pack, std::string path,
+      bool decompress, MipImage* out);
+    void worker(void);
+};
+
+#endif // VKTEST_TEXSTREAM_H
@@ -8,6 +8,10 @@ public:
     Timer(void);
     virtual ~Timer(void) { };
     double Elapsed(void);
+
+    /* The raw performance counter, for anything that can't afford a divide. */
+    static uint64_t Ticks(void) { return SDL_GetPerformanceCounter(); }
+    static uint64_t Frequency(void) { return SDL_GetPerformanceFrequency(); }
 private:
     uint64_t m_start;
     uint64_t m_freq;
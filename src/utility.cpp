@@ -32,7 +32,7 @@ VkResult Utility::BufferSingleUseBegin(VkDevice device, VkCommandPool pool,
     return VK_SUCCESS;
 }
 
-VkResult Utility::BufferSingleUseEnd(VkDevice device, VkQueue queue,
+VkResult Utility::BufferSingleUseEnd(VkDevice device, Scheduler* scheduler,
   VkCommandPool pool, VkCommandBuffer buffer)
 {
     VkResult result = VK_SUCCESS;
@@ -49,16 +49,18 @@ VkResult Utility::BufferSingleUseEnd(VkDevice device, VkQueue queue,
     si.commandBufferCount = 1;
     si.pCommandBuffers = &buffer;
 
-    result = vkQueueSubmit(queue, 1, &si, VK_NULL_HANDLE);
+    uint64_t value = 0;
+    FlightRecorder::Record(FLIGHT_SUBMIT, UINT32_MAX);
+    result = scheduler->Submit(&si, &value);
     if (result) {
-        Log::Write(Log::SEVERE, "Call to vkQueueSubmit in "
+        Log::Write(Log::SEVERE, "Call to Scheduler::Submit in "
           "Utility::BufferSingleUseEnd failed.");
         return result;
     }
 
-    result = vkQueueWaitIdle(queue);
+    result = scheduler->Wait(value);
     if (result) {
-        Log::Write(Log::SEVERE, "Call to vkQueueWaitIdle in "
+        Log::Write(Log::SEVERE, "Call to Scheduler::Wait in "
           "Utility::BufferSingleUseEnd failed.");
         return result;
     }
@@ -69,12 +71,10 @@ VkResult Utility::BufferSingleUseEnd(VkDevice device, VkQueue queue,
 }
 
 VkResult Utility::CopyBuffer(VkDevice device, VkBuffer src, VkBuffer dst,
-  VkDeviceSize size, VkCommandPool pool, VkQueue queue)
+  VkDeviceSize size, VkCommandPool pool, Scheduler* scheduler)
 {
-    VkResult result = VK_SUCCESS;
-
     VkCommandBuffer buff;
-    result = Utility::BufferSingleUseBegin(device, pool, &buff);
+    VkResult result = Utility::BufferSingleUseBegin(device, pool, &buff);
     if (result) {
         Log::Write(Log::SEVERE, "Utility::CopyBuffer -> Call to "
           "Utility::BufferSingleUseBegin failed.");
@@ -82,13 +82,10 @@ VkResult Utility::CopyBuffer(VkDevice device, VkBuffer src, VkBuffer dst,
     }
 
     VkBufferCopy region = {};
-    region.srcOffset = 0;
-    region.dstOffset = 0;
     region.size = size;
-
     vkCmdCopyBuffer(buff, src, dst, 1, &region);
 
-    result = Utility::BufferSingleUseEnd(device, queue, pool, buff);
+    result = Utility::BufferSingleUseEnd(device, scheduler, pool, buff);
     if (result) {
         Log::Write(Log::SEVERE, "Utility::CopyBuffer -> Call to "
           "Utility::BufferSingleUseEnd failed.");
@@ -99,7 +96,7 @@ VkResult Utility::CopyBuffer(VkDevice device, VkBuffer src, VkBuffer dst,
 }
 
 VkResult Utility::CopyImage(VkDevice device, VkImage src, VkImage dst,
-  VkExtent2D extent, VkCommandPool pool, VkQueue queue)
+  VkExtent2D extent, VkCommandPool pool, Scheduler* scheduler)
 {
     VkCommandBuffer cbuff;
     VkResult result = Utility::BufferSingleUseBegin(device, pool, &cbuff);
@@ -127,7 +124,7 @@ VkResult Utility::CopyImage(VkDevice device, VkImage src, VkImage dst,
     vkCmdCopyImage(cbuff, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
       dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
-    result = Utility::BufferSingleUseEnd(device, queue, pool, cbuff);
+    result = Utility::BufferSingleUseEnd(device, scheduler, pool, cbuff);
     if (result) {
         Log::Write(Log::SEVERE, "Utility::CopyImage -> Call to "
           "Utility::BufferSingleUseEnd failed.");
@@ -137,3 +134,29 @@ VkResult Utility::CopyImage(VkDevice device, VkImage src, VkImage dst,
     return VK_SUCCESS;
 }
 
+
+VkResult Utility::CopyBufferToImage(VkDevice device, VkBuffer src,
+  VkImage dst, const std::vector<VkBufferImageCopy>& regions,
+  VkCommandPool pool, Scheduler* scheduler)
+{
+    VkCommandBuffer cbuff;
+    VkResult result = Utility::BufferSingleUseBegin(device, pool, &cbuff);
+    if (result) {
+        Log::Write(Log::SEVERE, "Utility::CopyBufferToImage -> call to "
+          "Utility::BufferSingleUseBegin failed.");
+        return result;
+    }
+
+    vkCmdCopyBufferToImage(cbuff, src, dst,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      static_cast<uint32_t>(regions.size()), regions.data());
+
+    result = Utility::BufferSingleUseEnd(device, scheduler, pool, cbuff);
+    if (result) {
+        Log::Write(Log::SEVERE, "Utility::CopyBufferToImage -> Call to "
+          "Utility::BufferSingleUseEnd failed.");
+        return result;
+    }
+
+    return VK_SUCCESS;
+}
@@ -6,7 +6,9 @@
 
 #include <vulkan/vulkan.h>
 
+#include "flightrec.h"
 #include "global.h"
+#include "scheduler.h"
 
 class Utility {
 public:
@@ -14,22 +16,31 @@ public:
     * There are quite a few circumstances in which you wish to do a single
     * piece of work with a command buffer.  These two helper functions provide
     * all the necessary boilerplate to make that process a little easier.
-    * vkQueueWaitIdle is called on the provided queue in the end command.
+    * The end command submits through the Scheduler and waits for just that
+    * one submit, not for the whole queue to drain.
     */
     static VkResult BufferSingleUseBegin(VkDevice device, VkCommandPool pool,
       VkCommandBuffer* buffer);
-    static VkResult BufferSingleUseEnd(VkDevice device, VkQueue queue,
+    static VkResult BufferSingleUseEnd(VkDevice device, Scheduler* scheduler,
       VkCommandPool pool, VkCommandBuffer buffer);
 
     /*
     * Pretty easy to understand, I think.  Copies from src, to dest.  It needs
     * to create a command buffer, and submit that command, so the command
-    * pool and VkQueue objects are required.  Cleans up after itself too..
+    * pool and Scheduler objects are required.  Cleans up after itself too..
     */
     static VkResult CopyBuffer(VkDevice device, VkBuffer src, VkBuffer dst,
-      VkDeviceSize size, VkCommandPool pool, VkQueue queue);
+      VkDeviceSize size, VkCommandPool pool, Scheduler* scheduler);
     static VkResult CopyImage(VkDevice device, VkImage src, VkImage dst,
-      VkExtent2D extent, VkCommandPool pool, VkQueue queue);
+      VkExtent2D extent, VkCommandPool pool, Scheduler* scheduler);
+
+    /*
+    * Buffer to image copy, one region per mip level (or whatever else the
+    * caller describes).  dst has to be in TRANSFER_DST_OPTIMAL already.
+    */
+    static VkResult CopyBufferToImage(VkDevice device, VkBuffer src,
+      VkImage dst, const std::vector<VkBufferImageCopy>& regions,
+      VkCommandPool pool, Scheduler* scheduler);
 };
 
 #endif /* VKTEST_UTILITY_H */